@@ -0,0 +1,54 @@
+/**
+ * @file AnalysisArena.hh
+ * @brief Pool allocation of the hits and tracks of the tracking analyses
+ */
+
+#ifndef ANALYSISARENA_HH
+#define ANALYSISARENA_HH
+
+#include <cstddef>
+
+//! Where the hits and tracks are allocated: one by one on the global heap (HEAP), or in the chunks of the analysis arena (ARENA)
+enum class ArenaAllocation { HEAP, ARENA };
+
+/**
+ * @class AnalysisArena
+ * @brief Small object pools for the many short-lived hits and tracks created by each analysis pass.
+ *
+ * In ARENA mode, objects are carved out of large chunks, with one set of chunks per thread and per size class
+ * (multiples of 16 bytes, up to 4 kB), and the freed objects are recycled within their size class. Each block
+ * starts with a pointer to its chunk, so that an object can be freed from any thread and whatever the current
+ * mode. release() hands back to the system, in one go, all the chunks without live objects: it is called at the
+ * end of every analysis pass (see AnalysisArena::Pass), so that the memory of a pass does not outlive it, while
+ * the objects kept across passes (e.g. the shared track sample) stay where they are.
+ */
+class AnalysisArena {
+public:
+  //! Select where the objects allocated from now on go
+  static void setAllocation(ArenaAllocation allocation) { s_allocation = allocation; }
+  static ArenaAllocation getAllocation() { return s_allocation; }
+
+  static void* allocate(std::size_t size);
+  static void  deallocate(void* object);
+
+  //! Free all the chunks without live objects, for all threads
+  static void release();
+
+  /**
+   * @class Pass
+   * @brief Scope of an analysis pass: the arena chunks left empty are released when it ends
+   */
+  class Pass {
+  public:
+    Pass() {}
+    ~Pass() { release(); }
+  private:
+    Pass(const Pass&) = delete;
+    Pass& operator=(const Pass&) = delete;
+  };
+
+private:
+  static ArenaAllocation s_allocation;
+};
+
+#endif
@@ -12,8 +12,6 @@
 #ifndef ANALYZER_H
 #define ANALYZER_H
 
-#define MY_RANDOM_SEED 0xcaffe
-
 #include <cmath>
 #include <string>
 #include <vector>
@@ -32,7 +30,7 @@
 
 #include <global_funcs.hh>
 
-#include "TRandom3.h"
+#include "CounterRandom.hh"
 #include "Module.hh"
 #include "AnalyzerVisitor.hh"
 #include "Bag.hh"
@@ -40,6 +38,7 @@
 #include "TagMaker.hh"
 #include "Hit.hh"
 #include "Track.hh"
+#include "ModuleSpatialIndex.hh"
 
 #include <TFile.h>
 #include <TProfile.h>
@@ -85,6 +84,9 @@ namespace insur {
   bool compareIntPairFirst(std::pair<int, int> p, std::pair<int, int> q);
   bool compareIntPairSecond(std::pair<int, int> p, std::pair<int, int> q);
 
+  //! Errors of the pattern recognition: track refitted for every hit, incremental propagation, or both (cross-checked, refit used)
+  enum class PatternRecoErrors { REFIT, INCREMENTAL, VALIDATE };
+
 
   /**
    * @class Analyzer
@@ -100,6 +102,11 @@ namespace insur {
   public:
     Analyzer();
     virtual ~Analyzer() {}  
+    void setCheckSpatialIndex(bool check) { checkSpatialIndex_ = check; } // cross-check every indexed hit search against the brute-force one
+    void setNumThreads(int numThreads) { numThreads_ = numThreads; } // number of worker threads sharing the material budget eta scan
+    void setPatternRecoErrors(PatternRecoErrors errors) { patternRecoErrors_ = errors; } // how the pattern reco errors are computed
+    void createTrackSample(MaterialBudget& mb, MaterialBudget* pm, int nTracks);
+    void clearTrackSamples() { trackSample_ = TrackSample(); patternRecoSample_ = TrackSample(); } // before the material budgets are replaced
     std::map<std::string, TH1D*>& getHistoActiveComponentsR() { return rComponents; }
     std::map<std::string, TH1D*>& getHistoActiveComponentsI() { return iComponents; }
     // TRACKING VOLUMES PLOTS
@@ -190,6 +197,7 @@ namespace insur {
                                MaterialBudget* pm = nullptr);
     bool checkFile(const std::string& fileName, const std::string& filePath);
     bool isTripletFromDifLayers(Track& track, int iHit, bool propagOutIn);
+    void validatePatternRecoError(const std::string& quantity, double refPointRPos, double incremental, double refit);
     bool analyzePatterReco(MaterialBudget& mb, mainConfigHandler& mainConfig, int etaSteps = 50, MaterialBudget* pm = nullptr);
     std::vector<TProfile*> hisPatternRecoInOutPt;//! InOut approach - tracker: Bkg contamination probability accumulated across eta for set of pT
     std::vector<TProfile*> hisPatternRecoInOutP; //! InOut approach - inner tracker: Bkg contamination probability accumulated across eta for set of pT
@@ -211,7 +219,9 @@ namespace insur {
     virtual void analyzeTriggerEfficiency(Tracker& tracker,
                                           const std::vector<double>& triggerMomenta,
                                           const std::vector<double>& thresholdProbabilities,
-                                          int etaSteps = 50);
+                                          int etaSteps = 50,
+                                          MaterialBudget* mb = nullptr,
+                                          MaterialBudget* pm = nullptr);
     void createTriggerDistanceTuningPlots(Tracker& tracker, const std::vector<double>& triggerMomenta);
     void analyzeGeometry(Tracker& tracker, int nTracks = 1000);
     void computeBandwidth(Tracker& tracker);
@@ -448,14 +458,14 @@ namespace insur {
     std::vector<TObject> savingGeometryV; // Vector of ROOT objects to be saved
     std::vector<TObject> savingMaterialV; // Vector of ROOT objects to be saved
 
-    const XYZVector getLuminousRegion();
+    const XYZVector getLuminousRegion(CounterRandom::Stream& draws);
     const XYZVector getLuminousRegionInMatBudgetAnalysis();
 
     Material findAllHits(MaterialBudget& mb, MaterialBudget* pm, Track& track);
 
     void computeDetailedWeights(std::vector<std::vector<ModuleCap> >& tracker, std::map<std::string, SummaryTable>& weightTables, bool byMaterial);
     virtual Material analyzeModules(std::vector<std::vector<ModuleCap> >& tr, Track& track,
-                                    std::map<std::string, Material>& sumComponentsRI, bool isPixel = false);
+                                    ComponentsRISum& sumComponentsRI, bool isPixel = false);
 
     int findHitsModules(Tracker& tracker, Track& t);
 
@@ -463,7 +473,7 @@ namespace insur {
     virtual Material findHitsModuleLayer(std::vector<ModuleCap>& layer, Track& t, bool isPixel = false);
 
     virtual Material findModuleLayerRI(std::vector<ModuleCap>& layer, Track& track,
-                                       std::map<std::string, Material>& sumComponentsRI, bool isPixel = false);
+                                       ComponentsRISum& sumComponentsRI, bool isPixel = false);
     virtual Material analyzeInactiveSurfaces(std::vector<InactiveElement>& elements, Track& track,
                                              std::map<std::string, Material>& sumServicesComponentsRI, MaterialProperties::Category cat = MaterialProperties::no_cat, bool isPixel = false);
     virtual Material findHitsInactiveSurfaces(std::vector<InactiveElement>& elements, Track& t, bool isPixel = false);
@@ -494,18 +504,46 @@ namespace insur {
     void fillCell(double r, double eta, double theta, Material mat);
     void fillMapRT(const double& r, const double& theta, const Material& mat);
     void fillMapRZ(const double& r, const double& z, const Material& mat);
+    void analyzeMaterialBudgetTrack(MaterialBudget& mb, MaterialBudget* pm, int nTracks, double eta, double phi, const XYZVector& origin);
+    void analyzeMaterialBudgetThreaded(MaterialBudget& mb, MaterialBudget* pm, int nTracks, double etaStep,
+                                       const std::vector<double>& phis, const XYZVector& origin, int numThreads);
+    void mergeMaterialBudget(Analyzer& worker, int nTracks);
+    std::vector<TH1D*> materialBudgetHistograms();
+    std::vector<std::map<std::string, TH1D*>*> materialBudgetComponentsHistograms();
     void transformEtaToZ();
     double findXThreshold(const TProfile& aProfile, const double& yThreshold, const bool& goForward );
     std::pair<double, double> computeMinMaxTracksEta(const Tracker& t) const;
 
   private:
-    // A random number generator
-    TRandom3 myDice; 
     int findCellIndexR(double r);
     int findCellIndexEta(double eta);
     int createResetCounters(Tracker& tracker, std::map <std::string, int> &modTypes);
-    std::pair <XYZVector, double > shootDirection(double minEta, double maxEta);
+    std::pair <XYZVector, double > shootDirection(double minEta, double maxEta, CounterRandom::Stream& draws);
     std::vector<std::pair<Module*, HitType>> trackHit(const XYZVector& origin, const XYZVector& direction, Tracker::Modules& properModules);
+    // Spatial indexes shortlisting the modules which can be hit by a track, one per scanned collection (keyed by its address)
+    std::map<const void*, ModuleSpatialIndex> spatialIndexes_;
+    bool checkSpatialIndex_;
+    PatternRecoErrors patternRecoErrors_;
+    const ModuleSpatialIndex& spatialIndex(std::vector<ModuleCap>& layer);
+    const ModuleSpatialIndex& spatialIndex(Tracker::Modules& modules);
+    void checkSpatialIndexHits(const ModuleSpatialIndex& index, const XYZVector& origin, const XYZVector& direction, double zError = -1.) const;
+    // Tracks shot through the material budget with all their hits, shared by the analyses (see createTrackSample)
+    struct TrackSample {
+      std::pair<MaterialBudget*, MaterialBudget*> budgets = std::make_pair(nullptr, nullptr);
+      int size = 0;
+      TrackCollection tracks;
+    };
+    TrackSample trackSample_;       // eta from 0 to getEtaMaxTrigger() included, for the tagged tracking and the trigger efficiency
+    TrackSample patternRecoSample_; // eta at the centres of nTracks bins up to geom_max_eta_coverage, for the pattern recognition profiles
+    void fillTrackSample(TrackSample& sample, MaterialBudget& mb, MaterialBudget* pm, int nTracks, bool binCentres);
+    const TrackCollection& getTrackSample(MaterialBudget& mb, MaterialBudget* pm, int nTracks);
+    const TrackCollection& getPatternRecoSample(MaterialBudget& mb, MaterialBudget* pm, int nTracks);
+    // Threaded material budget analysis: the 2D material maps are too large to be cloned for each worker,
+    // so the workers record their fills, which are then replayed in the original track order
+    struct MaterialMapFill { double r, z; Material mat; };
+    int numThreads_;
+    bool bufferMaterialMapFills_;
+    std::vector<MaterialMapFill> materialMapFills_;
     void resetTypeCounter(std::map<std::string, int> &modTypes);
     double diffclock(clock_t clock1, clock_t clock2);
     Color_t colorPicker(std::string);
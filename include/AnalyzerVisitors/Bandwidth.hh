@@ -13,19 +13,42 @@
 
 #include "Visitor.hh"
 #include "SummaryTable.hh"
+#include "ModuleClasses.hh"
 
 class BandwidthVisitor : public ConstGeometryVisitor {
   TH1D &chanHitDistribution_, &bandwidthDistribution_, &bandwidthDistributionSparsified_;
 
+  // Hit channels, unsparsified and sparsified bandwidths of each strip sensor of a module
+  struct SensorBandwidth { double hitChannels, bandwidth, bandwidthSparsified; };
+  ModuleClassCache<std::vector<SensorBandwidth> > sensorBandwidths_;
+
   double nMB_;
+
+  std::vector<SensorBandwidth> computeBandwidths(const DetectorModule& m) const {
+    std::vector<SensorBandwidth> bandwidths;
+    for (auto s : m.sensors()) {
+      double occupancy = m.hitOccupancyPerEvent();
+      double hitChannels = occupancy * nMB_ * s.numChannels();
+      int nChips = s.totalROCs();
+
+      int spHdr = m.numSparsifiedHeaderBits();
+      int spPay = m.numSparsifiedPayloadBits();      
+
+      // Binary unsparsified (bps), then sparsified
+      bandwidths.push_back(SensorBandwidth{hitChannels, (16*nChips + s.numChannels())*100E3, ((spHdr*nChips)+(hitChannels*spPay))*100E3});
+    }
+    return bandwidths;
+  }
 public:
   BandwidthVisitor(TH1D& chanHitDistribution, TH1D& bandwidthDistribution, TH1D& bandwidthDistributionSparsified) :
       chanHitDistribution_(chanHitDistribution),
       bandwidthDistribution_(bandwidthDistribution),
-      bandwidthDistributionSparsified_(bandwidthDistributionSparsified)
+      bandwidthDistributionSparsified_(bandwidthDistributionSparsified),
+      sensorBandwidths_("BandwidthVisitor sensor bandwidths")
   {}
 
   void preVisit() {
+    sensorBandwidths_.clear();
     chanHitDistribution_.Reset();
     bandwidthDistribution_.Reset();
     bandwidthDistributionSparsified_.Reset();
@@ -45,19 +68,11 @@ public:
 
   void visit(const DetectorModule& m) {
     if (m.sensors().back().type() == SensorType::Strip) {
-      for (auto s : m.sensors()) {
-        double occupancy = m.hitOccupancyPerEvent();
-        double hitChannels = occupancy * nMB_ * s.numChannels();
-        chanHitDistribution_.Fill(hitChannels);
-        int nChips = s.totalROCs();
-
-        // Binary unsparsified (bps)
-        bandwidthDistribution_.Fill((16*nChips + s.numChannels())*100E3);
-
-        int spHdr = m.numSparsifiedHeaderBits();
-        int spPay = m.numSparsifiedPayloadBits();      
-
-        bandwidthDistributionSparsified_.Fill(((spHdr*nChips)+(hitChannels*spPay))*100E3);
+      const std::vector<SensorBandwidth>& bandwidths = sensorBandwidths_.get(m, [this](const DetectorModule& module) { return computeBandwidths(module); });
+      for (const SensorBandwidth& b : bandwidths) {
+        chanHitDistribution_.Fill(b.hitChannels);
+        bandwidthDistribution_.Fill(b.bandwidth);
+        bandwidthDistributionSparsified_.Fill(b.bandwidthSparsified);
       }
     }
   }
@@ -12,6 +12,7 @@
 #include "SimParms.hh"
 #include "Visitor.hh"
 #include "SummaryTable.hh"
+#include "PhiSymmetry.hh"
 
 typedef std::tuple<bool, bool, std::string, int, int> ModuleRef;
 // Used to identify an irradiated module : all info which matters in that respect.
@@ -37,6 +38,8 @@ class IrradiationPowerVisitor : public GeometryVisitor {
   std::map<ModuleRef, double> sensorsPowerMax_;
   std::map<ModuleRef, int> modulesCounter_;
   std::map<std::string, std::vector<const DetectorModule*> > mapTypeToFluence_;
+  const PhiSymmetry* symmetry_ = nullptr;
+  std::map<const DetectorModule*, std::pair<double, double> > representativeFluences_; // The fluence of a module applies to its images by the phi symmetry
 
  public:
   MultiSummaryTable sensorsPowerSummary;
@@ -45,6 +48,7 @@ class IrradiationPowerVisitor : public GeometryVisitor {
   
   void preVisit();
   void visit(SimParms& sp);
+  void visit(Tracker& t);
   void visit(Barrel& b);
   void visit(RodPair& r);
   void visit(Endcap& e);
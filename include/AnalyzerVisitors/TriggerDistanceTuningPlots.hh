@@ -31,6 +31,11 @@ class TriggerDistanceTuningPlotsVisitor : public ConstGeometryVisitor {
   std::map<std::string, bool> preparedProfiles_;
   std::map<std::string, bool> preparedTurnOn_;
 
+  static bool fastScan_;
+  static const double crossingTolerance_;
+  const std::vector<double> distanceGrid_ = scanGrid(0.5, 6, 0.02);
+  const std::vector<double> momentumGrid_ = scanGrid(0.5, 10, 0.02);
+
   
 
 
@@ -62,9 +67,138 @@ class TriggerDistanceTuningPlotsVisitor : public ConstGeometryVisitor {
       return 0;
     }
   }
+
+  static std::vector<double> scanGrid(double first, double last, double step) {
+    std::vector<double> grid;
+    for (double x=first; x<=last; x+=step) grid.push_back(x);
+    return grid;
+  }
+
+  // Crossing of a decreasing function with a level within [low, high], by bisection: low if the function is
+  // already below the level there, high if it is still above it at the end
+  template<class Function> static double findCrossing(Function f, double level, double low, double high) {
+    if (f(low) <= level) return low;
+    if (f(high) > level) return high;
+    while (high - low > crossingTolerance_) {
+      double middle = (low + high) / 2.;
+      if (f(middle) > level) low = middle; else high = middle;
+    }
+    return (low + high) / 2.;
+  }
+
+  // Efficiencies [%] of the modules with the same stub parameters, on flat grids: tuning[iDist*nMomenta+iPt] at
+  // the distances of distanceGrid_ and triggerMomenta_, turnOn[iPt*nWindows_+iWindow] at the momenta of
+  // momentumGrid_ and the windows 2*iWindow+1 (both with the negative or above 100% values set to -1, not filled)
+  struct EfficiencySurface {
+    std::vector<double> tuning;
+    std::vector<double> turnOn;
+  };
+  std::map<std::string, EfficiencySurface> efficiencySurfaces_;
+
+  const EfficiencySurface& efficiencySurface(const DetectorModule& aModule) {
+    PtErrorAdapter pterr(aModule);
+    EfficiencySurface& surface = efficiencySurfaces_[pterr.stubSignature()];
+    if (!surface.tuning.empty() || !surface.turnOn.empty()) return surface;
+    for (double dist : distanceGrid_) {
+      for (double myPt : triggerMomenta_) surface.tuning.push_back(filledEfficiency(pterr.getTriggerProbability(myPt, dist)));
+    }
+    for (double myPt : momentumGrid_) {
+      for (unsigned int iWindow=0; iWindow<nWindows_; ++iWindow) {
+        surface.turnOn.push_back(filledEfficiency(pterr.getTriggerProbability(myPt, aModule.dsDistance(), iWindow*2+1)));
+      }
+    }
+    return surface;
+  }
+
+  static double filledEfficiency(double probability) {
+    double myValue = 100 * probability;
+    return ((myValue>=0) && (myValue<=100)) ? myValue : -1;
+  }
+
+  void fillEfficiencyProfiles(const DetectorModule& aModule, std::map<double, TProfile>& tuningProfiles, std::map<double, TProfile>& turnonProfiles) {
+    if (fastScan_) {
+      const EfficiencySurface& surface = efficiencySurface(aModule);
+      for (unsigned int iDist=0; iDist<distanceGrid_.size(); ++iDist) {
+        for (unsigned int iPt=0; iPt<triggerMomenta_.size(); ++iPt) {
+          double myValue = surface.tuning[iDist*triggerMomenta_.size() + iPt];
+          if (myValue>=0) tuningProfiles[triggerMomenta_[iPt]].Fill(distanceGrid_[iDist], myValue);
+        }
+      }
+      for (unsigned int iPt=0; iPt<momentumGrid_.size(); ++iPt) {
+        for (unsigned int iWindow=0; iWindow<nWindows_; ++iWindow) {
+          double myValue = surface.turnOn[iPt*nWindows_ + iWindow];
+          if (myValue>=0) turnonProfiles[iWindow*2+1].Fill(momentumGrid_[iPt], myValue);
+        }
+      }
+      return;
+    }
+
+    PtErrorAdapter pterr(aModule);
+
+    // Fill the tuning profiles for the windows actually set
+    for (double dist=0.5; dist<=6; dist+=0.02) {
+      for (std::vector<double>::const_iterator it=triggerMomenta_.begin(); it!=triggerMomenta_.end(); ++it) {
+        double myPt = (*it);
+        double myValue = 100 * pterr.getTriggerProbability(myPt, dist);
+        if ((myValue>=0) && (myValue<=100))
+          tuningProfiles[myPt].Fill(dist, myValue);
+      }
+    }
+
+    // Fill the turnon curves profiles for the distance actually set
+    for (double myPt=0.5; myPt<=10; myPt+=0.02) {
+      for (unsigned int iWindow=0; iWindow<nWindows_; ++iWindow) {
+        double windowSize=iWindow*2+1;
+        double distance = aModule.dsDistance();
+        double myValue = 100 * pterr.getTriggerProbability(myPt, distance, int(windowSize));
+        if ((myValue>=0) && (myValue<=100))
+          turnonProfiles[windowSize].Fill(myPt, myValue);
+      }
+    }
+  }
+
+  // Spacing tuning of the modules of one type for one window: the spacing below which each module keeps more than
+  // 1% efficiency at the low momentum, and the edges of the optimal spacing range of the average module, all found
+  // by root finding on the efficiencies of one module per set of equal stub parameters
+  void findSpacingTuningFast(const ModuleVector& myModules, int windowSize, const std::pair<double, double>& spacingTuningMomenta,
+                             std::map<const DetectorModule*, double>& minDistBelow, double& lowEdge, double& highEdge) {
+    std::map<std::string, std::pair<const DetectorModule*, int> > signatures;
+    std::map<const DetectorModule*, const DetectorModule*> representatives;
+    for (const DetectorModule* aModule : myModules) {
+      auto& signature = signatures[PtErrorAdapter(*aModule).stubSignature()];
+      if (signature.second++ == 0) signature.first = aModule;
+      representatives[aModule] = signature.first;
+    }
+
+    std::vector<PtErrorAdapter> adapters;
+    std::vector<int> counts;
+    std::map<const DetectorModule*, double> representativeDistances;
+    for (const auto& signature : signatures) {
+      adapters.push_back(PtErrorAdapter(*signature.second.first));
+      counts.push_back(signature.second.second);
+      PtErrorAdapter& pterr = adapters.back();
+      auto lowEfficiency = [&](double dist) { return 100 * pterr.getTriggerProbability(spacingTuningMomenta.first, dist, windowSize); };
+      representativeDistances[signature.second.first] = lowEfficiency(distanceGrid_.front()) > 1 ? findCrossing(lowEfficiency, 1, distanceGrid_.front(), distanceGrid_.back()) : 0.;
+    }
+    for (const DetectorModule* aModule : myModules) minDistBelow[aModule] = representativeDistances[representatives[aModule]];
+
+    auto averageEfficiency = [&](double myPt, double dist) {
+      double sum = 0;
+      for (unsigned int i=0; i<adapters.size(); ++i) sum += counts[i] * 100 * adapters[i].getTriggerProbability(myPt, dist, windowSize);
+      return sum / myModules.size();
+    };
+    auto averageLow = [&](double dist) { return averageEfficiency(spacingTuningMomenta.first, dist); };
+    auto averageHigh = [&](double dist) { return averageEfficiency(spacingTuningMomenta.second, dist); };
+    lowEdge = averageLow(distanceGrid_.back()) >= 1 ? 100 : findCrossing(averageLow, 1, distanceGrid_.front(), distanceGrid_.back());
+    highEdge = averageHigh(distanceGrid_.front()) <= 90 ? 0 : findCrossing(averageHigh, 90, distanceGrid_.front(), distanceGrid_.back());
+  }
  
 
 public:
+  //! Evaluates the efficiencies once per set of modules with the same stub parameters, and finds the spacing
+  //! tuning limits by root finding instead of scanning profiles
+  static void setFastScan(bool fastScan) { fastScan_ = fastScan; }
+
   TH1D optimalSpacingDistribution, optimalSpacingDistributionAW;
   TH1D spacingTuningFrame;
   ModuleOptimalSpacings moduleOptimalSpacings;
@@ -148,28 +282,7 @@ public:
     if ((center.Z()<0) || (center.Phi()<0) || (center.Phi()>M_PI/2)) return;
     theseBarrelModules.push_back(&aModule);
 
-    PtErrorAdapter pterr(aModule);
-
-    // Fill the tuning profiles for the windows actually set
-    for (double dist=0.5; dist<=6; dist+=0.02) {
-      for (std::vector<double>::const_iterator it=triggerMomenta_.begin(); it!=triggerMomenta_.end(); ++it) {
-        double myPt = (*it);
-        double myValue = 100 * pterr.getTriggerProbability(myPt, dist);
-        if ((myValue>=0) && (myValue<=100))
-          tuningProfiles[myPt].Fill(dist, myValue);
-      }
-    }
-
-    // Fill the turnon curves profiles for the distance actually set
-    for (double myPt=0.5; myPt<=10; myPt+=0.02) {
-      for (unsigned int iWindow=0; iWindow<nWindows_; ++iWindow) {
-        double windowSize=iWindow*2+1;
-        double distance = aModule.dsDistance();
-        double myValue = 100 * pterr.getTriggerProbability(myPt, distance, int(windowSize));
-        if ((myValue>=0) && (myValue<=100))
-          turnonProfiles[windowSize].Fill(myPt, myValue);
-      }
-    }
+    fillEfficiencyProfiles(aModule, tuningProfiles, turnonProfiles);
   }
 
 
@@ -220,28 +333,7 @@ public:
       }     
     }
 
-    PtErrorAdapter pterr(aModule);
-
-    // Fill the tuning profiles for the windows actually set
-    for (double dist=0.5; dist<=6; dist+=0.02) {
-      for (std::vector<double>::const_iterator it=triggerMomenta_.begin(); it!=triggerMomenta_.end(); ++it) {
-        double myPt = (*it);
-        double myValue = 100 * pterr.getTriggerProbability(myPt, dist);
-        if ((myValue>=0) && (myValue<=100))
-          tuningProfiles[myPt].Fill(dist, myValue);
-      }
-    }
-
-    // Fill the turnon curves profiles for the distance actually set
-    for (double myPt=0.5; myPt<=10; myPt+=0.02) {
-      for (unsigned int iWindow=0; iWindow<nWindows_; ++iWindow) {
-        double windowSize=iWindow*2+1;
-        double distance = aModule.dsDistance();
-        double myValue = 100 * pterr.getTriggerProbability(myPt, distance, int(windowSize));
-        if ((myValue>=0) && (myValue<=100))
-          turnonProfiles[windowSize].Fill(myPt, myValue);
-      }
-    }
+    fillEfficiencyProfiles(aModule, tuningProfiles, turnonProfiles);
   }
 
   void postVisit() {
@@ -298,25 +390,31 @@ public:
       // Loop over the possible search windows
       for (unsigned int iWindow = 0; iWindow<nWindows_; ++iWindow) {
         windowSize = 1 + iWindow * 2;
+        std::map<const DetectorModule*, double> fastMinDistBelow;
+        double lowEdge, highEdge;
+        if (fastScan_) findSpacingTuningFast(myModules, windowSize, spacingTuningMomenta, fastMinDistBelow, lowEdge, highEdge);
         // Loop over the modules of type myName
         for (ModuleVector::const_iterator itModule = myModules.begin(); itModule!=myModules.end(); ++itModule) {
           const DetectorModule* aModule = (*itModule);
-          PtErrorAdapter pterr(*aModule);
           // Loop over the possible distances
           double minDistBelow = 0.;
           availableThinkness[aModule->dsDistance()] = true;
-          for (double dist=0.5; dist<=6; dist+=0.02) { // TODO: constant here
-            // First with the high momentum
-            myPt = (spacingTuningMomenta.second);
-            double myValue = 100 * pterr.getTriggerProbability(myPt, dist, windowSize);
-            if ((myValue>=0)&&(myValue<=100))
-              tempProfileHigh.Fill(dist, myValue);
-            // Then with low momentum
-            myPt = (spacingTuningMomenta.first);
-            myValue = 100 * pterr.getTriggerProbability(myPt, dist, windowSize);
-            if ((myValue>=0)&&(myValue<=100))
-              tempProfileLow.Fill(dist, myValue);
-            if (myValue>1) minDistBelow = dist;
+          if (fastScan_) minDistBelow = fastMinDistBelow[aModule];
+          else {
+            PtErrorAdapter pterr(*aModule);
+            for (double dist=0.5; dist<=6; dist+=0.02) { // TODO: constant here
+              // First with the high momentum
+              myPt = (spacingTuningMomenta.second);
+              double myValue = 100 * pterr.getTriggerProbability(myPt, dist, windowSize);
+              if ((myValue>=0)&&(myValue<=100))
+                tempProfileHigh.Fill(dist, myValue);
+              // Then with low momentum
+              myPt = (spacingTuningMomenta.first);
+              myValue = 100 * pterr.getTriggerProbability(myPt, dist, windowSize);
+              if ((myValue>=0)&&(myValue<=100))
+                tempProfileLow.Fill(dist, myValue);
+              if (myValue>1) minDistBelow = dist;
+            }
           }
           if (minDistBelow>=0) {
             if (windowSize==5) optimalSpacingDistribution.Fill(minDistBelow);
@@ -348,8 +446,10 @@ public:
           moduleOptimalSpacings[aModule][windowSize] = minDistBelow;
         }
         // Find the "high" and "low" points
-        double lowEdge = findXThreshold(tempProfileLow, 1, true);
-        double highEdge = findXThreshold(tempProfileHigh, 90, false);
+        if (!fastScan_) {
+          lowEdge = findXThreshold(tempProfileLow, 1, true);
+          highEdge = findXThreshold(tempProfileHigh, 90, false);
+        }
         // std::cerr << myName << ": " << lowEdge << " -> " << highEdge << std::endl; // debug
         double centerX; double sizeX;
         centerX = iType+(double(iWindow)+0.5)/(double(nWindows_));
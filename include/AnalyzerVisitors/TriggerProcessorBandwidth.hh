@@ -9,12 +9,12 @@
 #include "TH1.h"
 #include "TH2.h"
 #include "Math/Point2D.h"
-#include "TRandom3.h"
 #include "Math/Functor.h"
 #include "Math/BrentMinimizer1D.h"
 
 #include "Tracker.hh"
 #include "SimParms.hh"
+#include "CounterRandom.hh"
 
 #include "Visitor.hh"
 #include "SummaryTable.hh"
@@ -31,15 +31,33 @@ namespace AnalyzerHelpers {
   bool isPointInCircle(const Point& p, const Circle& c);
   bool areClockwise(const Point& p1, const Point& p2);
 
+  //! What the trigger tower assignment reads of a module: z, r and phi extents, and the corners in the transverse plane
+  struct ModuleExtents {
+    const DetectorModule* module;
+    int side;
+    double minZ, maxZ, minR, maxR, minPhi, maxPhi;
+    double centerPhi;
+    Point corners[4];
+  };
+  ModuleExtents moduleExtents(const DetectorModule& module);
+  std::vector<ModuleExtents> collectModuleExtents(const Tracker& tracker);
+
   double calculatePetalAreaMC(const Tracker& tracker, const SimParms& simParms, double crossoverR);
+  double calculatePetalAreaAnalytic(const Tracker& tracker, const SimParms& simParms, double crossoverR);
   double calculatePetalAreaModules(const Tracker& tracker, const SimParms& simParms, double crossoverR);
+  double calculatePetalAreaModules(const std::vector<ModuleExtents>& modules, double curvatureR, double crossoverR, int numTriggerProcessorsPhi);
   double calculatePetalCrossover(const Tracker& tracker, const SimParms& simParms);
+  double calculatePetalCrossover(const std::vector<ModuleExtents>& modules, const Tracker& tracker, const SimParms& simParms);
 
   bool isModuleInPetal(const DetectorModule& module, double petalPhi, double curvatureR, double crossoverR);
+  bool isModuleInPetal(const ModuleExtents& module, double petalPhi, double curvatureR, double crossoverR);
   bool isModuleInCircleSector(const DetectorModule& module, double startPhi, double endPhi);
+  bool isModuleInCircleSector(const ModuleExtents& module, double startPhi, double endPhi);
 
   bool isModuleInEtaSector(const SimParms& simParms, const Tracker& tracker, const DetectorModule& module, int etaSector); 
+  bool isModuleInEtaSector(const SimParms& simParms, const Tracker& tracker, const ModuleExtents& module, int etaSector);
   bool isModuleInPhiSector(const SimParms& simParms, const DetectorModule& module, double crossoverR, int phiSector);
+  bool isModuleInPhiSector(const SimParms& simParms, const ModuleExtents& module, double crossoverR, int phiSector);
 
 }
 
@@ -58,8 +76,23 @@ class TriggerProcessorBandwidthVisitor : public ConstGeometryVisitor {
   const Tracker* tracker_;
   const SimParms* simParms_;
 
+  // Trigger towers of each module, computed once for the numProcEta x numProcPhi towers
+  struct ModuleTowers {
+    int etaSectors = 0;                      // Eta sectors overlapping the module
+    std::vector<std::pair<int, int>> towers; // (eta, phi) of the towers the module is connected to
+  };
+  std::map<const DetectorModule*, ModuleTowers> towerLookup_;
+  void buildTowerLookup(const std::vector<ModuleExtents>& modules);
+  ModuleTowers moduleTowers(const ModuleExtents& m) const;
+
+  static bool checkPetalArea_;
+  void checkPetalArea() const;
+
   int accumulatedLayerOffset_ = 0;
 public:
+  //! Cross-check of the closed-form petal area against the Monte Carlo one at each crossover found (tklayout option --check-petal-area)
+  static void setCheckPetalArea(bool check) { checkPetalArea_ = check; }
+
   SummaryTable processorConnectionSummary, processorInboundBandwidthSummary, processorInboundStubPerEventSummary;
   SummaryTable processorCommonConnectionSummary;
   TH1I moduleConnectionsDistribution;
@@ -0,0 +1,80 @@
+/**
+ * @file BatchScan.hh
+ * @brief Analysis of a list of layouts and layout variants, summarized in a comparison table
+ */
+
+#ifndef BATCHSCAN_HH
+#define BATCHSCAN_HH
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "ConfigCache.hh"
+
+/**
+ * @struct BatchLayout
+ * @brief A layout of the batch: a geometry file, possibly with some of its configuration properties changed
+ */
+struct BatchLayout {
+  std::string name;
+  std::string geometryFile;
+  std::vector<std::pair<std::string, std::string> > overrides; // Configuration path, value
+};
+
+/**
+ * @class BatchScan
+ * @brief Runs the analysis of several layouts and writes a table comparing their key figures.
+ *
+ * The layouts are given one by one, or as parameter sweeps over a base layout, in a batch description:
+ *
+ *   Layout geometries/CMS_Phase2/OT613_200_IT404.cfg
+ *   Sweep {
+ *     base geometries/CMS_Phase2/OT614_200_IT404.cfg
+ *     parameter Tracker:Outer/Barrel:TBPS/Layer:1/radius
+ *     values 225,230,235
+ *   }
+ *
+ * The inputs shared by all the layouts (program configuration, material table) are loaded once, then each layout
+ * is analyzed in a forked process, which inherits them and keeps the global state of the geometry classes apart.
+ * Up to a given number of layouts are analyzed in parallel.
+ */
+class BatchScan {
+public:
+  BatchScan();
+
+  bool addLayout(const std::string& geometryFile);
+  bool readDescription(const std::string& fileName);
+  const std::vector<BatchLayout>& layouts() const { return layouts_; }
+
+  void setJobs(int jobs) { jobs_ = jobs; }
+  void setTracks(int geometryTracks, int materialTracks) { geometryTracks_ = geometryTracks; materialTracks_ = materialTracks; }
+  void setEtaValues(const std::vector<double>& etaValues) { etaValues_ = etaValues; }
+  void setPt(double pt) { pt_ = pt; }
+  void setTrackingTag(const std::string& trackingTag) { trackingTag_ = trackingTag; }
+  void setOutputDirectory(const std::string& outputDirectory) { outputDirectory_ = outputDirectory; }
+  void setWebSites(bool webSites) { webSites_ = webSites; }
+  void setConfigCache(const std::string& directory, ConfigCache::Check check) { configCacheDirectory_ = directory; configCacheCheck_ = check; }
+
+  bool run();
+
+private:
+  std::vector<BatchLayout> layouts_;
+  int jobs_;
+  int geometryTracks_, materialTracks_;
+  std::vector<double> etaValues_;
+  double pt_;
+  std::string trackingTag_;
+  std::string outputDirectory_;
+  bool webSites_;
+  std::string configCacheDirectory_;
+  ConfigCache::Check configCacheCheck_;
+
+  std::string uniqueName(const std::string& name) const;
+  std::string figuresFileName(const BatchLayout& layout) const;
+  void preloadSharedInputs() const;
+  bool analyzeLayout(const BatchLayout& layout) const;
+  bool writeComparisonTable() const;
+};
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * @file Benchmark.hh
+ * @brief Timing and memory benchmark of the main computing stages, with a comparison against a stored baseline
+ */
+
+#ifndef BENCHMARK_HH
+#define BENCHMARK_HH
+
+#include <string>
+#include <vector>
+
+/**
+ * @struct BenchmarkStage
+ * @brief Resources used by one computing stage on one geometry
+ */
+struct BenchmarkStage {
+  std::string name;
+  double wallSeconds;
+  double cpuSeconds;
+  long peakRssKb;     // Peak resident memory of the process when the stage ended
+};
+
+/**
+ * @struct BenchmarkGeometry
+ * @brief A benchmarked geometry file, with the stages measured on it
+ */
+struct BenchmarkGeometry {
+  std::string name;
+  std::string geometryFile;
+  bool completed;
+  std::vector<BenchmarkStage> stages;
+};
+
+/**
+ * @class Benchmark
+ * @brief Measures the wall-clock time, CPU time and peak memory of the main stages of tkLayout on reference geometries.
+ *
+ * The stages are run in the order of a full tkLayout analysis: configuration parsing, Tracker::build, the outer
+ * and inner cabling maps (on the layouts they are designed for, as with the option 'all'), the geometry analysis,
+ * Materialway::build, the material budget, analyzeMaterialBudget, analyzeTaggedTracking, analyzePatterReco and the
+ * generation of the Vizard web site. The stages nested in a Squid step (e.g. the configuration parsing within the
+ * tracker building) are read from the StopWatch profile, their CPU time being the one of the main thread; the
+ * others are measured around the Squid step, with the CPU time of the whole process.
+ *
+ * Each geometry is benchmarked in a forked process, so that the peak memory and the global state of the geometry
+ * classes of a geometry do not leak into the next one. With several repetitions, the minimum time of each stage
+ * is kept, which is the least noisy estimate of its cost. The results are written as JSON, and can be compared
+ * with those of a previous run: a stage regresses when its time or memory exceeds the baseline by more than the
+ * tolerance, stages shorter than a minimum duration being too noisy to be timed.
+ */
+class Benchmark {
+public:
+  Benchmark();
+
+  bool addGeometry(const std::string& geometryFile);
+  const std::vector<BenchmarkGeometry>& geometries() const { return geometries_; }
+
+  void setRepetitions(int repetitions) { repetitions_ = repetitions; }
+  void setTracks(int geometryTracks, int materialTracks) { geometryTracks_ = geometryTracks; materialTracks_ = materialTracks; }
+  void setOutputDirectory(const std::string& outputDirectory) { outputDirectory_ = outputDirectory; }
+  void setTolerance(double tolerance) { tolerance_ = tolerance; }
+  void setMinSeconds(double minSeconds) { minSeconds_ = minSeconds; }
+
+  bool run();
+  std::string resultsFileName() const { return outputDirectory_ + "/benchmark.json"; }
+  bool compare(const std::string& baselineFileName) const;
+
+private:
+  std::vector<BenchmarkGeometry> geometries_;
+  int repetitions_;
+  int geometryTracks_, materialTracks_;
+  std::string outputDirectory_;
+  double tolerance_;
+  double minSeconds_;
+
+  std::string stagesFileName(const BenchmarkGeometry& geometry) const;
+  bool measureGeometry(const BenchmarkGeometry& geometry) const;
+  bool readStages(BenchmarkGeometry& geometry) const;
+  bool writeResults() const;
+};
+
+#endif
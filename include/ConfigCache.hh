@@ -0,0 +1,60 @@
+/**
+ * @file ConfigCache.hh
+ * @brief Cache of the preprocessed and parsed geometry configuration
+ */
+
+#ifndef CONFIGCACHE_HH
+#define CONFIGCACHE_HH
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdint>
+#include <boost/property_tree/ptree.hpp>
+
+#include "MainConfigHandler.hh"
+
+class Tracker;
+
+/**
+ * @class ConfigCache
+ * @brief Keeps, for each geometry file, the result of expanding its @include tree and parsing it
+ * into a property tree, so that a later run on unchanged inputs skips both steps.
+ *
+ * A cache file records every file of the include tree with its size, modification time and content
+ * hash, the expanded configuration text and the property tree in a compact binary form. The entry is
+ * reused when the size and modification time of all the files are unchanged (MTIME), or only after
+ * hashing their contents again (VERIFY); INVALIDATE always rebuilds and overwrites it.
+ *
+ * Next to each entry, the resolved state of the modules built from it (DetId, subdetector and corner
+ * positions) is recorded, so that a run reusing the entry can check that the code still builds the same
+ * geometry from the same configuration.
+ */
+class ConfigCache {
+public:
+  enum Check { MTIME, VERIFY, INVALIDATE };
+
+  ConfigCache() : check_(MTIME) {}
+
+  void setDirectory(const std::string& directory) { directory_ = directory; }
+  void setCheck(Check check) { check_ = check; }
+  bool enabled() const { return !directory_.empty(); }
+
+  bool load(const std::string& geometryFile, std::string& expandedConfiguration, boost::property_tree::ptree& pt, ConfigIncludeTree& includeTree) const;
+  void save(const std::string& geometryFile, const std::string& expandedConfiguration, const boost::property_tree::ptree& pt, const ConfigIncludeTree& includeTree) const;
+  bool checkModules(const std::string& geometryFile, const std::vector<const Tracker*>& trackers) const;
+  void saveModules(const std::string& geometryFile, const std::vector<const Tracker*>& trackers) const;
+
+  static void writeString(std::ostream& os, const std::string& value);
+  static bool readString(std::istream& is, std::string& value);
+  static void writeTree(std::ostream& os, const boost::property_tree::ptree& pt);
+  static bool readTree(std::istream& is, boost::property_tree::ptree& pt);
+
+private:
+  std::string directory_;
+  Check check_;
+
+  std::string cacheFileName(const std::string& geometryFile) const;
+};
+
+#endif
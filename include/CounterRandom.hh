@@ -0,0 +1,101 @@
+/**
+ * @file CounterRandom.hh
+ * @brief Counter-based random numbers, reproducible whatever the order of the draws
+ */
+
+#ifndef COUNTERRANDOM_HH
+#define COUNTERRANDOM_HH
+
+#define MY_RANDOM_SEED 0xcaffe
+
+#include <cmath>
+#include <cstdint>
+
+/**
+ * @class CounterRandom
+ * @brief Random numbers of a Monte Carlo analysis, computed with the Philox4x32-10 function.
+ *
+ * Each number is obtained by encrypting a counter (analysis, track, draw) with the global seed as key, so the
+ * draws of track i of analysis A are a pure function of (seed, A, i): tracks can be processed in any order,
+ * in any thread or process, and still get the same numbers as in a serial run.
+ */
+class CounterRandom {
+public:
+  /**
+   * @enum Analysis The analyses drawing random numbers, each one with its own streams
+   */
+  enum Analysis { TrackSample = 1, TriggerEfficiency, MaterialBudget, Geometry, PetalArea, PatternRecoSample };
+
+  /**
+   * @class Stream
+   * @brief The sequence of random numbers of a single track
+   */
+  class Stream {
+  public:
+    /** @return A flat random number in [0, 1), with 53 random bits */
+    double uniform() {
+      if (used_ == 4) nextBlock();
+      uint32_t high = block_[used_++] >> 5;
+      uint32_t low = block_[used_++] >> 6;
+      return (high * 67108864. + low) / 9007199254740992.;
+    }
+    /** @return A gaussian random number (Box-Muller, one pair of flat numbers per draw) */
+    double gaus(double mean = 0., double sigma = 1.) {
+      double u1 = 1. - uniform(); // (0, 1]
+      double u2 = uniform();
+      return mean + sigma * sqrt(-2. * log(u1)) * cos(2. * M_PI * u2);
+    }
+
+  private:
+    friend class CounterRandom;
+    Stream(uint64_t seed, uint32_t analysis, uint64_t track) : draws_(0), used_(4) {
+      key_[0] = uint32_t(seed);
+      key_[1] = uint32_t(seed >> 32);
+      counter_[0] = uint32_t(track);
+      counter_[1] = uint32_t(track >> 32);
+      counter_[2] = analysis;
+    }
+    void nextBlock() {
+      counter_[3] = draws_++;
+      philox(counter_, key_, block_);
+      used_ = 0;
+    }
+
+    uint32_t key_[2];
+    uint32_t counter_[4];
+    uint32_t block_[4];
+    uint32_t draws_;
+    int used_;
+  };
+
+  CounterRandom(Analysis analysis, uint64_t seed = MY_RANDOM_SEED) : seed_(seed), analysis_(analysis) {}
+
+  Stream track(uint64_t index) const { return Stream(seed_, analysis_, index); }
+
+  /**
+   * Philox4x32 with 10 rounds (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC11)
+   */
+  static void philox(const uint32_t counter[4], const uint32_t key[2], uint32_t result[4]) {
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; round++) {
+      uint64_t product0 = uint64_t(0xD2511F53) * c0;
+      uint64_t product1 = uint64_t(0xCD9E8D57) * c2;
+      uint32_t n0 = uint32_t(product1 >> 32) ^ c1 ^ k0;
+      uint32_t n2 = uint32_t(product0 >> 32) ^ c3 ^ k1;
+      c1 = uint32_t(product1);
+      c3 = uint32_t(product0);
+      c0 = n0;
+      c2 = n2;
+      k0 += 0x9E3779B9;
+      k1 += 0xBB67AE85;
+    }
+    result[0] = c0; result[1] = c1; result[2] = c2; result[3] = c3;
+  }
+
+private:
+  uint64_t seed_;
+  Analysis analysis_;
+};
+
+#endif
@@ -72,6 +72,8 @@ public:
   void setModuleCap(ModuleCap* newCap) { myModuleCap_ = newCap ; }
   ModuleCap* getModuleCap() { return myModuleCap_ ; }
   const ModuleCap* getConstModuleCap() const { return myModuleCap_; }
+  void setEquivalenceClass(int id) { equivalenceClass_ = id; }
+  int equivalenceClass() const { return equivalenceClass_; } // See ModuleClasses, -1 when unclassified
 
   Property<int16_t, AutoDefault> side;
   Property<double, AutoDefault> skewAngle;
@@ -360,6 +362,7 @@ int numSegmentsEstimate() const { return sensors().front().numSegmentsEstimate()
   std::pair<XYZVector, HitType> checkTrackHits(const XYZVector& trackOrig, const XYZVector& trackDir);
   int numHits() const { return numHits_; }
   void resetHits() { numHits_ = 0; }
+  void countHit() { numHits_++; }
 
   std::string summaryType() const;
   std::string summaryFullType() const;
@@ -410,10 +413,11 @@ protected:
   XYZVector rAxis_;
   double tiltAngle_ = 0.;
 
-  int numHits_ = 0;
+  HitCounter numHits_;
   
   void clearSensorPolys() { for (auto& s : sensors_) s.clearPolys(); }
   ModuleCap* myModuleCap_ = nullptr;
+  int equivalenceClass_ = -1;
 
 private:
   PropertyNode<int> sensorNode;
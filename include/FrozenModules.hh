@@ -0,0 +1,96 @@
+#ifndef FROZENMODULES_H
+#define FROZENMODULES_H
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <cstdint>
+#include <Math/Vector3D.h>
+
+#include "Module.hh"
+#include "RayIntersection.hh"
+
+using ROOT::Math::XYZVector;
+
+namespace insur { class ModuleCap; }
+
+/**
+ * @class FrozenModules
+ * @brief Structure-of-arrays copy of the module attributes read by the analysis hot loops.
+ *
+ * Once a collection of modules is not modified anymore (after Tracker::build), freeze() copies the attributes
+ * needed while tracking into contiguous arrays indexed by the position of the module in the collection: centre,
+ * normal and corners, thickness, nominal resolutions, subdetector, layer (or disk) and ring, tilt angle, the hit
+ * polygons of the sensors and the tracking tags. freezeMaterials() adds the radiation and interaction lengths
+ * of the module caps, once the material budget is known. The analysis loops then read these arrays instead of
+ * going through the properties and the decorated geometry of each module.
+ *
+ * checkTrackHits() performs exactly the same operations as DetectorModule::checkTrackHits on the copied values,
+ * with the same intersection backend, so it returns the same hits, and it counts them in the module as well.
+ * crossedModules() tests a track against the sensors of all the modules at once, and crossedCandidates() against those
+ * of a list of modules, with the batched closed-form test.
+ */
+class FrozenModules {
+public:
+  void freeze(const std::vector<Module*>& modules, double zError);
+  void freezeMaterials(std::vector<insur::ModuleCap>& caps);
+  void clear();
+
+  int size() const { return modules_.size(); }
+  Module& module(int index) const { return *modules_[index]; }
+
+  XYZVector center(int index) const { return XYZVector(centerX_[index], centerY_[index], centerZ_[index]); }
+  XYZVector normal(int index) const { return XYZVector(normalX_[index], normalY_[index], normalZ_[index]); }
+  XYZVector corner(int index, int corner) const { const double* c = &corners_[12*index + 3*corner]; return XYZVector(c[0], c[1], c[2]); }
+  double thickness(int index) const { return thickness_[index]; }
+  double resolutionLocalX(int index) const { return resolutionLocalX_[index]; }
+  double resolutionLocalY(int index) const { return resolutionLocalY_[index]; }
+  ModuleSubdetector subdet(int index) const { return ModuleSubdetector(subdet_[index]); }
+  int layer(int index) const { return layer_[index]; }
+  int ring(int index) const { return ring_[index]; }
+  double tiltAngle(int index) const { return tiltAngle_[index]; }
+  double maxZ(int index) const { return maxZ_[index]; }
+  double radiationLength(int index) const { return radiationLength_[index]; }
+  double interactionLength(int index) const { return interactionLength_[index]; }
+  bool hasTrackingTag(int index, const std::string& tag) const;
+
+  bool couldHit(int index, const XYZVector& direction) const; // same as DetectorModule::couldHit with the zError given to freeze()
+  std::pair<XYZVector, HitType> checkTrackHits(int index, const XYZVector& trackOrig, const XYZVector& trackDir) const;
+  void crossedModules(const XYZVector& trackOrig, const XYZVector& trackDir, std::vector<bool>& crossed) const; // whether a sensor of each module is crossed (hits are not counted)
+  void crossedCandidates(const std::vector<int>& candidates, const XYZVector& trackOrig, const XYZVector& trackDir, std::vector<int>& crossed) const; // candidates with a crossed sensor, in the same order
+
+private:
+  // Hit polygon of a sensor, with the quantities DetectorModule::checkTrackHits derives from it
+  struct SensorPolys {
+    std::vector<double> vertices;       // 12 per module: 4 corners x (x, y, z)
+    std::vector<double> normal;         // 3 per module
+    std::vector<double> centerDotNormal;
+    std::vector<double> doubleArea;
+    std::vector<double> axis;           // 3 per module: unit vector from the first to the second corner
+    std::vector<double> stripLength;
+    PackedQuads quads;                  // corner and edges, for the closed-form test (RayIntersection)
+  };
+  static const int NoZCorrelation = -1;
+
+  std::vector<Module*> modules_;
+  std::vector<double> centerX_, centerY_, centerZ_;
+  std::vector<double> normalX_, normalY_, normalZ_;
+  std::vector<double> corners_;
+  std::vector<double> thickness_;
+  std::vector<double> resolutionLocalX_, resolutionLocalY_;
+  std::vector<int> subdet_, layer_, ring_;
+  std::vector<double> tiltAngle_, maxZ_;
+  std::vector<double> minEta_, maxEta_, minPhi_, maxPhi_;
+  std::vector<char> rectangular_;
+  std::vector<char> numSensors_;
+  std::vector<int> zCorrelation_, segmentsRatio_;
+  SensorPolys inner_, outer_;
+  std::vector<double> radiationLength_, interactionLength_;
+  std::vector<uint64_t> trackingTags_; // bit i set if the module has the tag trackingTagNames_[i]
+  std::vector<std::string> trackingTagNames_;
+
+  static void addSensor(SensorPolys& polys, const Sensor& sensor);
+  static int checkHitSegment(const SensorPolys& polys, int index, const XYZVector& trackOrig, const XYZVector& trackDir, XYZVector& p);
+};
+
+#endif
@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <functional>
 #include <array>
+#include <atomic>
 
 #include <boost/property_tree/info_parser.hpp>
 
@@ -34,9 +35,21 @@ namespace ModuleHelpers {
 
 enum ModuleShape { RECTANGULAR, WEDGE };
 
+// Counter of the hits on a module, which can be incremented concurrently by the threaded analyses; copies (clones) start from the current count
+class HitCounter {
+  std::atomic<int> count_;
+public:
+  HitCounter() : count_(0) {}
+  HitCounter(const HitCounter& other) : count_(other.count_.load()) {}
+  HitCounter& operator=(const HitCounter& other) { count_ = other.count_.load(); return *this; }
+  int operator++(int) { return count_.fetch_add(1, std::memory_order_relaxed); }
+  HitCounter& operator=(int count) { count_ = count; return *this; }
+  operator int() const { return count_.load(std::memory_order_relaxed); }
+};
+
 class GeometricModule : public ModuleDecorable {
 protected:
-  int numHits_ = 0;
+  HitCounter numHits_;
   bool flipped_ = false;
   int tiltAngle_ = 0., skewAngle_ = 0.;
   Polygon3d<4> basePoly_;
@@ -5,10 +5,15 @@
 #ifndef INCLUDE_HIT_H_
 #define INCLUDE_HIT_H_
 
+#include <atomic>
 #include <cmath>
 #include <vector>
 
+#include <boost/intrusive_ptr.hpp>
+
+#include "AnalysisArena.hh"
 #include "DetectorModule.hh"
+#include "InternedString.hh"
 #include "MaterialProperties.hh"
 
 // Forward declaration
@@ -37,6 +42,10 @@ enum class HitPassiveType : short { Undefined, BeamPipe, IP, Service, Support };
  * since those volumes only matter with respect to the radiation and interaction lengths they add to the total in the error calculations.
  * All the other information is available to both categories. For convenience, the scaled radiation and interaction lengths are stored in
  * here as well to avoid additional computation and callbacks to the material property objects.
+ *
+ * The position of the hit and the element it lies on (its geometry) are shared by the copies of a hit, e.g. by the copies of
+ * a track differing only in momentum, and only duplicated when one of the copies changes them. The per-track state (activity,
+ * corrected material, tracking volumes) belongs to each copy. Hits are allocated through the AnalysisArena.
  */
 // TODO: Remove pointer to track and find another method without any pointers involved!
 class Hit {
@@ -55,6 +64,10 @@ public:
   //! Destructor
   ~Hit();
 
+  //! Hits (and their geometry) are allocated through the analysis arena
+  static void* operator new(std::size_t size) { return AnalysisArena::allocate(size); }
+  static void  operator delete(void* hit)      { AnalysisArena::deallocate(hit); }
+
   //! Given two hits, compare the distance to the z-axis based on smaller R
   static bool sortSmallerR(const HitPtr& h1, const HitPtr& h2);
 
@@ -66,8 +79,8 @@ public:
 
   void setAsActive()                              { m_activity = HitActivity::Active;};
   void setAsPassive()                             { m_activity = HitActivity::Inactive;};
-  void setAsPixel()                               { m_isPixel    = true;}
-  void setActiveHitType(HitType activeHitType)    { m_activeHitType = activeHitType; }
+  void setAsPixel()                               { if (!m_geometry->isPixel) modifyGeometry().isPixel = true;}
+  void setActiveHitType(HitType activeHitType)    { if (m_geometry->activeHitType!=activeHitType) modifyGeometry().activeHitType = activeHitType; }
   void setCorrectedMaterial(RILength newMaterial) { m_correctedMaterial = newMaterial;};
 
   void setPixelIntersticeVolume(bool isVolume)    { m_isPixelIntersticeVol = isVolume; }
@@ -78,38 +91,38 @@ public:
 
   void setTrigger(bool isTrigger)                 { m_isTrigger = isTrigger;}
   void fillModuleLocalResolutionStats();
-  void setResolutionRphi(double newRes)           { m_resolutionRPhi = newRes; } // Only used for virtual hits on non-modules
-  void setResolutionZ(double newRes)              { m_resolutionZ = newRes; }    // Only used for virtual hits on non-modules
+  void setResolutionRphi(double newRes)           { modifyGeometry().resolutionRPhi = newRes; } // Only used for virtual hits on non-modules
+  void setResolutionZ(double newRes)              { modifyGeometry().resolutionZ = newRes; }    // Only used for virtual hits on non-modules
   void setResolutionY(double newRes)              { setResolutionZ(newRes); }    // Used for compatibility only -> use setResolutionZ(double newRes) instead
 
   // Getter methods
-  const DetectorModule* getHitModule() const                 { return m_hitModule; };
-  const insur::InactiveElement* getHitPassiveElement() const { return m_hitPassiveElem; }
+  const DetectorModule* getHitModule() const                 { return m_geometry->hitModule; };
+  const insur::InactiveElement* getHitPassiveElement() const { return m_geometry->hitPassiveElem; }
 
-  double   getDistance() const         { return m_distance;};
-  double   getRPos() const             { return m_rPos;};
-  double   getZPos() const             { return m_zPos;};
-  double   getTilt() const             { if (this->isMeasurable()) return m_hitModule->tiltAngle(); else return 0; };
+  double   getDistance() const         { return m_geometry->distance;};
+  double   getRPos() const             { return m_geometry->rPos;};
+  double   getZPos() const             { return m_geometry->zPos;};
+  double   getTilt() const             { if (this->isMeasurable()) return m_geometry->hitModule->tiltAngle(); else return 0; };
   bool     isActive() const            { if (m_activity==HitActivity::Active)   return true; else return false;};
   bool     isPassive() const           { if (m_activity==HitActivity::Inactive) return true; else return false;};
   bool     isActivityUndefined() const { if (m_activity==HitActivity::Undefined) return true; else return false;};
-  HitType  getActiveHitType() const    { return m_activeHitType; } // NONE, INNER, OUTER, BOTH or STUB -- only meaningful for hits on active elements
+  HitType  getActiveHitType() const    { return m_geometry->activeHitType; } // NONE, INNER, OUTER, BOTH or STUB -- only meaningful for hits on active elements
   RILength getCorrectedMaterial();
   double   getResolutionRphi(double trackRadius);
   double   getResolutionZ(double trackRadius);
   double   getD();
 
-  std::string getDetName()       const { return m_detName; };
+  const std::string& getDetName() const { return m_geometry->detName; };
   int         getLayerOrDiscID() const;
 
-  bool     isBeamPipe() const  { if (m_passiveHitType==HitPassiveType::BeamPipe) return true; else return false; };
-  bool     isService() const   { if (m_passiveHitType==HitPassiveType::Service) return true; else return false; };
-  bool     isSupport() const   { if (m_passiveHitType==HitPassiveType::Support) return true; else return false; };
-  bool     isIP() const        { if (m_passiveHitType==HitPassiveType::IP) return true; else return false; };
-  bool     isPixel() const     { return m_isPixel; };
-  bool     isBarrel() const    { if (m_hitModule && (m_hitModule->subdet()==BARREL)) return true; else return false;};
-  bool     isEndcap() const    { if (m_hitModule && (m_hitModule->subdet()==ENDCAP)) return true; else return false;};
-  bool     isMeasurable() const{ if (m_hitModule!=nullptr) return true; else return false;};
+  bool     isBeamPipe() const  { if (m_geometry->passiveHitType==HitPassiveType::BeamPipe) return true; else return false; };
+  bool     isService() const   { if (m_geometry->passiveHitType==HitPassiveType::Service) return true; else return false; };
+  bool     isSupport() const   { if (m_geometry->passiveHitType==HitPassiveType::Support) return true; else return false; };
+  bool     isIP() const        { if (m_geometry->passiveHitType==HitPassiveType::IP) return true; else return false; };
+  bool     isPixel() const     { return m_geometry->isPixel; };
+  bool     isBarrel() const    { if (m_geometry->hitModule && (m_geometry->hitModule->subdet()==BARREL)) return true; else return false;};
+  bool     isEndcap() const    { if (m_geometry->hitModule && (m_geometry->hitModule->subdet()==ENDCAP)) return true; else return false;};
+  bool     isMeasurable() const{ if (m_geometry->hitModule!=nullptr) return true; else return false;};
   bool     isTrigger() const   { return m_isTrigger; };
 
   bool     isPixelIntersticeVolume(){ return m_isPixelIntersticeVol; };
@@ -132,21 +145,55 @@ protected:
   //! Set pointer to inactive element in the constructor
   void setHitPassiveElement(const insur::InactiveElement* myPassiveElem);
 
-  double         m_distance;      //!< Distance of hit from origin in 3D = sqrt(rPos*rPos + zPos*zPos)
-  double         m_rPos;          //!< Distance of hit from origin in the x/y plane (cylindrical coordinates -> r)
-  double         m_zPos;          //!< Distance of hit from origin in z (cylindrical coordinates -> z)
+  /**
+   * @struct Geometry
+   * @brief Position of the hit and element it lies on: shared by the copies of a hit, until one of them modifies it
+   */
+  struct Geometry {
+
+    //! Reference count, starting from zero for each new or copied geometry
+    struct RefCount {
+      RefCount() : value(0) {}
+      RefCount(const RefCount&) : value(0) {}
+      RefCount& operator=(const RefCount&) { return *this; }
+      std::atomic<int> value;
+    };
+
+    static void* operator new(std::size_t size) { return AnalysisArena::allocate(size); }
+    static void  operator delete(void* geometry) { AnalysisArena::deallocate(geometry); }
+
+    friend void intrusive_ptr_add_ref(Geometry* geometry) { geometry->refCount.value++; }
+    friend void intrusive_ptr_release(Geometry* geometry) { if (--geometry->refCount.value==0) delete geometry; }
+
+    double         distance;       //!< Distance of hit from origin in 3D = sqrt(rPos*rPos + zPos*zPos)
+    double         rPos;           //!< Distance of hit from origin in the x/y plane (cylindrical coordinates -> r)
+    double         zPos;           //!< Distance of hit from origin in z (cylindrical coordinates -> z)
+    HitType        activeHitType;  //!< Hit coming from inner, outer, stub, ... module
+    HitPassiveType passiveHitType; //!< Hit coming from which passive part: beam-pipe, service, support etc.
+
+    DetectorModule*               hitModule;      //!< Pointer to the hit module
+    const insur::InactiveElement* hitPassiveElem; //!< Const pointer to the hit inactive element
+
+    bool           isPixel;        //!< Hit coming from the pixel module?
+    InternedString detName;        //!< Detector name, in which the hit has been measured
+
+    double resolutionRPhi;         //!< Only used for virtual hits on non-modules
+    double resolutionZ;            //!< Only used for virtual hits on non-modules
+
+    RefCount refCount;
+  };
+
+  //! Geometry of this hit only, duplicated first if shared with other hits
+  Geometry& modifyGeometry() { if (m_geometry->refCount.value>1) m_geometry = new Geometry(*m_geometry); return *m_geometry; }
+
+  boost::intrusive_ptr<Geometry> m_geometry; //!< Position & hit element, shared between the copies of the hit
+
   HitActivity    m_activity;      //!< Hit defined as pure material (inactive) or measurement point (active)
-  HitType        m_activeHitType; //!< Hit coming from inner, outer, stub, ... module
-  HitPassiveType m_passiveHitType;//!< Hit coming from which passive part: beam-pipe, service, support etc.
-  
-  DetectorModule*         m_hitModule;     //!< Const pointer to the hit module
-  const insur::InactiveElement* m_hitPassiveElem;//!< Const pointer to the hit inactive element
-  const Track*                  m_track;         //!< Const pointer to the track, into which the hit was assigned
+  const Track*   m_track;         //!< Const pointer to the track, into which the hit was assigned
   
   RILength m_correctedMaterial; //!< Material in the way of particle shot at m_track direction, i.e. theta, module tilt angles corrected
   
   bool m_isTrigger; //!< Hit coming from the trigger module?
-  bool m_isPixel;   //!< Hit coming from the pixel module?
 
   // Tracking volumes variables
   bool m_isPixelIntersticeVol;
@@ -155,16 +202,11 @@ protected:
   bool m_isOuterTrackingVol;
   bool m_isTotalTrackingVol;
 
-  std::string m_detName; //!< Detector name, in which the hit has been measured
-
 private:
   
   double getTrackPhi();
   double getTrackTheta();
 
-  double m_resolutionRPhi; // Only used for virtual hits on non-modules
-  double m_resolutionZ;    // Only used for virtual hits on non-modules
-
 }; // Class
 
 #endif /* INCLUDE_HIT_H_ */
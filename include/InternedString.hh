@@ -0,0 +1,48 @@
+/**
+ * @file InternedString.hh
+ * @brief Strings stored once per process and handled through a pointer
+ */
+
+#ifndef INTERNEDSTRING_HH
+#define INTERNEDSTRING_HH
+
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+/**
+ * @class InternedString
+ * @brief Handle to a string of a process-wide table, holding each distinct value once.
+ *
+ * Creating a handle from a string looks the value up in the table (under a lock); copying, assigning and
+ * comparing handles then only copy and compare a pointer, and the value never moves nor disappears.
+ * Meant for the few names repeated in very many objects, e.g. the detector names of the hits.
+ */
+class InternedString {
+public:
+  InternedString() : value_(&empty()) {}
+  InternedString(const std::string& value) : value_(&intern(value)) {}
+  InternedString(const char* value) : value_(&intern(value)) {}
+
+  const std::string& str() const { return *value_; }
+  operator const std::string&() const { return *value_; }
+
+  bool operator==(const InternedString& other) const { return value_ == other.value_; }
+  bool operator!=(const InternedString& other) const { return value_ != other.value_; }
+
+private:
+  static const std::string& intern(const std::string& value) {
+    static std::mutex mutex;
+    static std::unordered_set<std::string> table; // node based: the elements never move
+    std::lock_guard<std::mutex> lock(mutex);
+    return *table.insert(value).first;
+  }
+  static const std::string& empty() {
+    static const std::string& value = intern(std::string());
+    return value;
+  }
+
+  const std::string* value_;
+};
+
+#endif
@@ -12,6 +12,8 @@
 #include <fstream>
 #include <utility>
 #include <vector>
+#include <memory>
+#include <cstdint>
 #include <cmath>
 #include "MessageLogger.hh"
 
@@ -20,6 +22,10 @@
  * @brief This class represent a single irradiation map.
  * @details It is possible to feed the map with a new file, it can read the values from header.
  * The maps are sortable on resolution with operator <.
+ * When a cache directory is set (tklayout option --irradiation-cache), the converted content of a text map
+ * is also written there in a binary file, one per map file, stamped with the size and modification time of
+ * the text source: later runs memory-map the binary file instead of reading the text, as long as the text
+ * file is unchanged.
  */
 class IrradiationMap {
 public:
@@ -65,7 +71,69 @@ public:
    */
   double calculateIrradiation(const std::pair<double,double>& coordinates) const;
 
+  /**
+   * Test if the values of the map were read
+   * @return False if the map file could not be read or parsed
+   */
+  bool isValid() const { return bool(irradiation); }
+
+  /**
+   * Set the directory of the binary maps and of the fluence caches, caching is disabled if empty
+   * @param directory is the path of the cache directory, created when first written
+   */
+  static void setCacheDirectory(const std::string& directory) { cacheDirectory_ = directory; }
+  static const std::string& cacheDirectory() { return cacheDirectory_; }
+
+  /**
+   * FNV-1a hash of a block of bytes, used to checksum the map sources and to key the cached fluences
+   * @param data is the start of the block
+   * @param size is the number of bytes to hash
+   * @param seed is the hash of the previous blocks, if the hash covers several of them
+   * @return The 64-bit hash of the block
+   */
+  static uint64_t checksum(const void* data, size_t size, uint64_t seed = checksumSeed);
+
+  static const uint64_t checksumSeed = 14695981039346656037ULL; /**< FNV-1a offset basis*/
+
 private:
+  /**
+   * Parse the text content of a map file, filling the header values and the grid
+   * @param content is the whole text of the map file
+   * @return True if all the header values were found
+   */
+  bool parse(const std::string& content);
+
+  /**
+   * Get the path of the binary version of a map file in the cache directory
+   * @param irradiationMapFile is the path of the text map file
+   */
+  static std::string binaryFileName(const std::string& irradiationMapFile);
+
+  /**
+   * Memory-map the binary version of the map, if it was converted from the same text source
+   * @param binaryFile is the path of the binary file
+   * @param sourceSize is the size in bytes of the text source
+   * @param sourceModificationTime is the modification time of the text source
+   * @return True if the map was loaded from the binary file
+   */
+  bool loadBinary(const std::string& binaryFile, int64_t sourceSize, int64_t sourceModificationTime);
+
+  /**
+   * Write the binary version of the map, so that the next runs can skip reading the text source
+   * @param binaryFile is the path of the binary file
+   * @param sourceSize is the size in bytes of the text source
+   * @param sourceModificationTime is the modification time of the text source
+   */
+  void writeBinary(const std::string& binaryFile, int64_t sourceSize, int64_t sourceModificationTime) const;
+
+  /**
+   * Get the irradiation value stored in a bin of the grid
+   * @param rhoBin is the index of the bin in rho
+   * @param zBin is the index of the bin in Z
+   * @return The irradiation value of the bin
+   */
+  double binValue(long int rhoBin, long int zBin) const { return irradiation.get()[rhoBin * irradiationColumns + zBin]; }
+
   const std::string comp_rhoMin = "# R min: ";                  /**< Prefix of the line of the header of the feeded file that precedes the value of min rho*/
   const std::string comp_rhoMax = "# R max: ";                  /**< Prefix of the line of the header of the feeded file that precedes the value of max rho*/
   const std::string comp_rhoBinWidth = "# R bin width: ";       /**< Prefix of the line of the header of the feeded file that precedes the value of bin width in rho*/
@@ -86,7 +154,11 @@ private:
   long int zBinNum;     /**< The value of the number of bins in Z*/
   double invFemUnit;    /**< The value of the normalization value in fb^-1*/
 
-  std::vector< std::vector<double> > irradiation;       /**< The matrix (rho * Z) that contains the irradiation values for each bin of the map*/
+  std::shared_ptr<const double> irradiation;   /**< The row-major matrix (rho * Z) that contains the irradiation values for each bin of the map, owned or memory-mapped*/
+  long int irradiationRows;                    /**< The number of rows (rho bins) stored in the matrix*/
+  long int irradiationColumns;                 /**< The number of columns (Z bins) stored in the matrix*/
+
+  static std::string cacheDirectory_;          /**< The directory of the binary maps and fluence caches, empty if caching is disabled*/
 };
 
 
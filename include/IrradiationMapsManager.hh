@@ -10,6 +10,9 @@
 #include <utility>
 #include <string>
 #include <set>
+#include <map>
+#include <vector>
+#include <cstdint>
 #include"IrradiationMap.hh"
 
 /**
@@ -17,7 +20,11 @@
  * @brief The administrator of the irradiation maps.
  * @details Mantains a set of maps sorted by resolution, when
  * is asked for the irradiation of a point returns the value of the
- * better map that contains this point in his region
+ * better map that contains this point in his region.
+ * The maps added by file name are only read when a point is first asked for. When the cache
+ * directory of the maps is set, the fluences of whole modules are also cached there, keyed by the
+ * sampled points: when all the modules of a layout are found in the cache, the maps are not even read.
+ * There is one cache file per set of map files, discarded as soon as one of them changes.
  */
 class IrradiationMapsManager {
 public:
@@ -31,7 +38,7 @@ public:
   void addIrradiationMap(const IrradiationMap& newIrradiationMap);
 
   /**
-   * Create a new map with passed file and ad it to internal set
+   * Record the file of a new map, which is read and added to the internal set when first needed
    * @param newIrradiationMapFile is the path of the file for the new map
    */
   void addIrradiationMap(std::string newIrradiationMapFile);
@@ -44,12 +51,59 @@ public:
    */
   double calculateIrradiationPower(const std::pair<double,double>& coordinates) const;
 
+  /**
+   * Get the mean and max irradiation over a set of points, typically sampled on the sensors of a module.
+   * The result is cached, keyed by the hash of the points.
+   * @param points is the vector of pairs (z,r) of the points
+   * @return The pair (mean, max) of the irradiation values on the points
+   */
+  std::pair<double,double> calculateFluenceMeanMax(const std::vector<std::pair<double,double> >& points) const;
+
+  /**
+   * Write the fluence cache to disk, if new fluences were computed since it was read
+   */
+  void saveFluenceCache() const;
+
 private:
+  /**
+   * Read the maps recorded by file name and not read yet
+   */
+  void loadPendingMaps() const;
+
+  /**
+   * Read the fluence cache from disk, the first time it is needed
+   */
+  void loadFluenceCache() const;
+
+  /**
+   * Read the records of the fluence cache file, if it was written for the current content of the maps
+   * @param cache is filled with the (mean, max) fluences read
+   * @return True if the file was read
+   */
+  bool readFluenceCache(std::map<uint64_t, std::pair<double,double> >& cache) const;
+
+  /**
+   * Test if the fluence cache is used: the maps all come from files and a cache directory is set
+   */
+  bool fluenceCacheUsed() const { return fluenceCacheEnabled && !IrradiationMap::cacheDirectory().empty(); }
+
+  /**
+   * Get the path of the fluence cache file of this set of maps
+   */
+  std::string fluenceCacheFile() const;
 
   /**
    * The set that contains all the maps ordered by resolution
    */
-  std::set<IrradiationMap> irradiationMaps;
+  mutable std::set<IrradiationMap> irradiationMaps;
+
+  mutable std::vector<std::string> pendingMapFiles;   /**< The map files recorded but not read yet*/
+  uint64_t mapsKey;                                   /**< Hash of the paths of all the map files, naming the fluence cache file*/
+  uint64_t mapsFingerprint;                           /**< Hash of the path, size and modification time of all the map files*/
+  bool fluenceCacheEnabled;                           /**< The fluence cache is only used if all the maps come from files*/
+  mutable bool fluenceCacheLoaded;                    /**< The fluence cache file was read already*/
+  mutable bool fluenceCacheDirty;                     /**< New fluences were added to the cache since it was read*/
+  mutable std::map<uint64_t, std::pair<double,double> > fluenceCache;  /**< (mean, max) fluence for each hash of the sampled points*/
 };
 
 #endif /* IRRADIATIONMAPSMANAGER_H_ */
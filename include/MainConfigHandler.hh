@@ -27,6 +27,20 @@ using namespace std;
 #define TRIGGERMOMENTADEFINITION "TKG_TRIGGERMOMENTA" 
 #define THRESHOLDPROBABILITIESDEFINITION "TKG_THRESHOLD_PROB"
 
+// One file of the include tree of a configuration, in the order it was visited
+struct ConfigFileRecord {
+  string absoluteFileName;
+  string relativeFileName;
+  bool standardInclude;
+  int parent; // index of the including file, -1 for the main configuration file
+};
+
+// The files visited while preprocessing a configuration, which is enough to replay the include graph
+struct ConfigIncludeTree {
+  vector<ConfigFileRecord> files;
+  bool complete = true; // false if some included file could not be opened
+};
+
 class ConfigInputOutput {
 public:
   ConfigInputOutput(istream& newIs, ostream& newOs) : is(newIs) , os(newOs) {}
@@ -38,6 +52,8 @@ public:
   set<string> includePathList;
   string getIncludedFile(string fileName);
   bool webOutput;
+  ConfigIncludeTree* includeTree = nullptr; // filled while preprocessing, if set
+  int includeTreeParent = -1;
 };
 
 // This object wil read the configuration only once
@@ -68,6 +84,7 @@ public:
   string getGeometriesDirectory();
   string getConfigFileName();
   std::set<string> preprocessConfiguration(ConfigInputOutput);
+  void replayConfigurationGraph(const ConfigIncludeTree& includeTree, bool webOutput);
   vector<double>& getMomenta();
   vector<double>& getTriggerMomenta();
   vector<double>& getThresholdProbabilities();
@@ -106,6 +123,7 @@ private:
   void readDetIdSchemes();
   string getStandardIncludeDirectory_();
   string getGeometriesDirectory_();
+  void replayConfigurationNode(const ConfigIncludeTree& includeTree, int fileIndex, bool webOutput);
 
 };
 
@@ -51,6 +51,7 @@ namespace material {
     void populateMaterialProperties(MaterialProperties& materialProperties) const;
 
     ElementsVector& getLocalElements() const;
+    const ElementsVector& getServiceElements() const { return serviceElements_; }
 
     bool isPopulated() const;
 
@@ -144,6 +145,7 @@ namespace material {
       std::map<int, ReferenceSensor*> referenceSensors_;
 
       virtual ~Element();
+      void check() override;
       void build(const std::map<int, int>& newSensorChannels);
       void deployMaterialTo(MaterialObject& outputObject, const std::vector<std::string>& unitsToDeploy, bool onlyServices = false, double gramsMultiplier = 1.) const;
       double quantityInGrams(const DetectorModule& module) const;
@@ -160,9 +162,19 @@ namespace material {
       std::map<int, int> sensorChannels_;
 
     private:
+      double quantityInUnit(Unit desiredUnit, const double length, const double surface) const;
+      double density() const;
+
       const MaterialTab& materialTab_;
       static const std::string msg_no_valid_unit;
       MaterialObject::Type& materialType_;
+      // unit and material registry ID of the element, resolved from the unit and elementName strings when the element is checked
+      // or copied, so that the analysis threads only read them
+      void resolveIds();
+      static const int unresolved = -1;
+      static const int invalidUnit = -2;
+      int unitVal_;
+      int materialId_;
       //static const std::map<std::string, Materialway::Train::UnitType> unitTypeMap;
     };
 
@@ -17,6 +17,7 @@
 #include <iostream>
 #include <sstream>
 #include <map>
+#include <vector>
 #include <MaterialTable.hh>
 
 class RILength {
@@ -30,6 +31,8 @@ public:
 
 typedef RILength Material;
 
+typedef std::vector<std::pair<int, RILength> > ComponentsRIById; // <component ID in the material registry, radiation and interaction lengths>
+
 
 namespace insur {
     /**
@@ -55,6 +58,13 @@ namespace insur {
          */
 
         enum Category {no_cat, b_mod, e_mod, b_ser, e_ser, b_sup, e_sup, o_sup, t_sup, u_sup};
+        /**
+         * @enum MassStorage How the masses are accumulated: keyed by material and component names only, or also
+         * indexed by the IDs of the material registry, so that the material lengths can be summed up as array adds
+         */
+        enum MassStorage {map_storage, dense_storage};
+        static void setMassStorage(MassStorage storage);
+        static MassStorage getMassStorage();
         MaterialProperties();
         virtual ~MaterialProperties() {} 
         // bureaucracy
@@ -81,6 +91,7 @@ namespace insur {
         double getInteractionLength();
         RILength getMaterialLengths();
         const std::map<std::string, RILength>& getComponentsRI() const;
+        const ComponentsRIById& getComponentsRIById() const; // dense storage only
         // output calculations
         void calculateTotalMass(double offset = 0);
         void calculateLocalMass(double offset = 0);
@@ -105,11 +116,35 @@ namespace insur {
         std::map<std::string, std::map<std::string, double> > localCompMats; // format here is <component name string, <material name, mass> >
 
         std::map<std::string, RILength> componentsRI;  // component-by-component radiation and interaction lengths
+        // dense storage, indexed by the material registry IDs
+        static MassStorage massStorage;
+        struct ComponentMass { int componentId; int materialId; double mass; }; // componentId is the one of the super name
+        std::vector<std::pair<int, double> > localMassesById;  // <material ID, mass>
+        std::vector<ComponentMass> localCompMassesById;
+        ComponentsRIById componentsRIById;
         // complex parameters (OUTPUT)
         double total_mass, local_mass, r_length, i_length;
         // internal help
         std::string getSuperName(std::string name) const;
         std::string getSubName(std::string name) const;
+        void calculateDenseLengths(double offset, bool radiation);
+    };
+
+    /**
+     * @class ComponentsRISum
+     * @brief The radiation and interaction lengths crossed by a track, summed up component by component.
+     *
+     * With the dense mass storage the sums are array adds indexed by the component IDs of the material registry,
+     * otherwise they are keyed by the component names.
+     */
+    class ComponentsRISum {
+    public:
+        void add(const MaterialProperties& element, double scale);
+        std::map<std::string, RILength> byName() const;
+    private:
+        std::map<std::string, RILength> byName_;
+        std::vector<RILength> byId_;
+        std::vector<bool> usedIds_;
     };
 }
 #endif	/* _MATERIALPROPERTIES_H */
@@ -0,0 +1,61 @@
+/**
+ * @file MaterialRegistry.h
+ *
+ * @brief Dense integer identifiers for the material and component names
+ */
+
+#ifndef MATERIALREGISTRY_H_
+#define MATERIALREGISTRY_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+namespace material {
+
+  /**
+   * @class MaterialRegistry
+   * @brief Interns each material and component name to a dense integer ID, so that masses and material lengths
+   * can be accumulated in vectors indexed by ID instead of maps keyed by name.
+   *
+   * The materials of the material tab are registered, with their properties, when the tab is loaded: the properties
+   * are never changed afterwards, and are read without locking. Component names and materials missing from the tab
+   * are registered the first time they are seen, which may happen in any thread: the name tables are guarded by a mutex.
+   */
+  class MaterialRegistry {
+  public:
+    static MaterialRegistry& instance();
+
+    int materialId(const std::string& material);
+    int componentId(const std::string& component);
+    std::string materialName(int id) const;
+    std::string componentName(int id) const;
+    int materialCount() const;
+    int componentCount() const;
+
+    void setMaterialProperties(int id, double density, double radiationLength, double interactionLength);
+    bool isKnown(int id) const { return id < (int)materialProperties_.size() && materialProperties_[id].known; }
+    double density(int id) const { return materialProperties_[id].density; }
+    double radiationLength(int id) const { return materialProperties_[id].radiationLength; }
+    double interactionLength(int id) const { return materialProperties_[id].interactionLength; }
+
+  private:
+    MaterialRegistry() {}
+
+    struct MaterialProperties {
+      bool known;
+      double density, radiationLength, interactionLength;
+    };
+
+    std::vector<std::string> materialNames_;
+    std::vector<std::string> componentNames_;
+    std::unordered_map<std::string, int> materialIds_;
+    std::unordered_map<std::string, int> componentIds_;
+    std::vector<MaterialProperties> materialProperties_; // only filled up to the materials of the tab
+    mutable std::mutex namesMutex_;
+  };
+
+} /* namespace material */
+
+#endif /* MATERIALREGISTRY_H_ */
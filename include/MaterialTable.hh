@@ -72,6 +72,7 @@ namespace insur {
     protected:
         std::vector<MaterialRow> materials;
     private:
+        std::map<std::string, int> indices; // position of each tag in materials, the first one if a tag is repeated
         int findIndex(std::string tag);
     };
 
@@ -123,6 +123,7 @@ namespace material {
 
       virtual void getServicesAndPass(const MaterialObject& source);
       virtual void getServicesAndPass(const MaterialObject& source, const std::vector<std::string>& unitsToPass);
+      const std::vector<std::string>& unitsToPass() const { return unitsToPass_; }
 
       bool debug_;
     private:
@@ -162,6 +163,52 @@ namespace material {
     typedef std::vector<Station*> StationVector;
     typedef std::map<const DetectorModule*, Section*> ModuleSectionMap;
 
+    /**
+     * @class ServiceFlow
+     * @brief Deploys the materials routed along the sections, either right away or in a single pass
+     *
+     * The sections linked by their next section form a forest whose roots are the stations. In the
+     * topological mode every deployment is only recorded at the section where it enters, and its source
+     * elements are filtered by unit once instead of once per traversed section; flush() then visits each
+     * reached section once, upstream sections first, delivering the recorded contributions and forwarding
+     * the routed ones to the next section. Every section still receives its own copy of each element routed
+     * through it, so the work stays proportional to the number of deliveries, as with the chained walk.
+     * The deliveries of each material object are appended in the order the contributions were made, so the
+     * sections and conversion stations end up with the same elements, in the same order, as with the
+     * chained getServicesAndPass. In the validating mode the chained walk is done, and the topological
+     * deliveries are only compared with it.
+     */
+    class ServiceFlow {
+    public:
+      ServiceFlow(bool topological, bool validate = false);
+
+      void deploy(const MaterialObject& source, Section* section, const std::vector<std::string>& units, bool onlyServices = false, double gramsMultiplier = 1.);
+      void pass(const MaterialObject& source, Section* section);
+      void pass(const MaterialObject& source, Section* section, const std::vector<std::string>& units);
+      void flush();
+
+    private:
+      struct Contribution {
+        Section* section;                 /**< the section where the contribution enters */
+        bool passed;                      /**< routed to the next sections, up to a station */
+        size_t first, last;               /**< elements delivered to the entry section */
+        size_t passedFirst, passedLast;   /**< elements delivered to the next sections */
+      };
+
+      bool topological_;
+      bool validate_;
+      MaterialObject collected_;          /**< the elements of all the contributions, filtered once */
+      std::vector<Contribution> contributions_;
+      std::map<Section*, std::vector<size_t> > entries_;
+      std::map<MaterialObject*, size_t> chainedFirst_;  /**< validation: number of elements of each target before the chained walk */
+
+      void add(const Contribution& contribution);
+      void recordChainedTargets(Section* section, bool passed);
+      bool checkDeliveries(MaterialObject& materialObject, const MaterialObject::ElementsVector& delivered) const;
+      static Section* downstream(Section* section);
+      static MaterialObject& target(Section* section, bool passed);
+    }; //class ServiceFlow
+
     /**
      * @class Boundary
      * @brief Represents a boundary where the services are routed around
@@ -282,6 +329,16 @@ namespace material {
 
 
   public:
+    /**
+     * @enum ServiceRouting How the services are routed along the sections: by walking the chain of sections
+     * for every source, by recording each source at its entry section and propagating all of them in one
+     * topological pass (same per-section results), or by walking the chains and checking the topological
+     * pass against them
+     */
+    enum ServiceRouting {chained_routing, topological_routing, validated_routing};
+    static void setServiceRouting(ServiceRouting routing);
+    static ServiceRouting getServiceRouting();
+
     Materialway();
     virtual ~Materialway();
 
@@ -319,6 +376,7 @@ namespace material {
     SectionVector sectionsList_;         /**< Vector for storing all the sections (also stations)*/
     StationVector stationListFirst_;         /**< Pointers to first step stations*/
     StationVector stationListSecond_;         /**< Pointers to second step stations*/
+    static ServiceRouting serviceRouting;
 
     OuterUsher outerUsher;
     InnerUsher innerUsher;
@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <set>
 #include <list>
 #include <vector>
@@ -51,6 +52,7 @@ class MessageLogger {
   static std::vector<LogMessage> logMessageV;
   static int countInstances;
   static int messageCounter[];
+  static std::mutex mutex_; // Messages may come from the threads of a parallel build or analysis
   int screenLevel_;
   std::set<std::string> uniqueMessages;
 };
@@ -17,6 +17,7 @@
 
 //#include <module.hh>
 #include "Module.hh"
+#include "InternedString.hh"
 #include <MaterialProperties.hh>
 #include <global_constants.hh>
 
@@ -40,12 +41,13 @@ namespace insur {
         virtual double      getLength() const;
         virtual int         getLayerOrDiscID() const {return m_layerOrDiscID; }
         virtual std::string getDetName() const {return m_detName;}
+        const InternedString& getInternedDetName() const {return m_detName;}
         virtual void print();
         virtual void setDetName(const std::string& detName) {m_detName = detName;};
     protected:
         Module* m_module;
         int     m_layerOrDiscID; // Unique layer/disc ID, whether layer or disc can be found out from module tag: BARREL/ENDCAP
-        std::string m_detName;   // Unique barrel or disc name
+        InternedString m_detName; // Unique barrel or disc name, shared with the hits on the module
     };
 }
 #endif	/* _MODULECAP_H */
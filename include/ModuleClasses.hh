@@ -0,0 +1,98 @@
+/**
+ * @file ModuleClasses.hh
+ * @brief Equivalence classes of the modules of a built tracker, and caches memoizing results per class
+ */
+
+#ifndef MODULECLASSES_HH
+#define MODULECLASSES_HH
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "DetectorModule.hh"
+
+class Tracker;
+
+/**
+ * @class ModuleClasses
+ * @brief Groups the modules that only differ by their phi placement, so that per-module computations are done once per class.
+ *
+ * Two modules are equivalent when they have the same properties (subdetector, layer or disk, ring, type, sensors
+ * and their channels, thickness, stereo distance, size, tilt and skew, trigger window, resolutions, operating
+ * conditions), the same stub parameters (effective stereo distance, geometric efficiency, pitch and strip length
+ * of the outer sensor, magnetic field) and the same radius and z, within 1 um. The sign of z is kept, some estimates (e.g. the endcap
+ * occupancy) not being mirror-symmetric. classify() is called on each tracker after Tracker::build, and sets the
+ * class of each of its modules (DetectorModule::equivalenceClass), -1 meaning unclassified.
+ *
+ * A consumer memoizes a result depending on these properties only with a ModuleClassCache: the result is computed
+ * on the first module of each class it sees, and reused for the others. The hits and computations of every cache,
+ * by name, are gathered for the report of logReport().
+ *
+ * The modules are classified only when enabled (tklayout option --module-classes).
+ */
+class ModuleClasses {
+public:
+  struct CacheStatistics {
+    long hits = 0;
+    long computations = 0;
+    long unclassified = 0;  // Computations on modules without class
+  };
+
+  static void setEnabled(bool enabled) { enabled_ = enabled; }
+  static bool isEnabled() { return enabled_; }
+
+  static void classify(Tracker& tracker);
+  static std::string signature(const DetectorModule& module);
+
+  static int numClasses() { return classes_.size(); }
+  static CacheStatistics& cacheStatistics(const std::string& cacheName);
+  static void logReport();
+
+private:
+  struct ModuleClass {
+    std::string subdetectorName;
+    int numModules;
+  };
+
+  static bool enabled_;
+  static std::map<std::string, int> classIds_;
+  static std::vector<ModuleClass> classes_;
+  static std::map<std::string, CacheStatistics>& allCacheStatistics();
+};
+
+/**
+ * @class ModuleClassCache
+ * @brief Results of a computation on modules, memoized per equivalence class.
+ *
+ * The reference returned by get() for an unclassified module is only valid until the next call.
+ */
+template<class T> class ModuleClassCache {
+public:
+  explicit ModuleClassCache(const std::string& name) : statistics_(ModuleClasses::cacheStatistics(name)) {}
+
+  template<class Compute> const T& get(const DetectorModule& module, Compute compute) {
+    int id = module.equivalenceClass();
+    if (id < 0) {
+      statistics_.unclassified++;
+      unclassifiedValue_ = compute(module);
+      return unclassifiedValue_;
+    }
+    auto found = values_.find(id);
+    if (found != values_.end()) {
+      statistics_.hits++;
+      return found->second;
+    }
+    statistics_.computations++;
+    return values_.insert(std::make_pair(id, compute(module))).first->second;
+  }
+
+  void clear() { values_.clear(); }
+
+private:
+  ModuleClasses::CacheStatistics& statistics_;
+  std::map<int, T> values_;
+  T unclassifiedValue_;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef MODULESPATIALINDEX_H
+#define MODULESPATIALINDEX_H
+
+#include <vector>
+#include <Math/Vector3D.h>
+
+#include "Module.hh"
+#include "FrozenModules.hh"
+
+using ROOT::Math::XYZVector;
+
+/**
+ * @class ModuleSpatialIndex
+ * @brief A phi-eta bucket grid over the sensor envelopes of a frozen collection of modules.
+ *
+ * Each module is registered in every (phi, eta) bucket which a straight line starting on the beam axis,
+ * within +-zTolerance of z=0, could cross while going through any of its sensor envelopes. A query for a
+ * given track then only returns the modules of the single bucket containing the track direction, sorted
+ * in the order in which the modules were given to build(): scanning the candidates with the exact
+ * polygon test therefore yields the same hits, in the same order, as scanning the whole collection.
+ * Queries which cannot be answered by the grid (origin off the beam axis or beyond zTolerance,
+ * track parallel to the beam axis) fall back to the full list of modules.
+ * Building the grid also freezes the hot attributes of the modules, read through frozen() by the hit finding.
+ * With the closed-form intersection backend (RayIntersection), the candidates of a track can also be narrowed
+ * to the modules whose sensors it crosses, tested in one batch before the hit finding goes through them.
+ */
+class ModuleSpatialIndex {
+public:
+  typedef std::vector<int> Candidates;
+
+  ModuleSpatialIndex(int numPhiBins = 256, int numEtaBins = 256);
+
+  void build(const std::vector<Module*>& modules, double zTolerance);
+  void clear();
+
+  bool empty() const { return modules_.empty(); }
+  bool isBuiltFor(int size, const Module* first) const { return size == (int)modules_.size() && (modules_.empty() || first == modules_.front()); } // cheap staleness check
+  int size() const { return modules_.size(); }
+  Module& module(int index) const { return *modules_[index]; }
+  const FrozenModules& frozen() const { return frozen_; }
+  void freezeMaterials(std::vector<insur::ModuleCap>& caps) { frozen_.freezeMaterials(caps); }
+
+  const Candidates& candidates(const XYZVector& origin, const XYZVector& direction) const; // indices of the modules which could be hit, in build order
+  const Candidates& candidates(const XYZVector& origin, const XYZVector& direction, Candidates& crossed) const; // same, narrowed by the batched closed-form test with that backend
+  std::vector<int> missedHits(const XYZVector& origin, const XYZVector& direction) const;  // modules hit by the track but not among its candidates (used for cross-checks, does not touch the hit counters)
+
+private:
+  struct Envelope { double minPhi, maxPhi, minEta, maxEta; bool anywhere; };
+  Envelope computeEnvelope(const Module& m) const;
+  int phiBin(double phi) const;
+  int etaBin(double eta) const;
+
+  int numPhiBins_, numEtaBins_;
+  double zTolerance_;
+  double minEta_, maxEta_;
+  std::vector<Module*> modules_;
+  std::vector<Candidates> buckets_;
+  Candidates all_;
+  Candidates outside_; // modules registered in every bucket, returned for directions outside the eta span of the grid
+  FrozenModules frozen_;
+};
+
+#endif
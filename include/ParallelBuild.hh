@@ -0,0 +1,36 @@
+/**
+ * @file ParallelBuild.hh
+ * @brief Concurrent construction of the independent parts of a tracker geometry
+ */
+
+#ifndef PARALLELBUILD_HH
+#define PARALLELBUILD_HH
+
+#include <functional>
+#include <vector>
+
+/**
+ * @class ParallelBuild
+ * @brief Runs the builds of sibling geometry objects (the layers of a barrel, the disks of an endcap) on several threads.
+ *
+ * The callers store the properties of every sibling serially, then hand over the builds, which only touch the
+ * sibling itself (and the shared caches and logs, which are locked), and finally collect the built objects in
+ * their original order, so that the geometry does not depend on the number of threads. A build run from within
+ * a parallel task is run serially. The first exception thrown, in the order of the tasks, is rethrown once all
+ * the tasks are over.
+ *
+ * The builds are serial unless a number of threads is set (tklayout option --parallel-build).
+ */
+class ParallelBuild {
+public:
+  static void setNumThreads(int numThreads) { numThreads_ = numThreads; }
+  static int numThreads() { return numThreads_; }
+
+  static void run(const std::vector<std::function<void()> >& tasks);
+
+private:
+  static int numThreads_;
+  static thread_local bool inTask_;
+};
+
+#endif
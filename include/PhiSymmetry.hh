@@ -0,0 +1,73 @@
+/**
+ * @file PhiSymmetry.hh
+ * @brief Detection of the azimuthal symmetry of a built tracker
+ */
+
+#ifndef PHISYMMETRY_HH
+#define PHISYMMETRY_HH
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Module.hh"
+
+class Tracker;
+
+/**
+ * @class PhiSymmetry
+ * @brief The smallest phi sector whose rotations rebuild a tracker, with the modules grouped by rotation.
+ *
+ * A tracker has an N-fold symmetry when the rotation by 2 pi / N around the z axis maps every module onto another
+ * module with the same properties (subdetector, layer or disk, ring, type, sensors, resolutions, operating
+ * conditions) and the same placement (rotated centre, normal and corners). detect() tries the divisors of the
+ * numbers of equivalent modules at each (r, z) position, from the largest one, and keeps the first rotation that
+ * maps the whole tracker onto itself. A module removed from a ring or a rod (see Tracker::build), or a module with
+ * special properties, breaks the symmetry: the tracker then has a 1-fold symmetry, and nothing is folded.
+ *
+ * The modules are grouped in orbits, the N images of a module by the rotations, so that a quantity computed on one
+ * module of an orbit (the representative, with the smallest phi in [0, 2 pi)) applies to all of them, and a tally
+ * made with tracks shot in one sector only (see foldPhi) can be spread over the orbit.
+ *
+ * The modules of an orbit are stored in the order of the rotations, so that image() gives the module a rotation by
+ * a number of sectors brings a module onto, e.g. to map the modules hit by a track onto those hit by its images.
+ *
+ * The analyses exploit the symmetry only when enabled (tklayout option --phi-symmetry). It is then detected once per
+ * tracker, when the tracker is built (record) or first analyzed (forAnalysis), and kept by the tracker itself.
+ */
+class PhiSymmetry {
+public:
+  PhiSymmetry() : folds_(1), reason_("not checked") {}
+
+  static PhiSymmetry detect(const Tracker& tracker);
+  //! Detect the symmetry of a tracker right after it is built, and store it in the tracker
+  static void record(const Tracker& tracker);
+  //! The symmetry of the tracker when the analyses exploit it, detected once per tracker, the 1-fold symmetry otherwise
+  static const PhiSymmetry& forAnalysis(const Tracker& tracker);
+
+  static void setEnabled(bool enabled) { enabled_ = enabled; }
+  static bool isEnabled() { return enabled_; }
+
+  int folds() const { return folds_; }
+  bool isSymmetric() const { return folds_ > 1; }
+  double sectorWidth() const { return 2*M_PI / folds_; }
+  const std::string& reason() const { return reason_; } // Why the symmetry is not larger
+
+
+  double foldPhi(double phi) const;  // Angle brought into [0, sectorWidth)
+  std::vector<double> images(double phi) const; // The folds() rotations of the angle, in [-pi, pi) (the angle itself without symmetry)
+
+  const Module& representative(const Module& module) const;
+  std::vector<const Module*> orbit(const Module& module) const;
+  const Module& image(const Module& module, int sectors) const; // The module itself without symmetry
+
+private:
+  static bool enabled_;
+
+  int folds_;
+  std::string reason_;
+  std::map<const Module*, std::pair<int, int> > orbitIndex_; // Orbit, and position in it
+  std::vector<std::vector<const Module*> > orbits_;           // The representative first, then its images by 1, 2, ... sectors
+};
+
+#endif
@@ -7,6 +7,7 @@
 #include <list>
 #include <set>
 #include <memory>
+#include <mutex>
 #include <functional>
 #include <algorithm>
 #include <stdexcept>
@@ -375,6 +376,7 @@ class PropertyObject {
   PropertyTree pt_;
   static std::set<string> globalMatchedProperties_;
   static std::set<string> globalUnmatchedProperties_;
+  static std::mutex globalPropertiesMutex_; // Objects may be stored by the threads of a parallel build
 
   void processProperties(PropertyMap& props) {
     for (auto& propElem : props) {
@@ -399,6 +401,7 @@ protected:
   PropertyMap& checkedOnly() { return checkedProperties_; }
 
   void recordMatchedProperties() {
+    std::lock_guard<std::mutex> lock(globalPropertiesMutex_);
     for (auto& mapel : parsedCheckedProperties_) globalMatchedProperties_.insert(mapel.first);
     for (auto& mapel : parsedProperties_) globalMatchedProperties_.insert(mapel.first);
     for (auto& mapel : checkedProperties_) globalMatchedProperties_.insert(mapel.first);
@@ -1,27 +1,60 @@
 #ifndef PT_ERROR_ADAPTER_H
 #define PT_ERROR_ADAPTER_H
 
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include "global_constants.hh"
 #include "PtError.hh"
 #include "Module.hh"
 
+//! How the particle and true stub rates over a pt range are integrated: step by step for each call, by lookup in a
+//! cumulative table built once per set of modules with the same stub parameters, radius and |z| (the phi copies of a
+//! module and their mirror images in z), or both, cross-checked. The tabulated rates may differ slightly from the
+//! direct ones when the lower cut does not fall on the pt grid of the table (see integrateTabulated)
+enum class RateIntegration { DIRECT, TABULATED, VALIDATE };
 
 class PtErrorAdapter {
   static const double minimumPt;
   static const double maximumPt;
   static const double ptMinFit;
   static const double ptMaxFit;
+  static const double ptStep;
   // log(pt/z) distribution parameters for 12000 events at 14 TeV
   static const double ptFitParamsLow[]; // 0.22 GeV to 1 GeV  Chi^2 / dof = 22.0408/16 = 1.37755
   static const double ptFitParamsMid[]; // 1 GeV to 4 GeV     Chi^2 / dof = 84.2299/71 = 1.18634
   static const double ptFitParamsHigh[]; // 4 GeV to 10 GeV    Chi^2 / dof = 102.736/135 = 0.76101
 
+  // Rates integrated on the pt grid of the direct integration, from its lowest point (the pt curling at the module
+  // radius, or ptMinFit): element k is the integral over the first k points, without the eta-phi aperture factor
+  struct RateTable {
+    double ptStart;
+    std::vector<double> particles;
+    std::vector<double> triggers;
+    double cumulative(const std::vector<double>& rates, double pt) const;
+  };
+  static const double rateTolerance; // Relative deviation between the tabulated and direct rates above which a warning is issued
+  static RateIntegration s_rateIntegration;
+  static std::map<std::string, RateTable> s_rateTables;
+  static std::mutex s_rateTablesMutex;
+
   ptError myPtError;
   const DetectorModule& mod_;
 
    void setPterrorParameters();
+   static double particleSpectrum(double pt);
+   double etaPhiAperture() const;
+   const RateTable& rateTable();
+   const RateTable& buildRateTable();
+   double integrateDirect(double myLowCut, double myHighCut, bool triggered);
+   double integrateTabulated(double myLowCut, double myHighCut, bool triggered);
+   double integrate(double myLowCut, double myHighCut, bool triggered);
 public:
    PtErrorAdapter(const DetectorModule& m) : mod_(m) { setPterrorParameters(); }
+   static void setRateIntegration(RateIntegration integration) { s_rateIntegration = integration; }
+   std::string stubSignature() const; // Everything the trigger probability depends on: modules with the same signature have the same efficiencies and rates
    double getTriggerProbability(const double& trackPt, const double& stereoDistance = 0, const int& triggerWindow = 0);
    double getTriggerFrequencyTruePerEventAbove(const double& myCut);
    double getParticleFrequencyPerEventAbove(const double& myCut);
@@ -0,0 +1,95 @@
+/**
+ * @file RayIntersection.hh
+ * @brief Closed-form crossing of straight tracks with triangles and with the quadrilaterals of the sensors
+ */
+
+#ifndef RAYINTERSECTION_HH
+#define RAYINTERSECTION_HH
+
+#include <vector>
+#include <Math/Vector3D.h>
+
+#include "Polygon3d.hh"
+
+using ROOT::Math::XYZVector;
+
+//! Test of a track against the hit polygon of a sensor: plane crossing and triangle areas (Polygon3d::isLineIntersecting), or barycentric coordinates
+enum class IntersectionBackend { AREA_SUM, MOLLER_TRUMBORE };
+
+/**
+ * @class PackedQuads
+ * @brief Quadrilaterals stored as a structure of arrays, with the edges and normal the crossing tests need.
+ *
+ * A quadrilateral (v0, v1, v2, v3) is split into the triangles (v0, v1, v2) and (v0, v2, v3), as in
+ * GeometricModule::trackCross: only its first corner v0, the edges e1 = v1 - v0, e2 = v2 - v0, e3 = v3 - v0
+ * and the normal of the polygon are kept.
+ */
+class PackedQuads {
+public:
+  void add(const Polygon3d<4>& poly);
+  void clear();
+  int size() const { return origin_.x.size(); }
+
+private:
+  friend class RayIntersection;
+  struct Coordinates { std::vector<double> x, y, z; };
+  Coordinates origin_, edge1_, edge2_, edge3_, normal_;
+};
+
+/**
+ * @class RayIntersection
+ * @brief Moller-Trumbore crossing of a line with a triangle, on plain doubles.
+ *
+ * The line orig + t * dir crosses the triangle v0 + u * e1 + v * e2 where u, v >= 0 and u + v <= 1. The three
+ * unknowns are obtained from the triple products of dir, e1, e2 and orig - v0 (Cramer's rule), without building
+ * and inverting a matrix. Quadrilaterals are tested as two triangles sharing the diagonal v0-v2.
+ *
+ * crossSensor() and crossQuads() reproduce the hit test of Polygon3d::isLineIntersecting on the hit polygons of
+ * the sensors: a track only crosses a polygon along its normal (normal . dir >= FacingThreshold). crossQuads()
+ * tests one track against a range of packed quadrilaterals in a loop without branches, which GCC vectorizes at -O3
+ * from SSE4.2/AVX targets on (-march=x86-64-v2), or against a list of them (the candidates of a spatial index
+ * bucket, see ModuleSpatialIndex::candidates), where the loads become gathers.
+ *
+ * The backend used by Sensor::checkHitSegment, FrozenModules::checkTrackHits and GeometricModule::trackCross is
+ * selected with setBackend() (tklayout option --intersection-backend). The default keeps the original tests, the
+ * triangle areas and the TMatrixD solve of GeometricModule::triangleCross, as the area test accepts points up to
+ * 1e-4 mm2 outside the polygons and EdgeTolerance accepts crossings just past the triangle edges: the hits may differ
+ * on the very edges of the sensors.
+ */
+class RayIntersection {
+public:
+  static constexpr double FacingThreshold = 1e-3;
+  static constexpr double EdgeTolerance = 1e-9; // On the barycentric coordinates, so that a crossing on the diagonal is seen by either triangle
+
+  static void setBackend(IntersectionBackend backend) { backend_ = backend; }
+  static IntersectionBackend backend() { return backend_; }
+  static bool isClosedForm() { return backend_ == IntersectionBackend::MOLLER_TRUMBORE; }
+
+  //! Line parameter t of the crossing with the triangle (v0, v0 + e1, v0 + e2): false if the line misses it or is parallel to it
+  static bool crossTriangle(const double* orig, const double* dir, const double* v0, const double* e1, const double* e2, double& t);
+  //! Line parameter t of the crossing with the polygon of a sensor, which the track must go through along the normal
+  static bool crossSensor(const Polygon3d<4>& poly, const XYZVector& orig, const XYZVector& dir, double& t);
+  static bool crossSensor(const PackedQuads& quads, int index, const XYZVector& orig, const XYZVector& dir, double& t);
+  //! Crossings with the packed quadrilaterals [first, last): t[i - first] (line parameter at the plane of the quadrilateral) and crossed[i - first] are set for each of them
+  static void crossQuads(const PackedQuads& quads, int first, int last, const XYZVector& orig, const XYZVector& dir, double* __restrict__ t, unsigned char* __restrict__ crossed);
+  //! Same for the packed quadrilaterals indices[0, count): t[k] and crossed[k] are set for the quadrilateral indices[k]
+  static void crossQuads(const PackedQuads& quads, const int* indices, int count, const XYZVector& orig, const XYZVector& dir, double* __restrict__ t, unsigned char* __restrict__ crossed);
+
+private:
+  static IntersectionBackend backend_;
+};
+
+
+inline bool RayIntersection::crossTriangle(const double* orig, const double* dir, const double* v0, const double* e1, const double* e2, double& t) {
+  double p[3] = { dir[1]*e2[2] - dir[2]*e2[1], dir[2]*e2[0] - dir[0]*e2[2], dir[0]*e2[1] - dir[1]*e2[0] };
+  double det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+  double invDet = 1. / det; // infinite for a line parallel to the triangle, which is then rejected by the det test
+  double s[3] = { orig[0] - v0[0], orig[1] - v0[1], orig[2] - v0[2] };
+  double u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2]) * invDet;
+  double q[3] = { s[1]*e1[2] - s[2]*e1[1], s[2]*e1[0] - s[0]*e1[2], s[0]*e1[1] - s[1]*e1[0] };
+  double v = (dir[0]*q[0] + dir[1]*q[1] + dir[2]*q[2]) * invDet;
+  t = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2]) * invDet;
+  return (det != 0.) & (u >= -EdgeTolerance) & (v >= -EdgeTolerance) & (u + v <= 1. + EdgeTolerance); // no short circuit, to keep the callers' loops free of branches
+}
+
+#endif
@@ -103,6 +103,21 @@ private:
 
 typedef string RootWImageSize;
 
+// Files to be printed from a canvas, as prepared by RootWImage::saveFiles: they can be printed
+// right away or queued by the site and printed later on by a pool of worker processes
+class RootWImageExport {
+public:
+  TCanvas* canvas;
+  string canvasName;
+  int smallWidth, smallHeight;
+  int largeWidth, largeHeight;
+  string smallFileName;
+  vector<string> largeFileNames;
+  long cost; // Estimated rendering cost (histogram cells & graph points), biggest images are printed first
+  void print() const;
+};
+typedef vector<RootWImageExport> RootWImageExportQueue;
+
 class RootWImage : public RootWItem {
 public:
   ~RootWImage();
@@ -126,8 +141,10 @@ public:
   bool isImage() {return true;};
   bool addExtension(string newExt);
   void saveSummary(std::string baseName, TFile* myTargetFile);
+  void setExportQueue(RootWImageExportQueue* exportQueue) { exportQueue_ = exportQueue; }
 private:
   TCanvas* myCanvas_;
+  RootWImageExportQueue* exportQueue_; // If set, files are queued instead of being printed right away
   int zoomedWidth_;
   int zoomedHeight_;
   string relativeHtmlDirectory_;
@@ -140,6 +157,7 @@ private:
   RootWImageSize makeSizeCode(int sw, int sh, int lw, int lh);
   vector<string> fileTypeV_;
   void saveSummaryLoop(TPad* basePad, std::string baseName, TFile* myTargetFile);
+  static long estimateCost(TPad* basePad);
 
   static constexpr double thumb_compression_ = 2.;
   string allowedExtensions_; // Will be initialized in the constructor
@@ -261,6 +279,7 @@ public:
   RootWBinaryFile& addBinaryFile(string newFileName, string newDescription, string newOriginalFile);
   void setPage(RootWPage*);
   TFile* getSummaryFile();
+  RootWImageExportQueue* getExportQueue();
 private:
   bool visible_;
   string title_;
@@ -287,6 +306,11 @@ private:
   TFile* summaryFile_;
   bool createSummaryFile_;
   string summaryFileName_;
+  int exportWorkers_;
+  bool checkExport_;
+  RootWImageExportQueue* exportQueue_;
+  bool exportImages(RootWImageExportQueue& exportQueue);
+  bool checkExportedImages(const RootWImageExportQueue& exportQueue);
 public:
   ~RootWSite();
   RootWSite();
@@ -306,11 +330,15 @@ public:
   void addPage(RootWPage* newPage, int relevance = least_relevant);
   void addAuthor(string newAuthor);
   void setTargetDirectory(string newTargetDirectory) {targetDirectory_ = newTargetDirectory; };
+  string getTargetDirectory() const {return targetDirectory_; };
   //void setStyleDirectory(string newStyleDirectory) {styleDirectory_ = newStyleDirectory; } ;
   bool makeSite(bool verbose);
   void setSummaryFile(bool);
   TFile* getSummaryFile();
   void setSummaryFileName(std::string);
+  void setExportWorkers(int workers) { exportWorkers_ = workers; } // number of processes printing the image files
+  void setCheckExport(bool check) { checkExport_ = check; } // compare the images printed by the workers with serial prints
+  RootWImageExportQueue* getExportQueue() { return exportQueue_; }
 };
 
 class RootWPage {
@@ -340,6 +368,7 @@ public:
   void setRelevance(int newRelevance);
   int getRelevance();
   TFile* getSummaryFile();
+  RootWImageExportQueue* getExportQueue();
 };
 
 class RootWItemCollection {
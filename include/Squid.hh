@@ -30,6 +30,7 @@
 #include <memory>
 #include <RootWeb.hh>
 #include <MainConfigHandler.hh>
+#include <ConfigCache.hh>
 #include <MessageLogger.hh>
 
 #include <Tracker.hh>
@@ -37,6 +38,8 @@
 #include <OuterCabling/OuterCablingMap.hh>
 #include <InnerCabling/InnerCablingMap.hh>
 #include "Materialway.hh"
+#include "ModuleClasses.hh"
+#include "PhiSymmetry.hh"
 #include "WeightDistributionGrid.hh"
 
 
@@ -110,10 +113,17 @@ namespace insur {
     bool reportTriggerPerformanceSite(bool extended);
     bool reportNeighbourGraphSite();
     bool additionalInfoSite();
+    bool computeKeyFigures(const std::vector<double>& etaValues, double pt, const std::string& trackingTag, std::vector<std::pair<std::string, double> >& figures);
     bool makeSite(bool addLogPage = true);
     void setBasename(std::string newBaseName);
     void setGeometryFile(std::string geomFile);
     void setHtmlDir(std::string htmlDir);
+    void setCheckSpatialIndex(bool check);
+    void setNumThreads(int numThreads);
+    void setExportProcesses(int numProcesses, bool check);
+    void setPatternRecoErrors(PatternRecoErrors errors);
+    void setConfigCache(const std::string& directory, ConfigCache::Check check);
+    void setConfigurationOverrides(const std::vector<std::pair<std::string, std::string> >& overrides);
 
     void simulateTracks(const po::variables_map& varmap, int seed);
     void setCommandLine(int argc, char* argv[]);
@@ -155,6 +165,8 @@ namespace insur {
     std::string myMaterialFile_;
     std::string myPixelMaterialFile_;
     std::set<std::string> includeSet_; // list of configuration files
+    ConfigCache configCache_;
+    std::vector<std::pair<std::string, std::string> > configurationOverrides_; // Configuration path, value
     bool defaultMaterialFile;
     bool defaultPixelMaterialFile;
 
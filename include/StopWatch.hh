@@ -3,12 +3,19 @@
 
 #include <MessageLogger.hh>
 #include <ctime>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <ostream>
 #include <string>
 #include <list>
+#include <thread>
+#include <vector>
 
 #define startTaskClock(message) StopWatch::instance()->startCounter(message)
 #define addTaskInfo(message) StopWatch::instance()->addInfo(message)
 #define stopTaskClock() StopWatch::instance()->stopCounter()
+#define profileScope(name) StopWatch::Scope stopWatchScope(name)
 
 /**
  * @class StopWatch
@@ -20,6 +27,18 @@
  * most in a 32 bit CPU) The stop watch is started by the constructyor
  * (and by restart()) and it gives the elapsed CPU time in seconds
  * when asked
+ *
+ * When profiling is enabled, the task clocks and the silent profiled scopes
+ * (see profileScope) also build a call tree with, for each scope, the number
+ * of calls, the wall-clock time, the CPU time of its thread, the CPU time of
+ * the child processes waited for meanwhile, the growth of the resident memory
+ * between the opening and the closing of the scope (largest over the calls,
+ * from /proc/self/statm) and the peak resident memory of the whole process
+ * when the scope closed.
+ * Each thread has its own stack of scopes: the first scopes of a worker thread
+ * hang below the scope open in the main thread. writeProfile() exports the
+ * tree as JSON and every scope as a Chrome trace event (chrome://tracing,
+ * Perfetto). When profiling is disabled, a profiled scope costs one test.
  */
 class StopWatch {
  public:
@@ -29,6 +48,35 @@ class StopWatch {
   void setVerbosity(unsigned int newVerbosity, bool newPerformance);
   void addInfo(std::string message);
   static void destroy();
+
+  void setProfiling(bool profiling);
+  static bool isProfiling() { return profiling_; }
+  bool writeProfile(const std::string& directory);
+
+  //! Calls, wall-clock and CPU time (of the thread the scope ran in) and memory of the scopes with a given name, summed over the call tree
+  struct ScopeTotals {
+    long calls;
+    double wallSeconds;
+    double cpuSeconds;
+    long rssIncreaseKb;     // Largest growth of the resident memory during one call
+    long processPeakRssKb;  // Peak resident memory of the process when the last call closed
+  };
+  ScopeTotals scopeTotals(const std::string& name);
+
+  /**
+   * @class Scope
+   * @brief A profiled scope, silent on the console: it is recorded in the call tree only when profiling
+   */
+  class Scope {
+   public:
+    explicit Scope(const char* name) : open_(profiling_) { if (open_) instance()->openScope(name); }
+    ~Scope() { if (open_) instance()->closeScope(); }
+   private:
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    bool open_;
+  };
+
  private:
   StopWatch();
   ~StopWatch();
@@ -38,6 +86,42 @@ class StopWatch {
   unsigned int verbosity_;
   unsigned int lastVerbosity_;
   bool reportTime_;
+
+  // Profile
+  struct ProfileNode {
+    std::string name;
+    int parent;
+    std::vector<int> children;
+    std::map<std::string, int> childByName;
+    long calls;
+    double wallSeconds;
+    double cpuSeconds;
+    double childCpuSeconds;
+    long rssIncreaseKb;
+    long processPeakRssKb;
+  };
+  struct TraceEvent {
+    int node;
+    int thread;
+    double startMicroseconds;
+    double durationMicroseconds;
+    double cpuSeconds;
+    long rssIncreaseKb;
+    long processPeakRssKb;
+  };
+
+  void openScope(const std::string& name);
+  void closeScope();
+  int threadIndex();
+  void writeNode(std::ostream& output, int node, int depth) const;
+
+  static bool profiling_;
+  std::mutex profileMutex_;
+  std::chrono::steady_clock::time_point profileStart_;
+  std::vector<ProfileNode> nodes_;    // Node 0 is the whole run
+  std::vector<TraceEvent> events_;
+  std::vector<std::thread::id> threads_; // In order of appearance, the main thread first
+  int mainThreadNode_;                   // Innermost scope open in the main thread
 };
 
 #endif
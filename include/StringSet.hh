@@ -1,11 +1,13 @@
 #ifndef STRINGSET_H
 #define STRINGSET_H
 
+#include <mutex>
 #include <set>
 #include <string>
 
 class StringSet {
   std::set<std::string> strings_;
+  std::mutex mutex_; // Properties may be constructed by the threads of a parallel build
   StringSet() {}
 public:
   static StringSet& instance() {
@@ -18,6 +20,7 @@ public:
   }
 
   const std::string& makeRef(const std::string& s) { 
+    std::lock_guard<std::mutex> lock(mutex_);
     return *strings_.insert(s).first;
   }
 
@@ -17,6 +17,7 @@
 #include <Math/Vector3D.h>
 #include <TMatrixT.h>
 #include <TMatrixTSym.h>
+#include <Math/SMatrix.h>
 #include "Hit.hh"
 
 // Forward declaration
@@ -29,6 +30,10 @@ class RILength;
 typedef std::unique_ptr<Track> TrackPtr;
 typedef std::vector<TrackPtr>  TrackCollection;
 
+//! Algorithm computing the covariance matrices of the track parameters: by inverting the full NxN hit variance matrix (TMATRIX),
+//! in closed form with fixed-size parameter matrices (SMATRIX), or both, cross-checking them (VALIDATE)
+enum class CovarianceBackend { TMATRIX, SMATRIX, VALIDATE };
+
 /**
  * @class Track
  * @details The Track class is essentially a collection of consecutive hits used to calculate track parameters
@@ -52,15 +57,22 @@ public:
   //! Track constructor -> need to use setter methods to set: 2 of these [theta, phi, eta, cot(theta)] & 2 of these [mag. field, transv. momentum, radius]
   Track();
 
-  //! Track copy-constructor -> creates deep copy of hit vector
+  //! Track copy-constructor -> creates copy of hit vector, the hits sharing their geometry with the original ones
   Track(const Track& track);
 
-  //! Assign operator with deep copy of hit vector
+  //! Assign operator with copy of hit vector, the hits sharing their geometry with the original ones
   Track& operator=(const Track &track);
 
   //! Destructor
   ~Track();
 
+  //! Tracks are allocated through the analysis arena
+  static void* operator new(std::size_t size) { return AnalysisArena::allocate(size); }
+  static void  operator delete(void* track)    { AnalysisArena::deallocate(track); }
+
+  //! Select the algorithm used by all tracks to compute the covariance matrices of the track parameters
+  static void setCovarianceBackend(CovarianceBackend backend) { s_covarianceBackend = backend; }
+
   //
   // Define track properties
 
@@ -162,6 +174,15 @@ public:
   double getDeltaZ(double refPointRPos, bool propagOutIn=true);
   double getDeltaZ0() { return getDeltaZ(0.0); }
 
+  //! Start incremental (Kalman-like) propagation of the track errors: hits then fitted one by one inside-out (propagOutIn=false) or outside-in (propagOutIn=true),
+  //! keeping only the running information matrices in R-Phi & s-Z. Ref. points must be then requested in the propagation order. Needs to be restarted if track changed.
+  void startIncrementalErrors(bool propagOutIn=true);
+
+  //! Get DeltaD/DeltaZ at refPoint [rPos, zPos] using the incremental propagation: only the hits between the previous & current ref. point are newly fitted, the results
+  //! are the same as those of getDeltaD/getDeltaZ called with the propagator direction passed to startIncrementalErrors
+  double getIncrementalDeltaD(double refPointRPos);
+  double getIncrementalDeltaZ(double refPointRPos);
+
   //! Get DeltaCTau for secondary particles coming from the primary vertex at ~ [0,0] -> an important quantity to estimate the
   //! resolution of secondary vertices
   double getDeltaCTau();
@@ -253,6 +274,16 @@ protected:
   //! Return true if V invertable
   bool computeCovarianceMatrixRPhi(double refPointRPos, bool propagOutIn);
 
+  //! Helper fce returning the MS angle^2/sin^2(theta) caused by the material of given hit, projected to R-Phi or s-Z
+  double computeMSThetaOverSinSqRPhi(Hit& hit) const;
+  double computeMSThetaOverSinSqRZ(Hit& hit) const;
+
+  //! Fit all hits in front of the ref. point (in propagation direction), which haven't been used by the incremental error propagation yet
+  void addIncrementalHits(double refPointRPos);
+
+  //! Transport the information matrices of the incremental error propagation to given radius
+  void transportIncrementalErrors(double rPos);
+
   //! Helper fce returning derivative: d[f(rho, d0, phi0)]/d[rho], where f approximates
   //! a helix by set of parabolas. In general, N connected parabolas used, for const B
   //! field only one parabola assumed.
@@ -290,6 +321,20 @@ protected:
   TMatrixTSym<double>   m_varMatrixRZ;   //!< NxN (hits) Variance matrix in R-Z V(NxN) (N hits = K+L: K active hits on detectors + L passive (artificial) hits due to material)
   TMatrixT<double>      m_covMatrixRZ;   //!< 2x2 Covariance matrix in R-Phi: z0, cotg(theta) at ref. point [r,z] = [0,0]: C(2x2)
 
+  // Incremental error propagation (see startIncrementalErrors)
+  typedef ROOT::Math::SMatrix<double, 3, 3, ROOT::Math::MatRepSym<double, 3> > IncrInfoMatrixRPhi;
+  typedef ROOT::Math::SMatrix<double, 2, 2, ROOT::Math::MatRepSym<double, 2> > IncrInfoMatrixRZ;
+
+  bool                  m_incrStarted;        //!< Incremental error propagation started (reset if track changed)
+  bool                  m_incrPropagOutIn;    //!< Propagator direction of the incremental error propagation
+  int                   m_incrNextHit;        //!< Index of the next hit to be fitted by the incremental error propagation
+  double                m_incrRPos;           //!< Radius of the last hit fitted by the incremental error propagation, at which the track parameters are expressed
+  int                   m_incrNMeasurable;    //!< Number of measurable hits fitted so far (counted as by the global fit)
+  IncrInfoMatrixRPhi    m_incrInfoMatrixRPhi; //!< 3x3 running information matrix (inverse covariance) in R-Phi: 1/R, phi, d at m_incrRPos
+  IncrInfoMatrixRZ      m_incrInfoMatrixRZ;   //!< 2x2 running information matrix (inverse covariance) in s-Z: cotg(theta), z at m_incrRPos
+
+  static CovarianceBackend s_covarianceBackend; //!< Algorithm used to compute the covariance matrices (the NxN variance matrices are only filled by the TMatrix one)
+
 }; // Class
 
 #endif /* INCLUDE_TRACK_H_ */
@@ -22,6 +22,7 @@
 #include "InnerCabling/InnerCablingMap.hh"
 #include "MainConfigHandler.hh"
 #include "DetIdBuilder.hh"
+#include "PhiSymmetry.hh"
 
 using std::set;
 using material::SupportStructure;
@@ -78,6 +79,7 @@ private:
   //std::map<uint32_t, Module> modules_;
   std::unique_ptr<const OuterCablingMap> myOuterCablingMap_;
   std::unique_ptr<const InnerCablingMap> myInnerCablingMap_;
+  mutable std::unique_ptr<const PhiSymmetry> phiSymmetry_; // detected once, possibly at the first analysis of the const tracker
 
   //Tracker(const Tracker& otherTracker) = default;
 public:
@@ -167,6 +169,10 @@ public:
     return myInnerCablingMap_.get();
   }
 
+  // Phi symmetry of the built tracker, see PhiSymmetry::record and PhiSymmetry::forAnalysis
+  void setPhiSymmetry(std::unique_ptr<const PhiSymmetry> symmetry) const { phiSymmetry_ = std::move(symmetry); }
+  const PhiSymmetry* phiSymmetry() const { return phiSymmetry_.get(); }
+
   const Barrels& barrels() const { return barrels_; }
   const Endcaps& endcaps() const { return endcaps_; }
 
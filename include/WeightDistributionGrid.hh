@@ -2,6 +2,7 @@
 #define WEIGHTDISTRIBUTIONGRID_H
 
 #include <map>
+#include <vector>
 
 namespace material {
 
@@ -9,14 +10,40 @@ namespace material {
   
   typedef std::map<std::pair<int, int>,double> WeightDistributionGridMapType;
 
-  class WeightDistributionGrid : public WeightDistributionGridMapType {
+  /**
+   * Grams of material per (z, r) bin. The bins are stored in dense square tiles of tileBins x tileBins bins, allocated
+   * when some material first falls in them: a single array over the tracker envelope would need several 10^8 bins at
+   * the 0.1 mm bins of the tracker, while the tiles only cover the occupied regions and are filled row by row.
+   * With setCheckStorage(true), the grams are also accumulated bin by bin in a map, as they were before the tiles,
+   * and checkStorage() compares both.
+   */
+  class WeightDistributionGrid {
   public:
+    static const int tileBins = 64;
+
     WeightDistributionGrid(double binDimension);
+    WeightDistributionGrid(const WeightDistributionGrid&) = delete; // would share the last tile pointer
+    WeightDistributionGrid& operator=(const WeightDistributionGrid&) = delete;
     virtual ~WeightDistributionGrid() {};
     void addTotalGrams(double minZ, double minR, double maxZ, double maxR, double length, double surface, const MaterialObject& materialObject);
     double binDimension() const;
+    double& operator[](const std::pair<int, int>& binIndex) { return bin(binIndex.first, binIndex.second); }
+    double operator()(int binIndexZ, int binIndexR) const;
+    WeightDistributionGridMapType bins() const;
+    void clear();
+
+    static void setCheckStorage(bool check) { checkStorage_ = check; }
+    static bool isCheckingStorage() { return checkStorage_; }
+    bool checkStorage() const;
   private:
+    typedef std::pair<int, int> TileIndex;
     double binDimension_;
+    std::map<TileIndex, std::vector<double> > tiles_; // Bin (z, r) of a tile at index (r % tileBins) * tileBins + z % tileBins
+    TileIndex lastTileIndex_;                         // addTotalGrams runs along z, mostly within the same tile
+    std::vector<double>* lastTile_;
+    WeightDistributionGridMapType referenceGrams_;    // Only filled when checking the storage
+    static bool checkStorage_;
+    double& bin(int binIndexZ, int binIndexR);
   };
 }
 
@@ -0,0 +1,176 @@
+/**
+ * @file AnalysisArena.cc
+ * @brief Pool allocation of the hits and tracks of the tracking analyses
+ */
+
+#include "AnalysisArena.hh"
+
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <vector>
+
+ArenaAllocation AnalysisArena::s_allocation = ArenaAllocation::HEAP;
+
+namespace {
+
+  const std::size_t Granularity    = 16;       // Size classes, also the alignment of the objects
+  const std::size_t MaxObjectSize  = 4096;     // Larger objects always go to the global heap
+  const std::size_t HeaderSize     = 16;       // Chunk pointer in front of each object, keeping the objects aligned
+  const std::size_t ChunkSize      = 64*1024;
+  const std::size_t MinChunkBlocks = 16;
+
+  struct Pool;
+
+  //
+  // Chunk header, followed by the blocks. Blocks taken from the global heap have a null chunk pointer
+  //
+  struct Chunk {
+    Pool* pool;
+    long  live;        // Blocks of the chunk in use
+    char  padding[Granularity - (sizeof(Pool*) + sizeof(long)) % Granularity];
+  };
+
+  Chunk*& chunkOf(char* block) { return *reinterpret_cast<Chunk**>(block); }
+  char*&  nextFree(char* block) { return *reinterpret_cast<char**>(block + HeaderSize); }
+
+  //
+  // Blocks of one size class, for one thread: free blocks are chained through their object part
+  //
+  struct Pool {
+    explicit Pool(std::size_t size) : blockSize(HeaderSize + size), freeList(nullptr), next(nullptr), end(nullptr) {}
+
+    char* take() {
+      char* block;
+      if (freeList != nullptr) {
+        block    = freeList;
+        freeList = nextFree(block);
+      } else {
+        if (next == end) addChunk();
+        block = next;
+        next += blockSize;
+        chunkOf(block) = chunks.back();
+      }
+      chunkOf(block)->live++;
+      return block;
+    }
+
+    void give(char* block) {
+      chunkOf(block)->live--;
+      nextFree(block) = freeList;
+      freeList = block;
+    }
+
+    void addChunk() {
+      std::size_t nBlocks = std::max(MinChunkBlocks, ChunkSize / blockSize);
+      char* memory = static_cast<char*>(::operator new(sizeof(Chunk) + nBlocks*blockSize));
+      Chunk* chunk = new (memory) Chunk;
+      chunk->pool = this;
+      chunk->live = 0;
+      chunks.push_back(chunk);
+      next = memory + sizeof(Chunk);
+      end  = next + nBlocks*blockSize;
+    }
+
+    // Free the chunks without live blocks, forgetting their free blocks
+    void releaseEmptyChunks() {
+      if (std::none_of(chunks.begin(), chunks.end(), [](const Chunk* c) { return c->live == 0; })) return;
+
+      char** link = &freeList;
+      while (*link != nullptr) {
+        if (chunkOf(*link)->live == 0) *link = nextFree(*link);
+        else link = &nextFree(*link);
+      }
+      if (chunks.back()->live == 0) next = end = nullptr;
+
+      std::vector<Chunk*> kept;
+      for (Chunk* chunk : chunks) {
+        if (chunk->live != 0) kept.push_back(chunk);
+        else ::operator delete(chunk);
+      }
+      chunks.swap(kept);
+    }
+
+    std::mutex          mutex;    // Taken by the owning thread, and by others freeing its blocks or releasing chunks
+    const std::size_t   blockSize;
+    std::vector<Chunk*> chunks;
+    char*               freeList;
+    char*               next;     // Unused tail of the last chunk
+    char*               end;
+  };
+
+  //
+  // Pools of all threads, for release(). They are never deleted, as blocks may outlive their thread:
+  // the pools of the finished threads are taken over by the new ones
+  //
+  std::mutex& registryMutex() { static std::mutex mutex; return mutex; }
+  std::vector<Pool*>& registry() { static std::vector<Pool*> pools; return pools; }
+  std::vector<Pool*>& orphans() { static std::vector<Pool*> pools; return pools; }
+
+  struct ThreadPools {
+    ThreadPools() : bySizeClass(MaxObjectSize / Granularity, nullptr) {}
+    ~ThreadPools() {
+      std::lock_guard<std::mutex> lock(registryMutex());
+      for (Pool* pool : bySizeClass) if (pool != nullptr) orphans().push_back(pool);
+    }
+    std::vector<Pool*> bySizeClass;
+  };
+
+  Pool& threadPool(std::size_t size) {
+    thread_local ThreadPools pools;
+    std::size_t sizeClass = (size + Granularity - 1) / Granularity - 1;
+    Pool*& pool = pools.bySizeClass[sizeClass];
+    if (pool == nullptr) {
+      std::size_t blockSize = (sizeClass + 1) * Granularity;
+      std::lock_guard<std::mutex> lock(registryMutex());
+      auto orphan = std::find_if(orphans().begin(), orphans().end(), [&](const Pool* p) { return p->blockSize == HeaderSize + blockSize; });
+      if (orphan != orphans().end()) {
+        pool = *orphan;
+        orphans().erase(orphan);
+      } else {
+        pool = new Pool(blockSize);
+        registry().push_back(pool);
+      }
+    }
+    return *pool;
+  }
+}
+
+/**
+ * Allocate an object, from the arena of the current thread in ARENA mode, from the global heap otherwise
+ */
+void* AnalysisArena::allocate(std::size_t size) {
+  char* block;
+  if (s_allocation == ArenaAllocation::ARENA && size > 0 && size <= MaxObjectSize) {
+    Pool& pool = threadPool(size);
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    block = pool.take();
+  } else {
+    block = static_cast<char*>(::operator new(HeaderSize + size));
+    chunkOf(block) = nullptr;
+  }
+  return block + HeaderSize;
+}
+
+/**
+ * Free an object obtained from allocate(), whichever thread and mode it was allocated with
+ */
+void AnalysisArena::deallocate(void* object) {
+  if (object == nullptr) return;
+  char* block = static_cast<char*>(object) - HeaderSize;
+  Chunk* chunk = chunkOf(block);
+  if (chunk == nullptr) {
+    ::operator delete(block);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(chunk->pool->mutex);
+  chunk->pool->give(block);
+}
+
+void AnalysisArena::release() {
+  std::lock_guard<std::mutex> registryLock(registryMutex());
+  for (Pool* pool : registry()) {
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    pool->releaseEmptyChunks();
+  }
+}
@@ -7,14 +7,19 @@
 #include <Analyzer.hh>
 #include "MainConfigHandler.hh"
 #include <Hit.hh>
+#include <StopWatch.hh>
 #include <TProfile.h>
 #include <TLegend.h>
 #include <Palette.hh>
 #include "SimParms.hh"
+#include "PhiSymmetry.hh"
 #include "AnalyzerVisitors/MaterialBillAnalyzer.hh"
 #include <Units.hh>
 #include "TProfile.h"
 #include "TMath.h"
+#include <TROOT.h>
+#include <thread>
+#include <exception>
 
 #undef MATERIAL_SHADOW
 
@@ -68,6 +73,10 @@ namespace insur {
     geomLiteEC         = nullptr; geomLiteECCreated=false;
     geometryTracksUsed = 0;
     materialTracksUsed = 0;
+    checkSpatialIndex_ = false;
+    patternRecoErrors_ = PatternRecoErrors::REFIT;
+    numThreads_ = 1;
+    bufferMaterialMapFills_ = false;
   }
 
   // private
@@ -78,7 +87,7 @@ namespace insur {
    * Shape of luminous region in Z is always assumed to be centered around Z = 0.
    * return: XYZVector defining the IP position (in CMS official frame of reference).
    */
-  const XYZVector Analyzer::getLuminousRegion() {
+  const XYZVector Analyzer::getLuminousRegion(CounterRandom::Stream& draws) {
     // IP is always assumed to be on the (Z) axis.
     const double dx = 0.;
     const double dy = 0.;
@@ -90,8 +99,8 @@ namespace insur {
 
     double dz = 0.;
     if (lumiShape == LumiRegShape::SPOT) dz = 0.;
-    else if (lumiShape == LumiRegShape::FLAT) dz = (myDice.Rndm() * 2. - 1.) * zError;
-    else if (lumiShape == LumiRegShape::GAUSSIAN) dz = myDice.Gaus(0., zError);
+    else if (lumiShape == LumiRegShape::FLAT) dz = (draws.uniform() * 2. - 1.) * zError;
+    else if (lumiShape == LumiRegShape::GAUSSIAN) dz = draws.gaus(0., zError);
     else logERROR("Shape of luminous region specified in SimParms is not supported.");
 
     // IP position
@@ -145,6 +154,84 @@ namespace insur {
   }
 
 
+  /**
+   * Shoots a fan of tracks through the material budget (eta from 0 to getEtaMaxTrigger(), random phi, origin in the
+   * luminous region), finds all their hits on modules and inactive surfaces and adds the hit on the beam pipe.
+   * The sample is shared read-only by the analyses needing the full material along the tracks, so that the
+   * intersections with the detector are computed only once. The random numbers of each track only depend on its
+   * index, hence the sample only depends on the material budgets and on the number of tracks.
+   * @param mb A reference to the instance of <i>MaterialBudget</i> that is to be analysed
+   * @param pm A pointer to a second material budget associated to a pixel detector; may be <i>NULL</i>
+   * @param nTracks The number of tracks in the sample
+   */
+  void Analyzer::createTrackSample(MaterialBudget& mb, MaterialBudget* pm, int nTracks) {
+    fillTrackSample(trackSample_, mb, pm, nTracks, false);
+  }
+
+  /**
+   * Fills a track sample: eta is either spread from 0 to getEtaMaxTrigger() included (the tagged tracking grid), or
+   * taken at the centres of nTracks bins from 0 to geom_max_eta_coverage (the pattern recognition profiles), each
+   * grid drawing its phi and origins from its own random streams.
+   */
+  void Analyzer::fillTrackSample(TrackSample& sample, MaterialBudget& mb, MaterialBudget* pm, int nTracks, bool binCentres) {
+    profileScope(binCentres ? "Creating the pattern recognition track sample" : "Creating the track sample");
+    sample.tracks.clear();
+    sample.budgets = std::make_pair(&mb, pm);
+    sample.size = nTracks;
+
+    double etaStep;
+    if (binCentres) etaStep = geom_max_eta_coverage / (double)nTracks;
+    else if (nTracks > 1) etaStep = getEtaMaxTrigger() / (double)(nTracks - 1);
+    else etaStep = getEtaMaxTrigger();
+
+    CounterRandom random(binCentres ? CounterRandom::PatternRecoSample : CounterRandom::TrackSample);
+    for (int i_eta = 0; i_eta < nTracks; i_eta++) {
+      CounterRandom::Stream draws = random.track(i_eta);
+      double phi = draws.uniform() * M_PI * 2.0;
+      double eta = binCentres ? (i_eta + 0.5) * etaStep : i_eta * etaStep;
+      double theta = 2 * atan(exp(-eta));
+
+      TrackPtr track(new Track());
+      track->setThetaPhiPt(theta, phi, 1*Units::TeV);
+      track->setOrigin(getLuminousRegion(draws));
+
+      // Assign material to the track
+      findAllHits(mb, pm, *track);
+
+      // TODO: add the beam pipe as a user material eveywhere!
+      // in a coherent way
+      // Add the hit on the beam pipe
+      double rPos  = 23.*Units::mm;
+      double zPos  = rPos/tan(theta);
+
+      HitPtr hit(new Hit(rPos, zPos, nullptr, HitPassiveType::BeamPipe));
+
+      Material material;
+      material.radiation   = 0.0022761 / sin(theta);  // was 0.0023, adapted to fit CMSSW 81X 2016/11/30
+      material.interaction = 0.0020334 / sin(theta);  // was 0.0019, adapted to fit CMSSW 81X 2016/11/30
+      hit->setCorrectedMaterial(material);
+      track->addHit(std::move(hit));
+
+      sample.tracks.push_back(std::move(track));
+    }
+  }
+
+  /**
+   * Returns the shared track sample, creating it first if it was not built yet for these material budgets and number of tracks.
+   */
+  const TrackCollection& Analyzer::getTrackSample(MaterialBudget& mb, MaterialBudget* pm, int nTracks) {
+    if (trackSample_.budgets != std::make_pair(&mb, pm) || trackSample_.size != nTracks) fillTrackSample(trackSample_, mb, pm, nTracks, false);
+    return trackSample_.tracks;
+  }
+
+  /**
+   * Returns the track sample of the pattern recognition, whose tracks sit at the centres of its eta bins
+   */
+  const TrackCollection& Analyzer::getPatternRecoSample(MaterialBudget& mb, MaterialBudget* pm, int nTracks) {
+    if (patternRecoSample_.budgets != std::make_pair(&mb, pm) || patternRecoSample_.size != nTracks) fillTrackSample(patternRecoSample_, mb, pm, nTracks, true);
+    return patternRecoSample_.tracks;
+  }
+
   /* TODO: finish this :-)
 void Analyzer::createTaggedTrackCollection(std::vector<MaterialBudget*> materialBudgets,
                                            int etaSteps,
@@ -175,16 +262,12 @@ void Analyzer::createTaggedTrackCollection(std::vector<MaterialBudget*> material
 				       bool& debugResolution,
 				       int etaSteps,
 				       MaterialBudget* pm) {
+  profileScope("Tagged tracking");
 
   materialTracksUsed = etaSteps;
+  AnalysisArena::Pass arenaPass; // the hits and tracks of this pass are released in bulk at its end
 
-  int nTracks;
-  double etaStep, eta, theta, phi;
-
-  // prepare etaStep, phiStep, nTracks, nScans
-  if (etaSteps > 1) etaStep = getEtaMaxTrigger() / (double)(etaSteps - 1);
-  else etaStep = getEtaMaxTrigger();
-  nTracks = etaSteps;
+  double theta;
 
   // prepareTriggerPerformanceHistograms(nTracks, getEtaMaxTrigger(), triggerMomenta, thresholdProbabilities);
 
@@ -197,38 +280,10 @@ void Analyzer::createTaggedTrackCollection(std::vector<MaterialBudget*> material
   std::map<std::string, TrackCollectionMap> taggedTrackPCollectionMapIdeal;
 
 
-  for (int i_eta = 0; i_eta < nTracks; i_eta++) {
-    phi = myDice.Rndm() * M_PI * 2.0;
-    Material tmp;
-    Track track;
-    eta = i_eta * etaStep;
-    theta = 2 * atan(exp(-eta)); 
-    track.setThetaPhiPt(theta,phi,1*Units::TeV);
-
-    track.setOrigin(getLuminousRegion());
-
-    // Assign material to the track
-    tmp = findAllHits(mb, pm, track);
-
-    // Debug: material amount
-    // std::cerr << "eta = " << eta
-    //           << ", material.radiation = " << tmp.radiation
-    //           << ", material.interaction = " << tmp.interaction
-    //           << std::endl;
-
-    // TODO: add the beam pipe as a user material eveywhere!
-    // in a coherent way
-    // Add the hit on the beam pipe
-    double rPos  = 23.*Units::mm;
-    double zPos  = rPos/tan(theta);
-
-    HitPtr hit(new Hit(rPos, zPos, nullptr, HitPassiveType::BeamPipe));
-
-    Material material;
-    material.radiation   = 0.0022761 / sin(theta);  // was 0.0023, adapted to fit CMSSW 81X 2016/11/30
-    material.interaction = 0.0020334 / sin(theta);  // was 0.0019, adapted to fit CMSSW 81X 2016/11/30
-    hit->setCorrectedMaterial(material);
-    track.addHit(std::move(hit));
+  // Tracks with all their hits (beam pipe included) are taken from the shared sample
+  for (const auto& sampleTrack : getTrackSample(mb, pm, etaSteps)) {
+    Track track(*sampleTrack);
+    theta = track.getTheta();
 
     if (!track.hasNoHits()) {
       for (string tag : track.getTags()) {
@@ -360,12 +415,21 @@ void Analyzer::createTaggedTrackCollection(std::vector<MaterialBudget*> material
    * @param thresholdProbabilities
    * @param etaSteps The number of wedges in the fan of tracks covered by the eta scan
    */
+  /**
+   * Counts the triggering points along tracks with eta from 0 to getEtaMaxTrigger(). When the material budget of the
+   * tracker is given, the tracks are copied from the shared track sample (the same grid as the tagged tracking), whose
+   * hits on the tracker modules are those the bare tracker would give; otherwise they are shot through the bare tracker.
+   */
   void Analyzer::analyzeTriggerEfficiency(Tracker& tracker,
                                           const std::vector<double>& triggerMomenta,
                                           const std::vector<double>& thresholdProbabilities,
-                                          int etaSteps) {
+                                          int etaSteps,
+                                          MaterialBudget* mb,
+                                          MaterialBudget* pm) {
+    profileScope("Trigger efficiency");
 
     materialTracksUsed = etaSteps;
+    AnalysisArena::Pass arenaPass;
 
     int nTracks;
     double etaStep, eta, theta, phi;
@@ -381,16 +445,26 @@ void Analyzer::createTaggedTrackCollection(std::vector<MaterialBudget*> material
     TrackCollection tracks;
 
     // Loop over nTracks (eta range [0, getEtaMaxTrigger()])
+    const TrackCollection* sample = mb ? &getTrackSample(*mb, pm, nTracks) : nullptr;
+    CounterRandom random(CounterRandom::TriggerEfficiency);
     for (int i_eta = 0; i_eta < nTracks; i_eta++) {
-      phi = myDice.Rndm() * M_PI * 2.0;
-
       Track track;
-      eta = i_eta * etaStep;
-      theta = 2 * atan(exp(-eta));
-      track.setThetaPhiPt(theta,phi,1*Units::TeV);
-      track.setOrigin(getLuminousRegion());
-
-      int nHits = findHitsModules(tracker, track);
+      int nHits;
+      if (sample) {
+        // Hits on inactive surfaces, on the beam pipe and on pixel modules are left passive by keepTriggerHitsOnly
+        track = *sample->at(i_eta);
+        nHits = track.getNHits();
+      } else {
+        CounterRandom::Stream draws = random.track(i_eta);
+        phi = draws.uniform() * M_PI * 2.0;
+
+        eta = i_eta * etaStep;
+        theta = 2 * atan(exp(-eta));
+        track.setThetaPhiPt(theta,phi,1*Units::TeV);
+        track.setOrigin(getLuminousRegion(draws));
+
+        nHits = findHitsModules(tracker, track);
+      }
 
       if (nHits) {
 
@@ -458,6 +532,19 @@ bool Analyzer::isTripletFromDifLayers(Track& track, int iHit, bool propagOutIn)
   else                  return false;
 }
 
+//
+// Cross-check an error of the incremental propagation against the global refit: both must be computed (or not) and agree within the tolerance
+//
+void Analyzer::validatePatternRecoError(const std::string& quantity, double refPointRPos, double incremental, double refit) {
+
+  static const double tolerance = 1e-6; // relative
+
+  if ((incremental<0) != (refit<0) || (refit>=0 && fabs(incremental-refit) > tolerance*refit)) {
+    logWARNING("PatternReco: "+quantity+" at r[mm]="+any2str(refPointRPos/Units::mm,1)+" -> incremental propagation differs from refit: "
+               +any2str(incremental)+" vs "+any2str(refit));
+  }
+}
+
 //
 // Analyze tracker pattern recognition capabilities. The quantities used to qualify the pattern reco capabilities are meant for primary tracks only
 // rather than for secondary tracks, as one always starts in the innermost layer (+ IP contraint) or outermost layer in case of out-in approach.
@@ -466,7 +553,9 @@ bool Analyzer::isTripletFromDifLayers(Track& track, int iHit, bool propagOutIn)
 // & rough detector (material) setup.
 //
 bool Analyzer::analyzePatterReco(MaterialBudget& mb, mainConfigHandler& mainConfig, int nTracks, MaterialBudget* pm) {
+  profileScope("Pattern recognition");
 
+  AnalysisArena::Pass arenaPass;
   bool isAnalysisOK = true;
 
   // Get fluence map
@@ -477,7 +566,10 @@ bool Analyzer::analyzePatterReco(MaterialBudget& mb, mainConfigHandler& mainConf
 
   fluenceMapOK = checkFile(default_fluence_file, directory);
   std::cout << "Reading in: " << directory + "/" + default_fluence_file << std::endl;
-  if (fluenceMapOK) fluenceMap  = new IrradiationMap(directory + "/" + default_fluence_file);
+  if (fluenceMapOK) {
+    fluenceMap   = new IrradiationMap(directory + "/" + default_fluence_file);
+    fluenceMapOK = fluenceMap->isValid();
+  }
 
   // Set nTracks
   if (nTracks<=0) {
@@ -507,34 +599,14 @@ bool Analyzer::analyzePatterReco(MaterialBudget& mb, mainConfigHandler& mainConf
 
   // Check that map available
   if (!fluenceMapOK) isAnalysisOK = false;
-  else for (int iTrack = 0; iTrack <nTracks; iTrack++) {
-
-    // Define track
-    Track matTrack;
-
-    double eta   = 0.0 + geom_max_eta_coverage/nTracks*(iTrack+0.5);
-    double theta = 2 * atan(exp(-eta));
-    double phi   = myDice.Rndm() * M_PI * 2.0;
-    double pT    = 100*Units::TeV; // Arbitrarily high number
+  else for (const auto& sampleTrack : getPatternRecoSample(mb, pm, nTracks)) {
 
-    matTrack.setThetaPhiPt(theta, phi, pT);
+    // Define track: hits & material (beam pipe included) taken from the shared sample
+    const Track& matTrack = *sampleTrack;
 
-    matTrack.setOrigin(getLuminousRegion());
-
-    // Assign material to the track
-    findAllHits(mb, pm, matTrack);
-
-    // Add beam-pipe
-    double rPos  = 23.*Units::mm;
-    double zPos  = rPos/tan(theta);
-
-    HitPtr hit(new Hit(rPos, zPos, nullptr, HitPassiveType::BeamPipe));
-
-    Material material;
-    material.radiation   = 0.0022761 / sin(theta);  // was 0.0023, adapted to fit CMSSW 81X 2016/11/30
-    material.interaction = 0.0020334 / sin(theta);  // was 0.0019, adapted to fit CMSSW 81X 2016/11/30
-    hit->setCorrectedMaterial(material);
-    matTrack.addHit(std::move(hit));
+    double eta   = matTrack.getEta();
+    double theta = matTrack.getTheta();
+    double pT    = 0;
 
     // For each momentum/transverse momentum compute
     int iMomentum = 0;
@@ -561,6 +633,7 @@ bool Analyzer::analyzePatterReco(MaterialBudget& mb, mainConfigHandler& mainConf
           // Set track & prune hits
           Track track(matTrack);
           track.resetPt(pT);
+          if (patternRecoErrors_ != PatternRecoErrors::REFIT) track.startIncrementalErrors(propagOutIn);
 
           //
           // Pattern recognition procedure
@@ -617,8 +690,23 @@ bool Analyzer::analyzePatterReco(MaterialBudget& mb, mainConfigHandler& mainConf
             double flux   = fluenceMap->calculateIrradiation(std::make_pair(nextZPos/Units::mm,nextRPos/Units::mm))*1/Units::cm2/Units::s * nPU;
 
             double corrFactor = cos(nextHitTilt) + track.getCotgTheta()/sqrt(1-A*A)*sin(nextHitTilt);
-            double dZProj     = track.getDeltaZ(nextRPos,propagOutIn)/corrFactor;
-            double dDProj     = track.getDeltaD(nextRPos,propagOutIn);
+            double dZProj     = 0;
+            double dDProj     = 0;
+            if (patternRecoErrors_ == PatternRecoErrors::INCREMENTAL) {
+
+              // Only hits between the previous & the next hit fitted -> ref. points requested in the propagation order
+              dZProj = track.getIncrementalDeltaZ(nextRPos)/corrFactor;
+              dDProj = track.getIncrementalDeltaD(nextRPos);
+            }
+            else {
+
+              dZProj = track.getDeltaZ(nextRPos,propagOutIn)/corrFactor;
+              dDProj = track.getDeltaD(nextRPos,propagOutIn);
+              if (patternRecoErrors_ == PatternRecoErrors::VALIDATE) {
+                validatePatternRecoError("dZ", nextRPos, track.getIncrementalDeltaZ(nextRPos)/corrFactor, dZProj);
+                validatePatternRecoError("dD", nextRPos, track.getIncrementalDeltaD(nextRPos), dDProj);
+              }
+            }
 
             // Print info
             //std::cout << ">> " << iHitID << " R=" << nextRPos/Units::mm << " dD=" << dDProj/Units::um << " " << " Z=" << nextZPos/Units::mm << " dZ=" << dZProj/Units::um << std::endl;
@@ -912,10 +1000,12 @@ void Analyzer::fillTriggerEfficiencyGraphs(const Tracker& tracker,
  */
 void Analyzer::analyzeMaterialBudget(MaterialBudget& mb, const std::vector<double>& momenta, int etaSteps,
                                      MaterialBudget* pm) {
+  profileScope("Material budget");
 
   materialTracksUsed = etaSteps;
+  AnalysisArena::Pass arenaPass;
   int nTracks;
-  double etaStep, eta, theta, phi;
+  double etaStep;
   clearMaterialBudgetHistograms();
   clearCells();
   // prepare etaStep, phiStep, nTracks, nScans
@@ -930,303 +1020,471 @@ void Analyzer::analyzeMaterialBudget(MaterialBudget& mb, const std::vector<doubl
   // std::vector<Track> tv;
   // std::vector<Track> tvIdeal;
 
-  for (int i_eta = 0; i_eta < nTracks; i_eta++) {
-    phi = myDice.Rndm() * M_PI * 2.0;
-    Material tmp;
-    Track track;
-    eta = i_eta * etaStep;
-    theta = 2 * atan(exp(-eta)); // TODO: switch to exp() here
-    track.setThetaPhiPt(theta,phi,1*Units::TeV);
-    track.setOrigin(getLuminousRegionInMatBudgetAnalysis());
-    //      active volumes, barrel
-    std::map<std::string, Material> sumComponentsRI;
-    tmp = analyzeModules(mb.getBarrelModuleCaps(), track, sumComponentsRI);
-    ractivebarrel.Fill(eta, tmp.radiation);
-    iactivebarrel.Fill(eta, tmp.interaction);
-    rbarrelall.Fill(eta, tmp.radiation);
-    ibarrelall.Fill(eta, tmp.interaction);
-    ractiveall.Fill(eta, tmp.radiation);
-    iactiveall.Fill(eta, tmp.interaction);
-    rglobal.Fill(eta, tmp.radiation);
-    iglobal.Fill(eta, tmp.interaction);
-
-    //      active volumes, endcap
-    tmp = analyzeModules(mb.getEndcapModuleCaps(), track, sumComponentsRI);
-    ractiveendcap.Fill(eta, tmp.radiation);
-    iactiveendcap.Fill(eta, tmp.interaction);
-    rendcapall.Fill(eta, tmp.radiation);
-    iendcapall.Fill(eta, tmp.interaction);
-    ractiveall.Fill(eta, tmp.radiation);
-    iactiveall.Fill(eta, tmp.interaction);
-    rglobal.Fill(eta, tmp.radiation);
-    iglobal.Fill(eta, tmp.interaction);
-
-    for (std::map<std::string, Material>::iterator it = sumComponentsRI.begin(); it != sumComponentsRI.end(); ++it) {
-      if (rComponents[it->first]==NULL) { 
-        rComponents[it->first] = new TH1D();
-        rComponents[it->first]->SetBins(nTracks, 0.0, getEtaMaxMaterial()); 
-      }
-      rComponents[it->first]->Fill(eta, it->second.radiation);
-      if (iComponents[it->first]==NULL) {
-        iComponents[it->first] = new TH1D();
-        iComponents[it->first]->SetBins(nTracks, 0.0, getEtaMaxMaterial()); 
-      }
-      iComponents[it->first]->Fill(eta, it->second.interaction);
-    }
+  // the track directions are drawn upfront, so that the results do not depend on the number of threads
+  std::vector<double> phis(nTracks);
+  CounterRandom random(CounterRandom::MaterialBudget);
+  for (int i_eta = 0; i_eta < nTracks; i_eta++) phis[i_eta] = random.track(i_eta).uniform() * M_PI * 2.0;
+  const XYZVector origin = getLuminousRegionInMatBudgetAnalysis();
 
+  int numThreads = MIN(numThreads_, nTracks);
+  if (numThreads > 1 && checkSpatialIndex_) {
+    logINFO("Spatial index cross-check requested: running the material budget analysis in a single thread.");
+    numThreads = 1;
+  }
+  if (numThreads > 1) analyzeMaterialBudgetThreaded(mb, pm, nTracks, etaStep, phis, origin, numThreads);
+  else {
+    for (int i_eta = 0; i_eta < nTracks; i_eta++) analyzeMaterialBudgetTrack(mb, pm, nTracks, i_eta * etaStep, phis[i_eta], origin);
+  }
 
-    if (rComponents["Services"]==NULL) { 
-      rComponents["Services"] = new TH1D();
-      rComponents["Services"]->SetBins(nTracks, 0.0, getEtaMaxMaterial()); 
-    }
-    if (iComponents["Services"]==NULL) { 
-      iComponents["Services"] = new TH1D();
-      iComponents["Services"]->SetBins(nTracks, 0.0, getEtaMaxMaterial()); 
-    }
-    if (rComponents["Supports"]==NULL) { 
-      rComponents["Supports"] = new TH1D();
-      rComponents["Supports"]->SetBins(nTracks, 0.0, getEtaMaxMaterial()); 
-    }
-    if (iComponents["Supports"]==NULL) { 
-      iComponents["Supports"] = new TH1D();
-      iComponents["Supports"]->SetBins(nTracks, 0.0, getEtaMaxMaterial()); 
+#ifdef MATERIAL_SHADOW       
+  // integration over eta
+  for (unsigned int i = 0; i < cells.size(); i++) {
+    for (unsigned int j = 1; j < cells.at(i).size(); j++) {
+      cells.at(i).at(j).rlength = cells.at(i).at(j).rlength + cells.at(i).at(j - 1).rlength;
+      cells.at(i).at(j).ilength = cells.at(i).at(j).ilength + cells.at(i).at(j - 1).ilength;
     }
+  }
+  // transformation from (eta, r) to (z, r) coordinates
+  transformEtaToZ();
+#endif // MATERIAL_SHADOW
 
-    std::map<std::string, Material> sumServicesComponentsRI;
+}
 
-    //      services, barrel
-    tmp = analyzeInactiveSurfaces(mb.getInactiveSurfaces().getBarrelServices(), track, sumServicesComponentsRI, MaterialProperties::no_cat);
-    rserfbarrel.Fill(eta, tmp.radiation);
-    iserfbarrel.Fill(eta, tmp.interaction);
-    rbarrelall.Fill(eta, tmp.radiation);
-    ibarrelall.Fill(eta, tmp.interaction);
-    rserfall.Fill(eta, tmp.radiation);
-    iserfall.Fill(eta, tmp.interaction);
-    rglobal.Fill(eta, tmp.radiation);
-    iglobal.Fill(eta, tmp.interaction);
-    rComponents["Services"]->Fill(eta, tmp.radiation);
-    iComponents["Services"]->Fill(eta, tmp.interaction);
-    //      services, endcap
-    tmp = analyzeInactiveSurfaces(mb.getInactiveSurfaces().getEndcapServices(), track, sumServicesComponentsRI, MaterialProperties::no_cat);
-    rserfendcap.Fill(eta, tmp.radiation);
-    iserfendcap.Fill(eta, tmp.interaction);
-    rendcapall.Fill(eta, tmp.radiation);
-    iendcapall.Fill(eta, tmp.interaction);
-    rserfall.Fill(eta, tmp.radiation);
-    iserfall.Fill(eta, tmp.interaction);
-    rglobal.Fill(eta, tmp.radiation);
-    iglobal.Fill(eta, tmp.interaction);
-    rComponents["Services"]->Fill(eta, tmp.radiation);
-    iComponents["Services"]->Fill(eta, tmp.interaction);
-
-
-    /*for (std::map<std::string, Material>::iterator it = sumServicesComponentsRI.begin(); it != sumServicesComponentsRI.end(); ++it) {
-      if (rComponents[it->first]==NULL) { 
+/**
+ * Shoots a single track through the material budget and sorts the crossed material into the histograms.
+ * @param mb A reference to the instance of <i>MaterialBudget</i> that is to be analysed
+ * @param pm A pointer to a second material budget associated to a pixel detector; may be <i>NULL</i>
+ * @param nTracks The number of tracks of the eta scan, which is also the number of bins of the histograms
+ * @param eta The pseudorapidity of the track
+ * @param phi The track angle in the xy-plane
+ * @param origin The origin of the track
+ */
+void Analyzer::analyzeMaterialBudgetTrack(MaterialBudget& mb, MaterialBudget* pm, int nTracks, double eta, double phi, const XYZVector& origin) {
+  Material tmp;
+  Track track;
+  double theta = 2 * atan(exp(-eta)); // TODO: switch to exp() here
+  track.setThetaPhiPt(theta,phi,1*Units::TeV);
+  track.setOrigin(origin);
+  //      active volumes, barrel
+  ComponentsRISum sumComponentsRI;
+  tmp = analyzeModules(mb.getBarrelModuleCaps(), track, sumComponentsRI);
+  ractivebarrel.Fill(eta, tmp.radiation);
+  iactivebarrel.Fill(eta, tmp.interaction);
+  rbarrelall.Fill(eta, tmp.radiation);
+  ibarrelall.Fill(eta, tmp.interaction);
+  ractiveall.Fill(eta, tmp.radiation);
+  iactiveall.Fill(eta, tmp.interaction);
+  rglobal.Fill(eta, tmp.radiation);
+  iglobal.Fill(eta, tmp.interaction);
+
+  //      active volumes, endcap
+  tmp = analyzeModules(mb.getEndcapModuleCaps(), track, sumComponentsRI);
+  ractiveendcap.Fill(eta, tmp.radiation);
+  iactiveendcap.Fill(eta, tmp.interaction);
+  rendcapall.Fill(eta, tmp.radiation);
+  iendcapall.Fill(eta, tmp.interaction);
+  ractiveall.Fill(eta, tmp.radiation);
+  iactiveall.Fill(eta, tmp.interaction);
+  rglobal.Fill(eta, tmp.radiation);
+  iglobal.Fill(eta, tmp.interaction);
+
+  std::map<std::string, Material> sumComponentsRIByName = sumComponentsRI.byName();
+  for (std::map<std::string, Material>::iterator it = sumComponentsRIByName.begin(); it != sumComponentsRIByName.end(); ++it) {
+    if (rComponents[it->first]==NULL) { 
       rComponents[it->first] = new TH1D();
       rComponents[it->first]->SetBins(nTracks, 0.0, getEtaMaxMaterial()); 
-      }
-      rComponents[it->first]->Fill(eta, it->second.radiation);
-      if (iComponents[it->first]==NULL) {
+    }
+    rComponents[it->first]->Fill(eta, it->second.radiation);
+    if (iComponents[it->first]==NULL) {
       iComponents[it->first] = new TH1D();
       iComponents[it->first]->SetBins(nTracks, 0.0, getEtaMaxMaterial()); 
-      }
-      iComponents[it->first]->Fill(eta, it->second.interaction);
-      }*/
-
-
-
-    //      supports, barrel
-    tmp = analyzeInactiveSurfaces(mb.getInactiveSurfaces().getSupports(), track, sumServicesComponentsRI, MaterialProperties::b_sup);
-    rlazybarrel.Fill(eta, tmp.radiation);
-    ilazybarrel.Fill(eta, tmp.interaction);
-    rbarrelall.Fill(eta, tmp.radiation);
-    ibarrelall.Fill(eta, tmp.interaction);
-    rlazyall.Fill(eta, tmp.radiation);
-    ilazyall.Fill(eta, tmp.interaction);
-    rglobal.Fill(eta, tmp.radiation);
-    iglobal.Fill(eta, tmp.interaction);
-    rComponents["Supports"]->Fill(eta, tmp.radiation);
-    iComponents["Supports"]->Fill(eta, tmp.interaction);
-    //      supports, endcap
-    tmp = analyzeInactiveSurfaces(mb.getInactiveSurfaces().getSupports(), track, sumServicesComponentsRI, MaterialProperties::e_sup);
-    rlazyendcap.Fill(eta, tmp.radiation);
-    ilazyendcap.Fill(eta, tmp.interaction);
-    rendcapall.Fill(eta, tmp.radiation);
-    iendcapall.Fill(eta, tmp.interaction);
-    rlazyall.Fill(eta, tmp.radiation);
-    ilazyall.Fill(eta, tmp.interaction);
-    rglobal.Fill(eta, tmp.radiation);
-    iglobal.Fill(eta, tmp.interaction);
-    rComponents["Supports"]->Fill(eta, tmp.radiation);
-    iComponents["Supports"]->Fill(eta, tmp.interaction);
-    //      supports, tubes
-    tmp = analyzeInactiveSurfaces(mb.getInactiveSurfaces().getSupports(), track, sumServicesComponentsRI, MaterialProperties::o_sup);
-    rlazytube.Fill(eta, tmp.radiation);
-    ilazytube.Fill(eta, tmp.interaction);
-    rlazyall.Fill(eta, tmp.radiation);
-    ilazyall.Fill(eta, tmp.interaction);
-    rglobal.Fill(eta, tmp.radiation);
-    iglobal.Fill(eta, tmp.interaction);
-    rComponents["Supports"]->Fill(eta, tmp.radiation);
-    iComponents["Supports"]->Fill(eta, tmp.interaction);
-    //      supports, barrel tubes
-    tmp = analyzeInactiveSurfaces(mb.getInactiveSurfaces().getSupports(), track, sumServicesComponentsRI, MaterialProperties::t_sup);
-    rlazybtube.Fill(eta, tmp.radiation);
-    ilazybtube.Fill(eta, tmp.interaction);
-    rlazyall.Fill(eta, tmp.radiation);
-    ilazyall.Fill(eta, tmp.interaction);
-    rglobal.Fill(eta, tmp.radiation);
-    iglobal.Fill(eta, tmp.interaction);
-    rComponents["Supports"]->Fill(eta, tmp.radiation);
-    iComponents["Supports"]->Fill(eta, tmp.interaction);
-    //      supports, user defined
-    tmp = analyzeInactiveSurfaces(mb.getInactiveSurfaces().getSupports(), track, sumServicesComponentsRI, MaterialProperties::u_sup);
-    rlazyuserdef.Fill(eta, tmp.radiation);
-    ilazyuserdef.Fill(eta, tmp.interaction);
-    rlazyall.Fill(eta, tmp.radiation);
-    ilazyall.Fill(eta, tmp.interaction);
-    rglobal.Fill(eta, tmp.radiation);
-    iglobal.Fill(eta, tmp.interaction);
-    rComponents["Supports"]->Fill(eta, tmp.radiation);
-    iComponents["Supports"]->Fill(eta, tmp.interaction);
-    //      pixels, if they exist
-    std::map<std::string, Material> ignoredPixelSumComponentsRI;
-    std::map<std::string, Material> ignoredPixelSumServicesComponentsRI;
-    if (pm != nullptr) {
-      analyzeModules(pm->getBarrelModuleCaps(), track, ignoredPixelSumComponentsRI, true);
-      analyzeModules(pm->getEndcapModuleCaps(), track, ignoredPixelSumComponentsRI, true);
-      analyzeInactiveSurfaces(pm->getInactiveSurfaces().getBarrelServices(), track, ignoredPixelSumServicesComponentsRI, MaterialProperties::no_cat, true);
-      analyzeInactiveSurfaces(pm->getInactiveSurfaces().getEndcapServices(), track, ignoredPixelSumServicesComponentsRI, MaterialProperties::no_cat, true);
-      analyzeInactiveSurfaces(pm->getInactiveSurfaces().getSupports(),       track, ignoredPixelSumServicesComponentsRI, MaterialProperties::b_sup, true);
     }
+    iComponents[it->first]->Fill(eta, it->second.interaction);
+  }
+
 
-    // TODO: add the beam pipe as a user material eveywhere!
-    // in a coherent way
-    // Add the hit on the beam pipe
-    double rPos  = 23.*Units::mm;
-    double zPos  = rPos/tan(theta);
+  if (rComponents["Services"]==NULL) { 
+    rComponents["Services"] = new TH1D();
+    rComponents["Services"]->SetBins(nTracks, 0.0, getEtaMaxMaterial()); 
+  }
+  if (iComponents["Services"]==NULL) { 
+    iComponents["Services"] = new TH1D();
+    iComponents["Services"]->SetBins(nTracks, 0.0, getEtaMaxMaterial()); 
+  }
+  if (rComponents["Supports"]==NULL) { 
+    rComponents["Supports"] = new TH1D();
+    rComponents["Supports"]->SetBins(nTracks, 0.0, getEtaMaxMaterial()); 
+  }
+  if (iComponents["Supports"]==NULL) { 
+    iComponents["Supports"] = new TH1D();
+    iComponents["Supports"]->SetBins(nTracks, 0.0, getEtaMaxMaterial()); 
+  }
+
+  std::map<std::string, Material> sumServicesComponentsRI;
+
+  //      services, barrel
+  tmp = analyzeInactiveSurfaces(mb.getInactiveSurfaces().getBarrelServices(), track, sumServicesComponentsRI, MaterialProperties::no_cat);
+  rserfbarrel.Fill(eta, tmp.radiation);
+  iserfbarrel.Fill(eta, tmp.interaction);
+  rbarrelall.Fill(eta, tmp.radiation);
+  ibarrelall.Fill(eta, tmp.interaction);
+  rserfall.Fill(eta, tmp.radiation);
+  iserfall.Fill(eta, tmp.interaction);
+  rglobal.Fill(eta, tmp.radiation);
+  iglobal.Fill(eta, tmp.interaction);
+  rComponents["Services"]->Fill(eta, tmp.radiation);
+  iComponents["Services"]->Fill(eta, tmp.interaction);
+  //      services, endcap
+  tmp = analyzeInactiveSurfaces(mb.getInactiveSurfaces().getEndcapServices(), track, sumServicesComponentsRI, MaterialProperties::no_cat);
+  rserfendcap.Fill(eta, tmp.radiation);
+  iserfendcap.Fill(eta, tmp.interaction);
+  rendcapall.Fill(eta, tmp.radiation);
+  iendcapall.Fill(eta, tmp.interaction);
+  rserfall.Fill(eta, tmp.radiation);
+  iserfall.Fill(eta, tmp.interaction);
+  rglobal.Fill(eta, tmp.radiation);
+  iglobal.Fill(eta, tmp.interaction);
+  rComponents["Services"]->Fill(eta, tmp.radiation);
+  iComponents["Services"]->Fill(eta, tmp.interaction);
+
+
+  /*for (std::map<std::string, Material>::iterator it = sumServicesComponentsRI.begin(); it != sumServicesComponentsRI.end(); ++it) {
+    if (rComponents[it->first]==NULL) { 
+    rComponents[it->first] = new TH1D();
+    rComponents[it->first]->SetBins(nTracks, 0.0, getEtaMaxMaterial()); 
+    }
+    rComponents[it->first]->Fill(eta, it->second.radiation);
+    if (iComponents[it->first]==NULL) {
+    iComponents[it->first] = new TH1D();
+    iComponents[it->first]->SetBins(nTracks, 0.0, getEtaMaxMaterial()); 
+    }
+    iComponents[it->first]->Fill(eta, it->second.interaction);
+    }*/
 
-    HitPtr hit(new Hit(rPos, zPos, nullptr, HitPassiveType::BeamPipe));
 
-    Material material;
-    material.radiation   = 0.0022761 / sin(theta);  // was 0.0023, adapted to fit CMSSW 81X 2016/11/30
-    material.interaction = 0.0020334 / sin(theta);  // was 0.0019, adapted to fit CMSSW 81X 2016/11/30
-    hit->setCorrectedMaterial(material);
-    track.addHit(std::move(hit));
 
-    if (!track.hasNoHits()) {
-      track.addEfficiency();
+  //      supports, barrel
+  tmp = analyzeInactiveSurfaces(mb.getInactiveSurfaces().getSupports(), track, sumServicesComponentsRI, MaterialProperties::b_sup);
+  rlazybarrel.Fill(eta, tmp.radiation);
+  ilazybarrel.Fill(eta, tmp.interaction);
+  rbarrelall.Fill(eta, tmp.radiation);
+  ibarrelall.Fill(eta, tmp.interaction);
+  rlazyall.Fill(eta, tmp.radiation);
+  ilazyall.Fill(eta, tmp.interaction);
+  rglobal.Fill(eta, tmp.radiation);
+  iglobal.Fill(eta, tmp.interaction);
+  rComponents["Supports"]->Fill(eta, tmp.radiation);
+  iComponents["Supports"]->Fill(eta, tmp.interaction);
+  //      supports, endcap
+  tmp = analyzeInactiveSurfaces(mb.getInactiveSurfaces().getSupports(), track, sumServicesComponentsRI, MaterialProperties::e_sup);
+  rlazyendcap.Fill(eta, tmp.radiation);
+  ilazyendcap.Fill(eta, tmp.interaction);
+  rendcapall.Fill(eta, tmp.radiation);
+  iendcapall.Fill(eta, tmp.interaction);
+  rlazyall.Fill(eta, tmp.radiation);
+  ilazyall.Fill(eta, tmp.interaction);
+  rglobal.Fill(eta, tmp.radiation);
+  iglobal.Fill(eta, tmp.interaction);
+  rComponents["Supports"]->Fill(eta, tmp.radiation);
+  iComponents["Supports"]->Fill(eta, tmp.interaction);
+  //      supports, tubes
+  tmp = analyzeInactiveSurfaces(mb.getInactiveSurfaces().getSupports(), track, sumServicesComponentsRI, MaterialProperties::o_sup);
+  rlazytube.Fill(eta, tmp.radiation);
+  ilazytube.Fill(eta, tmp.interaction);
+  rlazyall.Fill(eta, tmp.radiation);
+  ilazyall.Fill(eta, tmp.interaction);
+  rglobal.Fill(eta, tmp.radiation);
+  iglobal.Fill(eta, tmp.interaction);
+  rComponents["Supports"]->Fill(eta, tmp.radiation);
+  iComponents["Supports"]->Fill(eta, tmp.interaction);
+  //      supports, barrel tubes
+  tmp = analyzeInactiveSurfaces(mb.getInactiveSurfaces().getSupports(), track, sumServicesComponentsRI, MaterialProperties::t_sup);
+  rlazybtube.Fill(eta, tmp.radiation);
+  ilazybtube.Fill(eta, tmp.interaction);
+  rlazyall.Fill(eta, tmp.radiation);
+  ilazyall.Fill(eta, tmp.interaction);
+  rglobal.Fill(eta, tmp.radiation);
+  iglobal.Fill(eta, tmp.interaction);
+  rComponents["Supports"]->Fill(eta, tmp.radiation);
+  iComponents["Supports"]->Fill(eta, tmp.interaction);
+  //      supports, user defined
+  tmp = analyzeInactiveSurfaces(mb.getInactiveSurfaces().getSupports(), track, sumServicesComponentsRI, MaterialProperties::u_sup);
+  rlazyuserdef.Fill(eta, tmp.radiation);
+  ilazyuserdef.Fill(eta, tmp.interaction);
+  rlazyall.Fill(eta, tmp.radiation);
+  ilazyall.Fill(eta, tmp.interaction);
+  rglobal.Fill(eta, tmp.radiation);
+  iglobal.Fill(eta, tmp.interaction);
+  rComponents["Supports"]->Fill(eta, tmp.radiation);
+  iComponents["Supports"]->Fill(eta, tmp.interaction);
+  //      pixels, if they exist
+  ComponentsRISum ignoredPixelSumComponentsRI;
+  std::map<std::string, Material> ignoredPixelSumServicesComponentsRI;
+  if (pm != nullptr) {
+    analyzeModules(pm->getBarrelModuleCaps(), track, ignoredPixelSumComponentsRI, true);
+    analyzeModules(pm->getEndcapModuleCaps(), track, ignoredPixelSumComponentsRI, true);
+    analyzeInactiveSurfaces(pm->getInactiveSurfaces().getBarrelServices(), track, ignoredPixelSumServicesComponentsRI, MaterialProperties::no_cat, true);
+    analyzeInactiveSurfaces(pm->getInactiveSurfaces().getEndcapServices(), track, ignoredPixelSumServicesComponentsRI, MaterialProperties::no_cat, true);
+    analyzeInactiveSurfaces(pm->getInactiveSurfaces().getSupports(),       track, ignoredPixelSumServicesComponentsRI, MaterialProperties::b_sup, true);
+  }
 
-      // @@ Hadrons
-      std::string trackingTag = (pm != nullptr ? "trigger" : "pixel");
-      int nActiveHits = track.getNActiveHits(trackingTag);
-      if (nActiveHits>0) {
-        hadronTotalHitsGraph.SetPoint(hadronTotalHitsGraph.GetN(),
+  // TODO: add the beam pipe as a user material eveywhere!
+  // in a coherent way
+  // Add the hit on the beam pipe
+  double rPos  = 23.*Units::mm;
+  double zPos  = rPos/tan(theta);
+
+  HitPtr hit(new Hit(rPos, zPos, nullptr, HitPassiveType::BeamPipe));
+
+  Material material;
+  material.radiation   = 0.0022761 / sin(theta);  // was 0.0023, adapted to fit CMSSW 81X 2016/11/30
+  material.interaction = 0.0020334 / sin(theta);  // was 0.0019, adapted to fit CMSSW 81X 2016/11/30
+  hit->setCorrectedMaterial(material);
+  track.addHit(std::move(hit));
+
+  if (!track.hasNoHits()) {
+    track.addEfficiency();
+
+    // @@ Hadrons
+    std::string trackingTag = (pm != nullptr ? "trigger" : "pixel");
+    int nActiveHits = track.getNActiveHits(trackingTag);
+    if (nActiveHits>0) {
+      hadronTotalHitsGraph.SetPoint(hadronTotalHitsGraph.GetN(),
+                                    eta,
+                                    nActiveHits);
+      double probability;
+      std::vector<double> probabilities = track.getHadronActiveHitsProbability(trackingTag);
+
+      double averageHits=0;
+      //double averageSquaredHits=0;
+      double exactProb=0;
+      double moreThanProb = 0;
+      for (int i=probabilities.size()-1;
+           i>=0;
+           --i) {
+        //if (nActive==10) { // debug
+        //  std::cerr << "probabilities.at(" 
+        //  << i << ")=" << probabilities.at(i)
+        //  << endl;
+        //}
+        exactProb=probabilities.at(i)-moreThanProb;
+        averageHits+=(i+1)*exactProb;
+        //averageSquaredHits+=((i+1)*(i+1))*exactProb;
+        moreThanProb+=exactProb;
+      }
+      hadronAverageHitsGraph.SetPoint(hadronAverageHitsGraph.GetN(),
                                       eta,
-                                      nActiveHits);
-        double probability;
-        std::vector<double> probabilities = track.getHadronActiveHitsProbability(trackingTag);
-
-        double averageHits=0;
-        //double averageSquaredHits=0;
-        double exactProb=0;
-        double moreThanProb = 0;
-        for (int i=probabilities.size()-1;
-             i>=0;
-             --i) {
-          //if (nActive==10) { // debug
-          //  std::cerr << "probabilities.at(" 
-          //  << i << ")=" << probabilities.at(i)
-          //  << endl;
-          //}
-          exactProb=probabilities.at(i)-moreThanProb;
-          averageHits+=(i+1)*exactProb;
-          //averageSquaredHits+=((i+1)*(i+1))*exactProb;
-          moreThanProb+=exactProb;
-        }
-        hadronAverageHitsGraph.SetPoint(hadronAverageHitsGraph.GetN(),
-                                        eta,
-                                        averageHits);
-        //hadronAverageHitsGraph.SetPointError(hadronAverageHitsGraph.GetN()-1,
-        //                       0,
-        //                       sqrt( averageSquaredHits - averageHits*averageHits) );
-
-        unsigned int requiredHits;
-        for (unsigned int i = 0;
-             i<hadronNeededHitsFraction.size();
-             ++i) {
-          requiredHits = int(ceil(double(nActiveHits) * hadronNeededHitsFraction.at(i)));
-          if (requiredHits==0)
-            probability=1;
-          else if (requiredHits>probabilities.size())
-            probability = 0;
-          else
-            probability = probabilities.at(requiredHits-1);
-          //if (probabilities.size()==10) { // debug
-          //  std::cerr << "required " << requiredHits
-          //              << " out of " << probabilities.size()
-          //              << " == " << nActive
-          //              << endl;
-          // std::cerr << "      PROBABILITY = " << probability << endl << endl;
-          //}
-          hadronGoodTracksFraction.at(i).SetPoint(hadronGoodTracksFraction.at(i).GetN(),
-                                                  eta,
-                                                  probability);
-        }
+                                      averageHits);
+      //hadronAverageHitsGraph.SetPointError(hadronAverageHitsGraph.GetN()-1,
+      //                       0,
+      //                       sqrt( averageSquaredHits - averageHits*averageHits) );
+
+      unsigned int requiredHits;
+      for (unsigned int i = 0;
+           i<hadronNeededHitsFraction.size();
+           ++i) {
+        requiredHits = int(ceil(double(nActiveHits) * hadronNeededHitsFraction.at(i)));
+        if (requiredHits==0)
+          probability=1;
+        else if (requiredHits>probabilities.size())
+          probability = 0;
+        else
+          probability = probabilities.at(requiredHits-1);
+        //if (probabilities.size()==10) { // debug
+        //  std::cerr << "required " << requiredHits
+        //              << " out of " << probabilities.size()
+        //              << " == " << nActive
+        //              << endl;
+        // std::cerr << "      PROBABILITY = " << probability << endl << endl;
+        //}
+        hadronGoodTracksFraction.at(i).SetPoint(hadronGoodTracksFraction.at(i).GetN(),
+                                                eta,
+                                                probability);
       }
     }
+  }
 
 
-    double etaMax = getEtaMaxMaterial();
+  double etaMax = getEtaMaxMaterial();
 
-    if (eta >= 0.) {
+  if (eta >= 0.) {
 
-      // EXTRA PLOTS: SERVICES DETAILS (FULL VOLUMES)
-      for (std::vector<std::unique_ptr<Hit>>::const_iterator itHit=track.getBeginHits(); itHit!=track.getEndHits(); itHit++) {
-        auto& hit = *itHit;
+    // EXTRA PLOTS: SERVICES DETAILS (FULL VOLUMES)
+    for (std::vector<std::unique_ptr<Hit>>::const_iterator itHit=track.getBeginHits(); itHit!=track.getEndHits(); itHit++) {
+      auto& hit = *itHit;
 	if (!hit->isPixel() && hit->isService()) {
 	  fillRIServicesDetailsHistos(rComponentsServicesDetails, iComponentsServicesDetails,
 				      hit, eta, theta, nTracks, etaMax);
 	}
-      }
+    }
 
 
-      // TRACKING VOLUME MATERIAL BUDGET PLOTS    
-      if (mb.getTracker().myid() == outer_tracker_id) {
+    // TRACKING VOLUME MATERIAL BUDGET PLOTS    
+    if (mb.getTracker().myid() == outer_tracker_id) {
 
 	// 1) ASSIGN TRACKING VOLUME IDENTIFIERS TO ALL HITS OF THE TRACK:
 	// Is the hit within Inner Tracker Tracking Volume ? Outer Tracking Volume ? In between ? Outside ?
 	track.assignTrackingVolumesToHits();
 
 	// 2) FILL THE TRACKING VOLUME MATERIAL BUDGET HISTOGRAMS
-	computeTrackingVolumeMaterialBudget(track, nTracks, ignoredPixelSumComponentsRI, sumComponentsRI);
-      }
+	computeTrackingVolumeMaterialBudget(track, nTracks, ignoredPixelSumComponentsRI.byName(), sumComponentsRIByName);
     }
+  }
+}
 
+/**
+ * Evaluates once the lazily computed geometry of a module used by the hit finding (sensor polygons,
+ * their centers and normals), so that concurrent hit searches only ever read it.
+ * @param m The module to prepare
+ */
+static void precomputeHitGeometry(const Module& m) {
+  m.maxZ();
+  for (const auto& s : m.sensors()) {
+    s.hitPoly().getCenter();
+    s.hitPoly().getNormal();
+  }
+}
 
-  } // loop on eta
+/**
+ * Splits the eta scan of the material budget analysis into contiguous slices, each of them analysed by a
+ * worker thread filling its own private histograms. The workers are then merged in the order of their
+ * slices, so that the results are reproducible for a given number of threads.
+ * @param mb A reference to the instance of <i>MaterialBudget</i> that is to be analysed
+ * @param pm A pointer to a second material budget associated to a pixel detector; may be <i>NULL</i>
+ * @param nTracks The number of tracks of the eta scan
+ * @param etaStep The eta distance between two consecutive tracks
+ * @param phis The phi of each track of the scan
+ * @param origin The origin of the tracks
+ * @param numThreads The number of worker threads
+ */
+void Analyzer::analyzeMaterialBudgetThreaded(MaterialBudget& mb, MaterialBudget* pm, int nTracks, double etaStep,
+                                             const std::vector<double>& phis, const XYZVector& origin, int numThreads) {
+  // everything shared by the workers is prepared upfront, and only read afterwards
+  std::vector<std::vector<std::vector<ModuleCap> >*> moduleCaps{ &mb.getBarrelModuleCaps(), &mb.getEndcapModuleCaps() };
+  if (pm != nullptr) {
+    moduleCaps.push_back(&pm->getBarrelModuleCaps());
+    moduleCaps.push_back(&pm->getEndcapModuleCaps());
+  }
+  std::map<const void*, ModuleSpatialIndex> sharedIndexes;
+  for (auto caps : moduleCaps) {
+    for (auto& layer : *caps) {
+      sharedIndexes.insert(std::make_pair(&layer, spatialIndex(layer)));
+      for (const auto& cap : layer) precomputeHitGeometry(cap.getModule());
+    }
+  }
+  ROOT::EnableThreadSafety();
+
+  std::vector<std::unique_ptr<Analyzer> > workers;
+  for (int iThread = 0; iThread < numThreads; iThread++) {
+    workers.emplace_back(new Analyzer());
+    Analyzer& worker = *workers.back();
+    worker.spatialIndexes_ = sharedIndexes;
+    worker.clearMaterialBudgetHistograms();
+    for (TH1D* histo : worker.materialBudgetHistograms()) histo->SetBins(nTracks, 0.0, getEtaMaxMaterial());
+    worker.setCellBoundaries(nTracks, 0.0, geom_max_radius + geom_inactive_volume_width, 0.0, getEtaMaxMaterial());
+    worker.bufferMaterialMapFills_ = true;
+  }
 
+  std::vector<std::thread> threads;
+  std::vector<std::exception_ptr> errors(numThreads);
+  for (int iThread = 0; iThread < numThreads; iThread++) {
+    int firstTrack = (long)nTracks * iThread / numThreads;
+    int lastTrack = (long)nTracks * (iThread + 1) / numThreads;
+    Analyzer* worker = workers.at(iThread).get();
+    std::exception_ptr& error = errors.at(iThread);
+    threads.emplace_back([&mb, pm, &phis, &origin, &error, worker, nTracks, etaStep, firstTrack, lastTrack]() {
+      profileScope("Material budget worker");
+      try {
+        for (int i_eta = firstTrack; i_eta < lastTrack; i_eta++) {
+          worker->analyzeMaterialBudgetTrack(mb, pm, nTracks, i_eta * etaStep, phis.at(i_eta), origin);
+        }
+      } catch (...) {
+        error = std::current_exception();
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  for (auto& error : errors) if (error) std::rethrow_exception(error);
 
+  for (auto& worker : workers) mergeMaterialBudget(*worker, nTracks);
+}
 
+/**
+ * Adds the material budget histograms filled by a worker of the threaded analysis to the ones of this analyzer.
+ * The component histograms of the worker are released once merged.
+ * @param worker The worker analyzer
+ * @param nTracks The number of tracks of the eta scan, which is also the number of bins of the histograms
+ */
+void Analyzer::mergeMaterialBudget(Analyzer& worker, int nTracks) {
+  std::vector<TH1D*> histos = materialBudgetHistograms();
+  std::vector<TH1D*> workerHistos = worker.materialBudgetHistograms();
+  for (unsigned int i = 0; i < histos.size(); i++) histos.at(i)->Add(workerHistos.at(i));
+
+  std::vector<std::map<std::string, TH1D*>*> components = materialBudgetComponentsHistograms();
+  std::vector<std::map<std::string, TH1D*>*> workerComponents = worker.materialBudgetComponentsHistograms();
+  for (unsigned int i = 0; i < components.size(); i++) {
+    for (auto& it : *workerComponents.at(i)) {
+      if (it.second == nullptr) continue;
+      TH1D*& histo = (*components.at(i))[it.first];
+      if (histo == nullptr) {
+        histo = new TH1D();
+        histo->SetBins(nTracks, 0.0, getEtaMaxMaterial());
+      }
+      histo->Add(it.second);
+      delete it.second;
+    }
+    workerComponents.at(i)->clear();
+  }
 
+  // graphs points are appended, the slices being merged in increasing eta order
+  auto appendPoints = [](TGraph& graph, const TGraph& workerGraph) {
+    for (int i = 0; i < workerGraph.GetN(); i++) graph.SetPoint(graph.GetN(), workerGraph.GetX()[i], workerGraph.GetY()[i]);
+  };
+  appendPoints(hadronTotalHitsGraph, worker.hadronTotalHitsGraph);
+  appendPoints(hadronAverageHitsGraph, worker.hadronAverageHitsGraph);
+  for (unsigned int i = 0; i < hadronGoodTracksFraction.size(); i++) appendPoints(hadronGoodTracksFraction.at(i), worker.hadronGoodTracksFraction.at(i));
 
-#ifdef MATERIAL_SHADOW       
-  // integration over eta
   for (unsigned int i = 0; i < cells.size(); i++) {
-    for (unsigned int j = 1; j < cells.at(i).size(); j++) {
-      cells.at(i).at(j).rlength = cells.at(i).at(j).rlength + cells.at(i).at(j - 1).rlength;
-      cells.at(i).at(j).ilength = cells.at(i).at(j).ilength + cells.at(i).at(j - 1).ilength;
+    for (unsigned int j = 0; j < cells.at(i).size(); j++) {
+      cells.at(i).at(j).rlength += worker.cells.at(i).at(j).rlength;
+      cells.at(i).at(j).ilength += worker.cells.at(i).at(j).ilength;
     }
   }
-  // transformation from (eta, r) to (z, r) coordinates
-  transformEtaToZ();
-#endif // MATERIAL_SHADOW
 
+  for (const auto& fill : worker.materialMapFills_) fillMapRZ(fill.r, fill.z, fill.mat);
+  worker.materialMapFills_.clear();
+}
+
+/**
+ * @return the 1D histograms filled by the material budget analysis, in a fixed order
+ */
+std::vector<TH1D*> Analyzer::materialBudgetHistograms() {
+  return { &ractivebarrel, &ractiveendcap, &rserfbarrel, &rserfendcap, &rlazybarrel, &rlazyendcap, &rlazybtube, &rlazytube, &rlazyuserdef,
+           &iactivebarrel, &iactiveendcap, &iserfbarrel, &iserfendcap, &ilazybarrel, &ilazyendcap, &ilazybtube, &ilazytube, &ilazyuserdef,
+           &rbarrelall, &rendcapall, &ractiveall, &rserfall, &rlazyall,
+           &ibarrelall, &iendcapall, &iactiveall, &iserfall, &ilazyall,
+           &rglobal, &iglobal };
+}
+
+/**
+ * @return the maps of per-component histograms filled by the material budget analysis, in a fixed order
+ */
+std::vector<std::map<std::string, TH1D*>*> Analyzer::materialBudgetComponentsHistograms() {
+  return { &rComponents, &iComponents,
+           &rComponentsServicesDetails, &iComponentsServicesDetails,
+           &rComponentsBeamPipe, &iComponentsBeamPipe,
+           &rComponentsPixelInterstice, &iComponentsPixelInterstice,
+           &rComponentsPixelTrackingVolume, &iComponentsPixelTrackingVolume,
+           &rComponentsInterstice, &iComponentsInterstice,
+           &rComponentsOuterTrackingVolume, &iComponentsOuterTrackingVolume,
+           &rComponentsServicesDetailsPixelTrackingVolume, &iComponentsServicesDetailsPixelTrackingVolume,
+           &rComponentsServicesDetailsOuterTrackingVolume, &iComponentsServicesDetailsOuterTrackingVolume };
 }
 
 
 
 void Analyzer::computeTriggerFrequency(Tracker& tracker) {
+  profileScope("Trigger frequency");
   TriggerFrequencyVisitor v; 
   SimParms::getInstance().accept(v);
   tracker.accept(v);
@@ -1249,6 +1507,7 @@ void Analyzer::computeTriggerFrequency(Tracker& tracker) {
   
     
 void Analyzer::computeTriggerProcessorsBandwidth(Tracker& tracker) {
+  profileScope("Trigger processors bandwidth");
   TriggerProcessorBandwidthVisitor v(triggerDataBandwidths_, triggerFrequenciesPerEvent_);
   v.preVisit();
   SimParms::getInstance().accept(v);
@@ -1445,6 +1704,7 @@ void Analyzer::computeDetailedWeights(std::vector<std::vector<ModuleCap> >& trac
  * Produces a full material summary for the modules
  */
 void Analyzer::computeWeightSummary(MaterialBudget& mb) {
+  profileScope("Weight summary");
 
   typeWeight.clear();
   tagWeight.clear();
@@ -1477,7 +1737,7 @@ void Analyzer::computeWeightSummary(MaterialBudget& mb) {
  */
 Material Analyzer::analyzeModules(std::vector<std::vector<ModuleCap> >& tr,
                                   Track& track,
-                                  std::map<std::string, Material>& sumComponentsRI,
+                                  ComponentsRISum& sumComponentsRI,
                                   bool isPixel) {
   std::vector<std::vector<ModuleCap> >::iterator iter = tr.begin();
   std::vector<std::vector<ModuleCap> >::iterator guard = tr.end();
@@ -1512,10 +1772,8 @@ void printPosRefString(std::ostream& os, const Module& m, const string& delim =
  */
 Material Analyzer::findModuleLayerRI(std::vector<ModuleCap>& layer,
                                      Track& track,
-                                     std::map<std::string, Material>& sumComponentsRI,
+                                     ComponentsRISum& sumComponentsRI,
                                      bool isPixel) {
-  std::vector<ModuleCap>::iterator iter = layer.begin();
-  std::vector<ModuleCap>::iterator guard = layer.end();
   Material res, tmp;
   XYZVector origin, direction;
   origin    = track.getOrigin();
@@ -1524,29 +1782,33 @@ Material Analyzer::findModuleLayerRI(std::vector<ModuleCap>& layer,
   int hits = 0;
   res.radiation = 0.0;
   res.interaction = 0.0;
-  // set the track direction vector
-  while (iter != guard) {
+  // only the modules shortlisted by the spatial index can be hit (same hits and order as scanning the whole layer)
+  const ModuleSpatialIndex& index = spatialIndex(layer);
+  const FrozenModules& frozen = index.frozen();
+  if (checkSpatialIndex_) checkSpatialIndexHits(index, origin, direction);
+  ModuleSpatialIndex::Candidates crossed;
+  for (int candidate : index.candidates(origin, direction, crossed)) {
+    std::vector<ModuleCap>::iterator iter = layer.begin() + candidate;
     // collision detection: rays are in z+ only, so consider only modules that lie on that side
     // only consider modules that have type BarrelModule or EndcapModule
-    if (iter->getModule().maxZ() > 0) {
+    if (frozen.maxZ(candidate) > 0) {
         // same method as in Tracker, same function used
         // TODO: in case origin==0,0,0 and phi==0 just check if sectionYZ and minEta, maxEta
         //distance = iter->getModule().trackCross(origin, direction);
-        auto h = iter->getModule().checkTrackHits(origin, direction);
+        auto h = frozen.checkTrackHits(candidate, origin, direction);
         if (h.second != HitType::NONE) {
           distance = h.first.R();
           // module was hit
           hits++;
           r = distance * sin(track.getTheta());
-          tmp.radiation = iter->getRadiationLength();
-          tmp.interaction = iter->getInteractionLength();
+          tmp.radiation = frozen.radiationLength(candidate);
+          tmp.interaction = frozen.interactionLength(candidate);
 
-          Module& m = iter->getModule();
-          double tiltAngle = m.tiltAngle();
+          double tiltAngle = frozen.tiltAngle(candidate);
           // 2D material maps
           fillMapRT(r, track.getTheta(), tmp);
           // radiation and interaction length scaling for barrels
-          if (iter->getModule().subdet() == BARREL) {
+          if (frozen.subdet(candidate) == BARREL) {
             tmp.radiation = tmp.radiation / sin(track.getTheta() + tiltAngle);
             tmp.interaction = tmp.interaction / sin(track.getTheta() + tiltAngle);
           }
@@ -1556,16 +1818,7 @@ Material Analyzer::findModuleLayerRI(std::vector<ModuleCap>& layer,
             tmp.interaction = tmp.interaction / cos(track.getTheta() + tiltAngle - M_PI/2);
           }
 
-          double tmpr = 0., tmpi = 0.;
-
-          std::map<std::string, Material> moduleComponentsRI = iter->getComponentsRI();
-          for (std::map<std::string, Material>::iterator cit = moduleComponentsRI.begin(); cit != moduleComponentsRI.end(); ++cit) {
-            sumComponentsRI[cit->first].radiation += cit->second.radiation / (iter->getModule().subdet() == BARREL ? sin(track.getTheta() + tiltAngle) : cos(track.getTheta() + tiltAngle - M_PI/2));
-            //if (cit->first == "SupportMechanics") std::cout << eta << " " << distance << " " << cit->second.radiation / sin(theta + tiltAngle) << " " << cit->second.radiation << std::endl;
-            tmpr += sumComponentsRI[cit->first].radiation;
-            sumComponentsRI[cit->first].interaction += cit->second.interaction / (iter->getModule().subdet() == BARREL ? sin(track.getTheta() + tiltAngle) : cos(track.getTheta() + tiltAngle - M_PI/2));
-            tmpi += sumComponentsRI[cit->first].interaction;
-          }
+          sumComponentsRI.add(*iter, (frozen.subdet(candidate) == BARREL ? sin(track.getTheta() + tiltAngle) : cos(track.getTheta() + tiltAngle - M_PI/2)));
           // 2D plot and eta plot results
           if (!isPixel) fillCell(r, track.getEta(), track.getTheta(), tmp);
           res += tmp;
@@ -1581,7 +1834,6 @@ Material Analyzer::findModuleLayerRI(std::vector<ModuleCap>& layer,
           track.addHit(std::move(hit));
         }
     }
-    iter++;
   }
   return res;
 }
@@ -1628,10 +1880,15 @@ int Analyzer::findHitsModules(Tracker& tracker, Track& t) {
 
   int hits = 0;
 
-  for (auto aModule : tracker.modules()) {
+  const ModuleSpatialIndex& index = spatialIndex(tracker.modules());
+  const FrozenModules& frozen = index.frozen();
+  if (checkSpatialIndex_) checkSpatialIndexHits(index, origin, direction);
+  ModuleSpatialIndex::Candidates crossed;
+  for (int candidate : index.candidates(origin, direction, crossed)) {
+      Module* aModule = &frozen.module(candidate);
       // same method as in Tracker, same function used
       //distance = aModule->trackCross(origin, direction);
-      auto ht = aModule->checkTrackHits(origin, direction);
+      auto ht = frozen.checkTrackHits(candidate, origin, direction);
 
       if (ht.second != HitType::NONE) {
         // module was hit
@@ -1664,8 +1921,6 @@ int Analyzer::findHitsModules(Tracker& tracker, Track& t) {
  * @return The scaled and summed up radiation and interaction lengths for the given layer and track, bundled into a <i>std::pair</i>
  */
 Material Analyzer::findHitsModuleLayer(std::vector<ModuleCap>& layer, Track& t, bool isPixel) {
-  std::vector<ModuleCap>::iterator iter = layer.begin();
-  std::vector<ModuleCap>::iterator guard = layer.end();
   Material res, tmp;
   XYZVector origin, direction;
   origin    = t.getOrigin();
@@ -1673,18 +1928,21 @@ Material Analyzer::findHitsModuleLayer(std::vector<ModuleCap>& layer, Track& t,
   int hits = 0;
   res.radiation = 0.0;
   res.interaction = 0.0;
-  // set the track direction vector
-  while (iter != guard) {
-        auto h = iter->getModule().checkTrackHits(origin, direction); 
+  const ModuleSpatialIndex& index = spatialIndex(layer);
+  const FrozenModules& frozen = index.frozen();
+  if (checkSpatialIndex_) checkSpatialIndexHits(index, origin, direction);
+  ModuleSpatialIndex::Candidates crossed;
+  for (int candidate : index.candidates(origin, direction, crossed)) {
+        auto h = frozen.checkTrackHits(candidate, origin, direction);
         if (h.second != HitType::NONE) {
           // module was hit
           hits++;
-          tmp.radiation = iter->getRadiationLength();
-          tmp.interaction = iter->getInteractionLength();
+          tmp.radiation = frozen.radiationLength(candidate);
+          tmp.interaction = frozen.interactionLength(candidate);
           // radiation and interaction length scaling for barrels
-          if (iter->getModule().subdet() == BARREL) {
-            tmp.radiation = tmp.radiation / sin(t.getTheta() + iter->getModule().tiltAngle());
-            tmp.interaction = tmp.interaction / sin(t.getTheta() + iter->getModule().tiltAngle());
+          if (frozen.subdet(candidate) == BARREL) {
+            tmp.radiation = tmp.radiation / sin(t.getTheta() + frozen.tiltAngle(candidate));
+            tmp.interaction = tmp.interaction / sin(t.getTheta() + frozen.tiltAngle(candidate));
           }
           // radiation and interaction length scaling for endcaps
           else {
@@ -1697,12 +1955,11 @@ Material Analyzer::findHitsModuleLayer(std::vector<ModuleCap>& layer, Track& t,
           auto hitZPos = h.first.z();
           auto hitType = h.second;
 
-          HitPtr hit(new Hit(hitRPos, hitZPos, &(iter->getModule()), hitType));
+          HitPtr hit(new Hit(hitRPos, hitZPos, &frozen.module(candidate), hitType));
           hit->setCorrectedMaterial(tmp);
           if (isPixel) hit->setAsPixel();
           t.addHit(std::move(hit));
         }
-    iter++;
   }
   return res;
 }
@@ -2417,6 +2674,8 @@ void Analyzer::clearMaterialBudgetHistograms() {
   rlazyendcap.SetNameTitle("rlazyendcap", "Endcap Supports Radiation Length");
   rlazytube.Reset();
   rlazytube.SetNameTitle("rlazytube", "Support Tubes Radiation Length");
+  rlazybtube.Reset();
+  rlazybtube.SetNameTitle("rlazybtube", "Barrel Support Tubes Radiation Length");
   rlazyuserdef.Reset();
   rlazyuserdef.SetNameTitle("rlazyuserdef", "Userdefined Supports Radiation Length");
   iactivebarrel.Reset();
@@ -2433,6 +2692,8 @@ void Analyzer::clearMaterialBudgetHistograms() {
   ilazyendcap.SetNameTitle("ilazyendcap", "Endcap Supports Interaction Length");
   ilazytube.Reset();
   ilazytube.SetNameTitle("ilazytube", "Support Tubes Interaction Length");
+  ilazybtube.Reset();
+  ilazybtube.SetNameTitle("ilazybtube", "Barrel Support Tubes Interaction Length");
   ilazyuserdef.Reset();
   ilazyuserdef.SetNameTitle("ilazyuserdef", "Userdefined Supports Interaction Length");
   // composite
@@ -2799,6 +3060,7 @@ void Analyzer::setHistogramBinsBoundaries(int bins, double min, double max) {
   rlazybarrel.SetBins(bins, min, max);
   rlazyendcap.SetBins(bins, min, max);
   rlazytube.SetBins(bins, min, max);
+  rlazybtube.SetBins(bins, min, max);
   rlazyuserdef.SetBins(bins, min, max);
   iactivebarrel.SetBins(bins, min, max);
   iactiveendcap.SetBins(bins, min, max);
@@ -2807,6 +3069,7 @@ void Analyzer::setHistogramBinsBoundaries(int bins, double min, double max) {
   ilazybarrel.SetBins(bins, min, max);
   ilazyendcap.SetBins(bins, min, max);
   ilazytube.SetBins(bins, min, max);
+  ilazybtube.SetBins(bins, min, max);
   ilazyuserdef.SetBins(bins, min, max);
   // composite
   rbarrelall.SetBins(bins, min, max);
@@ -2880,14 +3143,7 @@ void Analyzer::setCellBoundaries(int bins, double minr, double maxr, double mine
  */
 void Analyzer::fillMapRT(const double& r, const double& theta, const Material& mat) {
   double z = r /tan(theta);
-  if (mat.radiation>0){
-    mapRadiation.Fill(z,r,mat.radiation);
-    mapRadiationCount.Fill(z,r);
-  } 
-  if (mat.interaction>0) {
-    mapInteraction.Fill(z,r,mat.interaction);
-    mapInteractionCount.Fill(z,r);
-  }
+  fillMapRZ(r, z, mat);
 }
 
 /**
@@ -2898,6 +3154,10 @@ void Analyzer::fillMapRT(const double& r, const double& theta, const Material& m
  * @param il The local interaction length
  */
 void Analyzer::fillMapRZ(const double& r, const double& z, const Material& mat) {
+  if (bufferMaterialMapFills_) {
+    materialMapFills_.push_back({r, z, mat});
+    return;
+  }
   if (mat.radiation>0){
     mapRadiation.Fill(z,r,mat.radiation);
     mapRadiationCount.Fill(z,r);
@@ -3095,6 +3355,7 @@ std::pair<double, double> Analyzer::computeMinMaxTracksEta(const Tracker& t) con
  * @param nTracker the number of tracks to be used to analyze the coverage (defaults to 1000)
  */
 void Analyzer::analyzeGeometry(Tracker& tracker, int nTracks /*=1000*/ ) {
+  profileScope("Geometry");
   geometryTracksUsed = nTracks;
   savingGeometryV.clear();
   clearGeometryHistograms();
@@ -3121,7 +3382,8 @@ void Analyzer::analyzeGeometry(Tracker& tracker, int nTracks /*=1000*/ ) {
 
 
   // Initialize random number generator, counters and histograms
-  myDice.SetSeed(MY_RANDOM_SEED);
+  CounterRandom random(CounterRandom::Geometry);
+  const PhiSymmetry& symmetry = PhiSymmetry::forAnalysis(tracker);
   createResetCounters(tracker, moduleTypeCount);
   createResetCounters(tracker, sensorTypeCount);
   createResetCounters(tracker, moduleTypeCountStubs);
@@ -3165,6 +3427,9 @@ void Analyzer::analyzeGeometry(Tracker& tracker, int nTracks /*=1000*/ ) {
   int nTracksPerSide = int(pow(nTracks, 0.5));
   int nBlocks = int(nTracksPerSide/2.);
   nTracks = nTracksPerSide*nTracksPerSide;
+  // With a phi-symmetric layout, only the first sector is simulated: each track stands for its images in all the sectors,
+  // so that a fraction 1/folds of the tracks gives the same statistics
+  const int nSimulatedTracks = symmetry.isSymmetric() ? (nTracks + symmetry.folds() - 1) / symmetry.folds() : nTracks;
   mapPhiEta.SetBins(nBlocks, -1*M_PI, M_PI, nBlocks, -maxEta, maxEta);
   mapPhiEtaDTC.SetBins(nBlocks, -1*M_PI, M_PI, nBlocks, -maxEta, maxEta);
   TH2I mapPhiEtaCount("mapPhiEtaCount ", "phi Eta hit count", nBlocks, -1*M_PI, M_PI, nBlocks, -maxEta, maxEta);
@@ -3224,78 +3489,82 @@ void Analyzer::analyzeGeometry(Tracker& tracker, int nTracks /*=1000*/ ) {
   std::map<std::string, int> modulePlotColors; // CUIDADO quick and dirty way of creating a map with all the module colors (a cleaner way would be to have the map already created somewhere else)
 
   //XYZVector dir(0, 1, 0);
-  // Shoot nTracksPerSide^2 tracks
+  // Shoot nTracksPerSide^2 tracks (or their share in the first sector)
   //double angle = M_PI/2/(double)nTracksPerSide;
-  for (int i=0; i<nTracksPerSide; i++) {
-    for (int j=0; j<nTracksPerSide; j++) {
-      // Reset the hit counter
-      // Generate a straight track and collect the list of hit modules
-      aLine = shootDirection(randomBase, randomSpan);
-      std::vector<std::pair<Module*, HitType>> hitModules = trackHit( getLuminousRegion(), aLine.first, tracker.modules());
-      std::set<std::string> hitModulesDTC;
-      // Reset the per-type hit counter and fill it
-      resetTypeCounter(moduleTypeCount);
-      resetTypeCounter(sensorTypeCount);
-      resetTypeCounter(moduleTypeCountStubs);
-      int numOuterTrackerStubs = 0;
-      int numHits = 0;    
-      for (auto& mh : hitModules) {
-        moduleTypeCount[mh.first->moduleType()]++;
-
-        if (mh.second == HitType::INNER || mh.second == HitType::OUTER) {
+  for (int iTrack=0; iTrack<nSimulatedTracks; iTrack++) {
+    // Reset the hit counter
+    // Generate a straight track and collect the list of hit modules
+    CounterRandom::Stream draws = random.track(iTrack);
+    aLine = shootDirection(randomBase, randomSpan, draws);
+    if (symmetry.isSymmetric()) aLine.first = RotationZ(symmetry.foldPhi(aLine.first.Phi()) - aLine.first.Phi())(aLine.first);
+    std::vector<std::pair<Module*, HitType>> hitModules = trackHit( getLuminousRegion(draws), aLine.first, tracker.modules());
+    // Reset the per-type hit counter and fill it
+    resetTypeCounter(moduleTypeCount);
+    resetTypeCounter(sensorTypeCount);
+    resetTypeCounter(moduleTypeCountStubs);
+    int numOuterTrackerStubs = 0;
+    int numHits = 0;    
+    for (auto& mh : hitModules) {
+      moduleTypeCount[mh.first->moduleType()]++;
+
+      if (mh.second == HitType::INNER || mh.second == HitType::OUTER) {
 	  // Important NB: Concerning Inner Tracker modules, all hits are of type INNER
-          sensorTypeCount[mh.first->moduleType()]++;
-          numHits++;
-        }
-	else if (mh.second == HitType::BOTH || mh.second == HitType::STUB) {
-          sensorTypeCount[mh.first->moduleType()] += 2;
-          numHits+=2;
-        }
-        
-	if (mh.second == HitType::STUB) {
-          moduleTypeCountStubs[mh.first->moduleType()]++;
-          numOuterTrackerStubs++;
-        }
-        modulePlotColors[mh.first->moduleType()] = mh.first->plotColor();
+        sensorTypeCount[mh.first->moduleType()]++;
+        numHits++;
       }
-      for (auto& mh : hitModules) {
-	const OuterDTC* myDTC = mh.first->getDTC();
-        if (myDTC) hitModulesDTC.insert(myDTC->name());
+	else if (mh.second == HitType::BOTH || mh.second == HitType::STUB) {
+        sensorTypeCount[mh.first->moduleType()] += 2;
+        numHits+=2;
       }
-      // Fill the module type hit plot
-      for (std::map <std::string, int>::iterator it = moduleTypeCount.begin(); it!=moduleTypeCount.end(); it++) {
-        etaProfileByType[(*it).first].Fill(fabs(aLine.second), (*it).second);
+      
+	if (mh.second == HitType::STUB) {
+        moduleTypeCountStubs[mh.first->moduleType()]++;
+        numOuterTrackerStubs++;
       }
+      modulePlotColors[mh.first->moduleType()] = mh.first->plotColor();
+    }
+    // Fill the module type hit plot
+    for (std::map <std::string, int>::iterator it = moduleTypeCount.begin(); it!=moduleTypeCount.end(); it++) {
+      etaProfileByType[(*it).first].Fill(fabs(aLine.second), (*it).second);
+    }
 
-      for (auto& mel : sensorTypeCount) {
-        etaProfileByTypeSensors[mel.first].Fill(fabs(aLine.second), mel.second);
-      }
+    for (auto& mel : sensorTypeCount) {
+      etaProfileByTypeSensors[mel.first].Fill(fabs(aLine.second), mel.second);
+    }
 
-      if (!tracker.isPixelTracker()) {
+    if (!tracker.isPixelTracker()) {
 	// Does not make sense to sort IT stubs per module type.
 	// Indeed, 1 IT 'offline' stub can be on different modules types!
 	for (auto& mel : moduleTypeCountStubs) {
 	  etaProfileByTypeStubs[mel.first].Fill(fabs(aLine.second), mel.second);
 	}
+    }
+    // Fill other plots
+    const std::vector<double> phiImages = symmetry.images(aLine.first.Phi());
+    for (unsigned int k = 0; k < phiImages.size(); k++) {
+      // The image track hits the images of the hit modules, which need not share their DTCs
+      std::set<std::string> hitModulesDTC;
+      for (auto& mh : hitModules) {
+        const OuterDTC* myDTC = symmetry.image(*mh.first, k).getDTC();
+        if (myDTC) hitModulesDTC.insert(myDTC->name());
       }
-      // Fill other plots
-      mapPhiEta.Fill(aLine.first.Phi(), aLine.second, hitModules.size()); // phi, eta 2d plot
-      mapPhiEtaDTC.Fill(aLine.first.Phi(), aLine.second, hitModulesDTC.size()); // phi, eta  DTC 2d plot
-      mapPhiEtaCount.Fill(aLine.first.Phi(), aLine.second);               // Number of shot tracks
+      mapPhiEta.Fill(phiImages[k], aLine.second, hitModules.size()); // phi, eta 2d plot
+      mapPhiEtaDTC.Fill(phiImages[k], aLine.second, hitModulesDTC.size()); // phi, eta  DTC 2d plot
+      mapPhiEtaCount.Fill(phiImages[k], aLine.second);               // Number of shot tracks
+    }
 
-      totalEtaProfile.Fill(fabs(aLine.second), hitModules.size());                // Total number of hits
-      totalEtaProfileSensors.Fill(fabs(aLine.second), numHits);
+    totalEtaProfile.Fill(fabs(aLine.second), hitModules.size());                // Total number of hits
+    totalEtaProfileSensors.Fill(fabs(aLine.second), numHits);
 
 
-      // COVERAGE PER LAYER (fill 'per layer' plots and compute parameters of interest).
-      const std::pair<int, int>& coveragePerLayer = computeCoveragePerLayer(aLine, hitModules, layerNames, tracker.isPixelTracker(), maxEta);
-      const int numLayersWithAtLeastOneHit = coveragePerLayer.first;
-      const int numInnerTrackerStubs = coveragePerLayer.second;
-      const int numStubsPerTrack = (!tracker.isPixelTracker() ? numOuterTrackerStubs : numInnerTrackerStubs);
+    // COVERAGE PER LAYER (fill 'per layer' plots and compute parameters of interest).
+    const std::pair<int, int>& coveragePerLayer = computeCoveragePerLayer(aLine, hitModules, layerNames, tracker.isPixelTracker(), maxEta);
+    const int numLayersWithAtLeastOneHit = coveragePerLayer.first;
+    const int numInnerTrackerStubs = coveragePerLayer.second;
+    const int numStubsPerTrack = (!tracker.isPixelTracker() ? numOuterTrackerStubs : numInnerTrackerStubs);
 
-      // COVERAGE FOR ALL LAYERS (use the 'per layer' information)
-      computeCoveragePlotsAllLayers(aLine, numLayersWithAtLeastOneHit, numStubsPerTrack, plotMaxNumberOfStubs);     
-    }
+    // COVERAGE FOR ALL LAYERS (use the 'per layer' information)
+    computeCoveragePlotsAllLayers(aLine, numLayersWithAtLeastOneHit, numStubsPerTrack, plotMaxNumberOfStubs);     
   }
 
   // Create and archive for saving our 2D map of hits
@@ -3401,8 +3670,12 @@ void Analyzer::analyzeGeometry(Tracker& tracker, int nTracks /*=1000*/ ) {
   // Record the fraction of hits per module
   hitDistribution.SetBins(nTracks, 0 , 1);
   savingGeometryV.push_back(hitDistribution);
+  // with a phi-symmetric layout, the hits of the first sector are shared among the modules of each orbit
   for (auto m : tracker.modules()) {
-    hitDistribution.Fill(m->numHits()/double(nTracks));
+    std::vector<const Module*> orbit = symmetry.orbit(*m);
+    double hits = 0;
+    for (const Module* image : orbit) hits += image->numHits();
+    hitDistribution.Fill(hits/orbit.size()/double(nSimulatedTracks));
   }
 
 
@@ -3433,7 +3706,7 @@ void Analyzer::analyzeGeometry(Tracker& tracker, int nTracks /*=1000*/ ) {
     // Normalize by the number of tracks.
     for (auto& ringTransitionIndexIt : stubWith3HitsCountPerRing) {
       const int ringTransitionIndex = ringTransitionIndexIt.first;
-      stubWith3HitsCountPerDiskAndRing_[diskName][ringTransitionIndex] /= nTracks;
+      stubWith3HitsCountPerDiskAndRing_[diskName][ringTransitionIndex] /= nSimulatedTracks;
     }
   }
 
@@ -3447,6 +3720,7 @@ void Analyzer::analyzeGeometry(Tracker& tracker, int nTracks /*=1000*/ ) {
 // they could be just lists of 3d poly objects)
 // Moreover now we create them by calling the tracker object, which seems improper
 void Analyzer::createGeometryLite(Tracker& tracker) {
+  profileScope("Geometry lite");
   if (!(geomLiteCreated &&
         geomLiteXYCreated &&
         geomLiteYZCreated &&
@@ -3495,9 +3769,10 @@ void Analyzer::createGeometryLite(Tracker& tracker) {
      * gives also the direction's eta
      * @param minEta minimum eta to shoot tracks
      * @param spanEta difference between minimum and maximum eta
+     * @param draws the random numbers of the track
      * @return the pair of value: pointing XYZVector and eta of the track
      */
-    std::pair <XYZVector, double > Analyzer::shootDirection(double minEta, double spanEta) {
+    std::pair <XYZVector, double > Analyzer::shootDirection(double minEta, double spanEta, CounterRandom::Stream& draws) {
       std::pair <XYZVector, double> result;
 
       double eta;
@@ -3505,10 +3780,10 @@ void Analyzer::createGeometryLite(Tracker& tracker) {
       double theta;
 
       // phi is random [0, 2pi)
-      phi = myDice.Rndm() * 2 * M_PI; // debug
+      phi = draws.uniform() * 2 * M_PI; // debug
 
       // eta is random (-4, 4]
-      eta = myDice.Rndm() * spanEta + minEta;
+      eta = draws.uniform() * spanEta + minEta;
       theta=2*atan(exp(-1*eta));
 
       // Direction
@@ -3530,19 +3805,75 @@ void Analyzer::createGeometryLite(Tracker& tracker) {
       static const double BoundaryEtaSafetyMargin = 5. ; // track origin shift in units of zError to compute boundaries
 
       //static std::ofstream ofs("hits.txt");
-      for (auto& m : moduleV) {
+      const ModuleSpatialIndex& index = spatialIndex(moduleV);
+      const FrozenModules& frozen = index.frozen(); // frozen with the same zError
+      if (checkSpatialIndex_) checkSpatialIndexHits(index, origin, direction, SimParms::getInstance().lumiRegZError()*BoundaryEtaSafetyMargin);
+      ModuleSpatialIndex::Candidates crossed;
+      for (int candidate : index.candidates(origin, direction, crossed)) {
         // A module can be hit if it fits the phi (precise) contraints
         // and the eta constaints (taken assuming origin within 5 sigma)
-        if (m->couldHit(direction, SimParms::getInstance().lumiRegZError()*BoundaryEtaSafetyMargin)) {
-          auto h = m->checkTrackHits(origin, direction); 
+        if (frozen.couldHit(candidate, direction)) {
+          auto h = frozen.checkTrackHits(candidate, origin, direction);
           if (h.second != HitType::NONE) {
-            result.push_back(std::make_pair(m,h.second));
+            result.push_back(std::make_pair(&frozen.module(candidate), h.second));
           }
         }
       }
       return result;
     }
 
+    /**
+     * Returns the spatial index of a layer of module caps, building it on first use.
+     * The index is rebuilt if the layer it was built for has changed in the meantime.
+     * @param layer the module caps of the layer
+     * @return the spatial index of the layer, with the same module order as the layer
+     */
+    const ModuleSpatialIndex& Analyzer::spatialIndex(std::vector<ModuleCap>& layer) {
+      static const double BoundaryEtaSafetyMargin = 5. ; // same track origin spread as in trackHit
+      const Module* first = layer.empty() ? nullptr : &layer.front().getModule();
+      auto found = spatialIndexes_.find(&layer);
+      if (found == spatialIndexes_.end()) found = spatialIndexes_.insert(std::make_pair(&layer, ModuleSpatialIndex(64, 64))).first;
+      else if (found->second.isBuiltFor(layer.size(), first)) return found->second;
+      std::vector<Module*> modules;
+      for (auto& cap : layer) modules.push_back(&cap.getModule());
+      found->second.build(modules, SimParms::getInstance().lumiRegZError()*BoundaryEtaSafetyMargin);
+      found->second.freezeMaterials(layer);
+      return found->second;
+    }
+
+    /**
+     * Returns the spatial index of a whole set of modules, building it on first use.
+     * @param modules the modules of the tracker
+     * @return the spatial index of the modules, with the same module order as the set
+     */
+    const ModuleSpatialIndex& Analyzer::spatialIndex(Tracker::Modules& modules) {
+      static const double BoundaryEtaSafetyMargin = 5. ; // same track origin spread as in trackHit
+      const Module* first = modules.empty() ? nullptr : *modules.begin();
+      auto found = spatialIndexes_.find(&modules);
+      if (found == spatialIndexes_.end()) found = spatialIndexes_.insert(std::make_pair(&modules, ModuleSpatialIndex())).first;
+      else if (found->second.isBuiltFor(modules.size(), first)) return found->second;
+      found->second.build(std::vector<Module*>(modules.begin(), modules.end()), SimParms::getInstance().lumiRegZError()*BoundaryEtaSafetyMargin);
+      return found->second;
+    }
+
+    /**
+     * Cross-checks the spatial index against the brute-force scan of all the modules, reporting
+     * any module hit by the track which was not among the candidates returned by the index.
+     * @param index the spatial index to be checked
+     * @param origin XYZVector of origin of the track
+     * @param direction pointing XYZVector of the track
+     * @param zError if positive, modules failing DetectorModule::couldHit with this error are not reported (as they are skipped by the brute-force scan too)
+     */
+    void Analyzer::checkSpatialIndexHits(const ModuleSpatialIndex& index, const XYZVector& origin, const XYZVector& direction, double zError) const {
+      for (int missed : index.missedHits(origin, direction)) {
+        const Module& m = index.module(missed);
+        if (zError >= 0 && !m.couldHit(direction, zError)) continue;
+        logERROR("Spatial index missed the hit of module " + any2str(m.myDetId())
+                 + " (r = " + any2str(m.center().Rho()) + ", z = " + any2str(m.center().Z()) + ", phi = " + any2str(m.center().Phi()) + ")"
+                 + " by the track with eta = " + any2str(direction.Eta()) + ", phi = " + any2str(direction.Phi()) + ", z0 = " + any2str(origin.Z()));
+      }
+    }
+
     // Resets a module type counter
     void Analyzer::resetTypeCounter(std::map <std::string, int> &modTypes) {
       for (std::map <std::string, int>::iterator it = modTypes.begin();
@@ -3991,7 +4322,7 @@ void Analyzer::createGeometryLite(Tracker& tracker) {
 
     const InactiveElement* inactive = hitOnService->getHitPassiveElement();
     if (inactive != nullptr) {
-      std::map<std::string, Material> servicesComponentsRI = inactive->getComponentsRI();
+      const std::map<std::string, Material>& servicesComponentsRI = inactive->getComponentsRI();
 
       for (const auto& it : servicesComponentsRI) {
 
@@ -4,6 +4,7 @@ void IrradiationPowerVisitor::preVisit() {
   sensorsPowerSummary.clear();
   sensorsFluenceSummary.clear();
   sensorsFluencePerType.clear();
+  representativeFluences_.clear();
 }
 
 void IrradiationPowerVisitor::visit(SimParms& sp) {
@@ -13,6 +14,10 @@ void IrradiationPowerVisitor::visit(SimParms& sp) {
   irradiationMap_  = &sp.irradiationMapsManager();
 }
 
+void IrradiationPowerVisitor::visit(Tracker& t) {
+  symmetry_ = &PhiSymmetry::forAnalysis(t);
+}
+
 void IrradiationPowerVisitor::visit(Barrel& b) {
   isBarrel_ = true;
 }
@@ -36,7 +41,15 @@ void IrradiationPowerVisitor::visit(DetectorModule& m) {
   // The irradiationMap_ was obtained with FLUKA simulation.
   // The irradiationMap_ values are 1 MeV-neutrons-equivalent fluence, for an integrated luminosity = 1 fb-1 .
   // The values are the mean and the max on different points on the module's sensor(s).
-  std::pair<double, double> irradiationMeanMax = getModuleFluenceMeanMax(irradiationMap_, m);
+  // With a phi-symmetric layout, the fluence is computed once per orbit, the map depending on (z, rho) only.
+  const DetectorModule& representative = symmetry_->representative(m);
+  auto known = representativeFluences_.find(&representative);
+  std::pair<double, double> irradiationMeanMax;
+  if (known != representativeFluences_.end()) irradiationMeanMax = known->second;
+  else {
+    irradiationMeanMax = getModuleFluenceMeanMax(irradiationMap_, representative);
+    if (symmetry_->isSymmetric()) representativeFluences_[&representative] = irradiationMeanMax;
+  }
   double irradiationMean = irradiationMeanMax.first * timeIntegratedLumi_;  // 1MeV-equiv-neutrons / cm^2
   double irradiationMax = irradiationMeanMax.second * timeIntegratedLumi_;  // 1MeV-equiv-neutrons / cm^2
 
@@ -74,6 +87,8 @@ void IrradiationPowerVisitor::visit(DetectorModule& m) {
 
 
 void IrradiationPowerVisitor::postVisit() {
+  irradiationMap_->saveFluenceCache();
+
   // Sort the irradiation and extract the max and 95% percentiles
   sensorsFluencePerType.setCell(0, 0, "Type");
   sensorsFluencePerType.setCell(0, 1, "# mods");
@@ -158,36 +173,26 @@ void IrradiationPowerVisitor::postVisit() {
 */
 std::pair<double, double> IrradiationPowerVisitor::getModuleFluenceMeanMax(const IrradiationMapsManager* irradiationMap, const DetectorModule& m) {
 
-  // Get the irradiation from irradiationMap at differents points of the modules's sensor(s).
-  std::vector<double> irradiationValues;
+  // Collect differents points of the modules's sensor(s), as (z, rho) pairs.
+  std::vector<std::pair<double,double> > points;
   for (const auto& s : m.sensors()) {
 
     // Center of the sensor
-    const std::pair<double,double>& center = std::make_pair(s.center().Z(), s.center().Rho());
-    double centerIrradiation = irradiationMap->calculateIrradiationPower(center);
-    irradiationValues.push_back(centerIrradiation);
+    points.push_back(std::make_pair(s.center().Z(), s.center().Rho()));
 
     // Many vertexes of the sensor
     for (int i = 0; i < s.envelopePoly().getNumSides(); i++) {
       // each vertex
-      std::pair<double,double> vertex = std::make_pair(s.envelopePoly().getVertex(i).Z(), s.envelopePoly().getVertex(i).Rho());
-      double vertexIrradiation = irradiationMap->calculateIrradiationPower(vertex);
-      irradiationValues.push_back(vertexIrradiation);
+      points.push_back(std::make_pair(s.envelopePoly().getVertex(i).Z(), s.envelopePoly().getVertex(i).Rho()));
 
       // each middle of 2 consecutive vertexes
-      std::pair<double,double> midVertex = std::make_pair(s.envelopeMidPoly().getVertex(i).Z(), s.envelopeMidPoly().getVertex(i).Rho());
-      double midVertexIrradiation = irradiationMap->calculateIrradiationPower(midVertex);
-      irradiationValues.push_back(midVertexIrradiation);
+      points.push_back(std::make_pair(s.envelopeMidPoly().getVertex(i).Z(), s.envelopeMidPoly().getVertex(i).Rho()));
     }
   }
 
   // For a given module, take the average and the max irradiation on all the considered points.
-  double sum = std::accumulate(irradiationValues.begin(), irradiationValues.end(), 0.);
-  double irradiationMean = sum / irradiationValues.size();                                   // 1MeV-equiv-neutrons / cm^2 / fb-1
-  double irradiationMax = *max_element(irradiationValues.begin(), irradiationValues.end());  // 1MeV-equiv-neutrons / cm^2 / fb-1
-
-  std::pair<double, double> irradiationMeanMax = std::make_pair(irradiationMean, irradiationMax);
-  return irradiationMeanMax;
+  // The irradiationMap caches the result by module geometry, so that a layout already seen skips the map lookups.
+  return irradiationMap->calculateFluenceMeanMax(points);  // 1MeV-equiv-neutrons / cm^2 / fb-1
 }
 
 
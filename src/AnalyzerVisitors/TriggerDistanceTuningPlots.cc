@@ -1 +1,4 @@
 #include "AnalyzerVisitors/TriggerDistanceTuningPlots.hh"
+
+bool TriggerDistanceTuningPlotsVisitor::fastScan_ = false;
+const double TriggerDistanceTuningPlotsVisitor::crossingTolerance_ = 1e-4; // mm
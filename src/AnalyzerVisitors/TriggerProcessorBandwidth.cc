@@ -2,10 +2,15 @@
 #include "AnalyzerVisitors/TriggerProcessorBandwidth.hh"
 #include "SimParms.hh"
 
+#include <algorithm>
+#include <sstream>
+
 
 using AnalyzerHelpers::Circle;
 using AnalyzerHelpers::Point;
 
+bool TriggerProcessorBandwidthVisitor::checkPetalArea_ = false;
+
 
 std::pair<Circle, Circle> AnalyzerHelpers::findCirclesTwoPoints(const Point& p1, const Point& p2, double r) {
   double x1 = p1.x, y1 = p1.y, x2 = p2.x, y2 = p2.y;
@@ -26,9 +31,37 @@ std::pair<Circle, Circle> AnalyzerHelpers::findCirclesTwoPoints(const Point& p1,
 bool AnalyzerHelpers::isPointInCircle(const Point& p, const Circle& c) { return pow(p.x - c.x0, 2) + pow(p.y - c.y0, 2) <= c.r*c.r; }
 
 
+AnalyzerHelpers::ModuleExtents AnalyzerHelpers::moduleExtents(const DetectorModule& module) {
+  ModuleExtents extents;
+  extents.module    = &module;
+  extents.side      = module.side();
+  extents.minZ      = module.minZ();
+  extents.maxZ      = module.maxZ();
+  extents.minR      = module.minR();
+  extents.maxR      = module.maxR();
+  extents.minPhi    = module.minPhi();
+  extents.maxPhi    = module.maxPhi();
+  extents.centerPhi = module.center().Phi();
+  for (int i = 0; i < 4; i++) {
+    const XYZVector& corner = module.basePoly().getVertex(i);
+    extents.corners[i] = (Point){ corner.X(), corner.Y() };
+  }
+  return extents;
+}
+
+std::vector<AnalyzerHelpers::ModuleExtents> AnalyzerHelpers::collectModuleExtents(const Tracker& tracker) {
+  struct ExtentsVisitor : public ConstGeometryVisitor {
+    std::vector<ModuleExtents> modules;
+    void visit(const Module& m) { modules.push_back(moduleExtents(m)); }
+  } v;
+  tracker.accept(v);
+  return v.modules;
+}
+
+
 
 double AnalyzerHelpers::calculatePetalAreaMC(const Tracker& tracker, const SimParms& simParms, double crossoverR) {
-  static TRandom3 die;
+  CounterRandom random(CounterRandom::PetalArea);
 
   double r = simParms.triggerPtCut()/(0.3*SimParms::getInstance().magField()) * 1e3; // curvature radius of particles with the minimum accepted pt
 
@@ -42,8 +75,9 @@ double AnalyzerHelpers::calculatePetalAreaMC(const Tracker& tracker, const SimPa
   //double maxPhi = M_PI/2 + aperture/2;
   double minPhi = M_PI/2 - aperture/2;
   for (int i = 0; i < 100000; i++) {
-    double rr  = minR + die.Rndm()*(maxR-minR);
-    double phi = minPhi + die.Rndm()*aperture;
+    CounterRandom::Stream draws = random.track(i);
+    double rr  = minR + draws.uniform()*(maxR-minR);
+    double phi = minPhi + draws.uniform()*aperture;
     Polar2DPoint rndp(rr, phi);
     bool inFirstCircle  = isPointInCircle((Point){rndp.X(), rndp.Y()}, cc.first);
     bool inSecondCircle = isPointInCircle((Point){rndp.X(), rndp.Y()}, cc.second);
@@ -54,39 +88,97 @@ double AnalyzerHelpers::calculatePetalAreaMC(const Tracker& tracker, const SimPa
 }
 
 
+namespace {
+  double clippedLength(double start, double end, double halfAperture) { return std::max(0., std::min(end, halfAperture) - std::max(start, -halfAperture)); }
+
+  //
+  // Angle, within [-halfAperture, halfAperture] around the petal axis, covered by the points at radius r lying in both or in
+  // none of the two petal circles. Both circles go through the origin with radius R, their centres being at angles +-beta
+  // from the axis: the points at radius r of such a circle are those within alpha = acos(r/2R) of the direction of its centre
+  //
+  double petalAngle(double alpha, double beta, double halfAperture) {
+    double inOneCircle;
+    if (alpha > beta) inOneCircle = clippedLength(-beta-alpha, beta-alpha, halfAperture) + clippedLength(alpha-beta, beta+alpha, halfAperture);
+    else              inOneCircle = clippedLength(-beta-alpha, -beta+alpha, halfAperture) + clippedLength(beta-alpha, beta+alpha, halfAperture);
+    return 2*halfAperture - inOneCircle;
+  }
+}
+
+/**
+ * Closed-form counterpart of calculatePetalAreaMC: the expected number of its 100000 random points falling in the petal.
+ * The angle covered by the petal at radius r is linear in acos(r/2R) between the radii where the boundaries of the
+ * circles cross each other or the edges of the slice, and the integral of acos(r/2R) over r is known.
+ */
+double AnalyzerHelpers::calculatePetalAreaAnalytic(const Tracker& tracker, const SimParms& simParms, double crossoverR) {
+  double r = simParms.triggerPtCut()/(0.3*SimParms::getInstance().magField()) * 1e3; // curvature radius of particles with the minimum accepted pt
+  double maxR = tracker.maxR();
+  double minR = tracker.minR();
+  double aperture = 0.34906585 * 2; // 40 degrees, as in calculatePetalAreaMC
+  double halfAperture = aperture/2;
+  double k = 2*r;                   // beyond this radius particles never get
+  double beta = crossoverR < k ? acos(crossoverR/k) : 0.;
+  auto alphaAt = [k](double radius) { return radius < k ? acos(radius/k) : 0.; };
+  auto alphaIntegral = [k](double radius) { return radius < k ? radius*acos(radius/k) - sqrt(k*k - radius*radius) : 0.; };
+
+  std::vector<double> radii = { minR, maxR, k };
+  for (double alpha : { beta, fabs(halfAperture - beta), halfAperture + beta }) {
+    if (alpha < M_PI/2) radii.push_back(k*cos(alpha));
+  }
+  std::sort(radii.begin(), radii.end());
+
+  double integral = 0;
+  for (unsigned int i = 0; i+1 < radii.size(); i++) {
+    double rStart = std::max(radii[i], minR), rEnd = std::min(radii[i+1], maxR);
+    if (rEnd <= rStart) continue;
+    double alphaStart = alphaAt(rStart), alphaEnd = alphaAt(rEnd);
+    double angleStart = petalAngle(alphaStart, beta, halfAperture), angleEnd = petalAngle(alphaEnd, beta, halfAperture);
+    double slope = alphaEnd != alphaStart ? (angleEnd - angleStart)/(alphaEnd - alphaStart) : 0.;
+    integral += (angleStart - slope*alphaStart)*(rEnd - rStart) + slope*(alphaIntegral(rEnd) - alphaIntegral(rStart));
+  }
+
+  return 100000 * integral / (aperture*(maxR - minR)); // the MC points are uniform in r and phi
+}
+
+
 double AnalyzerHelpers::calculatePetalAreaModules(const Tracker& tracker, const SimParms& simParms, double crossoverR) {
   double curvatureR = simParms.particleCurvatureR(simParms.triggerPtCut()); // curvature radius of particles with the minimum accepted pt
-  int numTriggerProcessorsPhi = simParms.numTriggerTowersPhi();
-
-  struct PetalAreaVisitor : public ConstGeometryVisitor {
-    double curvatureR_, crossoverR_, numTriggerProcessorsPhi_;  
-    int hits = 0;
-    PetalAreaVisitor(double curvatureR, double crossoverR, double numTriggerProcessorsPhi) : curvatureR_(curvatureR), crossoverR_(crossoverR), numTriggerProcessorsPhi_(numTriggerProcessorsPhi) {}
-    void visit(const Module& m) {
-      if (m.side() < 0) return;
-      const double petalInterval = 2*M_PI / numTriggerProcessorsPhi_; // aka Psi
-      for (int i = 0; i < numTriggerProcessorsPhi_; ++i) {
-        if (AnalyzerHelpers::isModuleInPetal(m, petalInterval*i, curvatureR_, crossoverR_)) { hits++; } // we could break after the find found hit, but this way we take into account the (admittedly unlikely) situation of petals being so wide that some modules belong to more than one.
-      }
-    }
-  } v(curvatureR, crossoverR, numTriggerProcessorsPhi);
-
-  tracker.accept(v);
+  return calculatePetalAreaModules(collectModuleExtents(tracker), curvatureR, crossoverR, simParms.numTriggerTowersPhi());
+}
 
-  return v.hits;
+/**
+ * Number of (module, petal) pairs with the module in the petal, from the cached module extents
+ */
+double AnalyzerHelpers::calculatePetalAreaModules(const std::vector<ModuleExtents>& modules, double curvatureR, double crossoverR, int numTriggerProcessorsPhi) {
+  const double petalInterval = 2*M_PI / numTriggerProcessorsPhi; // aka Psi
+  int hits = 0;
+  for (const ModuleExtents& m : modules) {
+    if (m.side < 0) continue;
+    for (int i = 0; i < numTriggerProcessorsPhi; ++i) {
+      if (AnalyzerHelpers::isModuleInPetal(m, petalInterval*i, curvatureR, crossoverR)) { hits++; } // we could break after the find found hit, but this way we take into account the (admittedly unlikely) situation of petals being so wide that some modules belong to more than one.
+    }
+  }
+  return hits;
 }
 
 double AnalyzerHelpers::calculatePetalCrossover(const Tracker& tracker, const SimParms& simParms) {
+  return calculatePetalCrossover(collectModuleExtents(tracker), tracker, simParms);
+}
+
+/**
+ * Crossover radius minimizing the number of modules in the petals, evaluated on the cached module extents
+ */
+double AnalyzerHelpers::calculatePetalCrossover(const std::vector<ModuleExtents>& modules, const Tracker& tracker, const SimParms& simParms) {
   class Trampoline : public ROOT::Math::IBaseFunctionOneDim {
-    const Tracker& t_;
-    const SimParms& s_;
-    double DoEval(double x) const { return calculatePetalAreaModules(t_, s_, x); }
+    const std::vector<ModuleExtents>& m_;
+    double curvatureR_;
+    int numTriggerProcessorsPhi_;
+    double DoEval(double x) const { return calculatePetalAreaModules(m_, curvatureR_, x, numTriggerProcessorsPhi_); }
   public:
-    Trampoline(const Tracker& t, const SimParms& s) : t_(t), s_(s) {}
-    ROOT::Math::IBaseFunctionOneDim* Clone() const { return new Trampoline(t_, s_); }
+    Trampoline(const std::vector<ModuleExtents>& m, double curvatureR, int numTriggerProcessorsPhi) : m_(m), curvatureR_(curvatureR), numTriggerProcessorsPhi_(numTriggerProcessorsPhi) {}
+    ROOT::Math::IBaseFunctionOneDim* Clone() const { return new Trampoline(m_, curvatureR_, numTriggerProcessorsPhi_); }
   };
 
-  Trampoline t(tracker, simParms);
+  Trampoline t(modules, simParms.particleCurvatureR(simParms.triggerPtCut()), simParms.numTriggerTowersPhi());
 
   ROOT::Math::BrentMinimizer1D minBrent;
   minBrent.SetFunction(t, 0., tracker.maxR());
@@ -108,6 +200,10 @@ double AnalyzerHelpers::calculatePetalCrossover(const Tracker& tracker, const Si
 
 
 bool AnalyzerHelpers::isModuleInEtaSector(const SimParms& simParms, const Tracker& tracker, const DetectorModule& module, int etaSector) {
+  return isModuleInEtaSector(simParms, tracker, moduleExtents(module), etaSector);
+}
+
+bool AnalyzerHelpers::isModuleInEtaSector(const SimParms& simParms, const Tracker& tracker, const ModuleExtents& module, int etaSector) {
   int numProcEta = simParms.numTriggerTowersEta();
   double etaCut = simParms.triggerEtaCut();
   double etaSlice = etaCut*2 / numProcEta;
@@ -115,10 +211,10 @@ bool AnalyzerHelpers::isModuleInEtaSector(const SimParms& simParms, const Tracke
   double zError = simParms.lumiRegZError();
   double eta = etaSlice*etaSector-etaCut;    
 
-  double modMinZ = module.minZ();
-  double modMaxZ = module.maxZ();
-  double modMinR = module.minR();                
-  double modMaxR = module.maxR();                
+  double modMinZ = module.minZ;
+  double modMaxZ = module.maxZ;
+  double modMinR = module.minR;
+  double modMaxR = module.maxR;
 
   double etaSliceZ1 = maxR/tan(2*atan(exp(-eta)));
   double etaSliceZ2 = maxR/tan(2*atan(exp(-eta-etaSlice)));
@@ -130,16 +226,19 @@ bool AnalyzerHelpers::isModuleInEtaSector(const SimParms& simParms, const Tracke
 }
 
 bool AnalyzerHelpers::isModuleInPetal(const DetectorModule& module, double petalPhi, double curvatureR, double crossoverR) {
+  return isModuleInPetal(moduleExtents(module), petalPhi, curvatureR, crossoverR);
+}
+
+bool AnalyzerHelpers::isModuleInPetal(const ModuleExtents& module, double petalPhi, double curvatureR, double crossoverR) {
   Polar2DPoint crossoverPoint(crossoverR, petalPhi);
-  double proj = cos(module.center().Phi() - petalPhi); // check if module is in the same semi-plane as the petal by projecting its center on the petal symmetry line
+  double proj = cos(module.centerPhi - petalPhi); // check if module is in the same semi-plane as the petal by projecting its center on the petal symmetry line
   if (proj < 0.) return false;
   std::pair<Circle, Circle> cc = findCirclesTwoPoints((Point){0.,0.}, (Point){crossoverPoint.X(), crossoverPoint.Y()}, curvatureR);
 
   int inFirstCircle = 0, inSecondCircle = 0;
   for (int i = 0; i < 4; i++) {
-    const XYZVector& corner = module.basePoly().getVertex(i);
-    inFirstCircle  |= (isPointInCircle((Point){corner.X(), corner.Y()}, cc.first) << i);
-    inSecondCircle |= (isPointInCircle((Point){corner.X(), corner.Y()}, cc.second) << i);
+    inFirstCircle  |= (isPointInCircle(module.corners[i], cc.first) << i);
+    inSecondCircle |= (isPointInCircle(module.corners[i], cc.second) << i);
   }
   return (inFirstCircle && inSecondCircle) || (inFirstCircle < 0xF && inSecondCircle < 0xF);
 }
@@ -148,23 +247,26 @@ bool AnalyzerHelpers::isModuleInPetal(const DetectorModule& module, double petal
 bool AnalyzerHelpers::areClockwise(const Point& p1, const Point& p2) { return -p1.x*p2.y + p1.y*p2.x > 0; }
 //#define OLD_PHI_SECTOR_CHECK
 //
-#ifndef OLD_PHI_SECTOR_CHECK
 bool AnalyzerHelpers::isModuleInCircleSector(const DetectorModule& module, double startPhi, double endPhi) {
+  return isModuleInCircleSector(moduleExtents(module), startPhi, endPhi);
+}
+
+#ifndef OLD_PHI_SECTOR_CHECK
+bool AnalyzerHelpers::isModuleInCircleSector(const ModuleExtents& module, double startPhi, double endPhi) {
 
   Point startArm = {cos(startPhi), sin(startPhi)};
   Point endArm   = {cos(endPhi), sin(endPhi)};
 
   for (int i = 0; i < 4; i++) {
-    const XYZVector& corner = module.basePoly().getVertex(i);
-    if (!areClockwise(startArm, (Point){corner.X(), corner.Y()}) && areClockwise(endArm, (Point){corner.X(), corner.Y()})) return true;
+    if (!areClockwise(startArm, module.corners[i]) && areClockwise(endArm, module.corners[i])) return true;
   }
   return false;
 }
 #else
-bool AnalyzerHelpers::isModuleInCircleSector(const DetectorModule& module, double sliceMinPhi, double sliceMaxPhi) {
+bool AnalyzerHelpers::isModuleInCircleSector(const ModuleExtents& module, double sliceMinPhi, double sliceMaxPhi) {
 
-  double modMinPhi = module.minPhi() >= 0 ? module.minPhi() : module.minPhi() + 2*M_PI;
-  double modMaxPhi = module.maxPhi() >= 0 ? module.maxPhi() : module.maxPhi() + 2*M_PI;
+  double modMinPhi = module.minPhi >= 0 ? module.minPhi : module.minPhi + 2*M_PI;
+  double modMaxPhi = module.maxPhi >= 0 ? module.maxPhi : module.maxPhi + 2*M_PI;
 
 
   if (modMinPhi > modMaxPhi && sliceMaxPhi > 2*M_PI) modMaxPhi += 2*M_PI;      // this solves the issue with modules across the 2 PI line
@@ -180,6 +282,10 @@ bool AnalyzerHelpers::isModuleInCircleSector(const DetectorModule& module, doubl
 #endif
 
 bool AnalyzerHelpers::isModuleInPhiSector(const SimParms& simParms, const DetectorModule& module, double crossoverR, int phiSector) {
+  return isModuleInPhiSector(simParms, moduleExtents(module), crossoverR, phiSector);
+}
+
+bool AnalyzerHelpers::isModuleInPhiSector(const SimParms& simParms, const ModuleExtents& module, double crossoverR, int phiSector) {
   static const double curvatureR = simParms.triggerPtCut()/(0.3*SimParms::getInstance().magField()) * 1e3; // curvature radius of particles with the minimum accepted pt
 
   double phiSlice = 2*M_PI / simParms.numTriggerTowersPhi();  // aka Psi
@@ -221,7 +327,10 @@ void TriggerProcessorBandwidthVisitor::visit(const SimParms& sp) {
 
 void TriggerProcessorBandwidthVisitor::visit(const Tracker& t) { 
   tracker_ = &t; 
-  crossoverR = AnalyzerHelpers::calculatePetalCrossover(*tracker_, *simParms_);
+  std::vector<ModuleExtents> modules = collectModuleExtents(t);
+  crossoverR = AnalyzerHelpers::calculatePetalCrossover(modules, *tracker_, *simParms_);
+  if (checkPetalArea_) checkPetalArea();
+  buildTowerLookup(modules);
   sampleTriggerPetal = findCirclesTwoPoints((Point){0., 0.}, (Point){crossoverR, 0.}, simParms_->particleCurvatureR(simParms_->triggerPtCut()));
   int totalProcs = numProcEta * numProcPhi;
   processorCommonConnectionMap.SetBins(totalProcs, 0, totalProcs, totalProcs, 0, totalProcs);
@@ -230,35 +339,73 @@ void TriggerProcessorBandwidthVisitor::visit(const Tracker& t) {
 
 }
 
+/**
+ * Compare the Monte Carlo and the closed-form petal areas at the crossover radius: their difference is expected
+ * within the binomial fluctuation of the random points
+ */
+void TriggerProcessorBandwidthVisitor::checkPetalArea() const {
+  double areaMC = AnalyzerHelpers::calculatePetalAreaMC(*tracker_, *simParms_, crossoverR);
+  double areaAnalytic = AnalyzerHelpers::calculatePetalAreaAnalytic(*tracker_, *simParms_, crossoverR);
+  double fraction = std::min(std::max(areaAnalytic/100000, 0.), 1.);
+  double sigma = sqrt(100000 * fraction * (1 - fraction));
+  std::ostringstream message;
+  message << "Petal area at the crossover radius " << crossoverR << ": " << areaMC << " (Monte Carlo), " << areaAnalytic << " (closed form)";
+  if (fabs(areaMC - areaAnalytic) > 5*sigma + 1) logWARNING(message.str() + ", beyond the statistical fluctuation of the Monte Carlo");
+  else logINFO(message.str());
+}
+
+/**
+ * Assign the modules to the trigger towers once, from their cached extents
+ */
+void TriggerProcessorBandwidthVisitor::buildTowerLookup(const std::vector<ModuleExtents>& modules) {
+  towerLookup_.clear();
+  for (const ModuleExtents& m : modules) towerLookup_.insert(std::make_pair(m.module, moduleTowers(m)));
+}
+
+TriggerProcessorBandwidthVisitor::ModuleTowers TriggerProcessorBandwidthVisitor::moduleTowers(const ModuleExtents& m) const {
+  ModuleTowers result;
+  for (int i=0; i < numProcEta; i++) {
+    if (AnalyzerHelpers::isModuleInEtaSector(*simParms_, *tracker_, m, i)) {
+      result.etaSectors++;
+      for (int j=0; j < numProcPhi; j++) {
+        if (AnalyzerHelpers::isModuleInPhiSector(*simParms_, m, crossoverR, j)) result.towers.push_back(std::make_pair(i, j));
+      }
+    }
+  }
+  return result;
+}
+
 void TriggerProcessorBandwidthVisitor::visit(const DetectorModule& m) {
   TableRef p = m.tableRef();
 
   uint32_t detId = m.myDetId();
   moduleConnections[&m].detId(detId);
 
-  int etaConnections = 0, totalConnections = 0;
-  for (int i=0; i < numProcEta; i++) {
-    if (AnalyzerHelpers::isModuleInEtaSector(*simParms_, *tracker_, m, i)) {
-      etaConnections++;
-      for (int j=0; j < numProcPhi; j++) {
-        if (AnalyzerHelpers::isModuleInPhiSector(*simParms_, m, crossoverR, j)) {
-          totalConnections++;
+  auto lookup = towerLookup_.find(&m);
+  if (lookup == towerLookup_.end()) {
+    // Not found among the modules of the tracker the lookup was built from: assigned to the towers on the fly
+    logERROR("Module " + any2str(detId) + " is missing from the trigger tower lookup");
+    lookup = towerLookup_.insert(std::make_pair(&m, moduleTowers(AnalyzerHelpers::moduleExtents(m)))).first;
+  }
+  const ModuleTowers& towers = lookup->second;
 
-          processorConnections_[std::make_pair(j,i)] += 1;
-          processorConnectionSummary.setCell(j+1, i+1, processorConnections_[std::make_pair(j,i)]);
+  int etaConnections = towers.etaSectors, totalConnections = 0;
+  for (const auto& tower : towers.towers) {
+    int i = tower.first, j = tower.second;
+    totalConnections++;
 
-          moduleConnections[&m].connectedProcessors.insert(make_pair(i+1, j+1));
+    processorConnections_[std::make_pair(j,i)] += 1;
+    processorConnectionSummary.setCell(j+1, i+1, processorConnections_[std::make_pair(j,i)]);
 
-          processorInboundBandwidths_[std::make_pair(j,i)] += triggerDataBandwidths_[p.table][std::make_pair(p.row, p.col)]; // *2 takes into account negative Z's
-          processorInboundBandwidthSummary.setCell(j+1, i+1, processorInboundBandwidths_[std::make_pair(j,i)]);
+    moduleConnections[&m].connectedProcessors.insert(make_pair(i+1, j+1));
 
-          processorInboundStubsPerEvent_[std::make_pair(j,i)] += triggerFrequenciesPerEvent_[p.table][std::make_pair(p.row, p.col)];
-          processorInboundStubPerEventSummary.setCell(j+1, i+1, processorInboundStubsPerEvent_[std::make_pair(j,i)]);
+    processorInboundBandwidths_[std::make_pair(j,i)] += triggerDataBandwidths_[p.table][std::make_pair(p.row, p.col)]; // *2 takes into account negative Z's
+    processorInboundBandwidthSummary.setCell(j+1, i+1, processorInboundBandwidths_[std::make_pair(j,i)]);
 
-          sectorMap[make_pair(i+1, j+1)].insert(moduleConnections[&m].detId());
-        } 
-      }
-    }
+    processorInboundStubsPerEvent_[std::make_pair(j,i)] += triggerFrequenciesPerEvent_[p.table][std::make_pair(p.row, p.col)];
+    processorInboundStubPerEventSummary.setCell(j+1, i+1, processorInboundStubsPerEvent_[std::make_pair(j,i)]);
+
+    sectorMap[make_pair(i+1, j+1)].insert(moduleConnections[&m].detId());
   }
   moduleConnections[&m].etaCpuConnections(etaConnections);
   moduleConnections[&m].phiCpuConnections(totalConnections > 0 ? totalConnections/etaConnections : 0);
@@ -1,6 +1,7 @@
 #include "Barrel.hh"
 #include "MessageLogger.hh"
 #include "SupportStructure.hh"
+#include "ParallelBuild.hh"
 
 using material::SupportStructure;
 
@@ -15,8 +16,12 @@ void Barrel::build() {
     logINFO(Form("Building %s", fullid(*this).c_str()));
     check();
 
+    // The layers are independent once their properties are stored: they are built in parallel, then kept in order
+    std::vector<std::unique_ptr<Layer> > layers;
+    std::vector<std::function<void()> > builds;
     for (int i = 1; i <= numLayers(); i++) {
       Layer* layer = GeometryFactory::make<Layer>();
+      layers.emplace_back(layer);
       layer->myid(i);
 
       if      (i == 1)           { if (innerRadiusFixed()) layer->radiusMode(Layer::FIXED); layer->placeRadiusHint(innerRadius()); } 
@@ -31,11 +36,14 @@ void Barrel::build() {
 
       layer->store(propertyTree());
       if (layerNode.count(i) > 0) layer->store(layerNode.at(i)); // TO DO: WARNING!! layer->placeRadiusHint is reassigned here!!
-      layer->build();
-      layer->rotateZ(barrelRotation());
-      layer->rotateZ(layer->layerRotation());
-      layers_.push_back(layer);
+      builds.push_back([this, layer]() {
+        layer->build();
+        layer->rotateZ(barrelRotation());
+        layer->rotateZ(layer->layerRotation());
+      });
     }
+    ParallelBuild::run(builds);
+    for (auto& layer : layers) layers_.push_back(layer.release());
 
   } catch (PathfulException& pe) { pe.pushPath(fullid(*this)); throw; }
 
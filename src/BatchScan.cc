@@ -0,0 +1,267 @@
+/**
+ * @file BatchScan.cc
+ * @brief Analysis of a list of layouts and layout variants, summarized in a comparison table
+ */
+
+#include "BatchScan.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <map>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/info_parser.hpp>
+
+#include "Squid.hh"
+#include "MaterialTab.hh"
+#include "MainConfigHandler.hh"
+#include "MessageLogger.hh"
+#include "global_funcs.hh"
+
+BatchScan::BatchScan() :
+  jobs_(1),
+  geometryTracks_(100),
+  materialTracks_(100),
+  pt_(10),
+  trackingTag_("tracker"),
+  outputDirectory_("batch"),
+  webSites_(false),
+  configCacheCheck_(ConfigCache::MTIME) {}
+
+std::string BatchScan::uniqueName(const std::string& name) const {
+  std::string result = name;
+  for (int i = 2; std::any_of(layouts_.begin(), layouts_.end(), [&](const BatchLayout& l) { return l.name == result; }); i++) {
+    result = name + "_" + any2str(i);
+  }
+  return result;
+}
+
+bool BatchScan::addLayout(const std::string& geometryFile) {
+  if (!boost::filesystem::exists(geometryFile)) {
+    logERROR("Layout file " + geometryFile + " does not exist");
+    return false;
+  }
+  BatchLayout layout;
+  layout.geometryFile = geometryFile;
+  layout.name = uniqueName(boost::filesystem::path(geometryFile).stem().string());
+  layouts_.push_back(layout);
+  return true;
+}
+
+/**
+ * Read the layouts and the parameter sweeps of a batch description. The relative file names are taken from the
+ * directory of the description
+ * @return True if all the layouts of the description exist
+ */
+bool BatchScan::readDescription(const std::string& fileName) {
+  using namespace boost::property_tree;
+  ptree pt;
+  try {
+    info_parser::read_info(fileName, pt);
+  } catch (info_parser::info_parser_error& e) {
+    logERROR("Cannot read the batch description " + fileName + ": " + e.what());
+    return false;
+  }
+
+  boost::filesystem::path directory = boost::filesystem::path(fileName).parent_path();
+  auto resolve = [&](const std::string& layoutFile) {
+    boost::filesystem::path layoutPath(layoutFile);
+    return (layoutPath.is_absolute() ? layoutPath : directory / layoutPath).string();
+  };
+
+  bool ok = true;
+  for (const auto& entry : pt) {
+    if (entry.first == "Layout") {
+      ok &= addLayout(resolve(entry.second.data()));
+    } else if (entry.first == "Sweep") {
+      std::string base = resolve(entry.second.get<std::string>("base", ""));
+      std::string parameter = entry.second.get<std::string>("parameter", "");
+      std::vector<std::string> values = split<std::string>(entry.second.get<std::string>("values", ""), ",");
+      if (parameter.empty() || values.empty()) {
+        logERROR("Sweep over " + base + " in " + fileName + " needs a parameter and its values");
+        ok = false;
+        continue;
+      }
+      if (!boost::filesystem::exists(base)) {
+        logERROR("Layout file " + base + " does not exist");
+        ok = false;
+        continue;
+      }
+      // Variants are named after the base layout, the swept property and its value
+      std::string property = split<std::string>(parameter, "/").back();
+      property = property.substr(0, property.find(':'));
+      for (const auto& value : values) {
+        BatchLayout layout;
+        layout.geometryFile = base;
+        layout.name = uniqueName(boost::filesystem::path(base).stem().string() + "_" + property + "_" + trim(value));
+        layout.overrides.push_back(std::make_pair(parameter, trim(value)));
+        layouts_.push_back(layout);
+      }
+    } else {
+      logWARNING("Ignoring unknown entry " + entry.first + " in the batch description " + fileName);
+    }
+  }
+  return ok;
+}
+
+std::string BatchScan::figuresFileName(const BatchLayout& layout) const {
+  return outputDirectory_ + "/" + layout.name + ".figures";
+}
+
+/**
+ * Load the inputs which do not depend on the layout, so that the processes analyzing the layouts share them
+ */
+void BatchScan::preloadSharedInputs() const {
+  mainConfigHandler& mainConfiguration = mainConfigHandler::instance();
+  mainConfiguration.getConfiguration();
+  mainConfiguration.getMomenta();
+  material::MaterialTab::instance();
+}
+
+/**
+ * Analyze a layout and write its key figures, as tab-separated value and name lines
+ * @return True if there were no errors during processing, false otherwise
+ */
+bool BatchScan::analyzeLayout(const BatchLayout& layout) const {
+  insur::Squid squid;
+  squid.setGeometryFile(layout.geometryFile);
+  squid.setConfigurationOverrides(layout.overrides);
+  squid.setConfigCache(configCacheDirectory_, configCacheCheck_);
+  if (webSites_) squid.setHtmlDir(layout.name);
+
+  if (!squid.buildTracker()) return false;
+  if (!squid.pureAnalyzeGeometry(geometryTracks_)) return false;
+  bool material = squid.buildMaterials() && squid.createMaterialBudget() && squid.pureAnalyzeMaterialBudget(materialTracks_, true, false, false);
+
+  std::vector<std::pair<std::string, double> > figures;
+  if (!squid.computeKeyFigures(etaValues_, pt_, trackingTag_, figures)) return false;
+  std::ofstream figuresFile(figuresFileName(layout));
+  for (const auto& figure : figures) figuresFile << std::setprecision(8) << figure.second << "\t" << figure.first << std::endl;
+  figuresFile.close();
+  if (!figuresFile) {
+    logERROR("Cannot write " + figuresFileName(layout));
+    return false;
+  }
+
+  if (webSites_) {
+    if (!squid.reportGeometrySite(false) || !squid.reportPowerSite()) return false;
+    if (material && (!squid.reportMaterialBudgetSite(false) || !squid.reportResolutionSite())) return false;
+    if (!squid.additionalInfoSite() || !squid.makeSite()) return false;
+  }
+  return material;
+}
+
+/**
+ * Analyze all the layouts, each one in a child process, and write the comparison table
+ * @return True if all the layouts were analyzed successfully
+ */
+bool BatchScan::run() {
+  boost::system::error_code error;
+  boost::filesystem::create_directories(outputDirectory_, error);
+  if (error) {
+    logERROR("Cannot create the output directory " + outputDirectory_);
+    return false;
+  }
+  preloadSharedInputs();
+
+  std::map<pid_t, const BatchLayout*> running;
+  bool result = true;
+  auto waitForLayout = [&]() {
+    int status;
+    pid_t pid = wait(&status);
+    if (pid <= 0) {
+      logERROR("Lost track of the layout analysis processes");
+      running.clear();
+      result = false;
+      return;
+    }
+    const BatchLayout* layout = running[pid];
+    running.erase(pid);
+    bool done = WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+    std::cout << (done ? "Analyzed " : "FAILED ") << layout->name << " (log in " << outputDirectory_ << "/" << layout->name << ".log)" << std::endl;
+    result &= done;
+  };
+
+  for (const auto& layout : layouts_) {
+    while ((int)running.size() >= jobs_) waitForLayout();
+    remove(figuresFileName(layout).c_str());
+
+    // Flush the streams, so that the children don't write out the buffered output once more
+    std::cout << std::flush; std::cerr << std::flush;
+    pid_t pid = fork();
+    if (pid == 0) {
+      std::string logFileName = outputDirectory_ + "/" + layout.name + ".log";
+      if (!freopen(logFileName.c_str(), "w", stdout) || !freopen(logFileName.c_str(), "a", stderr)) _exit(EXIT_FAILURE);
+      bool done = analyzeLayout(layout);
+      std::cout << std::flush; std::cerr << std::flush;
+      _exit(done ? EXIT_SUCCESS : EXIT_FAILURE); // Skip the exit handlers of the parent (ROOT, open files)
+    } else if (pid > 0) {
+      running[pid] = &layout;
+      std::cout << "Analyzing " << layout.name << std::endl;
+    } else {
+      logERROR("Couldn't fork the analysis of " + layout.name);
+      result = false;
+    }
+  }
+  while (!running.empty()) waitForLayout();
+
+  return writeComparisonTable() && result;
+}
+
+/**
+ * Collect the key figures of the layouts in a CSV table, with a row per layout and a column per figure,
+ * and print it. Figures missing for a layout are left empty.
+ */
+bool BatchScan::writeComparisonTable() const {
+  std::vector<std::string> columns;
+  std::vector<std::map<std::string, std::string> > rows;
+  for (const auto& layout : layouts_) {
+    rows.push_back(std::map<std::string, std::string>());
+    std::ifstream figuresFile(figuresFileName(layout));
+    std::string line;
+    while (std::getline(figuresFile, line)) {
+      std::size_t separator = line.find('\t');
+      if (separator == std::string::npos) continue;
+      std::string name = line.substr(separator + 1);
+      if (std::find(columns.begin(), columns.end(), name) == columns.end()) columns.push_back(name);
+      rows.back()[name] = line.substr(0, separator);
+    }
+  }
+
+  std::string tableFileName = outputDirectory_ + "/comparison.csv";
+  std::ofstream table(tableFileName);
+  table << "layout";
+  for (const auto& column : columns) table << ",\"" << column << "\"";
+  table << std::endl;
+  for (unsigned int i = 0; i < layouts_.size(); i++) {
+    table << layouts_[i].name;
+    for (const auto& column : columns) table << "," << (rows[i].count(column) ? rows[i].at(column) : "");
+    table << std::endl;
+  }
+  table.close();
+  if (!table) {
+    logERROR("Cannot write the comparison table " + tableFileName);
+    return false;
+  }
+
+  // One line per figure, one column per layout
+  std::size_t width = 12;
+  for (const auto& column : columns) width = std::max(width, column.size());
+  std::cout << std::endl << std::left << std::setw(width) << "";
+  for (const auto& layout : layouts_) std::cout << "  " << layout.name;
+  std::cout << std::endl;
+  for (const auto& column : columns) {
+    std::cout << std::setw(width) << column;
+    for (unsigned int i = 0; i < layouts_.size(); i++) {
+      std::cout << "  " << std::setw(layouts_[i].name.size()) << (rows[i].count(column) ? rows[i].at(column) : "-");
+    }
+    std::cout << std::endl;
+  }
+  std::cout << std::right << std::endl << "Comparison table written to " << tableFileName << std::endl;
+  return true;
+}
@@ -0,0 +1,289 @@
+/**
+ * @file Benchmark.cc
+ * @brief Timing and memory benchmark of the main computing stages, with a comparison against a stored baseline
+ */
+
+#include "Benchmark.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include "Squid.hh"
+#include "StopWatch.hh"
+#include "SvnRevision.hh"
+#include "MessageLogger.hh"
+#include "global_constants.hh"
+#include "global_funcs.hh"
+
+namespace {
+
+  double processCpuSeconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec)*1e-6;
+  }
+
+  long processPeakRssKb() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+  }
+
+  std::string jsonString(const std::string& text) {
+    std::string result = "\"";
+    for (char c : text) {
+      if (c == '"' || c == '\\') result += '\\';
+      result += c;
+    }
+    return result + "\"";
+  }
+}
+
+Benchmark::Benchmark() :
+  repetitions_(1),
+  geometryTracks_(100),
+  materialTracks_(100),
+  outputDirectory_("benchmark"),
+  tolerance_(0.2),
+  minSeconds_(0.5) {}
+
+bool Benchmark::addGeometry(const std::string& geometryFile) {
+  if (!boost::filesystem::exists(geometryFile)) {
+    logERROR("Geometry file " + geometryFile + " does not exist");
+    return false;
+  }
+  BenchmarkGeometry geometry;
+  geometry.geometryFile = geometryFile;
+  geometry.name = boost::filesystem::path(geometryFile).stem().string();
+  for (int i = 2; std::any_of(geometries_.begin(), geometries_.end(), [&](const BenchmarkGeometry& g) { return g.name == geometry.name; }); i++) {
+    geometry.name = boost::filesystem::path(geometryFile).stem().string() + "_" + any2str(i);
+  }
+  geometry.completed = false;
+  geometries_.push_back(geometry);
+  return true;
+}
+
+std::string Benchmark::stagesFileName(const BenchmarkGeometry& geometry) const {
+  return outputDirectory_ + "/" + geometry.name + ".stages";
+}
+
+/**
+ * Run all the stages on a geometry and write what they used, as tab-separated name, wall-clock time, CPU time
+ * and peak memory lines. The stages run so far are written even if a stage fails.
+ * @return True if all the stages succeeded
+ */
+bool Benchmark::measureGeometry(const BenchmarkGeometry& geometry) const {
+  StopWatch::instance()->setProfiling(true);
+  std::vector<BenchmarkStage> stages;
+
+  auto measure = [&](const std::string& name, const std::function<bool()>& step) {
+    std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+    double cpuStart = processCpuSeconds();
+    bool done = step();
+    stages.push_back(BenchmarkStage{name, std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count(),
+                                    processCpuSeconds() - cpuStart, processPeakRssKb()});
+    return done;
+  };
+  auto fromProfile = [&](const std::string& name, const std::string& scope) {
+    StopWatch::ScopeTotals totals = StopWatch::instance()->scopeTotals(scope);
+    if (totals.calls > 0) stages.push_back(BenchmarkStage{name, totals.wallSeconds, totals.cpuSeconds, totals.processPeakRssKb});
+  };
+
+  insur::Squid squid;
+  squid.setGeometryFile(geometry.geometryFile);
+  squid.setHtmlDir(geometry.name + "_benchmark");
+  bool outerCabling = geometry.name.find(insur::default_cabledOTName) != std::string::npos;
+  bool innerCabling = geometry.name.find(insur::default_cabledITName) != std::string::npos;
+
+  bool done = squid.buildTracker();
+  fromProfile("config parse", "Parsing the configuration");
+  fromProfile("Tracker::build", "Building the tracker geometry");
+  if (done && outerCabling) done = measure("outer cabling map", [&]() { return squid.buildOuterCablingMap(false); });
+  if (done && innerCabling) done = measure("inner cabling map", [&]() { return squid.buildInnerCablingMap(false); });
+  if (done) done = measure("geometry analysis", [&]() { return squid.pureAnalyzeGeometry(geometryTracks_); });
+  if (done) done = measure("Materialway::build", [&]() { return squid.buildMaterials(); });
+  if (done) done = measure("material budget", [&]() { return squid.createMaterialBudget(); });
+  if (done) {
+    done = squid.pureAnalyzeMaterialBudget(materialTracks_, true, true, false);
+    fromProfile("analyzeMaterialBudget", "Analyzing material budget");
+    fromProfile("analyzeTaggedTracking", "Estimating tracking resolutions");
+    fromProfile("analyzePatterReco", "Estimating pattern recognition");
+  }
+  if (done) done = measure("Vizard site generation", [&]() {
+      bool ok = squid.reportMaterialBudgetSite(false) && squid.reportResolutionSite() && squid.reportPatternRecoSite();
+      if (ok && outerCabling) ok = squid.reportOuterCablingMapSite(false, geometry.name);
+      if (ok && innerCabling) ok = squid.reportInnerCablingMapSite(false, geometry.name);
+      return ok && squid.reportGeometrySite(false) && squid.additionalInfoSite() && squid.makeSite();
+    });
+
+  std::ofstream stagesFile(stagesFileName(geometry));
+  for (const auto& stage : stages) {
+    stagesFile << stage.name << "\t" << std::setprecision(8) << stage.wallSeconds << "\t" << stage.cpuSeconds << "\t" << stage.peakRssKb << std::endl;
+  }
+  stagesFile.close();
+  if (!stagesFile) {
+    logERROR("Cannot write " + stagesFileName(geometry));
+    return false;
+  }
+  return done;
+}
+
+/**
+ * Read the stages written by measureGeometry, keeping for each stage the minimum over the repetitions
+ */
+bool Benchmark::readStages(BenchmarkGeometry& geometry) const {
+  std::ifstream stagesFile(stagesFileName(geometry));
+  if (!stagesFile) return false;
+  std::string line;
+  while (std::getline(stagesFile, line)) {
+    std::vector<std::string> fields = split<std::string>(line, "\t");
+    if (fields.size() != 4) continue;
+    BenchmarkStage stage{fields[0], str2any<double>(fields[1]), str2any<double>(fields[2]), str2any<long>(fields[3])};
+    auto known = std::find_if(geometry.stages.begin(), geometry.stages.end(), [&](const BenchmarkStage& s) { return s.name == stage.name; });
+    if (known == geometry.stages.end()) geometry.stages.push_back(stage);
+    else {
+      known->wallSeconds = std::min(known->wallSeconds, stage.wallSeconds);
+      known->cpuSeconds  = std::min(known->cpuSeconds, stage.cpuSeconds);
+      known->peakRssKb   = std::min(known->peakRssKb, stage.peakRssKb);
+    }
+  }
+  return true;
+}
+
+/**
+ * Benchmark all the geometries, one process at a time so that they do not compete for the CPU, and write the results
+ * @return True if all the stages of all the geometries succeeded
+ */
+bool Benchmark::run() {
+  boost::system::error_code error;
+  boost::filesystem::create_directories(outputDirectory_, error);
+  if (error) {
+    logERROR("Cannot create the output directory " + outputDirectory_);
+    return false;
+  }
+
+  bool result = true;
+  for (auto& geometry : geometries_) {
+    geometry.completed = true;
+    geometry.stages.clear();
+    for (int repetition = 0; repetition < repetitions_; repetition++) {
+      remove(stagesFileName(geometry).c_str());
+      std::cout << "Benchmarking " << geometry.name << (repetitions_ > 1 ? " (" + any2str(repetition + 1) + "/" + any2str(repetitions_) + ")" : "") << std::endl;
+
+      // Flush the streams, so that the child doesn't write out the buffered output once more
+      std::cout << std::flush; std::cerr << std::flush;
+      pid_t pid = fork();
+      if (pid == 0) {
+        std::string logFileName = outputDirectory_ + "/" + geometry.name + ".log";
+        if (!freopen(logFileName.c_str(), "w", stdout) || !freopen(logFileName.c_str(), "a", stderr)) _exit(EXIT_FAILURE);
+        bool done = measureGeometry(geometry);
+        std::cout << std::flush; std::cerr << std::flush;
+        _exit(done ? EXIT_SUCCESS : EXIT_FAILURE); // Skip the exit handlers of the parent (ROOT, open files)
+      } else if (pid < 0) {
+        logERROR("Couldn't fork the benchmark of " + geometry.name);
+        geometry.completed = false;
+        break;
+      }
+
+      int status;
+      bool done = waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+      if (!readStages(geometry) || !done) {
+        std::cout << "FAILED " << geometry.name << " (log in " << outputDirectory_ << "/" << geometry.name << ".log)" << std::endl;
+        geometry.completed = false;
+        break;
+      }
+    }
+    result &= geometry.completed;
+  }
+
+  return writeResults() && result;
+}
+
+bool Benchmark::writeResults() const {
+  std::ofstream results(resultsFileName());
+  results << std::setprecision(6);
+  results << "{\"revision\": " << jsonString(SvnRevision::revisionNumber) << ", \"repetitions\": " << repetitions_
+          << ", \"geometry_tracks\": " << geometryTracks_ << ", \"material_tracks\": " << materialTracks_ << ", \"geometries\": [";
+  for (unsigned int i = 0; i < geometries_.size(); i++) {
+    const BenchmarkGeometry& geometry = geometries_[i];
+    results << (i ? ",\n" : "\n") << "  {\"name\": " << jsonString(geometry.name) << ", \"file\": " << jsonString(geometry.geometryFile)
+            << ", \"completed\": " << (geometry.completed ? "true" : "false") << ", \"stages\": [";
+    for (unsigned int j = 0; j < geometry.stages.size(); j++) {
+      const BenchmarkStage& stage = geometry.stages[j];
+      results << (j ? ",\n" : "\n") << "    {\"name\": " << jsonString(stage.name) << ", \"wall_s\": " << stage.wallSeconds
+              << ", \"cpu_s\": " << stage.cpuSeconds << ", \"peak_rss_kb\": " << stage.peakRssKb << "}";
+    }
+    results << (geometry.stages.empty() ? "" : "\n  ") << "]}";
+  }
+  results << "\n]}" << std::endl;
+  results.close();
+  if (!results) {
+    logERROR("Cannot write the benchmark results " + resultsFileName());
+    return false;
+  }
+  std::cout << "Benchmark results written to " << resultsFileName() << std::endl;
+  return true;
+}
+
+/**
+ * Compare the results of the last run with a baseline written by a previous run, and print the comparison table.
+ * The geometries and stages missing on either side are not compared.
+ * @return True if no stage regressed in time or memory
+ */
+bool Benchmark::compare(const std::string& baselineFileName) const {
+  using namespace boost::property_tree;
+  ptree baseline;
+  try {
+    json_parser::read_json(baselineFileName, baseline);
+  } catch (json_parser::json_parser_error& e) {
+    logERROR("Cannot read the benchmark baseline " + baselineFileName + ": " + e.what());
+    return false;
+  }
+
+  std::map<std::pair<std::string, std::string>, BenchmarkStage> baselineStages;
+  for (const auto& geometry : baseline.get_child("geometries", ptree())) {
+    for (const auto& stage : geometry.second.get_child("stages", ptree())) {
+      BenchmarkStage s{stage.second.get<std::string>("name", ""), stage.second.get<double>("wall_s", 0), stage.second.get<double>("cpu_s", 0), stage.second.get<long>("peak_rss_kb", 0)};
+      baselineStages[std::make_pair(geometry.second.get<std::string>("name", ""), s.name)] = s;
+    }
+  }
+
+  int regressions = 0;
+  std::cout << std::endl << "Comparison with " << baselineFileName << " (tolerance " << tolerance_*100 << "%, stages shorter than " << minSeconds_ << " s not timed)" << std::endl;
+  std::cout << std::left << std::setw(24) << "geometry" << std::setw(24) << "stage" << std::right
+            << std::setw(12) << "base [s]" << std::setw(12) << "now [s]" << std::setw(14) << "base [MB]" << std::setw(12) << "now [MB]" << std::endl;
+  for (const auto& geometry : geometries_) {
+    for (const auto& stage : geometry.stages) {
+      auto base = baselineStages.find(std::make_pair(geometry.name, stage.name));
+      if (base == baselineStages.end()) continue;
+      bool slower = std::max(base->second.wallSeconds, stage.wallSeconds) >= minSeconds_ && stage.wallSeconds > base->second.wallSeconds*(1 + tolerance_);
+      bool larger = stage.peakRssKb > base->second.peakRssKb*(1 + tolerance_);
+      std::cout << std::left << std::setw(24) << geometry.name << std::setw(24) << stage.name << std::right << std::fixed << std::setprecision(2)
+                << std::setw(12) << base->second.wallSeconds << std::setw(12) << stage.wallSeconds
+                << std::setw(14) << base->second.peakRssKb/1024. << std::setw(12) << stage.peakRssKb/1024.
+                << (slower ? "  SLOWER" : "") << (larger ? "  LARGER" : "") << std::endl;
+      std::cout.unsetf(std::ios_base::floatfield);
+      if (slower || larger) regressions++;
+    }
+  }
+
+  if (regressions > 0) {
+    logERROR(any2str(regressions) + " benchmark stage(s) regressed with respect to " + baselineFileName);
+    return false;
+  }
+  std::cout << "No regression with respect to " << baselineFileName << std::endl;
+  return true;
+}
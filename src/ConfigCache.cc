@@ -0,0 +1,369 @@
+/**
+ * @file ConfigCache.cc
+ * @brief Cache of the preprocessed and parsed geometry configuration
+ */
+
+#include "ConfigCache.hh"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <boost/filesystem.hpp>
+
+#include "Tracker.hh"
+
+namespace {
+  const char cacheMagic[8] = {'T', 'K', 'C', 'F', 'G', 'C', 'C', 'H'};
+  const uint32_t cacheVersion = 1;
+  const char modulesMagic[8] = {'T', 'K', 'C', 'F', 'G', 'M', 'O', 'D'};
+  const uint32_t modulesVersion = 1;
+
+  // Module corners are compared with a tolerance well below any geometry feature (mm)
+  const double vertexTolerance = 1e-9;
+
+  uint64_t fnv1a(const std::string& data, uint64_t hash = 14695981039346656037ULL) {
+    for (unsigned char c : data) {
+      hash ^= c;
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  // Size, modification time and content hash of a file of the include tree
+  struct FileStamp {
+    int64_t size, modificationTime;
+    uint64_t contentHash;
+  };
+
+  bool statFile(const std::string& fileName, FileStamp& stamp) {
+    struct stat fileStat;
+    if (stat(fileName.c_str(), &fileStat) != 0) return false;
+    stamp.size = fileStat.st_size;
+    stamp.modificationTime = fileStat.st_mtime;
+    return true;
+  }
+
+  bool hashFile(const std::string& fileName, uint64_t& contentHash) {
+    std::ifstream ifs(fileName, std::ios::binary);
+    if (!ifs) return false;
+    std::ostringstream content;
+    content << ifs.rdbuf();
+    contentHash = fnv1a(content.str());
+    return true;
+  }
+
+  //
+  // Binary encoding: fixed-size values are written as they are in memory
+  //
+  template<class T> void write(std::ostream& os, const T& value) { os.write(reinterpret_cast<const char*>(&value), sizeof(T)); }
+  template<class T> bool read(std::istream& is, T& value) { return bool(is.read(reinterpret_cast<char*>(&value), sizeof(T))); }
+
+  // Bytes between the read position and the end of a seekable stream
+  bool remainingBytes(std::istream& is, uint64_t& remaining) {
+    std::streampos position = is.tellg();
+    if (position < 0 || !is.seekg(0, std::ios::end)) return false;
+    std::streampos end = is.tellg();
+    if (end < position || !is.seekg(position)) return false;
+    remaining = uint64_t(end - position);
+    return true;
+  }
+
+  // Strings up to this size are read without checking the stream length first, which would cost two seeks each
+  const uint64_t uncheckedStringSize = 4096;
+
+  // Resolved state of a built module
+  struct ModuleRecord {
+    uint32_t detId;
+    std::string subdetectorName;
+    double vertices[4][3];
+  };
+
+  // Modules of a tracker, in the order of the geometry hierarchy
+  std::vector<ModuleRecord> recordModules(const Tracker& tracker) {
+    class ModuleRecorder : public ConstGeometryVisitor {
+    public:
+      ModuleRecorder(std::vector<ModuleRecord>& modules) : modules_(modules) {}
+      void visit(const DetectorModule& m) override {
+        ModuleRecord record;
+        record.detId = m.myDetId();
+        record.subdetectorName = m.subdetectorName();
+        for (int i = 0; i < 4; i++) {
+          const XYZVector& vertex = m.basePoly().getVertex(i);
+          record.vertices[i][0] = vertex.X();
+          record.vertices[i][1] = vertex.Y();
+          record.vertices[i][2] = vertex.Z();
+        }
+        modules_.push_back(record);
+      }
+    private:
+      std::vector<ModuleRecord>& modules_;
+    };
+
+    std::vector<ModuleRecord> modules;
+    ModuleRecorder recorder(modules);
+    tracker.accept(recorder);
+    return modules;
+  }
+
+  bool sameModule(const ModuleRecord& a, const ModuleRecord& b) {
+    bool same = a.detId == b.detId && a.subdetectorName == b.subdetectorName;
+    for (int v = 0; v < 4 && same; v++) {
+      for (int c = 0; c < 3 && same; c++) same = fabs(a.vertices[v][c] - b.vertices[v][c]) < vertexTolerance;
+    }
+    return same;
+  }
+}
+
+//
+// Strings and trees are written with their size first
+//
+void ConfigCache::writeString(std::ostream& os, const std::string& value) {
+  write<uint64_t>(os, value.size());
+  os.write(value.data(), value.size());
+}
+
+bool ConfigCache::readString(std::istream& is, std::string& value) {
+  uint64_t size;
+  if (!read(is, size)) return false;
+  // a size read from a truncated or corrupt file must not be allocated: the cache is then just missed
+  uint64_t remaining;
+  if (size > uncheckedStringSize && (!remainingBytes(is, remaining) || size > remaining)) return false;
+  value.resize(size);
+  return size == 0 || bool(is.read(&value[0], size));
+}
+
+void ConfigCache::writeTree(std::ostream& os, const boost::property_tree::ptree& pt) {
+  writeString(os, pt.data());
+  write<uint64_t>(os, pt.size());
+  for (const auto& child : pt) {
+    writeString(os, child.first);
+    writeTree(os, child.second);
+  }
+}
+
+bool ConfigCache::readTree(std::istream& is, boost::property_tree::ptree& pt) {
+  uint64_t children;
+  if (!readString(is, pt.data()) || !read(is, children)) return false;
+  for (uint64_t i = 0; i < children; i++) {
+    std::string key;
+    if (!readString(is, key)) return false;
+    // push_back keeps the order and the repeated keys of the configuration
+    boost::property_tree::ptree& child = pt.push_back(std::make_pair(key, boost::property_tree::ptree()))->second;
+    if (!readTree(is, child)) return false;
+  }
+  return true;
+}
+
+/**
+ * The cache file of a geometry is named after the hash of its canonical path and of the standard include
+ * directory, which together determine how the include tree is expanded
+ */
+std::string ConfigCache::cacheFileName(const std::string& geometryFile) const {
+  std::string canonicalName = boost::filesystem::canonical(geometryFile).string();
+  uint64_t key = fnv1a(mainConfigHandler::instance().getStandardIncludeDirectory(), fnv1a(canonicalName + '\0'));
+  std::ostringstream fileName;
+  fileName << directory_ << "/" << boost::filesystem::path(geometryFile).stem().string()
+           << "_" << std::hex << std::setw(16) << std::setfill('0') << key << ".cfgcache";
+  return fileName.str();
+}
+
+/**
+ * Load the expanded configuration and its property tree, if the cache entry of the geometry file is still valid
+ * @return True if loaded from the cache, false if the configuration has to be preprocessed and parsed
+ */
+bool ConfigCache::load(const std::string& geometryFile, std::string& expandedConfiguration, boost::property_tree::ptree& pt, ConfigIncludeTree& includeTree) const {
+  if (!enabled() || check_ == INVALIDATE) return false;
+
+  std::string fileName = cacheFileName(geometryFile);
+  std::ifstream ifs(fileName, std::ios::binary);
+  if (!ifs) return false;
+
+  char magic[sizeof(cacheMagic)];
+  uint32_t version;
+  uint64_t nFiles;
+  if (!ifs.read(magic, sizeof(magic)) || !read(ifs, version) || !read(ifs, nFiles)
+      || !std::equal(magic, magic + sizeof(magic), cacheMagic) || version != cacheVersion) {
+    logINFO("Ignoring configuration cache " + fileName + ": unknown format");
+    return false;
+  }
+
+  includeTree.files.clear();
+  for (uint64_t i = 0; i < nFiles; i++) {
+    ConfigFileRecord record;
+    uint8_t standardInclude;
+    int32_t parent;
+    FileStamp cached, current;
+    if (!readString(ifs, record.absoluteFileName) || !readString(ifs, record.relativeFileName)
+        || !read(ifs, standardInclude) || !read(ifs, parent)
+        || !read(ifs, cached.size) || !read(ifs, cached.modificationTime) || !read(ifs, cached.contentHash)) {
+      logINFO("Ignoring configuration cache " + fileName + ": truncated");
+      return false;
+    }
+    record.standardInclude = standardInclude;
+    record.parent = parent;
+
+    // Any change of the include tree invalidates the entry
+    if (!statFile(record.absoluteFileName, current) || current.size != cached.size
+        || (check_ == MTIME && current.modificationTime != cached.modificationTime)) {
+      logINFO("Configuration cache " + fileName + " is out of date: " + record.absoluteFileName + " changed");
+      return false;
+    }
+    if (check_ == VERIFY && (!hashFile(record.absoluteFileName, current.contentHash) || current.contentHash != cached.contentHash)) {
+      logINFO("Configuration cache " + fileName + " failed verification: " + record.absoluteFileName + " changed");
+      return false;
+    }
+    includeTree.files.push_back(record);
+  }
+
+  pt.clear();
+  if (!readString(ifs, expandedConfiguration) || !readTree(ifs, pt)) {
+    logINFO("Ignoring configuration cache " + fileName + ": truncated");
+    return false;
+  }
+  includeTree.complete = true;
+  logINFO("Configuration loaded from cache " + fileName);
+  return true;
+}
+
+/**
+ * Store the expanded configuration and its property tree. Configurations with missing included files are not cached,
+ * so that the error is reported again by the next run.
+ */
+void ConfigCache::save(const std::string& geometryFile, const std::string& expandedConfiguration, const boost::property_tree::ptree& pt, const ConfigIncludeTree& includeTree) const {
+  if (!enabled() || !includeTree.complete) return;
+
+  boost::system::error_code error;
+  boost::filesystem::create_directories(directory_, error);
+
+  std::string fileName = cacheFileName(geometryFile);
+  std::string temporaryFileName = fileName + ".tmp" + std::to_string(getpid());
+  std::ofstream ofs(temporaryFileName, std::ios::binary);
+  if (!ofs) {
+    logWARNING("Cannot write the configuration cache " + fileName);
+    return;
+  }
+
+  ofs.write(cacheMagic, sizeof(cacheMagic));
+  write(ofs, cacheVersion);
+  write<uint64_t>(ofs, includeTree.files.size());
+  for (const auto& record : includeTree.files) {
+    FileStamp stamp;
+    if (!statFile(record.absoluteFileName, stamp) || !hashFile(record.absoluteFileName, stamp.contentHash)) {
+      ofs.close();
+      remove(temporaryFileName.c_str());
+      return;
+    }
+    writeString(ofs, record.absoluteFileName);
+    writeString(ofs, record.relativeFileName);
+    write<uint8_t>(ofs, record.standardInclude);
+    write<int32_t>(ofs, record.parent);
+    write(ofs, stamp.size);
+    write(ofs, stamp.modificationTime);
+    write(ofs, stamp.contentHash);
+  }
+  writeString(ofs, expandedConfiguration);
+  writeTree(ofs, pt);
+  ofs.close();
+
+  // A concurrent run never reads a half-written cache
+  if (!ofs || rename(temporaryFileName.c_str(), fileName.c_str()) != 0) {
+    logWARNING("Cannot write the configuration cache " + fileName);
+    remove(temporaryFileName.c_str());
+  }
+}
+
+/**
+ * Compare the modules built from a cached configuration with those recorded when the entry was used last
+ * @return True if every tracker has the same modules, with the same DetId, subdetector and corner positions;
+ * false if the record is missing or differs, which is then logged
+ */
+bool ConfigCache::checkModules(const std::string& geometryFile, const std::vector<const Tracker*>& trackers) const {
+  if (!enabled()) return false;
+
+  std::string fileName = cacheFileName(geometryFile) + ".modules";
+  std::ifstream ifs(fileName, std::ios::binary);
+  if (!ifs) return false;
+
+  char magic[sizeof(modulesMagic)];
+  uint32_t version;
+  uint64_t nTrackers;
+  if (!ifs.read(magic, sizeof(magic)) || !read(ifs, version) || !read(ifs, nTrackers)
+      || !std::equal(magic, magic + sizeof(magic), modulesMagic) || version != modulesVersion || nTrackers != trackers.size()) {
+    logINFO("Ignoring the module record " + fileName + ": unknown format or other trackers");
+    return false;
+  }
+
+  for (const Tracker* tracker : trackers) {
+    std::string id;
+    uint64_t nModules;
+    if (!readString(ifs, id) || !read(ifs, nModules) || id != tracker->myid()) {
+      logINFO("Ignoring the module record " + fileName + ": truncated or other trackers");
+      return false;
+    }
+    std::vector<ModuleRecord> current = recordModules(*tracker);
+    if (nModules != current.size()) {
+      logWARNING("Tracker " + tracker->myid() + " built from the cached configuration has " + any2str(current.size())
+                 + " modules, " + any2str(nModules) + " when the configuration was cached: the geometry code changed since");
+      return false;
+    }
+    int mismatches = 0;
+    for (const ModuleRecord& module : current) {
+      ModuleRecord recorded;
+      if (!read(ifs, recorded.detId) || !readString(ifs, recorded.subdetectorName) || !read(ifs, recorded.vertices)) {
+        logINFO("Ignoring the module record " + fileName + ": truncated");
+        return false;
+      }
+      if (!sameModule(module, recorded) && mismatches++ == 0) {
+        logWARNING("Module DetId " + any2str(module.detId) + " of tracker " + tracker->myid()
+                   + " differs from the one built when the configuration was cached");
+      }
+    }
+    if (mismatches > 0) {
+      logWARNING(any2str(mismatches) + " modules of tracker " + tracker->myid()
+                 + " built from the cached configuration differ from the recorded ones: the geometry code changed since");
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Record the modules built from the configuration of a geometry file, for the next runs reusing its cache entry
+ */
+void ConfigCache::saveModules(const std::string& geometryFile, const std::vector<const Tracker*>& trackers) const {
+  if (!enabled()) return;
+
+  boost::system::error_code error;
+  boost::filesystem::create_directories(directory_, error);
+
+  std::string fileName = cacheFileName(geometryFile) + ".modules";
+  std::string temporaryFileName = fileName + ".tmp" + std::to_string(getpid());
+  std::ofstream ofs(temporaryFileName, std::ios::binary);
+  if (!ofs) {
+    logWARNING("Cannot write the module record " + fileName);
+    return;
+  }
+
+  ofs.write(modulesMagic, sizeof(modulesMagic));
+  write(ofs, modulesVersion);
+  write<uint64_t>(ofs, trackers.size());
+  for (const Tracker* tracker : trackers) {
+    std::vector<ModuleRecord> modules = recordModules(*tracker);
+    writeString(ofs, tracker->myid());
+    write<uint64_t>(ofs, modules.size());
+    for (const ModuleRecord& module : modules) {
+      write(ofs, module.detId);
+      writeString(ofs, module.subdetectorName);
+      write(ofs, module.vertices);
+    }
+  }
+  ofs.close();
+
+  if (!ofs || rename(temporaryFileName.c_str(), fileName.c_str()) != 0) {
+    logWARNING("Cannot write the module record " + fileName);
+    remove(temporaryFileName.c_str());
+  }
+}
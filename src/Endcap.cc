@@ -1,6 +1,7 @@
 #include "Endcap.hh"
 #include "MessageLogger.hh"
 #include "SupportStructure.hh"
+#include "ParallelBuild.hh"
 
 using material::SupportStructure;
 
@@ -52,8 +53,12 @@ void Endcap::build() {
 
     double alpha = pow(outerZ()/innerZ(), 1/double(numDisks()-1)); // geometric progression factor
 
+    // The disks are independent once their properties are stored: they are built in parallel, then kept in order
+    vector<std::unique_ptr<Disk> > positiveDisks(numDisks()), negativeDisks(numDisks());
+    vector<std::function<void()> > builds;
     for (int i = 1; i <= numDisks(); i++) {
       Disk* diskp = GeometryFactory::make<Disk>();
+      positiveDisks[i-1].reset(diskp);
       diskp->myid(i);
 
       // Standard is to build & calculate parameters for the central disc (in the middle)
@@ -70,20 +75,26 @@ void Endcap::build() {
       // To test the extreme cases -> one needs to test either first or last layer (based on parity)
       diskp->zHalfLength((outerZ()-innerZ())/2.);
 
-      // Build
-      diskp->build(extremaDisksInfo);
-
-      // Disk on (+Z) side is duplicated to (-Z) side.
-      // Please note that the duplication is a rotation of axis CMS_Y and angle Pi !
-      // This is because one does not want to build different disks for both sides, so no 'mirror' should be considered!
-      Disk* diskn = GeometryFactory::clone(*diskp);
-      diskn->rotateToNegativeZSide();
-
-      // Compute coverage on +Z side after built (TO DO : adapt for -Z side, and add a Tracker::computeActualCoverage(), completely independant from build() )
-      diskp->computeActualCoverage();
-
-      tdisks.push_back(diskp);
-      tdisks.push_back(diskn);
+      std::unique_ptr<Disk>& negativeDisk = negativeDisks[i-1];
+      builds.push_back([diskp, &negativeDisk, &extremaDisksInfo]() {
+        // Build
+        diskp->build(extremaDisksInfo);
+
+        // Disk on (+Z) side is duplicated to (-Z) side.
+        // Please note that the duplication is a rotation of axis CMS_Y and angle Pi !
+        // This is because one does not want to build different disks for both sides, so no 'mirror' should be considered!
+        Disk* diskn = GeometryFactory::clone(*diskp);
+        negativeDisk.reset(diskn);
+        diskn->rotateToNegativeZSide();
+
+        // Compute coverage on +Z side after built (TO DO : adapt for -Z side, and add a Tracker::computeActualCoverage(), completely independant from build() )
+        diskp->computeActualCoverage();
+      });
+    }
+    ParallelBuild::run(builds);
+    for (int i = 0; i < numDisks(); i++) {
+      tdisks.push_back(positiveDisks[i].release());
+      tdisks.push_back(negativeDisks[i].release());
     }
     std::stable_sort(tdisks.begin(), tdisks.end(), [](Disk* d1, Disk* d2) { return d1->minZ() < d2->maxZ(); });
     for (Disk* d : tdisks) disks_.push_back(d);
@@ -0,0 +1,202 @@
+#include "FrozenModules.hh"
+#include "ModuleCap.hh"
+#include <algorithm>
+#include <cmath>
+
+void FrozenModules::clear() {
+  *this = FrozenModules();
+}
+
+void FrozenModules::addSensor(SensorPolys& polys, const Sensor& sensor) {
+  const Polygon3d<4>& poly = sensor.hitPoly();
+  for (int i = 0; i < 4; i++) {
+    polys.vertices.push_back(poly.getVertex(i).X());
+    polys.vertices.push_back(poly.getVertex(i).Y());
+    polys.vertices.push_back(poly.getVertex(i).Z());
+  }
+  const XYZVector& normal = poly.getNormal();
+  polys.normal.push_back(normal.X());
+  polys.normal.push_back(normal.Y());
+  polys.normal.push_back(normal.Z());
+  polys.centerDotNormal.push_back(poly.getCenter().Dot(normal));
+  polys.doubleArea.push_back(poly.getDoubleArea());
+  XYZVector axis = (poly.getVertex(1) - poly.getVertex(0)).Unit();
+  polys.axis.push_back(axis.X());
+  polys.axis.push_back(axis.Y());
+  polys.axis.push_back(axis.Z());
+  polys.stripLength.push_back(sensor.stripLength());
+  polys.quads.add(poly);
+}
+
+/**
+ * Copies the hot attributes of a collection of modules, which must not be modified anymore afterwards.
+ * @param modules The modules, in the order of the indices used to read their attributes
+ * @param zError The spread of the track origins along z assumed by couldHit()
+ */
+void FrozenModules::freeze(const std::vector<Module*>& modules, double zError) {
+  clear();
+  modules_ = modules;
+  for (const Module* m : modules_) {
+    centerX_.push_back(m->center().X());
+    centerY_.push_back(m->center().Y());
+    centerZ_.push_back(m->center().Z());
+    normalX_.push_back(m->normal().X());
+    normalY_.push_back(m->normal().Y());
+    normalZ_.push_back(m->normal().Z());
+    for (int i = 0; i < 4; i++) {
+      const XYZVector& corner = m->basePoly().getVertex(i);
+      corners_.push_back(corner.X());
+      corners_.push_back(corner.Y());
+      corners_.push_back(corner.Z());
+    }
+    thickness_.push_back(m->thickness());
+    resolutionLocalX_.push_back(m->nominalResolutionLocalX());
+    resolutionLocalY_.push_back(m->nominalResolutionLocalY());
+    subdet_.push_back(m->subdet());
+    UniRef ref = m->uniRef();
+    layer_.push_back(ref.layer);
+    ring_.push_back(ref.ring);
+    tiltAngle_.push_back(m->tiltAngle());
+    maxZ_.push_back(m->maxZ());
+    std::pair<double, double> minMaxEta = m->minMaxEtaWithError(zError);
+    minEta_.push_back(minMaxEta.first);
+    maxEta_.push_back(minMaxEta.second);
+    minPhi_.push_back(m->minPhi());
+    maxPhi_.push_back(m->maxPhi());
+    rectangular_.push_back(m->shape() == ModuleShape::RECTANGULAR);
+
+    numSensors_.push_back(m->numSensors() == 1 ? 1 : 2);
+    addSensor(inner_, m->innerSensor());
+    addSensor(outer_, m->outerSensor());
+    zCorrelation_.push_back(m->numSensors() != 1 && m->zCorrelation.state() ? int(m->zCorrelation()) : NoZCorrelation);
+    segmentsRatio_.push_back(m->numSensors() != 1 ? m->maxSegments() / m->minSegments() : 1);
+
+    uint64_t tags = 0;
+    for (const std::string& tag : m->trackingTags) {
+      auto found = std::find(trackingTagNames_.begin(), trackingTagNames_.end(), tag);
+      int bit = found - trackingTagNames_.begin();
+      if (found == trackingTagNames_.end()) trackingTagNames_.push_back(tag);
+      if (bit < 64) tags |= uint64_t(1) << bit;
+    }
+    trackingTags_.push_back(tags);
+  }
+  radiationLength_.assign(modules_.size(), 0.);
+  interactionLength_.assign(modules_.size(), 0.);
+}
+
+/**
+ * Copies the radiation and interaction lengths of the module caps, in the same order as the frozen modules
+ */
+void FrozenModules::freezeMaterials(std::vector<insur::ModuleCap>& caps) {
+  for (int i = 0; i < (int)caps.size() && i < size(); i++) {
+    radiationLength_[i] = caps[i].getRadiationLength();
+    interactionLength_[i] = caps[i].getInteractionLength();
+  }
+}
+
+bool FrozenModules::hasTrackingTag(int index, const std::string& tag) const {
+  auto found = std::find(trackingTagNames_.begin(), trackingTagNames_.end(), tag);
+  int bit = found - trackingTagNames_.begin();
+  if (found == trackingTagNames_.end()) return false;
+  if (bit >= 64) return std::count(modules_[index]->trackingTags.begin(), modules_[index]->trackingTags.end(), tag) > 0;
+  return trackingTags_[index] & (uint64_t(1) << bit);
+}
+
+bool FrozenModules::couldHit(int index, const XYZVector& direction) const {
+  if (!rectangular_[index]) return true; // wedge shaped modules are always tried, as in DetectorModule::couldHit
+  double eta = direction.Eta();
+  double phi = direction.Phi();
+  double shiftPhi = phi + 2*M_PI;
+  bool withinEta = eta > minEta_[index] && eta < maxEta_[index];
+  bool withinPhi = (phi >= minPhi_[index] && phi <= maxPhi_[index]) || (shiftPhi >= minPhi_[index] && shiftPhi <= maxPhi_[index]);
+  return withinEta && withinPhi;
+}
+
+/**
+ * Same test as Sensor::checkHitSegment, on the frozen hit polygon of the sensor
+ * @return The index of the hit segment, -1 if the sensor is not hit
+ */
+int FrozenModules::checkHitSegment(const SensorPolys& polys, int index, const XYZVector& trackOrig, const XYZVector& trackDir, XYZVector& p) {
+  const double* v = &polys.vertices[12*index];
+  if (RayIntersection::isClosedForm()) {
+    double t;
+    if (!RayIntersection::crossSensor(polys.quads, index, trackOrig, trackDir, t)) return -1;
+    p = trackOrig + t * trackDir;
+  } else {
+    const double* n = &polys.normal[3*index];
+    XYZVector normal(n[0], n[1], n[2]);
+    double normOrig = normal.Dot(trackOrig);
+    double normDir = normal.Dot(trackDir);
+    if (normDir < 1e-3) return -1;
+    p = trackOrig + (((polys.centerDotNormal[index] - normOrig)/normDir) * trackDir);
+
+    // point inside the polygon if the triangles it forms with the sides add up to the polygon area
+    double area = polys.doubleArea[index];
+    double sum = 0;
+    for (int i = 0; i < 4; i++) {
+      const double* v1 = v + 3*i;
+      const double* v2 = v + 3*((i+1) % 4);
+      sum += sqrt((XYZVector(v1[0], v1[1], v1[2]) - p).Cross(XYZVector(v2[0], v2[1], v2[2]) - p).Mag2());
+      if (sum - area > 1e-4) return -1;
+    }
+    if (fabs(area - sum) >= 1e-4) return -1;
+  }
+
+  const double* a = &polys.axis[3*index];
+  double projL = (p - XYZVector(v[0], v[1], v[2])).Dot(XYZVector(a[0], a[1], a[2]));
+  return projL / polys.stripLength[index];
+}
+
+std::pair<XYZVector, HitType> FrozenModules::checkTrackHits(int index, const XYZVector& trackOrig, const XYZVector& trackDir) const {
+  HitType ht = HitType::NONE;
+  XYZVector gc; // global coordinates of the hit
+  XYZVector inHit, outHit;
+  int inSegment = checkHitSegment(inner_, index, trackOrig, trackDir, inHit);
+  if (numSensors_[index] == 1) {
+    if (inSegment > -1) { gc = inHit; ht = HitType::INNER; }
+  } else {
+    int outSegment = checkHitSegment(outer_, index, trackOrig, trackDir, outHit);
+    if (inSegment > -1 && outSegment > -1) {
+      gc = inHit; // in case of both sensors are hit, the inner sensor hit coordinate is returned
+      int zCorrelation = zCorrelation_[index] != NoZCorrelation ? zCorrelation_[index] : int(modules_[index]->zCorrelation());
+      ht = ((zCorrelation == SAMESEGMENT && (inSegment / segmentsRatio_[index] == outSegment)) || zCorrelation == MULTISEGMENT) ? HitType::STUB : HitType::BOTH;
+    } else if (inSegment > -1) { gc = inHit; ht = HitType::INNER; }
+    else if (outSegment > -1) { gc = outHit; ht = HitType::OUTER; }
+  }
+  if (ht != HitType::NONE) modules_[index]->countHit();
+  return std::make_pair(gc, ht);
+}
+
+/**
+ * Tests a track against the inner and outer sensors of all the modules, in two batched passes
+ * @param crossed Set for each module to whether the track crosses one of its sensors
+ */
+void FrozenModules::crossedModules(const XYZVector& trackOrig, const XYZVector& trackDir, std::vector<bool>& crossed) const {
+  std::vector<double> t(size());
+  std::vector<unsigned char> inCrossed(size()), outCrossed(size());
+  RayIntersection::crossQuads(inner_.quads, 0, size(), trackOrig, trackDir, t.data(), inCrossed.data());
+  RayIntersection::crossQuads(outer_.quads, 0, size(), trackOrig, trackDir, t.data(), outCrossed.data());
+  crossed.resize(size());
+  for (int i = 0; i < size(); i++) crossed[i] = inCrossed[i] || (numSensors_[i] != 1 && outCrossed[i]);
+}
+
+/**
+ * Tests a track against the inner and outer sensors of a list of modules, in two batched passes
+ * @param crossed Set to the modules of the list with a crossed sensor, in the order of the list: with the closed-form
+ * backend, checkTrackHits finds no hit on the others
+ */
+void FrozenModules::crossedCandidates(const std::vector<int>& candidates, const XYZVector& trackOrig, const XYZVector& trackDir, std::vector<int>& crossed) const {
+  thread_local std::vector<double> t;
+  thread_local std::vector<unsigned char> inCrossed, outCrossed;
+  int count = candidates.size();
+  t.resize(count);
+  inCrossed.resize(count);
+  outCrossed.resize(count);
+  RayIntersection::crossQuads(inner_.quads, candidates.data(), count, trackOrig, trackDir, t.data(), inCrossed.data());
+  RayIntersection::crossQuads(outer_.quads, candidates.data(), count, trackOrig, trackDir, t.data(), outCrossed.data());
+  crossed.clear();
+  for (int k = 0; k < count; k++) {
+    int i = candidates[k];
+    if (inCrossed[k] || (numSensors_[i] != 1 && outCrossed[k])) crossed.push_back(i);
+  }
+}
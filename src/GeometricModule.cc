@@ -1,4 +1,5 @@
 #include "GeometricModule.hh"
+#include "RayIntersection.hh"
 
 double ModuleHelpers::polygonAperture(const Polygon3d<4>& poly) { 
   auto minmax = std::minmax_element(poly.begin(), poly.end(), [](const XYZVector& v1, const XYZVector& v2) { return v1.Phi() < v2.Phi(); }); 
@@ -44,6 +45,18 @@ double GeometricModule::triangleCross(const XYZVector& P1, // Triangle points
                                       const XYZVector& PL, // Base line point
                                       const XYZVector& PU) // Line direction
 {
+  // With the closed-form backend, the three unknowns are solved without a matrix (see RayIntersection::crossTriangle)
+  if (RayIntersection::isClosedForm()) {
+    double orig[3] = { PL.x(), PL.y(), PL.z() };
+    double dir[3] = { PU.x(), PU.y(), PU.z() };
+    double v0[3] = { P1.x(), P1.y(), P1.z() };
+    double e1[3] = { P2.x()-P1.x(), P2.y()-P1.y(), P2.z()-P1.z() };
+    double e2[3] = { P3.x()-P1.x(), P3.y()-P1.y(), P3.z()-P1.z() };
+    double gamma;
+    if (RayIntersection::crossTriangle(orig, dir, v0, e1, e2, gamma)) return gamma;
+    else return -1.;
+  }
+
   bool moduleHit = false;
 
   // Triangle coordinates
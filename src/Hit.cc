@@ -47,51 +47,56 @@ bool Hit::sortHigherR(const HitPtr& h1, const HitPtr& h2) { return (h1->getRPos(
  */
 Hit::~Hit() {}
 
+namespace {
+
+  // Names of the hits, interned once
+  const InternedString& undefinedDetName() { static const InternedString name("Undefined"); return name; }
+
+  const InternedString& passiveDetName(HitPassiveType passiveHitType) {
+    static const InternedString beamPipe("BeamPipe"), ip("IP"), support("Support"), service("Service");
+    if (passiveHitType==HitPassiveType::BeamPipe) return beamPipe;
+    if (passiveHitType==HitPassiveType::IP)       return ip;
+    if (passiveHitType==HitPassiveType::Support)  return support;
+    if (passiveHitType==HitPassiveType::Service)  return service;
+    return undefinedDetName();
+  }
+}
+
 /**
  * The default constructor sets the internal parameters to default values.
  */
-Hit::Hit() {
-    m_detName             = "Undefined";
-    m_distance            = 0;
-    m_rPos                = 0;
-    m_zPos                = 0;
-    m_activity            = HitActivity::Undefined;
-    m_activeHitType       = HitType::NONE;
-    m_hitModule           = nullptr;
-    m_track               = nullptr;
-    m_isTrigger           = false;
-    m_passiveHitType      = HitPassiveType::Undefined;
-    m_hitPassiveElem      = nullptr;
-    m_isPixel             = false;
-    m_resolutionRPhi      = 0;
-    m_resolutionZ         = 0;
-    m_isPixelIntersticeVol= false;
-    m_isPixelTrackingVol  = false;
-    m_isIntersticeVol     = false;
-    m_isOuterTrackingVol  = false;
-    m_isTotalTrackingVol  = false;
+Hit::Hit() : m_geometry(new Geometry()) {
+    m_geometry->detName        = undefinedDetName();
+    m_geometry->distance       = 0;
+    m_geometry->rPos           = 0;
+    m_geometry->zPos           = 0;
+    m_activity                 = HitActivity::Undefined;
+    m_geometry->activeHitType  = HitType::NONE;
+    m_geometry->hitModule      = nullptr;
+    m_track                    = nullptr;
+    m_isTrigger                = false;
+    m_geometry->passiveHitType = HitPassiveType::Undefined;
+    m_geometry->hitPassiveElem = nullptr;
+    m_geometry->isPixel        = false;
+    m_geometry->resolutionRPhi = 0;
+    m_geometry->resolutionZ    = 0;
+    m_isPixelIntersticeVol     = false;
+    m_isPixelTrackingVol       = false;
+    m_isIntersticeVol          = false;
+    m_isOuterTrackingVol       = false;
+    m_isTotalTrackingVol       = false;
 }
 
 /**
  * The copy constructor makes sure the new object doesn't point to the old track (the track pointer needs to
- * be set explicitly later). The pointer to the module, on the other hand, stays the same as that of the original.
+ * be set explicitly later). The geometry, including the pointer to the module, is shared with the original
+ * until either of them modifies it.
  */
-Hit::Hit(const Hit& h) {
-    m_detName             = h.m_detName;
-    m_distance            = h.m_distance;
-    m_rPos                = h.m_rPos;
-    m_zPos                = h.m_zPos;
+Hit::Hit(const Hit& h) : m_geometry(h.m_geometry) {
     m_activity            = h.m_activity;
-    m_activeHitType       = h.m_activeHitType;
-    m_hitModule           = h.m_hitModule;
     m_track               = nullptr;
     m_correctedMaterial   = h.m_correctedMaterial;
     m_isTrigger           = h.m_isTrigger;
-    m_passiveHitType      = h.m_passiveHitType;
-    m_hitPassiveElem      = h.m_hitPassiveElem;
-    m_isPixel             = h.m_isPixel;
-    m_resolutionRPhi      = h.m_resolutionRPhi;
-    m_resolutionZ         = h.m_resolutionZ;
     m_isPixelIntersticeVol= false;
     m_isPixelTrackingVol  = false;
     m_isIntersticeVol     = false;
@@ -102,59 +107,56 @@ Hit::Hit(const Hit& h) {
 /**
  * Constructor for a hit on an inactive surface at a given [rPos, zPos] from the origin
  */
-Hit::Hit(double rPos, double zPos, const insur::InactiveElement* myPassiveElem, HitPassiveType passiveHitType) {
-    m_detName             = "Undefined";
-    m_distance            = sqrt(rPos*rPos + zPos*zPos);
-    m_rPos                = rPos;
-    m_zPos                = zPos;
-    m_activity            = HitActivity::Inactive;
-    m_activeHitType       = HitType::NONE;
-    m_hitModule           = nullptr;
-    m_track               = nullptr;
-    m_isTrigger           = false;
-    m_passiveHitType      = passiveHitType;
+Hit::Hit(double rPos, double zPos, const insur::InactiveElement* myPassiveElem, HitPassiveType passiveHitType) : m_geometry(new Geometry()) {
+    m_geometry->detName        = passiveDetName(passiveHitType);
+    m_geometry->distance       = sqrt(rPos*rPos + zPos*zPos);
+    m_geometry->rPos           = rPos;
+    m_geometry->zPos           = zPos;
+    m_activity                 = HitActivity::Inactive;
+    m_geometry->activeHitType  = HitType::NONE;
+    m_geometry->hitModule      = nullptr;
+    m_track                    = nullptr;
+    m_isTrigger                = false;
+    m_geometry->passiveHitType = passiveHitType;
+    m_geometry->hitPassiveElem = nullptr;
     setHitPassiveElement(myPassiveElem);
-    m_isPixel             = false;
-    m_resolutionRPhi      = 0;
-    m_resolutionZ         = 0;
-    m_isPixelIntersticeVol= false;
-    m_isPixelTrackingVol  = false;
-    m_isIntersticeVol     = false;
-    m_isOuterTrackingVol  = false;
-    m_isTotalTrackingVol  = false;
-
-    if (m_passiveHitType==HitPassiveType::BeamPipe) m_detName = "BeamPipe";
-    if (m_passiveHitType==HitPassiveType::IP)       m_detName = "IP";
-    if (m_passiveHitType==HitPassiveType::Support)  m_detName = "Support";
-    if (m_passiveHitType==HitPassiveType::Service)  m_detName = "Service";
+    m_geometry->isPixel        = false;
+    m_geometry->resolutionRPhi = 0;
+    m_geometry->resolutionZ    = 0;
+    m_isPixelIntersticeVol     = false;
+    m_isPixelTrackingVol       = false;
+    m_isIntersticeVol          = false;
+    m_isOuterTrackingVol       = false;
+    m_isTotalTrackingVol       = false;
 }
 
 /**
  * Constructor for a hit on a given module at [rPos, zPos] (cylindrical position) from the origin
  * @param myModule pointer to the module with the hit 
  */
-Hit::Hit(double rPos, double zPos, DetectorModule* myModule, HitType activeHitType) {
-    m_detName             = "Undefined";
-    m_distance            = sqrt(rPos*rPos + zPos*zPos);
-    m_rPos                = rPos;
-    m_zPos                = zPos;
-    m_activity            = HitActivity::Active;
-    m_activeHitType       = activeHitType;
+Hit::Hit(double rPos, double zPos, DetectorModule* myModule, HitType activeHitType) : m_geometry(new Geometry()) {
+    m_geometry->detName        = undefinedDetName();
+    m_geometry->distance       = sqrt(rPos*rPos + zPos*zPos);
+    m_geometry->rPos           = rPos;
+    m_geometry->zPos           = zPos;
+    m_activity                 = HitActivity::Active;
+    m_geometry->activeHitType  = activeHitType;
+    m_geometry->hitModule      = nullptr;
     setHitModule(myModule);
-    m_track               = nullptr;
-    m_isTrigger           = false;
-    m_passiveHitType      = HitPassiveType::Undefined;
-    m_hitPassiveElem      = nullptr;
-    m_isPixel             = false;
-    m_resolutionRPhi      = 0;
-    m_resolutionZ         = 0;
-    m_isPixelIntersticeVol= false;
-    m_isPixelTrackingVol  = false;
-    m_isIntersticeVol     = false;
-    m_isOuterTrackingVol  = false;
-    m_isTotalTrackingVol  = false;
-
-    if (myModule && myModule->getConstModuleCap()!=nullptr) m_detName = myModule->getConstModuleCap()->getDetName();
+    m_track                    = nullptr;
+    m_isTrigger                = false;
+    m_geometry->passiveHitType = HitPassiveType::Undefined;
+    m_geometry->hitPassiveElem = nullptr;
+    m_geometry->isPixel        = false;
+    m_geometry->resolutionRPhi = 0;
+    m_geometry->resolutionZ    = 0;
+    m_isPixelIntersticeVol     = false;
+    m_isPixelTrackingVol       = false;
+    m_isIntersticeVol          = false;
+    m_isOuterTrackingVol       = false;
+    m_isTotalTrackingVol       = false;
+
+    if (myModule && myModule->getConstModuleCap()!=nullptr) m_geometry->detName = myModule->getConstModuleCap()->getInternedDetName();
 }
 
 
@@ -164,7 +166,7 @@ Hit::Hit(double rPos, double zPos, DetectorModule* myModule, HitType activeHitTy
  */
 void Hit::setHitModule(DetectorModule* myModule) {
 
-  if (myModule) m_hitModule = myModule;
+  if (myModule) m_geometry->hitModule = myModule;
   else logWARNING("Hit::setHitModule -> can't set module to given hit, pointer null!");
 }
 
@@ -176,14 +178,14 @@ void Hit::fillModuleLocalResolutionStats() {
   if (!isActive()) {
     std::cerr << "ERROR: Hit::fillModuleLocalResolutionStats called on a non-active hit" << std::endl;
   } else {
-    if (m_hitModule) {
+    if (m_geometry->hitModule) {
       // Compute hit module local resolution.
-      const double resolutionLocalX = m_hitModule->resolutionLocalX(getTrackPhi());
-      const double resolutionLocalY = m_hitModule->resolutionLocalY(getTrackTheta());
+      const double resolutionLocalX = m_geometry->hitModule->resolutionLocalX(getTrackPhi());
+      const double resolutionLocalY = m_geometry->hitModule->resolutionLocalY(getTrackTheta());
       
       // Fill the module statistics.
-      if (m_hitModule->hasAnyResolutionLocalXParam()) m_hitModule->rollingParametrizedResolutionLocalX(resolutionLocalX);
-      if (m_hitModule->hasAnyResolutionLocalYParam()) m_hitModule->rollingParametrizedResolutionLocalY(resolutionLocalY);
+      if (m_geometry->hitModule->hasAnyResolutionLocalXParam()) m_geometry->hitModule->rollingParametrizedResolutionLocalX(resolutionLocalX);
+      if (m_geometry->hitModule->hasAnyResolutionLocalYParam()) m_geometry->hitModule->rollingParametrizedResolutionLocalY(resolutionLocalY);
     }
   }
 }
@@ -194,7 +196,7 @@ void Hit::fillModuleLocalResolutionStats() {
  */
 void Hit::setHitPassiveElement(const insur::InactiveElement* myPassiveElem) {
 
-  if (myPassiveElem) m_hitPassiveElem = myPassiveElem;
+  if (myPassiveElem) m_geometry->hitPassiveElem = myPassiveElem;
   //else logWARNING("Hit::setHitPassiveElement -> can't set inactive element to given hit, pointer null!");
 }
 
@@ -203,7 +205,7 @@ void Hit::setHitPassiveElement(const insur::InactiveElement* myPassiveElem) {
  */
 int Hit::getLayerOrDiscID() const {
 
-  if (m_hitModule && m_hitModule->getConstModuleCap()!=nullptr) return m_hitModule->getConstModuleCap()->getLayerOrDiscID(); else return -1;
+  if (m_geometry->hitModule && m_geometry->hitModule->getConstModuleCap()!=nullptr) return m_geometry->hitModule->getConstModuleCap()->getLayerOrDiscID(); else return -1;
 }
 
 
@@ -261,7 +263,7 @@ double Hit::getResolutionRphi(double trackRadius) {
   else {
 
     // Module hit
-    if (m_hitModule) {
+    if (m_geometry->hitModule) {
 
       // R-Phi-resolution calculated as for a barrel-type module -> transform local R-Phi res. to a true module orientation (rotation by theta angle, skew, tilt)
       // In detail, take into account a propagation of MS error on virtual barrel plane, on which all measurements are evaluated for consistency (global chi2 fit applied) ->
@@ -272,10 +274,10 @@ double Hit::getResolutionRphi(double trackRadius) {
       double A = 0;
       if (SimParms::getInstance().isMagFieldConst()) A = getRPos()/(2*trackRadius); // r_i / 2R
       double B         = A/sqrt(1-A*A);
-      double tiltAngle = m_hitModule->tiltAngle();
-      double skewAngle = m_hitModule->skewAngle();
-      const double resLocalX = m_hitModule->resolutionLocalX(getTrackPhi());
-      const double resLocalY = m_hitModule->resolutionLocalY(getTrackTheta());
+      double tiltAngle = m_geometry->hitModule->tiltAngle();
+      double skewAngle = m_geometry->hitModule->skewAngle();
+      const double resLocalX = m_geometry->hitModule->resolutionLocalX(getTrackPhi());
+      const double resLocalY = m_geometry->hitModule->resolutionLocalY(getTrackTheta());
 
       // All modules & its resolution propagated to the resolution of a virtual barrel module (endcap is a tilted module by 90 degrees, barrel is tilted by 0 degrees)
       double resolutionRPhi = sqrt(pow((B*sin(skewAngle)*cos(tiltAngle) + cos(skewAngle)) * resLocalX,2) + pow(B*sin(tiltAngle) * resLocalY,2));
@@ -283,7 +285,7 @@ double Hit::getResolutionRphi(double trackRadius) {
       return resolutionRPhi;
     }
     // IP or beam-constraint etc. hit
-    else return m_resolutionRPhi;
+    else return m_geometry->resolutionRPhi;
   }
 }
 
@@ -306,7 +308,7 @@ double Hit::getResolutionZ(double trackRadius) {
   else {
 
     // Module hit
-    if (m_hitModule) {
+    if (m_geometry->hitModule) {
 
       if (m_track==nullptr) {
 
@@ -324,10 +326,10 @@ double Hit::getResolutionZ(double trackRadius) {
         double A = 0;
         if (SimParms::getInstance().isMagFieldConst()) A = getRPos()/(2*trackRadius);
         double D         = m_track->getCotgTheta()/sqrt(1-A*A);
-        double tiltAngle = m_hitModule->tiltAngle();
-        double skewAngle = m_hitModule->skewAngle();
-        const double resLocalX = m_hitModule->resolutionLocalX(getTrackPhi());
-        const double resLocalY = m_hitModule->resolutionLocalY(getTrackTheta());
+        double tiltAngle = m_geometry->hitModule->tiltAngle();
+        double skewAngle = m_geometry->hitModule->skewAngle();
+        const double resLocalX = m_geometry->hitModule->resolutionLocalX(getTrackPhi());
+        const double resLocalY = m_geometry->hitModule->resolutionLocalY(getTrackTheta());
 
         // All modules & its resolution propagated to the resolution of a virtual barrel module (endcap is a tilted module by 90 degrees, barrel is tilted by 0 degrees)
         double resolutionZ = sqrt(pow(((D*cos(tiltAngle) + sin(tiltAngle))*sin(skewAngle)) * resLocalX,2) + pow((D*sin(tiltAngle) + cos(tiltAngle)) * resLocalY,2));
@@ -336,7 +338,7 @@ double Hit::getResolutionZ(double trackRadius) {
       }
     }
     // IP or beam-constraint etc. hit
-    else return m_resolutionZ;
+    else return m_geometry->resolutionZ;
   }
 }
 
@@ -349,9 +351,9 @@ bool Hit::isSquareEndcap() {
 
   //std::cout << "Hit::isSquareEndcap() "; //debug
 
-  if (m_hitModule) {
+  if (m_geometry->hitModule) {
     //std::cout << " hitModule_!= NULL "; //debug
-    if (m_hitModule->subdet() == ENDCAP && m_hitModule->shape() == RECTANGULAR) {
+    if (m_geometry->hitModule->subdet() == ENDCAP && m_geometry->hitModule->shape() == RECTANGULAR) {
       //std::cout << " getSubdetectorType()==Endcap "; //debug
        //std::cout << " getShape()==Rectangular "; //debug
        return true;
@@ -363,7 +365,7 @@ bool Hit::isSquareEndcap() {
 
 bool Hit::isStub() const
 {
-  return m_activeHitType == HitType::STUB;
+  return m_geometry->activeHitType == HitType::STUB;
 }
 
 /*
@@ -375,11 +377,11 @@ double Hit::getD() {
 
   double result = 0;
   //std::cout << "Hit::getD() "; //debug
-  if (m_hitModule) {
+  if (m_geometry->hitModule) {
     //std::cout << " hitModule_!= NULL "; //debug
     try {
 
-      const EndcapModule* myECModule = dynamic_cast<const EndcapModule*>(m_hitModule);//->as<EndcapModule>();
+      const EndcapModule* myECModule = dynamic_cast<const EndcapModule*>(m_geometry->hitModule);//->as<EndcapModule>();
       if (myECModule) {
         //std::cout << " myECModule!= NULL "; //debug
         result = (myECModule->minWidth() + myECModule->maxWidth()) / 2. / 2.;
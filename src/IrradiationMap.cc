@@ -8,6 +8,41 @@
 #include"IrradiationMap.hh"
 #include"Units.hh"
 
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/filesystem.hpp>
+
+namespace {
+  //
+  // Layout of the binary map file: this header, followed by the row-major (rho * Z) grid of doubles
+  //
+  struct BinaryMapHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    int64_t sourceSize;
+    int64_t sourceModificationTime;
+    double rhoMin, rhoMax, rhoBinWidth;
+    int64_t rhoBinNum;
+    double zMin, zMax, zBinWidth;
+    int64_t zBinNum;
+    double invFemUnit;
+    int64_t rows, columns;
+  };
+
+  const char binaryMapMagic[8] = {'T', 'K', 'I', 'R', 'R', 'M', 'A', 'P'};
+  const uint32_t binaryMapVersion = 2;
+}
+
+std::string IrradiationMap::cacheDirectory_;
+
 IrradiationMap::IrradiationMap(std::string irradiationMapFile) :
       rhoMin (0),
       rhoMax (0),
@@ -17,7 +52,9 @@ IrradiationMap::IrradiationMap(std::string irradiationMapFile) :
       zMax (0),
       zBinWidth (0),
       zBinNum (0),
-      invFemUnit (1)
+      invFemUnit (1),
+      irradiationRows (0),
+      irradiationColumns (0)
 {
   if (! irradiationMapFile.empty()) {
     ingest(irradiationMapFile);
@@ -28,6 +65,37 @@ IrradiationMap::IrradiationMap() : IrradiationMap("")
 {}
 
 void IrradiationMap::ingest(std::string irradiationMapFile) {
+  struct stat sourceStat;
+  if (stat(irradiationMapFile.c_str(), &sourceStat) != 0) {
+    logERROR("Failed opening irradiation map file " + irradiationMapFile);
+    return;
+  }
+
+  // An unchanged text source (same size and modification time) is not even read
+  std::string binaryFile;
+  if (!cacheDirectory_.empty()) {
+    binaryFile = binaryFileName(irradiationMapFile);
+    if (loadBinary(binaryFile, sourceStat.st_size, sourceStat.st_mtime)) return;
+  }
+
+  std::ifstream filein(irradiationMapFile);
+  if (!filein.is_open()) {
+    logERROR("Failed opening irradiation map file " + irradiationMapFile);
+    return;
+  }
+  std::ostringstream contentStream;
+  contentStream << filein.rdbuf();
+
+  if (!parse(contentStream.str())) {
+    logERROR("Irradiation map file " + irradiationMapFile + " could not be parsed, the map is not used");
+    irradiation.reset();
+    irradiationRows = irradiationColumns = 0;
+    return;
+  }
+  if (!binaryFile.empty()) writeBinary(binaryFile, sourceStat.st_size, sourceStat.st_mtime);
+}
+
+bool IrradiationMap::parse(const std::string& content) {
   std::string line;
   bool found_rhoMin = false;
   bool found_rhoMax = false;
@@ -39,11 +107,8 @@ void IrradiationMap::ingest(std::string irradiationMapFile) {
   bool found_zBinNum = false;
   bool found_invFemUnit = false;
   double irradiationValue = 0;
-  std::ifstream filein(irradiationMapFile);
-
-  if (!filein.is_open()) {
-    logERROR("Failed opening irradiation map file!");
-  }
+  std::istringstream filein(content);
+  std::vector< std::vector<double> > irradiationLines;
 
   while(std::getline(filein, line)) {
     //find rhoMin
@@ -127,8 +192,19 @@ void IrradiationMap::ingest(std::string irradiationMapFile) {
       }
     }
     //add vector to matrix
-    irradiation.push_back(irradiationLine);
+    irradiationLines.push_back(irradiationLine);
+  }
+
+  //flatten the rows in the row-major grid
+  irradiationRows = irradiationLines.size();
+  irradiationColumns = 0;
+  for (const auto& irradiationLine : irradiationLines) irradiationColumns = std::max(irradiationColumns, long(irradiationLine.size()));
+  std::shared_ptr<std::vector<double> > grid = std::make_shared<std::vector<double> >(irradiationRows * irradiationColumns, 0.);
+  for (long int i = 0; i < irradiationRows; i++) {
+    if (long(irradiationLines[i].size()) != irradiationColumns) logWARNING("Irradiation map row " + std::to_string(i) + " is shorter than the others, missing bins set to 0");
+    std::copy(irradiationLines[i].begin(), irradiationLines[i].end(), grid->begin() + i * irradiationColumns);
   }
+  irradiation = std::shared_ptr<const double>(grid, grid->data());
 
   //convert cm to mm
   zMin       *= Units::cm; //10;
@@ -155,7 +231,112 @@ void IrradiationMap::ingest(std::string irradiationMapFile) {
         << "; found_zMax " << found_zMax << "; found_zBinWidth " << found_zBinWidth
         << "; found_zBinNum " << found_zBinNum << "; found_invFemUnit " << found_invFemUnit;
     logERROR(tempSS);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * The binary map is named after the hash of the canonical path of its text source, so that the cache
+ * directory holds one file per map, overwritten whenever the map changes
+ */
+std::string IrradiationMap::binaryFileName(const std::string& irradiationMapFile) {
+  boost::system::error_code error;
+  std::string canonicalName = boost::filesystem::canonical(irradiationMapFile, error).string();
+  if (error) canonicalName = irradiationMapFile;
+  std::ostringstream fileName;
+  fileName << cacheDirectory_ << "/" << boost::filesystem::path(irradiationMapFile).stem().string()
+           << "_" << std::hex << std::setw(16) << std::setfill('0') << checksum(canonicalName.data(), canonicalName.size()) << ".irrmap";
+  return fileName.str();
+}
+
+bool IrradiationMap::loadBinary(const std::string& binaryFile, int64_t sourceSize, int64_t sourceModificationTime) {
+  int fd = open(binaryFile.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat binaryStat;
+  if (fstat(fd, &binaryStat) != 0 || size_t(binaryStat.st_size) < sizeof(BinaryMapHeader)) {
+    close(fd);
+    return false;
+  }
+  size_t length = binaryStat.st_size;
+  void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) return false;
+
+  // A stale or foreign binary file is ignored: the text source is read again and the binary file rewritten
+  const BinaryMapHeader* header = static_cast<const BinaryMapHeader*>(mapping);
+  if (memcmp(header->magic, binaryMapMagic, sizeof(binaryMapMagic)) != 0 || header->version != binaryMapVersion
+      || header->headerSize != sizeof(BinaryMapHeader) || header->sourceSize != sourceSize || header->sourceModificationTime != sourceModificationTime
+      || header->rows < 0 || header->columns < 0
+      || length != sizeof(BinaryMapHeader) + size_t(header->rows * header->columns) * sizeof(double)) {
+    munmap(mapping, length);
+    return false;
+  }
+
+  rhoMin = header->rhoMin;
+  rhoMax = header->rhoMax;
+  rhoBinWidth = header->rhoBinWidth;
+  rhoBinNum = header->rhoBinNum;
+  zMin = header->zMin;
+  zMax = header->zMax;
+  zBinWidth = header->zBinWidth;
+  zBinNum = header->zBinNum;
+  invFemUnit = header->invFemUnit;
+  irradiationRows = header->rows;
+  irradiationColumns = header->columns;
+
+  // The mapping lives as long as the last copy of the map using it
+  const double* grid = reinterpret_cast<const double*>(static_cast<const char*>(mapping) + sizeof(BinaryMapHeader));
+  irradiation = std::shared_ptr<const double>(grid, [mapping, length](const double*) { munmap(mapping, length); });
+  return true;
+}
+
+void IrradiationMap::writeBinary(const std::string& binaryFile, int64_t sourceSize, int64_t sourceModificationTime) const {
+  BinaryMapHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, binaryMapMagic, sizeof(binaryMapMagic));
+  header.version = binaryMapVersion;
+  header.headerSize = sizeof(BinaryMapHeader);
+  header.sourceSize = sourceSize;
+  header.sourceModificationTime = sourceModificationTime;
+  header.rhoMin = rhoMin;
+  header.rhoMax = rhoMax;
+  header.rhoBinWidth = rhoBinWidth;
+  header.rhoBinNum = rhoBinNum;
+  header.zMin = zMin;
+  header.zMax = zMax;
+  header.zBinWidth = zBinWidth;
+  header.zBinNum = zBinNum;
+  header.invFemUnit = invFemUnit;
+  header.rows = irradiationRows;
+  header.columns = irradiationColumns;
+
+  boost::system::error_code error;
+  boost::filesystem::create_directories(cacheDirectory_, error);
+
+  // Write to a temporary file first, so that a concurrent run never maps a half-written file
+  std::string temporaryFile = binaryFile + ".tmp" + std::to_string(getpid());
+  std::ofstream fileout(temporaryFile, std::ios::binary);
+  if (fileout.is_open()) {
+    fileout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    fileout.write(reinterpret_cast<const char*>(irradiation.get()), irradiationRows * irradiationColumns * sizeof(double));
+    fileout.close();
+  }
+  if (!fileout || rename(temporaryFile.c_str(), binaryFile.c_str()) != 0) {
+    logINFO("Could not write the binary irradiation map " + binaryFile + ", the text map will be parsed again next time");
+    remove(temporaryFile.c_str());
+  }
+}
+
+uint64_t IrradiationMap::checksum(const void* data, size_t size, uint64_t seed) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  uint64_t hash = seed;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
   }
+  return hash;
 }
 
 double IrradiationMap::binArea() const{
@@ -167,7 +348,7 @@ bool IrradiationMap::operator < (const IrradiationMap& confrontedMap) const{
 }
 
 bool IrradiationMap::isInRegion(const std::pair<double,double>& coordinates) const {
-  return ((zMin <= coordinates.first) && (zMax >= coordinates.first) && (rhoMin <= coordinates.second) && (rhoMax >= coordinates.second));
+  return irradiation && ((zMin <= coordinates.first) && (zMax >= coordinates.first) && (rhoMin <= coordinates.second) && (rhoMax >= coordinates.second));
 }
 
 double IrradiationMap::calculateIrradiation(const std::pair<double,double>& coordinates) const {
@@ -199,31 +380,31 @@ double IrradiationMap::calculateIrradiation(const std::pair<double,double>& coor
     //if the point is in a intersection of the grid formed by the map bin centers
     if((z1 == z2) && (rho1 == rho2)) {
       //single value
-      irrxy = irradiation[int(rho1)][int(z1)];
+      irrxy = binValue(rho1, z1);
     }
 
     //if is in a z line
     else if (z1 == z2) {
-      irr1 = irradiation[int(rho1)][int(z1)];
-      irr2 = irradiation[int(rho2)][int(z1)];
+      irr1 = binValue(rho1, z1);
+      irr2 = binValue(rho2, z1);
       //linear interpolation in rho
       irrxy = irr1/(rho2-rho1) * (rho2-rho) + irr2/(rho2-rho1) * (rho-rho1);
     }
 
     //if is in a rho line
     else if (rho1 == rho2) {
-      irr1 = irradiation[int(rho1)][int(z1)];
-      irr2 = irradiation[int(rho1)][int(z2)];
+      irr1 = binValue(rho1, z1);
+      irr2 = binValue(rho1, z2);
       //linear interpolation in z
       irrxy = irr1/(z2-z1) * (z2-z) + irr2/(z2-z1) * (z-z1);
     }
 
     //if is in the middle
     else {
-      irr11 = irradiation[int(rho1)][int(z1)];
-      irr21 = irradiation[int(rho1)][int(z2)];
-      irr12 = irradiation[int(rho2)][int(z1)];
-      irr22 = irradiation[int(rho2)][int(z2)];
+      irr11 = binValue(rho1, z1);
+      irr21 = binValue(rho1, z2);
+      irr12 = binValue(rho2, z1);
+      irr22 = binValue(rho2, z2);
       //bilinear interpolation in z and rho
       irrxy = irr11/((z2-z1)*(rho2-rho1))*(z2-z)*(rho2-rho) + irr21/((z2-z1)*(rho2-rho1))*(z-z1)*(rho2-rho) + irr12/((z2-z1)*(rho2-rho1))*(z2-z)*(rho-rho1) + irr22/((z2-z1)*(rho2-rho1))*(z-z1)*(rho-rho1);
     }
@@ -7,7 +7,46 @@
 
 #include "IrradiationMapsManager.hh"
 
-IrradiationMapsManager::IrradiationMapsManager() {
+#include <algorithm>
+#include <numeric>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <boost/filesystem.hpp>
+
+namespace {
+  //
+  // Layout of the fluence cache file: this header, followed by the (key, mean, max) records
+  //
+  struct FluenceCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t mapsFingerprint;
+    uint64_t records;
+  };
+
+  struct FluenceCacheRecord {
+    uint64_t key;
+    double mean;
+    double max;
+  };
+
+  const char fluenceCacheMagic[8] = {'T', 'K', 'F', 'L', 'U', 'E', 'N', 'C'};
+  const uint32_t fluenceCacheVersion = 2;
+}
+
+IrradiationMapsManager::IrradiationMapsManager() :
+    mapsKey (IrradiationMap::checksumSeed),
+    mapsFingerprint (IrradiationMap::checksumSeed),
+    fluenceCacheEnabled (true),
+    fluenceCacheLoaded (false),
+    fluenceCacheDirty (false) {
 }
 
 IrradiationMapsManager::~IrradiationMapsManager() {
@@ -16,17 +55,42 @@ IrradiationMapsManager::~IrradiationMapsManager() {
 
 void IrradiationMapsManager::addIrradiationMap(const IrradiationMap& newIrradiationMap) {
   irradiationMaps.insert(newIrradiationMap);
+  // The content of this map cannot be fingerprinted
+  fluenceCacheEnabled = false;
 }
 
 void IrradiationMapsManager::addIrradiationMap(std::string newIrradiationMapFile) {
-  IrradiationMap newIrradiationMap (newIrradiationMapFile);
-  addIrradiationMap(newIrradiationMap);
+  pendingMapFiles.push_back(newIrradiationMapFile);
+
+  // The fluence cache is invalidated by any change of the map files
+  struct stat mapStat;
+  if (stat(newIrradiationMapFile.c_str(), &mapStat) != 0) {
+    fluenceCacheEnabled = false;
+    return;
+  }
+  int64_t size = mapStat.st_size;
+  int64_t modificationTime = mapStat.st_mtime;
+  mapsKey = IrradiationMap::checksum(newIrradiationMapFile.c_str(), newIrradiationMapFile.size() + 1, mapsKey);
+  mapsFingerprint = IrradiationMap::checksum(newIrradiationMapFile.c_str(), newIrradiationMapFile.size() + 1, mapsFingerprint);
+  mapsFingerprint = IrradiationMap::checksum(&size, sizeof(size), mapsFingerprint);
+  mapsFingerprint = IrradiationMap::checksum(&modificationTime, sizeof(modificationTime), mapsFingerprint);
+}
+
+void IrradiationMapsManager::loadPendingMaps() const {
+  for (const auto& mapFile : pendingMapFiles) {
+    IrradiationMap irradiationMap(mapFile);
+    if (irradiationMap.isValid()) irradiationMaps.insert(irradiationMap);
+    else logERROR("Irradiation map " + mapFile + " is missing or unreadable, it is skipped");
+  }
+  pendingMapFiles.clear();
 }
 
 double IrradiationMapsManager::calculateIrradiationPower(const std::pair<double,double>& coordinates) const{
   double irradiation = 0;
   bool mapFound = false;
 
+  if (!pendingMapFiles.empty()) loadPendingMaps();
+
   //Iterate through the ordered map set untill find a proper map
   for(std::set<IrradiationMap>::const_iterator iter = irradiationMaps.cbegin(); iter != irradiationMaps.cend(); ++ iter) {
     if (iter->isInRegion(coordinates)) {
@@ -41,3 +105,114 @@ double IrradiationMapsManager::calculateIrradiationPower(const std::pair<double,
 
   return irradiation;
 }
+
+std::pair<double,double> IrradiationMapsManager::calculateFluenceMeanMax(const std::vector<std::pair<double,double> >& points) const {
+  uint64_t key = 0;
+  if (fluenceCacheUsed()) {
+    if (!fluenceCacheLoaded) loadFluenceCache();
+    key = IrradiationMap::checksum(points.data(), points.size() * sizeof(std::pair<double,double>));
+    auto cached = fluenceCache.find(key);
+    if (cached != fluenceCache.end()) return cached->second;
+  }
+
+  std::vector<double> irradiationValues;
+  for (const auto& point : points) irradiationValues.push_back(calculateIrradiationPower(point));
+
+  double sum = std::accumulate(irradiationValues.begin(), irradiationValues.end(), 0.);
+  double irradiationMean = sum / irradiationValues.size();
+  double irradiationMax = *std::max_element(irradiationValues.begin(), irradiationValues.end());
+  std::pair<double,double> irradiationMeanMax = std::make_pair(irradiationMean, irradiationMax);
+
+  if (fluenceCacheUsed()) {
+    fluenceCache[key] = irradiationMeanMax;
+    fluenceCacheDirty = true;
+  }
+  return irradiationMeanMax;
+}
+
+/**
+ * The cache file is named after the paths of the maps only: a change of their content replaces it instead of adding a new one
+ */
+std::string IrradiationMapsManager::fluenceCacheFile() const {
+  std::ostringstream fileName;
+  fileName << IrradiationMap::cacheDirectory() << "/fluence_" << std::hex << std::setw(16) << std::setfill('0') << mapsKey << ".cache";
+  return fileName.str();
+}
+
+bool IrradiationMapsManager::readFluenceCache(std::map<uint64_t, std::pair<double,double> >& cache) const {
+  std::ifstream filein(fluenceCacheFile(), std::ios::binary);
+  if (!filein.is_open()) return false;
+
+  FluenceCacheHeader header;
+  if (!filein.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+  if (memcmp(header.magic, fluenceCacheMagic, sizeof(fluenceCacheMagic)) != 0 || header.version != fluenceCacheVersion
+      || header.recordSize != sizeof(FluenceCacheRecord) || header.mapsFingerprint != mapsFingerprint) return false;
+
+  // The record count is checked against the file size before it is allocated: a truncated or corrupt cache is discarded
+  std::streampos recordsBegin = filein.tellg();
+  filein.seekg(0, std::ios::end);
+  std::streampos fileEnd = filein.tellg();
+  if (!filein || recordsBegin < 0 || fileEnd < recordsBegin
+      || header.records != uint64_t(fileEnd - recordsBegin) / sizeof(FluenceCacheRecord)
+      || uint64_t(fileEnd - recordsBegin) % sizeof(FluenceCacheRecord) != 0) {
+    logERROR("Discarding the corrupt fluence cache " + fluenceCacheFile());
+    return false;
+  }
+  filein.seekg(recordsBegin);
+
+  std::vector<FluenceCacheRecord> records(header.records);
+  if (!filein.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(FluenceCacheRecord))) return false;
+  for (const auto& record : records) cache[record.key] = std::make_pair(record.mean, record.max);
+  return true;
+}
+
+void IrradiationMapsManager::loadFluenceCache() const {
+  fluenceCacheLoaded = true;
+  readFluenceCache(fluenceCache);
+}
+
+void IrradiationMapsManager::saveFluenceCache() const {
+  if (!fluenceCacheUsed() || !fluenceCacheDirty) return;
+
+  boost::system::error_code error;
+  boost::filesystem::create_directories(IrradiationMap::cacheDirectory(), error);
+
+  // The fluences saved meanwhile by a concurrent run on another layout are kept: the runs merge their records one at a time
+  std::string cacheFile = fluenceCacheFile();
+  std::string lockFile = cacheFile + ".lock";
+  int lock = open(lockFile.c_str(), O_RDWR | O_CREAT, 0644);
+  if (lock >= 0) flock(lock, LOCK_EX);
+
+  std::map<uint64_t, std::pair<double,double> > savedCache;
+  readFluenceCache(savedCache);
+  for (const auto& entry : fluenceCache) savedCache[entry.first] = entry.second;
+
+  FluenceCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, fluenceCacheMagic, sizeof(fluenceCacheMagic));
+  header.version = fluenceCacheVersion;
+  header.recordSize = sizeof(FluenceCacheRecord);
+  header.mapsFingerprint = mapsFingerprint;
+  header.records = savedCache.size();
+
+  std::vector<FluenceCacheRecord> records;
+  records.reserve(savedCache.size());
+  for (const auto& entry : savedCache) records.push_back(FluenceCacheRecord{entry.first, entry.second.first, entry.second.second});
+
+  // Write to a temporary file first, so that a concurrent run never reads a half-written cache
+  std::string temporaryFile = cacheFile + ".tmp" + std::to_string(getpid());
+  std::ofstream fileout(temporaryFile, std::ios::binary);
+  if (fileout.is_open()) {
+    fileout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    fileout.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(FluenceCacheRecord));
+    fileout.close();
+  }
+  bool written = fileout && rename(temporaryFile.c_str(), cacheFile.c_str()) == 0;
+  if (lock >= 0) close(lock);
+  if (!written) {
+    logINFO("Could not write the fluence cache " + cacheFile + ", module fluences will be computed again next time");
+    remove(temporaryFile.c_str());
+    return;
+  }
+  fluenceCacheDirty = false;
+}
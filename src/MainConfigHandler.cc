@@ -479,6 +479,13 @@ std::set<string> mainConfigHandler::preprocessConfiguration(ConfigInputOutput cf
   // Avoid double-counting: files included from this one should be
   // counted only once
   clearGraphLinks(thisFileId);
+
+  // Record the visit, so that a cached configuration can replay the include graph
+  int thisRecord = -1;
+  if (cfgInOut.includeTree) {
+    thisRecord = cfgInOut.includeTree->files.size();
+    cfgInOut.includeTree->files.push_back(ConfigFileRecord{absoluteFileName, relativeFileName, standardInclude, cfgInOut.includeTreeParent});
+  }
   std::string full_path = boost::filesystem::system_complete(absoluteFileName).string();
 
   string line;
@@ -533,6 +540,8 @@ std::set<string> mainConfigHandler::preprocessConfiguration(ConfigInputOutput cf
 	nextIncludeInputOutput.absoluteFileName=fullIncludedFileName;
 	nextIncludeInputOutput.relativeFileName=nextIncludeFileName;
 	nextIncludeInputOutput.webOutput=cfgInOut.webOutput;
+	nextIncludeInputOutput.includeTree=cfgInOut.includeTree;
+	nextIncludeInputOutput.includeTreeParent=thisRecord;
         auto&& moreIncludes = preprocessConfiguration(nextIncludeInputOutput);
 
 	// Graph node links
@@ -544,6 +553,7 @@ std::set<string> mainConfigHandler::preprocessConfiguration(ConfigInputOutput cf
           os << indent << line << endl;   
         }
       } else {
+        if (cfgInOut.includeTree) cfgInOut.includeTree->complete = false;
         cerr << "ERROR: ignoring " << ( (includeStdOld||includeStdNew) ? "@include-std" : "@include" ) << " directive in " << absoluteFileName << ":" << numLine << " : could not open included file : " << nextIncludeFileName << endl;
       }
     } else {
@@ -554,6 +564,35 @@ std::set<string> mainConfigHandler::preprocessConfiguration(ConfigInputOutput cf
   return includeSet;
 }
 
+/**
+ * Rebuild the include graph of a configuration loaded from the cache, with the same
+ * sequence of graph calls preprocessConfiguration would have done on the same files
+ */
+void mainConfigHandler::replayConfigurationGraph(const ConfigIncludeTree& includeTree, bool webOutput) {
+  if (includeTree.files.empty()) return;
+  const ConfigFileRecord& mainFile = includeTree.files.front();
+  string firstFileName = boost::filesystem::canonical(mainFile.absoluteFileName).string();
+  addNodeUrl(firstFileName, "file://"+mainFile.absoluteFileName);
+  setNodeLocal(firstFileName, true);
+  replayConfigurationNode(includeTree, 0, webOutput);
+}
+
+void mainConfigHandler::replayConfigurationNode(const ConfigIncludeTree& includeTree, int fileIndex, bool webOutput) {
+  const ConfigFileRecord& file = includeTree.files.at(fileIndex);
+  int thisFileId = getFileId(file.absoluteFileName);
+  setNodeLocal(file.absoluteFileName, ! file.standardInclude);
+  prepareNodeOutput(file.absoluteFileName, file.relativeFileName, webOutput);
+  clearGraphLinks(thisFileId);
+
+  // children were recorded in include order, each one right after the subtree of the previous one
+  for (unsigned int i = fileIndex + 1; i < includeTree.files.size(); i++) {
+    if (includeTree.files[i].parent != fileIndex) continue;
+    int includedFileId = getFileId(includeTree.files[i].absoluteFileName);
+    replayConfigurationNode(includeTree, i, webOutput);
+    addGraphLink(thisFileId, includedFileId);
+  }
+}
+
 
 /** 
  * Read DetId schemes definitions from cfg files.
@@ -10,11 +10,13 @@
 #include "ConversionStation.hh"
 #include "global_constants.hh"
 #include "MaterialTab.hh"
+#include "MaterialRegistry.hh"
 //#include "InactiveElement.hh"
 #include "MaterialProperties.hh"
 #include "DetectorModule.hh"
 #include "MessageLogger.hh"
 #include <stdexcept>
+#include <mutex>
 
 
 namespace material {
@@ -82,6 +84,8 @@ namespace material {
       
 
       static std::map<MaterialObjectKey, Materials*> materialsMap_; //for saving memory
+      static std::mutex materialsMapMutex; // shared by the threads of a parallel build
+      std::lock_guard<std::mutex> lock(materialsMapMutex);
       for (auto& currentMaterialNode : materialsNode_) {
         store(currentMaterialNode.second);
 
@@ -320,7 +324,9 @@ namespace material {
     targetVolume ("targetVolume", parsedOnly(), 0),
     referenceSensorNode ("ReferenceSensor", parsedOnly()),
     materialTab_ (MaterialTab::instance()),
-    materialType_(newMaterialType) {
+    materialType_(newMaterialType),
+    unitVal_(unresolved),
+    materialId_(unresolved) {
   };
 
   MaterialObject::Element::Element(const Element& original, double multiplier) : Element(original.materialType_) {
@@ -332,10 +338,22 @@ namespace material {
     quantity(original.quantity() * original.scalingMultiplier() * multiplier); //apply the scaling in the copied object
     unit(original.unit());
     debugInactivate(original.debugInactivate());
+    resolveIds();
   }
   
   MaterialObject::Element::~Element() { }
 
+  void MaterialObject::Element::check() {
+    PropertyObject::check();
+    resolveIds();
+  }
+
+  void MaterialObject::Element::resolveIds() {
+    auto unitIter = unitStringMap.find(unit());
+    unitVal_ = (unitIter != unitStringMap.end()) ? unitIter->second : invalidUnit;
+    materialId_ = MaterialRegistry::instance().materialId(elementName());
+  }
+
   const std::string MaterialObject::Element::msg_no_valid_unit = "No valid unit: ";
 
   const std::map<std::string, MaterialObject::Element::Unit> MaterialObject::Element::unitStringMap = {
@@ -389,15 +407,15 @@ namespace material {
   }
 
   double MaterialObject::Element::quantityInGrams(const DetectorModule& module) const {
-    return quantityInUnit("g", module.length(), module.area());
+    return quantityInUnit(GRAMS, module.length(), module.area());
   }
 
   double MaterialObject::Element::quantityInGrams(const MaterialProperties& materialProperties) const {
-    return quantityInUnit("g", materialProperties.getLength(), materialProperties.getSurface());
+    return quantityInUnit(GRAMS, materialProperties.getLength(), materialProperties.getSurface());
   }
 
   double MaterialObject::Element::quantityInGrams(const double length, const double surface) const {
-    return quantityInUnit("g", length, surface);
+    return quantityInUnit(GRAMS, length, surface);
   }
 
   double MaterialObject::Element::quantityInUnit(const std::string desiredUnit, const MaterialProperties& materialProperties) const {
@@ -412,8 +430,27 @@ namespace material {
    */
      
   double MaterialObject::Element::quantityInUnit(const std::string desiredUnit, const double length, const double surface) const {
+    auto desiredUnitIter = unitStringMap.find(desiredUnit);
+    if (desiredUnitIter == unitStringMap.end()) {
+      logERROR(msg_no_valid_unit + unit() + ", " + desiredUnit + ".");
+      return 0;
+    }
+    return quantityInUnit(desiredUnitIter->second, length, surface);
+  }
+
+  /**
+   * return the density of the element material, through the material registry
+   */
+  double MaterialObject::Element::density() const {
+    MaterialRegistry& registry = MaterialRegistry::instance();
+    int materialId = materialId_ != unresolved ? materialId_ : registry.materialId(elementName());
+    if (registry.isKnown(materialId)) return registry.density(materialId);
+    return materialTab_.density(elementName()); // reports the missing material
+  }
+
+  double MaterialObject::Element::quantityInUnit(Unit desiredUnit, const double length, const double surface) const {
     double returnVal = 0;
-    double density = materialTab_.density(elementName());
+    double density = this->density();
     bool invert;
     Unit desiredUnitVal, elementUnitVal, tempUnit;
 
@@ -444,9 +481,20 @@ namespace material {
     }
     */
 
-    try {
-      desiredUnitVal = unitStringMap.at(desiredUnit);
-      elementUnitVal = unitStringMap.at(unit());
+    int unitVal = unitVal_;
+    if (unitVal == unresolved) {
+      auto unitIter = unitStringMap.find(unit());
+      unitVal = (unitIter != unitStringMap.end()) ? unitIter->second : invalidUnit;
+    }
+    if (unitVal == invalidUnit) {
+      std::string desiredUnitString;
+      for (const auto& unitIter : unitStringMap) {
+        if (unitIter.second == desiredUnit) desiredUnitString = unitIter.first;
+      }
+      logERROR(msg_no_valid_unit + unit() + ", " + desiredUnitString + ".");
+    } else {
+      desiredUnitVal = desiredUnit;
+      elementUnitVal = Unit(unitVal);
       
       if (desiredUnitVal == elementUnitVal) {
 	double quant = insur::mat_budget_overall_scaling_factor * quantity();
@@ -469,8 +517,6 @@ namespace material {
 
       if (invert)
         returnVal = 1 / returnVal;
-    } catch (const std::out_of_range& ex) {
-      logERROR(msg_no_valid_unit + unit() + ", " + desiredUnit + ".");
     }
     returnVal *= insur::mat_budget_overall_scaling_factor;
     return returnVal;
@@ -5,6 +5,7 @@
 
 #include <MaterialProperties.hh>
 #include<MaterialTab.hh>
+#include<MaterialRegistry.hh>
 
 RILength& RILength::operator+=(const RILength &a) {
   interaction += a.interaction;
@@ -20,8 +21,33 @@ const RILength RILength::operator+(const RILength &other) const {
 
 
 
+namespace {
+  // Add a value to the entry of a (ID, value) vector, appending the entry if missing
+  template<class T> T& findOrAddById(std::vector<std::pair<int, T> >& entries, int id) {
+    for (auto& entry : entries) {
+      if (entry.first == id) return entry.second;
+    }
+    entries.push_back(std::make_pair(id, T()));
+    return entries.back().second;
+  }
+}
+
 namespace insur {
+    MaterialProperties::MassStorage MaterialProperties::massStorage = MaterialProperties::map_storage;
+
     /*-----public functions-----*/
+    /**
+     * Select how the masses of all the elements are stored: this has to be done before any mass is added.
+     * @param storage The storage mode as defined in the enumeration <i>MassStorage</i>
+     */
+    void MaterialProperties::setMassStorage(MassStorage storage) { massStorage = storage; }
+
+    /**
+     * Get how the masses of all the elements are stored.
+     * @return The storage mode as defined in the enumeration <i>MassStorage</i>
+     */
+    MaterialProperties::MassStorage MaterialProperties::getMassStorage() { return massStorage; }
+
     /**
      * The constructor sets a few defaults. The flags for the initialisation status of the material vectors are
      * set to false, the element category to none, i.e. unidentified, and the numeric values for the sums of masses
@@ -96,6 +122,9 @@ namespace insur {
   void MaterialProperties::addLocalMass(std::string tag, double ms) {
         msl_set = true;
         localmasses[tag] += ms;
+        if (massStorage == dense_storage) {
+            findOrAddById(localMassesById, material::MaterialRegistry::instance().materialId(tag)) += ms;
+        }
     }
 
     /**
@@ -112,6 +141,17 @@ namespace insur {
         localmasses[tag] += ms;
         localmassesComp[getSubName(comp)] += ms;
         localCompMats[comp][tag] += ms; 
+        if (massStorage == dense_storage) {
+            material::MaterialRegistry& registry = material::MaterialRegistry::instance();
+            int materialId = registry.materialId(tag);
+            findOrAddById(localMassesById, materialId) += ms;
+            int componentId = registry.componentId(getSuperName(comp));
+            auto compMass = std::find_if(localCompMassesById.begin(), localCompMassesById.end(), [&](const ComponentMass& m) {
+                return m.componentId == componentId && m.materialId == materialId;
+              });
+            if (compMass != localCompMassesById.end()) compMass->mass += ms;
+            else localCompMassesById.push_back(ComponentMass{componentId, materialId, ms});
+        }
     }
     
     /**
@@ -133,6 +173,8 @@ namespace insur {
         localmasses.clear();
         localmassesComp.clear();
         localCompMats.clear();
+        localMassesById.clear();
+        localCompMassesById.clear();
     }
     
     /**
@@ -169,6 +211,12 @@ namespace insur {
 
     const std::map<std::string, RILength>& MaterialProperties::getComponentsRI() const { return componentsRI; } // CUIDADO: I know it parts with the old API but it's so much more practical this way
 
+    /**
+     * Get the component-by-component radiation and interaction lengths, indexed by the component IDs of the material registry.
+     * @return The lengths of the components found in the element; empty unless the masses use the dense storage
+     */
+    const ComponentsRIById& MaterialProperties::getComponentsRIById() const { return componentsRIById; }
+
     /**
      * Get the intraction length of the inactive element.
      * @return The overall radiation length, taking into account all registered materials; -1 if the value has not yet been computed
@@ -256,6 +304,10 @@ namespace insur {
 
   // Versions with new material tab definition
     void MaterialProperties::calculateRadiationLength(double offset) {
+      if (massStorage == dense_storage) {
+        calculateDenseLengths(offset, true);
+        return;
+      }
       const material::MaterialTab& materialTab = material::MaterialTab::instance();
  
         if (getSurface() > 0) {
@@ -275,6 +327,10 @@ namespace insur {
     }
     
     void MaterialProperties::calculateInteractionLength(double offset) {
+      if (massStorage == dense_storage) {
+        calculateDenseLengths(offset, false);
+        return;
+      }
       const material::MaterialTab& materialTab =  material::MaterialTab::instance();
 
         if (getSurface() > 0) {
@@ -344,5 +400,85 @@ namespace insur {
         return split.first;
     }
 
+    /**
+     * Dense storage version of the material tab calculations of the radiation and interaction lengths: same sums, but the
+     * material lengths are read from the material registry by ID instead of being looked up by name. The component-by-component
+     * lengths are stored both by component ID and by component name.
+     * @param offset A starting value for the calculation
+     * @param radiation True to calculate the radiation length, false for the interaction length
+     */
+    void MaterialProperties::calculateDenseLengths(double offset, bool radiation) {
+      const material::MaterialTab& materialTab = material::MaterialTab::instance(); // also registers the material tab entries
+      const material::MaterialRegistry& registry = material::MaterialRegistry::instance();
+      auto materialLength = [&](int materialId) {
+        // materials missing from the tab go through the tab anyway, which reports them
+        if (!registry.isKnown(materialId)) {
+          std::string name = registry.materialName(materialId);
+          return radiation ? materialTab.radiationLength(name) : materialTab.interactionLength(name);
+        }
+        return radiation ? registry.radiationLength(materialId) : registry.interactionLength(materialId);
+      };
+
+        if (getSurface() > 0) {
+            double& length = radiation ? r_length : i_length;
+            length = offset;
+            if (msl_set) {
+                // local mass loop
+                for (const auto& it : localMassesById) {
+                    length += it.second / (materialLength(it.first) * getSurface() / 100.0);
+                }
+                for (const auto& it : localCompMassesById) {
+                    double componentLength = it.mass / (materialLength(it.materialId) * getSurface() / 100.0);
+                    RILength& byId = findOrAddById(componentsRIById, it.componentId);
+                    RILength& byName = componentsRI[registry.componentName(it.componentId)];
+                    if (radiation) {
+                        byId.radiation += componentLength;
+                        byName.radiation += componentLength;
+                    } else {
+                        byId.interaction += componentLength;
+                        byName.interaction += componentLength;
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Add the component-by-component lengths of an element crossed by the track.
+     * @param element The element crossed by the track
+     * @param scale The lengths of the element are divided by this factor, which accounts for the crossing angle
+     */
+    void ComponentsRISum::add(const MaterialProperties& element, double scale) {
+        if (MaterialProperties::getMassStorage() == MaterialProperties::dense_storage) {
+            for (const auto& it : element.getComponentsRIById()) {
+                if (it.first >= (int)byId_.size()) {
+                    byId_.resize(it.first + 1);
+                    usedIds_.resize(it.first + 1, false);
+                }
+                byId_[it.first].radiation += it.second.radiation / scale;
+                byId_[it.first].interaction += it.second.interaction / scale;
+                usedIds_[it.first] = true;
+            }
+        } else {
+            for (const auto& it : element.getComponentsRI()) {
+                byName_[it.first].radiation += it.second.radiation / scale;
+                byName_[it.first].interaction += it.second.interaction / scale;
+            }
+        }
+    }
+
+    /**
+     * Get the sums keyed by component name, whatever the storage.
+     * @return The summed up lengths of each component crossed by the track
+     */
+    std::map<std::string, RILength> ComponentsRISum::byName() const {
+        std::map<std::string, RILength> result = byName_;
+        const material::MaterialRegistry& registry = material::MaterialRegistry::instance();
+        for (unsigned int id = 0; id < byId_.size(); id++) {
+            if (usedIds_[id]) result[registry.componentName(id)] += byId_[id];
+        }
+        return result;
+    }
+
 define_enum_strings(MaterialProperties::Category) = { "Nocat", "Bmod", "Emod", "Bser", "Eser", "Bsup", "Esup", "Osup", "Tsup", "Usup" };
 }
@@ -0,0 +1,66 @@
+/**
+ * @file MaterialRegistry.cc
+ *
+ * @brief Dense integer identifiers for the material and component names
+ */
+
+#include "MaterialRegistry.hh"
+
+namespace material {
+
+  MaterialRegistry& MaterialRegistry::instance() {
+    static MaterialRegistry instance_;
+    return instance_;
+  }
+
+  int MaterialRegistry::materialId(const std::string& material) {
+    std::lock_guard<std::mutex> lock(namesMutex_);
+    auto found = materialIds_.find(material);
+    if (found != materialIds_.end()) return found->second;
+
+    int id = materialNames_.size();
+    materialIds_[material] = id;
+    materialNames_.push_back(material);
+    return id;
+  }
+
+  int MaterialRegistry::componentId(const std::string& component) {
+    std::lock_guard<std::mutex> lock(namesMutex_);
+    auto found = componentIds_.find(component);
+    if (found != componentIds_.end()) return found->second;
+
+    int id = componentNames_.size();
+    componentIds_[component] = id;
+    componentNames_.push_back(component);
+    return id;
+  }
+
+  std::string MaterialRegistry::materialName(int id) const {
+    std::lock_guard<std::mutex> lock(namesMutex_);
+    return materialNames_.at(id);
+  }
+
+  std::string MaterialRegistry::componentName(int id) const {
+    std::lock_guard<std::mutex> lock(namesMutex_);
+    return componentNames_.at(id);
+  }
+
+  int MaterialRegistry::materialCount() const {
+    std::lock_guard<std::mutex> lock(namesMutex_);
+    return materialNames_.size();
+  }
+
+  int MaterialRegistry::componentCount() const {
+    std::lock_guard<std::mutex> lock(namesMutex_);
+    return componentNames_.size();
+  }
+
+  /**
+   * Only called while the material tab is loaded, before the properties are read
+   */
+  void MaterialRegistry::setMaterialProperties(int id, double density, double radiationLength, double interactionLength) {
+    if (id >= (int)materialProperties_.size()) materialProperties_.resize(id + 1, MaterialProperties{false, -1, -1, -1});
+    materialProperties_[id] = MaterialProperties{true, density, radiationLength, interactionLength};
+  }
+
+} /* namespace material */
@@ -9,6 +9,7 @@
 #include <fstream>
 #include <sstream>
 #include "MaterialTab.hh"
+#include "MaterialRegistry.hh"
 #include "global_constants.hh"
 #include "MainConfigHandler.hh"
 #include <MessageLogger.hh>
@@ -38,7 +39,10 @@ namespace material {
         if (material[0] != '#') {
           lineStream >> density >> radiationLength >> interactionLength;
           density /= 1000; // convert g/cm3 in g/mm3
-          insert(make_pair(material, make_tuple(density, radiationLength, interactionLength)));
+          if (insert(make_pair(material, make_tuple(density, radiationLength, interactionLength))).second) {
+            MaterialRegistry& registry = MaterialRegistry::instance();
+            registry.setMaterialProperties(registry.materialId(material), density, radiationLength, interactionLength);
+          }
         }
 
         lineStream.clear();
@@ -133,6 +133,7 @@ namespace insur {
    * @param mat The struct that will be copied and appended to the internal vector container
    */
   void MaterialTable::addMaterial(MaterialRow mat) {
+    indices.insert(std::make_pair(mat.tag, materials.size()));
     materials.push_back(mat);
   }
 
@@ -149,7 +150,7 @@ namespace insur {
     row.density = density;
     row.rlength = rlength;
     row.ilength = ilength;
-    materials.push_back(row);
+    addMaterial(row);
   }
 
   /**
@@ -193,6 +194,9 @@ namespace insur {
   bool MaterialTable::replaceMaterial(int index, MaterialRow newmat) {
     if (index < 0 || index >= (int)materials.size()) return false;
     materials.at(index) = newmat;
+    // the tag may have changed: rebuild the lookup, keeping the first position of each tag
+    indices.clear();
+    for (int i = materials.size() - 1; i >= 0; i--) indices[materials.at(i).tag] = i;
     return false;
   }
 
@@ -230,13 +234,8 @@ namespace insur {
    * @return The index of the requested material; -1 if no such material exists in the table
    */
   int MaterialTable::findIndex(std::string tag) {
-    bool found = false;
-    int index = 0;
-    while (index < (int)materials.size() && !found) {
-      if (tag.compare(materials.at(index).tag) == 0) found = true;
-      else index++;
-    }
-    if (!found) return -1;
-    return index;
+    auto indexIter = indices.find(tag);
+    if (indexIter == indices.end()) return -1;
+    return indexIter->second;
   }
 }
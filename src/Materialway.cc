@@ -24,6 +24,7 @@
 #include "StopWatch.hh"
 
 #include <ctime>
+#include <algorithm>
 
 
 namespace material {
@@ -278,6 +279,178 @@ namespace material {
 
   //END Materialway::Section
   //=================================================================================
+  //START Materialway::ServiceFlow
+
+  Materialway::ServiceFlow::ServiceFlow(bool topological, bool validate /*= false*/) :
+      topological_(topological || validate),
+      validate_(validate),
+      collected_(MaterialObject::SERVICE) {}
+
+  void Materialway::ServiceFlow::deploy(const MaterialObject& source, Section* section, const std::vector<std::string>& units, bool onlyServices /*= false*/, double gramsMultiplier /*= 1.*/) {
+    if (!topological_ || validate_) {
+      if (validate_) recordChainedTargets(section, false);
+      source.deployMaterialTo(section->materialObject(), units, onlyServices, gramsMultiplier);
+      if (!topological_) return;
+    }
+    Contribution contribution;
+    contribution.section = section;
+    contribution.passed = false;
+    contribution.first = collected_.getServiceElements().size();
+    source.deployMaterialTo(collected_, units, onlyServices, gramsMultiplier);
+    contribution.last = contribution.passedFirst = contribution.passedLast = collected_.getServiceElements().size();
+    add(contribution);
+  }
+
+  void Materialway::ServiceFlow::pass(const MaterialObject& source, Section* section) {
+    pass(source, section, section->unitsToPass());
+  }
+
+  void Materialway::ServiceFlow::pass(const MaterialObject& source, Section* section, const std::vector<std::string>& units) {
+    if (!topological_ || validate_) {
+      if (validate_) recordChainedTargets(section, true);
+      section->getServicesAndPass(source, units);
+      if (!topological_) return;
+    }
+    Contribution contribution;
+    contribution.section = section;
+    contribution.passed = true;
+    contribution.first = collected_.getServiceElements().size();
+    source.deployMaterialTo(collected_, units, MaterialObject::ONLY_SERVICES);
+    contribution.last = collected_.getServiceElements().size();
+    Section* next = downstream(section);
+    if (next == nullptr || units == next->unitsToPass()) {
+      contribution.passedFirst = contribution.first;
+      contribution.passedLast = contribution.last;
+    } else {
+      //the next sections take their own units, as in Section::getServicesAndPass
+      contribution.passedFirst = contribution.last;
+      source.deployMaterialTo(collected_, next->unitsToPass(), MaterialObject::ONLY_SERVICES);
+      contribution.passedLast = collected_.getServiceElements().size();
+    }
+    add(contribution);
+  }
+
+  void Materialway::ServiceFlow::add(const Contribution& contribution) {
+    entries_[contribution.section].push_back(contributions_.size());
+    contributions_.push_back(contribution);
+  }
+
+  /**
+   * Record how many elements the targets reached by a deployment had before the chained walk, the first time they are reached
+   */
+  void Materialway::ServiceFlow::recordChainedTargets(Section* section, bool passed) {
+    for (Section* current = section; current != nullptr; current = passed ? downstream(current) : nullptr) {
+      MaterialObject* materialObject = &target(current, passed);
+      chainedFirst_.insert(std::make_pair(materialObject, materialObject->getServiceElements().size()));
+    }
+  }
+
+  /**
+   * Compare the topological deliveries to a target with the elements the chained walk added to it
+   * @return True if both have the same elements, in the same order
+   */
+  bool Materialway::ServiceFlow::checkDeliveries(MaterialObject& materialObject, const MaterialObject::ElementsVector& delivered) const {
+    auto found = chainedFirst_.find(&materialObject);
+    size_t first = (found == chainedFirst_.end()) ? materialObject.getServiceElements().size() : found->second;
+    const MaterialObject::ElementsVector& chained = materialObject.getServiceElements();
+    if (chained.size() - first != delivered.size()) return false;
+    for (size_t i = 0; i < delivered.size(); i++) {
+      const MaterialObject::Element& a = *chained[first + i];
+      const MaterialObject::Element& b = *delivered[i];
+      if (a.elementName() != b.elementName() || a.unit() != b.unit() || a.quantity() != b.quantity() || a.service() != b.service()
+          || a.componentName.state() != b.componentName.state() || (a.componentName.state() && a.componentName() != b.componentName())) return false;
+    }
+    return true;
+  }
+
+  Materialway::Section* Materialway::ServiceFlow::downstream(Section* section) {
+    //stations don't pass
+    return (dynamic_cast<Station*>(section) == nullptr) ? section->nextSection() : nullptr;
+  }
+
+  MaterialObject& Materialway::ServiceFlow::target(Section* section, bool passed) {
+    Station* station = dynamic_cast<Station*>(section);
+    return (passed && station != nullptr) ? station->conversionStation() : section->materialObject();
+  }
+
+  void Materialway::ServiceFlow::flush() {
+    if (!topological_) return;
+
+    //sections reached by the contributions, with the number of sections passing to each one
+    std::map<Section*, int> upstreamCount;
+    std::vector<Section*> toVisit;
+    for (const auto& entry : entries_) {
+      if (upstreamCount.insert(std::make_pair(entry.first, 0)).second) toVisit.push_back(entry.first);
+    }
+    while (!toVisit.empty()) {
+      Section* next = downstream(toVisit.back());
+      toVisit.pop_back();
+      if (next == nullptr) continue;
+      auto found = upstreamCount.find(next);
+      if (found == upstreamCount.end()) {
+        upstreamCount[next] = 1;
+        toVisit.push_back(next);
+      } else {
+        found->second++;
+      }
+    }
+
+    //deliveries of every material object, tagged with the contribution index to keep the original order
+    typedef std::pair<size_t, std::pair<size_t, size_t> > Delivery;
+    std::map<MaterialObject*, std::vector<Delivery> > deliveries;
+    std::map<Section*, std::vector<size_t> > incoming;
+    std::vector<Section*> ready;
+    for (const auto& section : upstreamCount) {
+      if (section.second == 0) ready.push_back(section.first);
+    }
+    size_t visited = 0;
+    while (!ready.empty()) {
+      Section* section = ready.back();
+      ready.pop_back();
+      visited++;
+      Section* next = downstream(section);
+      for (size_t index : entries_[section]) {
+        const Contribution& contribution = contributions_[index];
+        deliveries[&target(section, contribution.passed)].push_back(Delivery(index, std::make_pair(contribution.first, contribution.last)));
+        if (contribution.passed && next != nullptr) incoming[next].push_back(index);
+      }
+      for (size_t index : incoming[section]) {
+        const Contribution& contribution = contributions_[index];
+        deliveries[&target(section, true)].push_back(Delivery(index, std::make_pair(contribution.passedFirst, contribution.passedLast)));
+        if (next != nullptr) incoming[next].push_back(index);
+      }
+      incoming.erase(section);
+      if (next != nullptr && --upstreamCount[next] == 0) ready.push_back(next);
+    }
+    if (visited != upstreamCount.size()) {
+      logERROR("Services not routed through " + any2str(upstreamCount.size() - visited) + " sections closing a loop.");
+    }
+
+    const MaterialObject::ElementsVector& elements = collected_.getServiceElements();
+    int mismatches = 0;
+    for (auto& materialDeliveries : deliveries) {
+      std::sort(materialDeliveries.second.begin(), materialDeliveries.second.end());
+      MaterialObject::ElementsVector delivered;
+      for (const Delivery& delivery : materialDeliveries.second) {
+        delivered.insert(delivered.end(), elements.begin() + delivery.second.first, elements.begin() + delivery.second.second);
+      }
+      // When validating, the chained walk already filled the targets
+      if (!validate_) for (const MaterialObject::Element* element : delivered) materialDeliveries.first->addElement(element);
+      else if (!checkDeliveries(*materialDeliveries.first, delivered)) mismatches++;
+    }
+    for (const auto& chainedTarget : chainedFirst_) {
+      if (validate_ && deliveries.count(chainedTarget.first) == 0 && chainedTarget.first->getServiceElements().size() != chainedTarget.second) mismatches++;
+    }
+    if (mismatches > 0) {
+      logWARNING("Topological service routing differs from the chained routing for " + any2str(mismatches) + " sections or conversion stations.");
+    }
+    entries_.clear();
+    contributions_.clear();
+    chainedFirst_.clear();
+  }
+
+  //END Materialway::ServiceFlow
+  //=================================================================================
   //START Materialway::Station
 
   Materialway::Station::Station(int minZ, int minR, int maxZ, int maxR, Direction bearing, ConversionStation& conversionStation, Section* nextSection) :
@@ -1211,6 +1384,10 @@ namespace material {
   const int Materialway::layerStationWidth = discretize(20.0);         /**< the width of the converting station on right of the layers */
   const double Materialway::radialDistribError = 0.05;                 /**< 5% max error in the material radial distribution */
 
+  Materialway::ServiceRouting Materialway::serviceRouting = Materialway::chained_routing;
+  void Materialway::setServiceRouting(ServiceRouting routing) { serviceRouting = routing; }
+  Materialway::ServiceRouting Materialway::getServiceRouting() { return serviceRouting; }
+
   Materialway::Materialway() :
     boundariesList_(),
     outerUsher(sectionsList_, boundariesList_),
@@ -1463,6 +1640,7 @@ namespace material {
       ModuleSectionMap& moduleSectionAssociations_;  /**< Map that associate each module with the section that it feeds */
       LayerRodSectionsMap& layerRodSections_;      /**< maps for sections of the rods */
       DiskRodSectionsMap& diskRodSections_;
+      ServiceFlow& serviceFlow_;
 
       const Layer* currLayer_;
       const Disk* currDisk_;
@@ -1480,10 +1658,11 @@ namespace material {
       const std::vector<std::string> unitsToPassLayer = {"g", "g/m", "mm"};
       const std::vector<std::string> unitsToPassLayerServ = {"g/m", "mm"};
     public:
-      ServiceVisitor(ModuleSectionMap& moduleSectionAssociations, LayerRodSectionsMap& layerRodSections, DiskRodSectionsMap& diskRodSections) :
+      ServiceVisitor(ModuleSectionMap& moduleSectionAssociations, LayerRodSectionsMap& layerRodSections, DiskRodSectionsMap& diskRodSections, ServiceFlow& serviceFlow) :
         moduleSectionAssociations_(moduleSectionAssociations),
         layerRodSections_(layerRodSections),
-        diskRodSections_(diskRodSections), printGuard(true), printCounter(0), firstRing(false), rodSectionsSize(0) {}
+        diskRodSections_(diskRodSections),
+        serviceFlow_(serviceFlow), printGuard(true), printCounter(0), firstRing(false), rodSectionsSize(0) {}
 
       void visit(const Layer& layer) {
         currLayer_ = &layer;
@@ -1495,9 +1674,9 @@ namespace material {
           }
 
           for (Section* currSection : layerRodSections_.at(currLayer_).getSections()) {
-            layer.materialObject().deployMaterialTo(currSection->materialObject(), unitsToPassLayer, MaterialObject::SERVICES_AND_LOCALS, double(currSection->maxZ()-currSection->minZ()) / totalLength);
+            serviceFlow_.deploy(layer.materialObject(), currSection, unitsToPassLayer, MaterialObject::SERVICES_AND_LOCALS, double(currSection->maxZ()-currSection->minZ()) / totalLength);
           }
-          layerRodSections_.at(currLayer_).getStation()->getServicesAndPass(layer.materialObject(), unitsToPassLayerServ);
+          serviceFlow_.pass(layer.materialObject(), layerRodSections_.at(currLayer_).getStation(), unitsToPassLayerServ);
         }
       }
 
@@ -1505,21 +1684,21 @@ namespace material {
         if (firstRod) {
           rodSectionsSize = 0;
           for (Section* currSection : layerRodSections_.at(currLayer_).getSections()) {
-            rod.materialObject().deployMaterialTo(currSection->materialObject(), unitsToPassRodMM);
+            serviceFlow_.deploy(rod.materialObject(), currSection, unitsToPassRodMM);
             rodSectionsSize += currSection->maxZ() - currSection->minZ();
           }
           firstRod = false;
-          layerRodSections_.at(currLayer_).getStation()->getServicesAndPass(rod.materialObject(), unitsToPassRodMM);
+          serviceFlow_.pass(rod.materialObject(), layerRodSections_.at(currLayer_).getStation(), unitsToPassRodMM);
         }
         for (Section* currSection : layerRodSections_.at(currLayer_).getSections()) {
-          rod.materialObject().deployMaterialTo(currSection->materialObject(), unitsToPassRodGGM, MaterialObject::SERVICES_AND_LOCALS, double(currSection->maxZ()-currSection->minZ()) / rodSectionsSize);
+          serviceFlow_.deploy(rod.materialObject(), currSection, unitsToPassRodGGM, MaterialObject::SERVICES_AND_LOCALS, double(currSection->maxZ()-currSection->minZ()) / rodSectionsSize);
         }
-        layerRodSections_.at(currLayer_).getStation()->getServicesAndPass(rod.materialObject(), unitsToPassRodGM);
+        serviceFlow_.pass(rod.materialObject(), layerRodSections_.at(currLayer_).getStation(), unitsToPassRodGM);
       }
 
       void visit(const BarrelModule& module) {
         if(module.maxZ() > 0) {
-          moduleSectionAssociations_.at(&module)->getServicesAndPass(module.materialObject());
+          serviceFlow_.pass(module.materialObject(), moduleSectionAssociations_.at(&module));
 
           return;
 
@@ -1607,9 +1786,9 @@ namespace material {
             totalLength += currSection->maxR() - currSection->minR();
           }
           for (Section* currSection : diskRodSections_.at(currDisk_).getSections()) {
-            disk.materialObject().deployMaterialTo(currSection->materialObject(), unitsToPassLayer, MaterialObject::SERVICES_AND_LOCALS, double(currSection->maxR()-currSection->minR()) / totalLength);
+            serviceFlow_.deploy(disk.materialObject(), currSection, unitsToPassLayer, MaterialObject::SERVICES_AND_LOCALS, double(currSection->maxR()-currSection->minR()) / totalLength);
           }          
-          diskRodSections_.at(currDisk_).getStation()->getServicesAndPass(disk.materialObject(), unitsToPassLayerServ);
+          serviceFlow_.pass(disk.materialObject(), diskRodSections_.at(currDisk_).getStation(), unitsToPassLayerServ);
         }
 
         /*
@@ -1663,7 +1842,7 @@ namespace material {
       void visit(const EndcapModule& module) {
         if (module.minZ() >= 0) {
           //route module services
-          moduleSectionAssociations_.at(&module)->getServicesAndPass(module.materialObject());
+          serviceFlow_.pass(module.materialObject(), moduleSectionAssociations_.at(&module));
 
           /*
           //route disk rod services
@@ -1677,8 +1856,10 @@ namespace material {
       }
     };
 
-    ServiceVisitor v(moduleSectionAssociations_, layerRodSections_, diskRodSections_);
+    ServiceFlow serviceFlow(serviceRouting == topological_routing, serviceRouting == validated_routing);
+    ServiceVisitor v(moduleSectionAssociations_, layerRodSections_, diskRodSections_, serviceFlow);
     tracker.accept(v);
+    serviceFlow.flush();
   }
 
   /*
@@ -1827,15 +2008,16 @@ namespace material {
         //section->inactiveElement()->addLocalMass("Steel", 1000.0*section->inactiveElement()->getZLength());
 
         section->materialObject().populateMaterialProperties(*section->inactiveElement());
-        /*
-        double sectionMinZ = undiscretize(section->minZ());
-        double sectionMinR = undiscretize(section->minR());
-        double sectionMaxZ = undiscretize(section->maxZ());
-        double sectionMaxR = undiscretize(section->maxR());
-        double sectionLength = undiscretize(section->maxZ() - section->minZ());
-        double sectionArea = sectionLength * 2 * M_PI * sectionMinR;
-        weightDistribution.addTotalGrams(sectionMinZ, sectionMinR, sectionMaxZ, sectionMaxR, sectionLength, sectionArea, section->materialObject());
-        */
+        // The weight distribution is not used by the reports yet: it is only filled to check its storage
+        if (WeightDistributionGrid::isCheckingStorage()) {
+          double sectionMinZ = undiscretize(section->minZ());
+          double sectionMinR = undiscretize(section->minR());
+          double sectionMaxZ = undiscretize(section->maxZ());
+          double sectionMaxR = undiscretize(section->maxR());
+          double sectionLength = undiscretize(section->maxZ() - section->minZ());
+          double sectionArea = sectionLength * 2 * M_PI * sectionMinR;
+          weightDistribution.addTotalGrams(sectionMinZ, sectionMinR, sectionMaxZ, sectionMaxR, sectionLength, sectionArea, section->materialObject());
+        }
       } else {
         logUniqueERROR(inactiveElementError);
       }
@@ -1856,12 +2038,13 @@ namespace material {
         //module.materialObject().populateMaterialProperties(*materialProperties);
         module.materialObject().populateMaterialProperties(*module.getModuleCap());
 
-        //weightDistribution_.addTotalGrams(module.minZ(), module.minR(), module.maxZ(), module.maxR(), module.length(), module.area(), module.materialObject());
+        if (WeightDistributionGrid::isCheckingStorage()) weightDistribution_.addTotalGrams(module.minZ(), module.minR(), module.maxZ(), module.maxR(), module.length(), module.area(), module.materialObject());
       }
     };
 
     ModuleVisitor visitor(weightDistribution);
     tracker.accept(visitor);
+    if (WeightDistributionGrid::isCheckingStorage()) weightDistribution.checkStorage();
   }
 
   /*
@@ -7,6 +7,7 @@ int MessageLogger::countInstances = 0;
 //  enum {UNKNOWN, ERROR, WARNING, INFO, DEBUG, NumberOfLevels};
 std::string MessageLogger::shortLevelCode[] = { "??", "EE", "WW", "II", "DD" };
 int MessageLogger::messageCounter[NumberOfLevels];
+std::mutex MessageLogger::mutex_;
 
 // Global static pointer used to ensure a single instance of the class.
 MessageLogger* MessageLogger::myInstance_ = NULL;
@@ -26,6 +27,7 @@ MessageLogger::MessageLogger() {
 }
 
 bool MessageLogger::addMessage(string sourceFunction, string message, int level /*=UNKNOWN*/, bool unique /*=false*/ ) {
+  std::lock_guard<std::mutex> lock(mutex_);
   if(unique) {
     if(uniqueMessages.count(message) == 0) {
       uniqueMessages.insert(message);
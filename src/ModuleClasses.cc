@@ -0,0 +1,92 @@
+/**
+ * @file ModuleClasses.cc
+ * @brief Equivalence classes of the modules of a built tracker, and caches memoizing results per class
+ */
+
+#include "ModuleClasses.hh"
+
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+
+#include "Tracker.hh"
+#include "SimParms.hh"
+#include "MessageLogger.hh"
+#include "global_funcs.hh"
+
+bool ModuleClasses::enabled_ = false;
+std::map<std::string, int> ModuleClasses::classIds_;
+std::vector<ModuleClasses::ModuleClass> ModuleClasses::classes_;
+
+namespace {
+  const double PositionBand = 1e-3;   // mm, within which two modules have the same radius or z
+}
+
+std::string ModuleClasses::signature(const DetectorModule& m) {
+  UniRef ref = m.uniRef();
+  std::ostringstream signature;
+  signature << std::setprecision(9)
+            << ref.subdetectorName << "|" << ref.layer << "|" << ref.ring << "|"
+            << m.moduleType() << "|" << m.summaryFullType() << "|" << m.numSensors() << "|";
+  for (const Sensor& s : m.sensors()) signature << int(s.type()) << "," << s.numStripsAcrossEstimate() << "," << s.numSegmentsEstimate() << "," << s.totalROCs() << "|";
+  signature << m.dsDistance() << "|" << m.sensorThickness() << "|" << m.area() << "|" << m.length() << "|"
+            << m.minWidth() << "|" << m.maxWidth() << "|" << m.tiltAngle() << "|" << m.skewAngle() << "|"
+            << m.triggerWindow() << "|" << int(m.zCorrelation()) << "|"
+            << m.effectiveDsDistance() << "|" << m.geometricEfficiency() << "|" << m.outerSensor().pitch() << "|" << m.outerSensor().stripLength() << "|"
+            << SimParms::getInstance().magField() << "|"
+            << m.nominalResolutionLocalX() << "|" << m.nominalResolutionLocalY() << "|"
+            << m.operatingTemp() << "|" << m.biasVoltage() << "|"
+            << lround(m.center().Rho() / PositionBand) << "|" << lround(m.center().Z() / PositionBand);
+  return signature.str();
+}
+
+void ModuleClasses::classify(Tracker& tracker) {
+  int numBefore = classes_.size();
+  for (Module* m : tracker.modules()) {
+    auto found = classIds_.insert(std::make_pair(signature(*m), int(classes_.size())));
+    if (found.second) classes_.push_back(ModuleClass{m->subdetectorName(), 0});
+    classes_[found.first->second].numModules++;
+    m->setEquivalenceClass(found.first->second);
+  }
+  logINFO(tracker.myid() + ": " + any2str(tracker.modules().size()) + " modules in " + any2str(int(classes_.size()) - numBefore) + " equivalence classes");
+}
+
+std::map<std::string, ModuleClasses::CacheStatistics>& ModuleClasses::allCacheStatistics() {
+  static std::map<std::string, CacheStatistics> statistics; // Built on first use, as the caches may be static objects
+  return statistics;
+}
+
+ModuleClasses::CacheStatistics& ModuleClasses::cacheStatistics(const std::string& cacheName) {
+  return allCacheStatistics()[cacheName];
+}
+
+void ModuleClasses::logReport() {
+  std::map<std::string, std::pair<long, long> > subdetectors; // modules, classes
+  long numModules = 0;
+  int largestClass = 0;
+  for (const ModuleClass& c : classes_) {
+    subdetectors[c.subdetectorName].first += c.numModules;
+    subdetectors[c.subdetectorName].second++;
+    numModules += c.numModules;
+    largestClass = std::max(largestClass, c.numModules);
+  }
+
+  std::ostringstream report;
+  report << std::fixed << std::setprecision(1);
+  report << "Module equivalence classes: " << numModules << " modules in " << classes_.size() << " classes";
+  if (!classes_.empty()) report << " (" << double(numModules) / classes_.size() << " modules per class on average, " << largestClass << " at most)";
+  report << std::endl;
+  for (const auto& subdetector : subdetectors) {
+    report << "  " << subdetector.first << ": " << subdetector.second.first << " modules in " << subdetector.second.second << " classes" << std::endl;
+  }
+  for (const auto& cache : allCacheStatistics()) {
+    const CacheStatistics& s = cache.second;
+    long lookups = s.hits + s.computations + s.unclassified;
+    report << "  cache '" << cache.first << "': " << lookups << " lookups, " << s.hits << " hits";
+    if (lookups > 0) report << " (" << 100. * s.hits / lookups << "%)";
+    report << ", " << s.computations << " computations";
+    if (s.unclassified > 0) report << ", " << s.unclassified << " on unclassified modules";
+    report << std::endl;
+  }
+  logINFO(report);
+}
@@ -0,0 +1,180 @@
+#include "ModuleSpatialIndex.hh"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+  // Safety margins absorbing the rounding of the exact hit finding (intersection point vs. track direction)
+  const double PhiMargin = 1e-4;
+  const double EtaMargin = 1e-4;
+}
+
+ModuleSpatialIndex::ModuleSpatialIndex(int numPhiBins, int numEtaBins) :
+  numPhiBins_(numPhiBins),
+  numEtaBins_(numEtaBins),
+  zTolerance_(0.),
+  minEta_(0.),
+  maxEta_(0.) {}
+
+void ModuleSpatialIndex::clear() {
+  modules_.clear();
+  buckets_.clear();
+  all_.clear();
+  outside_.clear();
+  frozen_.clear();
+}
+
+/**
+ * Computes the phi and eta span of all the sensor envelopes of a module, as seen from any point of the beam axis
+ * with |z| < zTolerance_. The phi span is computed around the phi of the first vertex, so that modules sitting
+ * across phi = +-pi get a contiguous range (which can then extend outside of <-pi;+pi>). Modules whose envelopes
+ * span more than pi in phi could contain the beam axis: they are flagged to be registered everywhere.
+ */
+ModuleSpatialIndex::Envelope ModuleSpatialIndex::computeEnvelope(const Module& m) const {
+  Envelope env;
+  env.anywhere = false;
+
+  std::vector<XYZVector> vertices;
+  for (const auto& s : m.sensors()) vertices.insert(vertices.end(), s.envelopePoly().begin(), s.envelopePoly().end());
+  if (vertices.empty()) { env.anywhere = true; return env; }
+
+  double refPhi = vertices.front().Phi();
+  double minDeltaPhi = 0., maxDeltaPhi = 0.;
+  double minR = std::numeric_limits<double>::max(), maxR = 0.;
+  double minZ = std::numeric_limits<double>::max(), maxZ = -std::numeric_limits<double>::max();
+  for (auto it = vertices.begin(); it != vertices.end(); ++it) {
+    double deltaPhi = it->Phi() - refPhi;
+    if (deltaPhi > M_PI) deltaPhi -= 2*M_PI;
+    else if (deltaPhi <= -M_PI) deltaPhi += 2*M_PI;
+    minDeltaPhi = MIN(minDeltaPhi, deltaPhi);
+    maxDeltaPhi = MAX(maxDeltaPhi, deltaPhi);
+    maxR = MAX(maxR, it->Rho());
+    minZ = MIN(minZ, it->Z());
+    maxZ = MAX(maxZ, it->Z());
+    // the closest point to the beam axis lies on the transverse projection of one of the segments joining two vertices
+    XYZVector v0(it->X(), it->Y(), 0.);
+    minR = MIN(minR, v0.R());
+    for (auto jt = it + 1; jt != vertices.end(); ++jt) {
+      XYZVector v1(jt->X(), jt->Y(), 0.);
+      if ((v1 - v0).Mag2() > 0.) minR = MIN(minR, CoordinateOperations::computeDistanceVector(v0, v1).R());
+    }
+  }
+
+  if (maxDeltaPhi - minDeltaPhi >= M_PI - 2*PhiMargin || minR <= 0.) { env.anywhere = true; return env; }
+
+  env.minPhi = refPhi + minDeltaPhi - PhiMargin;
+  env.maxPhi = refPhi + maxDeltaPhi + PhiMargin;
+
+  double eta1 = (XYZVector(0., maxR, maxZ + zTolerance_)).Eta();
+  double eta2 = (XYZVector(0., minR, minZ - zTolerance_)).Eta();
+  double eta3 = (XYZVector(0., minR, maxZ + zTolerance_)).Eta();
+  double eta4 = (XYZVector(0., maxR, minZ - zTolerance_)).Eta();
+  auto minMaxEta = std::minmax({eta1, eta2, eta3, eta4});
+  env.minEta = minMaxEta.first - EtaMargin;
+  env.maxEta = minMaxEta.second + EtaMargin;
+
+  return env;
+}
+
+int ModuleSpatialIndex::phiBin(double phi) const {
+  return floor((phi + M_PI) / (2*M_PI) * numPhiBins_); // not wrapped: callers take care of it
+}
+
+int ModuleSpatialIndex::etaBin(double eta) const {
+  int bin = floor((eta - minEta_) / (maxEta_ - minEta_) * numEtaBins_);
+  return MAX(0, MIN(numEtaBins_ - 1, bin));
+}
+
+/**
+ * Builds the grid for a collection of modules, which must not be moved anymore afterwards.
+ * @param modules The modules to index, in the order in which they are scanned by the brute-force hit finding
+ * @param zTolerance The maximum |z| of the track origins the grid has to be valid for
+ */
+void ModuleSpatialIndex::build(const std::vector<Module*>& modules, double zTolerance) {
+  clear();
+  modules_ = modules;
+  zTolerance_ = zTolerance;
+  frozen_.freeze(modules_, zTolerance);
+
+  std::vector<Envelope> envelopes;
+  envelopes.reserve(modules_.size());
+  minEta_ = std::numeric_limits<double>::max();
+  maxEta_ = -std::numeric_limits<double>::max();
+  for (int i = 0; i < (int)modules_.size(); i++) {
+    all_.push_back(i);
+    envelopes.push_back(computeEnvelope(*modules_[i]));
+    const Envelope& env = envelopes.back();
+    if (env.anywhere) continue;
+    minEta_ = MIN(minEta_, env.minEta);
+    maxEta_ = MAX(maxEta_, env.maxEta);
+  }
+  if (minEta_ >= maxEta_) { minEta_ = -1.; maxEta_ = 1.; } // no module with a finite envelope: any span will do
+
+  buckets_.resize(numPhiBins_ * numEtaBins_);
+  for (int i = 0; i < (int)modules_.size(); i++) {
+    const Envelope& env = envelopes[i];
+    if (env.anywhere) {
+      outside_.push_back(i);
+      for (auto& bucket : buckets_) bucket.push_back(i);
+      continue;
+    }
+    int firstPhiBin = phiBin(env.minPhi);
+    int lastPhiBin = MIN(phiBin(env.maxPhi), firstPhiBin + numPhiBins_ - 1);
+    int firstEtaBin = etaBin(env.minEta), lastEtaBin = etaBin(env.maxEta);
+    for (int p = firstPhiBin; p <= lastPhiBin; p++) {
+      int wrappedP = ((p % numPhiBins_) + numPhiBins_) % numPhiBins_;
+      for (int e = firstEtaBin; e <= lastEtaBin; e++) buckets_[wrappedP * numEtaBins_ + e].push_back(i);
+    }
+  }
+}
+
+/**
+ * Returns the indices of the modules which could be hit by a straight track, sorted by increasing index.
+ * The full list of modules is returned when the track origin is not covered by the grid.
+ */
+const ModuleSpatialIndex::Candidates& ModuleSpatialIndex::candidates(const XYZVector& origin, const XYZVector& direction) const {
+  if (buckets_.empty() || origin.Rho() > 0. || fabs(origin.Z()) > zTolerance_ || direction.Rho() <= 0.) return all_;
+  double eta = direction.Eta();
+  if (eta < minEta_ || eta > maxEta_) return outside_;
+  int p = MIN(phiBin(direction.Phi()), numPhiBins_ - 1);
+  p = MAX(0, p);
+  return buckets_[p * numEtaBins_ + etaBin(eta)];
+}
+
+/**
+ * Returns the candidates of a track, narrowed with the closed-form intersection backend to the modules whose sensors
+ * the track crosses, all tested in one batch: FrozenModules::checkTrackHits, which runs the same test one module at
+ * a time with that backend, finds the same hits among them. With the area backend, the candidates are returned as they are.
+ * @param crossed Storage for the narrowed list, which is then returned
+ */
+const ModuleSpatialIndex::Candidates& ModuleSpatialIndex::candidates(const XYZVector& origin, const XYZVector& direction, Candidates& crossed) const {
+  const Candidates& found = candidates(origin, direction);
+  if (!RayIntersection::isClosedForm()) return found;
+  frozen_.crossedCandidates(found, origin, direction, crossed);
+  return crossed;
+}
+
+/**
+ * Exhaustively looks for modules hit by the track which were not returned as candidates, with the same
+ * sensor test as DetectorModule::checkTrackHits (but without incrementing the module hit counters).
+ * An empty result means the indexed scan gives exactly the same hits as the brute-force one.
+ */
+std::vector<int> ModuleSpatialIndex::missedHits(const XYZVector& origin, const XYZVector& direction) const {
+  std::vector<int> result;
+  const Candidates& found = candidates(origin, direction);
+  std::vector<bool> crossed;
+  if (RayIntersection::isClosedForm()) frozen_.crossedModules(origin, direction, crossed); // all the modules in one batch
+  auto candIt = found.begin();
+  for (int i = 0; i < (int)modules_.size(); i++) {
+    if (candIt != found.end() && *candIt == i) { ++candIt; continue; }
+    bool hit;
+    if (!crossed.empty()) hit = crossed[i];
+    else {
+      const Module& m = *modules_[i];
+      hit = m.innerSensor().checkHitSegment(origin, direction).second > -1;
+      if (!hit && m.numSensors() != 1) hit = m.outerSensor().checkHitSegment(origin, direction).second > -1;
+    }
+    if (hit) result.push_back(i);
+  }
+  return result;
+}
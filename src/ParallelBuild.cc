@@ -0,0 +1,42 @@
+/**
+ * @file ParallelBuild.cc
+ * @brief Concurrent construction of the independent parts of a tracker geometry
+ */
+
+#include "ParallelBuild.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <TROOT.h>
+
+int ParallelBuild::numThreads_ = 1;
+thread_local bool ParallelBuild::inTask_ = false;
+
+void ParallelBuild::run(const std::vector<std::function<void()> >& tasks) {
+  int numThreads = std::min<int>(numThreads_, tasks.size());
+  if (numThreads <= 1 || inTask_) {
+    for (const auto& task : tasks) task();
+    return;
+  }
+  ROOT::EnableThreadSafety();
+
+  std::atomic<unsigned int> nextTask(0);
+  std::vector<std::exception_ptr> errors(tasks.size());
+  std::vector<std::thread> threads;
+  for (int iThread = 0; iThread < numThreads; iThread++) {
+    threads.emplace_back([&tasks, &nextTask, &errors]() {
+      inTask_ = true;
+      for (unsigned int i = nextTask++; i < tasks.size(); i = nextTask++) {
+        try {
+          tasks[i]();
+        } catch (...) {
+          errors[i] = std::current_exception();
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  for (auto& error : errors) if (error) std::rethrow_exception(error);
+}
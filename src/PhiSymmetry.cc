@@ -0,0 +1,191 @@
+/**
+ * @file PhiSymmetry.cc
+ * @brief Detection of the azimuthal symmetry of a built tracker
+ */
+
+#include "PhiSymmetry.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+#include <tuple>
+#include <Math/GenVector/RotationZ.h>
+
+#include "Tracker.hh"
+#include "MessageLogger.hh"
+#include "global_funcs.hh"
+
+bool PhiSymmetry::enabled_ = false;
+
+namespace {
+
+  const double PositionTolerance = 1e-3;   // mm, between a rotated module and its image
+  const double DirectionTolerance = 1e-6;
+
+  //
+  // Properties a module shares with its images, placement aside
+  //
+  std::string moduleSignature(const Module& m) {
+    UniRef ref = m.uniRef();
+    std::ostringstream signature;
+    signature << std::fixed << std::setprecision(4)
+              << ref.subdetectorName << "|" << ref.layer << "|" << ref.ring << "|" << ref.side << "|"
+              << m.moduleType() << "|" << m.summaryFullType() << "|" << m.numSensors() << "|"
+              << m.dsDistance() << "|" << m.sensorThickness() << "|" << m.area() << "|"
+              << m.operatingTemp() << "|" << m.biasVoltage() << "|"
+              << m.nominalResolutionLocalX() << "|" << m.nominalResolutionLocalY() << "|"
+              << m.tiltAngle() << "|" << m.skewAngle();
+    return signature.str();
+  }
+
+  //
+  // Modules looked up by the position of their centre
+  //
+  class CentreGrid {
+  public:
+    explicit CentreGrid(const std::vector<const Module*>& modules) : modules_(modules) {
+      for (unsigned int i = 0; i < modules.size(); i++) cells_[cell(modules[i]->center())].push_back(i);
+    }
+    int find(const XYZVector& position) const {
+      Cell c = cell(position);
+      for (long dx = -1; dx <= 1; dx++) for (long dy = -1; dy <= 1; dy++) for (long dz = -1; dz <= 1; dz++) {
+        auto it = cells_.find(Cell(std::get<0>(c) + dx, std::get<1>(c) + dy, std::get<2>(c) + dz));
+        if (it == cells_.end()) continue;
+        for (int i : it->second) if ((modules_[i]->center() - position).R() < PositionTolerance) return i;
+      }
+      return -1;
+    }
+  private:
+    typedef std::tuple<long, long, long> Cell;
+    static Cell cell(const XYZVector& p) { return Cell(lround(floor(p.X())), lround(floor(p.Y())), lround(floor(p.Z()))); } // 1 mm cells
+    const std::vector<const Module*>& modules_;
+    std::map<Cell, std::vector<int> > cells_;
+  };
+
+  //
+  // Image of each module by the rotation of 2 pi / folds, or an empty vector if a module has none
+  //
+  std::vector<int> rotationImages(const std::vector<const Module*>& modules, const std::vector<std::string>& signatures,
+                                  const CentreGrid& grid, int folds) {
+    ROOT::Math::RotationZ rotation(2*M_PI / folds);
+    std::vector<int> images(modules.size());
+    for (unsigned int i = 0; i < modules.size(); i++) {
+      const Module& m = *modules[i];
+      int image = grid.find(rotation(m.center()));
+      if (image < 0 || signatures[image] != signatures[i]) return std::vector<int>();
+      const Module& im = *modules[image];
+      if ((rotation(m.normal()) - im.normal()).R() > DirectionTolerance) return std::vector<int>();
+      for (int v = 0; v < m.basePoly().getNumSides(); v++) {
+        if ((rotation(m.basePoly().getVertex(v)) - im.basePoly().getVertex(v)).R() > PositionTolerance) return std::vector<int>();
+      }
+      images[i] = image;
+    }
+    return images;
+  }
+
+  long greatestCommonDivisor(long a, long b) { return b == 0 ? a : greatestCommonDivisor(b, a % b); }
+}
+
+/**
+ * Find the largest N for which the rotation by 2 pi / N maps the tracker onto itself, and group its modules by rotation
+ */
+PhiSymmetry PhiSymmetry::detect(const Tracker& tracker) {
+  PhiSymmetry symmetry;
+  std::vector<const Module*> modules(tracker.modules().begin(), tracker.modules().end());
+  if (modules.empty()) {
+    symmetry.reason_ = "no modules";
+    return symmetry;
+  }
+
+  // The number of folds divides the number of equivalent modules at each (r, z) position
+  std::vector<std::string> signatures;
+  std::map<std::string, long> positionCounts;
+  for (const Module* m : modules) {
+    signatures.push_back(moduleSignature(*m));
+    std::ostringstream position;
+    position << std::fixed << std::setprecision(2) << signatures.back() << "|" << m->center().Rho() << "|" << m->center().Z();
+    positionCounts[position.str()]++;
+  }
+  long commonDivisor = 0;
+  for (const auto& count : positionCounts) commonDivisor = greatestCommonDivisor(count.second, commonDivisor);
+
+  CentreGrid grid(modules);
+  std::vector<int> images;
+  for (long folds = commonDivisor; folds > 1 && images.empty(); folds--) {
+    if (commonDivisor % folds != 0) continue;
+    images = rotationImages(modules, signatures, grid, folds);
+    if (!images.empty()) symmetry.folds_ = folds;
+  }
+  if (commonDivisor <= 1) symmetry.reason_ = "the numbers of equivalent modules at the same (r, z) have no common divisor (removed or special modules)";
+  else if (images.empty()) symmetry.reason_ = "no rotation maps every module onto an equivalent one (removed or special modules, irregular placement)";
+  else symmetry.reason_ = "the numbers of equivalent modules at the same (r, z) allow no larger symmetry";
+
+  // Orbits, starting from the module closest to phi = 0 counterclockwise
+  if (symmetry.isSymmetric()) {
+    std::vector<bool> assigned(modules.size(), false);
+    for (unsigned int i = 0; i < modules.size(); i++) {
+      if (assigned[i]) continue;
+      std::vector<const Module*> orbit;
+      int current = i;
+      for (int k = 0; k < symmetry.folds_ && !assigned[current]; k++) {
+        assigned[current] = true;
+        orbit.push_back(modules[current]);
+        current = images[current];
+      }
+      auto phi = [](const Module* m) { double p = m->center().Phi(); return p < 0 ? p + 2*M_PI : p; };
+      std::rotate(orbit.begin(), std::min_element(orbit.begin(), orbit.end(), [&](const Module* a, const Module* b) { return phi(a) < phi(b); }), orbit.end());
+      for (unsigned int k = 0; k < orbit.size(); k++) symmetry.orbitIndex_[orbit[k]] = std::make_pair(int(symmetry.orbits_.size()), int(k));
+      symmetry.orbits_.push_back(orbit);
+    }
+  }
+
+  if (symmetry.isSymmetric()) logINFO(tracker.myid() + ": " + any2str(symmetry.folds_) + "-fold phi symmetry found, " + any2str(symmetry.orbits_.size()) + " modules per sector");
+  else logINFO(tracker.myid() + ": no phi symmetry, " + symmetry.reason_);
+  return symmetry;
+}
+
+void PhiSymmetry::record(const Tracker& tracker) {
+  if (enabled_) tracker.setPhiSymmetry(std::unique_ptr<const PhiSymmetry>(new PhiSymmetry(detect(tracker))));
+}
+
+const PhiSymmetry& PhiSymmetry::forAnalysis(const Tracker& tracker) {
+  static const PhiSymmetry none;
+  if (!enabled_) return none;
+  if (!tracker.phiSymmetry()) record(tracker);
+  return *tracker.phiSymmetry();
+}
+
+double PhiSymmetry::foldPhi(double phi) const {
+  double width = sectorWidth();
+  double folded = fmod(phi, width);
+  return folded < 0 ? folded + width : folded;
+}
+
+std::vector<double> PhiSymmetry::images(double phi) const {
+  if (folds_ == 1) return std::vector<double>(1, phi);
+  std::vector<double> result;
+  for (int k = 0; k < folds_; k++) {
+    double image = fmod(phi + k*sectorWidth() + M_PI, 2*M_PI);
+    result.push_back((image < 0 ? image + 2*M_PI : image) - M_PI);
+  }
+  return result;
+}
+
+const Module& PhiSymmetry::representative(const Module& module) const {
+  auto index = orbitIndex_.find(&module);
+  return index != orbitIndex_.end() ? *orbits_[index->second.first].front() : module;
+}
+
+std::vector<const Module*> PhiSymmetry::orbit(const Module& module) const {
+  auto index = orbitIndex_.find(&module);
+  return index != orbitIndex_.end() ? orbits_[index->second.first] : std::vector<const Module*>(1, &module);
+}
+
+const Module& PhiSymmetry::image(const Module& module, int sectors) const {
+  auto index = orbitIndex_.find(&module);
+  if (index == orbitIndex_.end()) return module;
+  const std::vector<const Module*>& orbit = orbits_[index->second.first];
+  int position = (index->second.second + sectors) % folds_;
+  return *orbit[position < 0 ? position + folds_ : position];
+}
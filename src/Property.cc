@@ -16,3 +16,4 @@ std::function<bool()> cacheIf(const bool& flag) { return [&flag]() { return flag
 
 std::set<string> PropertyObject::globalMatchedProperties_;
 std::set<string> PropertyObject::globalUnmatchedProperties_;
+std::mutex PropertyObject::globalPropertiesMutex_;
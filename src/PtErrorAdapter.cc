@@ -1,12 +1,26 @@
 #include "PtErrorAdapter.hh"
+
+#include <sstream>
+#include <iomanip>
+
 #include "SimParms.hh"
 #include "Units.hh"
+#include "ModuleClasses.hh"
+#include "MessageLogger.hh"
+#include "global_funcs.hh"
 
 const double PtErrorAdapter::minimumPt = 0.3*Units::GeV;
 const double PtErrorAdapter::maximumPt = 30*Units::GeV;
 
 const double PtErrorAdapter::ptMinFit = 0.22*Units::GeV;
 const double PtErrorAdapter::ptMaxFit = 10.*Units::GeV;
+const double PtErrorAdapter::ptStep = 0.05*Units::GeV;
+const double PtErrorAdapter::rateTolerance = 0.02;
+
+RateIntegration PtErrorAdapter::s_rateIntegration = RateIntegration::DIRECT;
+std::map<std::string, PtErrorAdapter::RateTable> PtErrorAdapter::s_rateTables;
+std::mutex PtErrorAdapter::s_rateTablesMutex;
+
 // log(pt/z) distribution parameters for 12000 events at 14 TeV
 const double PtErrorAdapter::ptFitParamsLow[]  = { 2.52523e+01, -6.84183e+00, -1.20149e+01,  1.89314e+00}; // 0.22 GeV to 1 GeV  Chi^2 / dof = 22.0408/16 = 1.37755
 const double PtErrorAdapter::ptFitParamsMid[]  = { 7.27638e-01, -1.04041e+00,  8.56495e+00,  6.52714e-03}; // 1 GeV to 4 GeV     Chi^2 / dof = 84.2299/71 = 1.18634
@@ -48,8 +62,6 @@ double PtErrorAdapter::getTriggerProbability(const double& trackPt, const double
   return result;
 }
 
-// TODO: this is VERY ugly!!! :( sorry: hurry !
-
 double PtErrorAdapter::getTriggerFrequencyTruePerEventAbove(const double& myCut) {
   return getTriggerFrequencyTruePerEventBetween(myCut, ptMaxFit);
 }
@@ -62,60 +74,119 @@ double PtErrorAdapter::getTriggerFrequencyTruePerEventBelow(const double& myCut)
   return getTriggerFrequencyTruePerEventBetween(ptMinFit, myCut);
 }
 
-// TODO: this and the next one should be merged in the same code...
 double PtErrorAdapter::getTriggerFrequencyTruePerEventBetween(double myLowCut, double myHighCut) { 
+  return integrate(myLowCut, myHighCut, true);
+}
+
+double PtErrorAdapter::getParticleFrequencyPerEventBetween(double myLowCut, double myHighCut) {
+  return integrate(myLowCut, myHighCut, false);
+}
+
+// Number of particles per event per unit of pt and pseudorapidity
+double PtErrorAdapter::particleSpectrum(double pt) {
+  const double* ptFitParams;
+  if      (pt < 1*Units::GeV) ptFitParams = ptFitParamsLow;
+  else if (pt < 6*Units::GeV) ptFitParams = ptFitParamsMid;
+  else                        ptFitParams = ptFitParamsHigh;
+
+  // TODO: nPt was fitted originally in different units, GeV=1, not GeV=1000 -> hence pt/1000 & final multiplying by 1000
+  double nPt = exp(ptFitParams[0]
+                   + ptFitParams[1] * pt/1000.
+                   + ptFitParams[2] * pow(pt/1000.,-0.1)
+                   + ptFitParams[3] * pow(pt/1000.,2))/12000 * 1000.;
+  return nPt/4e-2;
+}
+
+double PtErrorAdapter::etaPhiAperture() const {
+  return mod_.phiAperture()/(2.0*M_PI)*fabs(mod_.etaAperture())/6.0;
+}
+
+double PtErrorAdapter::integrate(double myLowCut, double myHighCut, bool triggered) {
+  if (s_rateIntegration == RateIntegration::DIRECT) return integrateDirect(myLowCut, myHighCut, triggered);
+  double tabulated = integrateTabulated(myLowCut, myHighCut, triggered);
+  if (s_rateIntegration == RateIntegration::TABULATED) return tabulated;
+
+  double direct = integrateDirect(myLowCut, myHighCut, triggered);
+  if (fabs(tabulated - direct) > rateTolerance*fabs(direct)) {
+    logWARNING(std::string(triggered ? "True stub" : "Particle") + " rate of module " + mod_.uniRef().subdetectorName + " " + any2str(mod_.uniRef().layer) + " ring " + any2str(mod_.uniRef().ring) + " between " + any2str(myLowCut/Units::GeV) + " and "
+               + any2str(myHighCut/Units::GeV) + " GeV -> tabulated " + any2str(tabulated) + " vs direct " + any2str(direct));
+  }
+  return direct;
+}
+
+// Sum over the pt grid between the cuts, the grid starting from the lowest pt reaching the module
+double PtErrorAdapter::integrateDirect(double myLowCut, double myHighCut, bool triggered) {
   if (myLowCut<ptMinFit) myLowCut=ptMinFit;
   if (myHighCut>ptMaxFit) myHighCut=ptMaxFit;
   double r        = mod_.center().Rho();
   double ptMin    = MAX(0.3 * SimParms::getInstance().magField() * r, myLowCut);
   double integral = 0.0;
-  double dPt      = 0.05*Units::GeV;
-  double etaphi   = mod_.phiAperture()/(2.0*M_PI)*fabs(mod_.etaAperture())/6.0;
-  double nPt;
-  const double* ptFitParams;
-  for (double pt = ptMin; pt < myHighCut; pt += dPt) {
-    if      (pt < 1*Units::GeV) ptFitParams = ptFitParamsLow;
-    else if (pt < 6*Units::GeV) ptFitParams = ptFitParamsMid;
-    else                        ptFitParams = ptFitParamsHigh;
-
-    // TODO: // nPt was fitted originally in different units, GeV=1, not GeV=1000 -> hence pt/1000 & final multiplying by 1000
-    nPt = exp(ptFitParams[0]
-              + ptFitParams[1] * pt/1000.
-              + ptFitParams[2] * pow(pt/1000.,-0.1)
-              + ptFitParams[3] * pow(pt/1000.,2))/12000 * 1000.;
-
-    integral += getTriggerProbability(pt) * (nPt/4e-2) * etaphi * dPt;
+  double etaphi   = etaPhiAperture();
+  for (double pt = ptMin; pt < myHighCut; pt += ptStep) {
+    double nPt = particleSpectrum(pt) * etaphi * ptStep;
+    integral += triggered ? getTriggerProbability(pt) * nPt : nPt;
   }
 
   return integral;
 }
 
-// TODO: this and the previous one should be merged in the same code...
-double PtErrorAdapter::getParticleFrequencyPerEventBetween(double myLowCut, double myHighCut) {
+// Difference of the cumulative rates at both ends of the grid of the table, which starts at table.ptStart. When the
+// lower cut falls between two points of the table, the cumulative rates are interpolated linearly, whereas the direct
+// sum restarts its grid at the cut: the two then differ by a fraction of one pt step, which VALIDATE reports when
+// beyond rateTolerance
+double PtErrorAdapter::integrateTabulated(double myLowCut, double myHighCut, bool triggered) {
   if (myLowCut<ptMinFit) myLowCut=ptMinFit;
   if (myHighCut>ptMaxFit) myHighCut=ptMaxFit;
-  double r        = mod_.center().Rho();
-  double ptMin    = MAX(0.3 * SimParms::getInstance().magField() * r, myLowCut);
-  double integral = 0.0;
-  double dPt      = 0.05*Units::GeV;
-  double etaphi = mod_.phiAperture()/(2.0*M_PI)*fabs(mod_.etaAperture())/6.0;
-  double nPt;
-  const double* ptFitParams;
-  for (double pt = ptMin; pt < myHighCut; pt += dPt) {
-    if      (pt < 1*Units::GeV) ptFitParams = ptFitParamsLow;
-    else if (pt < 6*Units::GeV) ptFitParams = ptFitParamsMid;
-    else                        ptFitParams = ptFitParamsHigh;
-
-    // TODO: nPt was fitted originally in different units, GeV=1, not GeV=1000 -> hence pt/1000 & final multiplying by 1000
-    nPt = exp(ptFitParams[0]
-              + ptFitParams[1] * pt/1000.
-              + ptFitParams[2] * pow(pt/1000.,-0.1)
-              + ptFitParams[3] * pow(pt/1000.,2))/12000 * 1000.;
-
-    integral += (nPt/4e-2) * etaphi * dPt;
-  }
+  const RateTable& table = rateTable();
+  double ptMin = MAX(table.ptStart, myLowCut);
+  if (ptMin >= myHighCut) return 0.;
+  double ptMax = ptMin + ceil((myHighCut - ptMin) / ptStep) * ptStep;
+  const std::vector<double>& rates = triggered ? table.triggers : table.particles;
+  return (table.cumulative(rates, ptMax) - table.cumulative(rates, ptMin)) * etaPhiAperture();
+}
 
-  return integral;
+double PtErrorAdapter::RateTable::cumulative(const std::vector<double>& rates, double pt) const {
+  double index = (pt - ptStart) / ptStep;
+  if (index <= 0.) return rates.front();
+  if (index >= rates.size() - 1) return rates.back();
+  size_t below = size_t(index);
+  double fraction = index - below;
+  return rates[below] + fraction * (rates[below + 1] - rates[below]);
+}
+
+std::string PtErrorAdapter::stubSignature() const {
+  std::ostringstream key;
+  key << std::setprecision(9)
+      << int(mod_.subdet()) << "|" << int(mod_.zCorrelation()) << "|" << mod_.triggerWindow() << "|" << mod_.dsDistance() << "|"
+      << mod_.effectiveDsDistance() << "|" << mod_.outerSensor().pitch() << "|" << mod_.outerSensor().stripLength() << "|"
+      << mod_.length() << "|" << mod_.tiltAngle() << "|" << mod_.geometricEfficiency() << "|"
+      << fabs(mod_.center().Z()) << "|" << mod_.center().Rho() << "|" << SimParms::getInstance().magField();
+  return key.str();
+}
+
+const PtErrorAdapter::RateTable& PtErrorAdapter::rateTable() {
+  static ModuleClassCache<const RateTable*> classRateTables("PtErrorAdapter rate tables");
+  std::lock_guard<std::mutex> lock(s_rateTablesMutex);
+  return *classRateTables.get(mod_, [this](const DetectorModule&) { return &buildRateTable(); });
+}
+
+// Table shared by the modules with the same stub signature, built on first use
+const PtErrorAdapter::RateTable& PtErrorAdapter::buildRateTable() {
+  std::string key = stubSignature();
+  auto found = s_rateTables.find(key);
+  if (found != s_rateTables.end()) return found->second;
+
+  RateTable& table = s_rateTables[key];
+  table.ptStart = MAX(0.3 * SimParms::getInstance().magField() * mod_.center().Rho(), ptMinFit);
+  table.particles.push_back(0.);
+  table.triggers.push_back(0.);
+  // One point beyond ptMaxFit, the last step of a direct sum reaching past it
+  for (double pt = table.ptStart; pt < ptMaxFit + ptStep; pt += ptStep) {
+    double nPt = particleSpectrum(pt) * ptStep;
+    table.particles.push_back(table.particles.back() + nPt);
+    table.triggers.push_back(table.triggers.back() + getTriggerProbability(pt) * nPt);
+  }
+  return table;
 }
 
 double PtErrorAdapter::getTriggerFrequencyFakePerEvent() {
@@ -0,0 +1,108 @@
+/**
+ * @file RayIntersection.cc
+ * @brief Closed-form crossing of straight tracks with triangles and with the quadrilaterals of the sensors
+ */
+
+#include "RayIntersection.hh"
+
+IntersectionBackend RayIntersection::backend_ = IntersectionBackend::AREA_SUM;
+constexpr double RayIntersection::FacingThreshold;
+constexpr double RayIntersection::EdgeTolerance;
+
+void PackedQuads::add(const Polygon3d<4>& poly) {
+  const XYZVector& v0 = poly.getVertex(0);
+  Coordinates* edges[3] = { &edge1_, &edge2_, &edge3_ };
+  for (int i = 0; i < 3; i++) {
+    XYZVector edge = poly.getVertex(i+1) - v0;
+    edges[i]->x.push_back(edge.X());
+    edges[i]->y.push_back(edge.Y());
+    edges[i]->z.push_back(edge.Z());
+  }
+  origin_.x.push_back(v0.X());
+  origin_.y.push_back(v0.Y());
+  origin_.z.push_back(v0.Z());
+  const XYZVector& normal = poly.getNormal();
+  normal_.x.push_back(normal.X());
+  normal_.y.push_back(normal.Y());
+  normal_.z.push_back(normal.Z());
+}
+
+void PackedQuads::clear() {
+  *this = PackedQuads();
+}
+
+bool RayIntersection::crossSensor(const Polygon3d<4>& poly, const XYZVector& orig, const XYZVector& dir, double& t) {
+  if (poly.getNormal().Dot(dir) < FacingThreshold) return false; // as in Polygon3d::isLineIntersecting, the sensor is not matched from the opposite direction
+  const XYZVector& first = poly.getVertex(0);
+  double o[3] = { orig.X(), orig.Y(), orig.Z() };
+  double d[3] = { dir.X(), dir.Y(), dir.Z() };
+  double v0[3] = { first.X(), first.Y(), first.Z() };
+  double e[3][3];
+  for (int i = 0; i < 3; i++) {
+    XYZVector edge = poly.getVertex(i+1) - first;
+    e[i][0] = edge.X(); e[i][1] = edge.Y(); e[i][2] = edge.Z();
+  }
+  return crossTriangle(o, d, v0, e[0], e[1], t) || crossTriangle(o, d, v0, e[1], e[2], t);
+}
+
+bool RayIntersection::crossSensor(const PackedQuads& quads, int index, const XYZVector& orig, const XYZVector& dir, double& t) {
+  unsigned char crossed;
+  crossQuads(quads, index, index+1, orig, dir, &t, &crossed);
+  return crossed;
+}
+
+/**
+ * Tests a track against a range of packed quadrilaterals, which it must cross along their normal.
+ * The line parameter is computed at the plane of each quadrilateral, so that no value is selected between the two
+ * triangles: the loop then only has straight-line arithmetic, and the compiler can vectorize it.
+ */
+void RayIntersection::crossQuads(const PackedQuads& quads, int first, int last, const XYZVector& orig, const XYZVector& dir, double* __restrict__ t, unsigned char* __restrict__ crossed) {
+  const double o[3] = { orig.X(), orig.Y(), orig.Z() };
+  const double d[3] = { dir.X(), dir.Y(), dir.Z() };
+  const double *ox = quads.origin_.x.data(), *oy = quads.origin_.y.data(), *oz = quads.origin_.z.data();
+  const double *e1x = quads.edge1_.x.data(), *e1y = quads.edge1_.y.data(), *e1z = quads.edge1_.z.data();
+  const double *e2x = quads.edge2_.x.data(), *e2y = quads.edge2_.y.data(), *e2z = quads.edge2_.z.data();
+  const double *e3x = quads.edge3_.x.data(), *e3y = quads.edge3_.y.data(), *e3z = quads.edge3_.z.data();
+  const double *nx = quads.normal_.x.data(), *ny = quads.normal_.y.data(), *nz = quads.normal_.z.data();
+
+  for (int i = first; i < last; i++) {
+    const double v0[3] = { ox[i], oy[i], oz[i] };
+    const double e1[3] = { e1x[i], e1y[i], e1z[i] };
+    const double e2[3] = { e2x[i], e2y[i], e2z[i] };
+    const double e3[3] = { e3x[i], e3y[i], e3z[i] };
+    double normDir = nx[i]*d[0] + ny[i]*d[1] + nz[i]*d[2];
+    double normDist = nx[i]*(v0[0] - o[0]) + ny[i]*(v0[1] - o[1]) + nz[i]*(v0[2] - o[2]);
+    double t1, t2; // unused: the same as the plane parameter for a planar quadrilateral
+    bool inside = crossTriangle(o, d, v0, e1, e2, t1) | crossTriangle(o, d, v0, e2, e3, t2);
+    t[i - first] = normDist / normDir;
+    crossed[i - first] = (normDir >= FacingThreshold) & inside;
+  }
+}
+
+/**
+ * Same test on a list of packed quadrilaterals, e.g. the candidates of a track in a spatial index: the loop is the
+ * same, with indexed loads
+ */
+void RayIntersection::crossQuads(const PackedQuads& quads, const int* indices, int count, const XYZVector& orig, const XYZVector& dir, double* __restrict__ t, unsigned char* __restrict__ crossed) {
+  const double o[3] = { orig.X(), orig.Y(), orig.Z() };
+  const double d[3] = { dir.X(), dir.Y(), dir.Z() };
+  const double *ox = quads.origin_.x.data(), *oy = quads.origin_.y.data(), *oz = quads.origin_.z.data();
+  const double *e1x = quads.edge1_.x.data(), *e1y = quads.edge1_.y.data(), *e1z = quads.edge1_.z.data();
+  const double *e2x = quads.edge2_.x.data(), *e2y = quads.edge2_.y.data(), *e2z = quads.edge2_.z.data();
+  const double *e3x = quads.edge3_.x.data(), *e3y = quads.edge3_.y.data(), *e3z = quads.edge3_.z.data();
+  const double *nx = quads.normal_.x.data(), *ny = quads.normal_.y.data(), *nz = quads.normal_.z.data();
+
+  for (int k = 0; k < count; k++) {
+    const int i = indices[k];
+    const double v0[3] = { ox[i], oy[i], oz[i] };
+    const double e1[3] = { e1x[i], e1y[i], e1z[i] };
+    const double e2[3] = { e2x[i], e2y[i], e2z[i] };
+    const double e3[3] = { e3x[i], e3y[i], e3z[i] };
+    double normDir = nx[i]*d[0] + ny[i]*d[1] + nz[i]*d[2];
+    double normDist = nx[i]*(v0[0] - o[0]) + ny[i]*(v0[1] - o[1]) + nz[i]*(v0[2] - o[2]);
+    double t1, t2;
+    bool inside = crossTriangle(o, d, v0, e1, e2, t1) | crossTriangle(o, d, v0, e2, e3, t2);
+    t[k] = normDist / normDir;
+    crossed[k] = (normDir >= FacingThreshold) & inside;
+  }
+}
@@ -1,6 +1,7 @@
 // Project includes
 #include <RootWeb.hh>
 #include "global_funcs.hh"
+#include "StopWatch.hh"
 
 // standard includes
 #include <limits>
@@ -20,6 +21,14 @@
 #include <vector>
 #include <TColor.h>
 #include <TROOT.h>
+#include <TH1.h>
+#include <TGraph.h>
+#include <algorithm>
+#include <iterator>
+#include <atomic>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 // boost includes
 #include <boost/filesystem/exception.hpp>
@@ -183,6 +192,23 @@ pair<int, int> RootWTable::newLine() {
   return make_pair(serialRow_, serialCol_);
 }
 
+//*******************************************//
+// RootWImageExport                          //
+//*******************************************//
+
+void RootWImageExport::print() const {
+  gErrorIgnoreLevel = 1500;
+  canvas->SetName(canvasName.c_str());
+  canvas->cd();
+  canvas->SetCanvasSize(smallWidth, smallHeight);
+  // std::cerr << "Saving " << smallFileName << std::endl; // debug
+  canvas->Print(smallFileName.c_str());
+  canvas->SetCanvasSize(largeWidth, largeHeight);
+  for (vector<string>::const_iterator it=largeFileNames.begin(); it!=largeFileNames.end(); ++it) {
+    canvas->Print(it->c_str());
+  }
+}
+
 //*******************************************//
 // RootWImage                                //
 //*******************************************//
@@ -190,6 +216,7 @@ pair<int, int> RootWTable::newLine() {
 RootWImage::RootWImage() {
   imageCounter_++;
   myCanvas_ = NULL;
+  exportQueue_ = NULL;
   zoomedWidth_ = 0; zoomedHeight_ = 0;
   relativeHtmlDirectory_ = "";
   targetDirectory_ = "";
@@ -202,6 +229,7 @@ RootWImage::RootWImage() {
 RootWImage::RootWImage(TCanvas* myCanvas, int witdh, int height) {
   imageCounter_++;
   myCanvas_ = NULL;
+  exportQueue_ = NULL;
   setCanvas(myCanvas);
   setZoomedSize(witdh, height);
   relativeHtmlDirectory_ = "";
@@ -215,6 +243,7 @@ RootWImage::RootWImage(TCanvas* myCanvas, int witdh, int height) {
 RootWImage::RootWImage(TCanvas* myCanvas, int witdh, int height, string relativehtmlDirectory) {
   imageCounter_++;
   myCanvas_ = NULL;
+  exportQueue_ = NULL;
   setCanvas(myCanvas);
   setZoomedSize(witdh, height);
   setRelativeHtmlDirectory(relativehtmlDirectory);
@@ -228,6 +257,7 @@ RootWImage::RootWImage(TCanvas* myCanvas, int witdh, int height, string relative
 RootWImage::RootWImage(TCanvas& myCanvas, int witdh, int height) {
   imageCounter_++;
   myCanvas_ = NULL;
+  exportQueue_ = NULL;
   setCanvas(myCanvas);
   setZoomedSize(witdh, height);
   relativeHtmlDirectory_ = "";
@@ -241,6 +271,7 @@ RootWImage::RootWImage(TCanvas& myCanvas, int witdh, int height) {
 RootWImage::RootWImage(TCanvas& myCanvas, int witdh, int height, string relativehtmlDirectory) {
   imageCounter_++;
   myCanvas_ = NULL;
+  exportQueue_ = NULL;
   setCanvas(myCanvas);
   setZoomedSize(witdh, height);
   setRelativeHtmlDirectory(relativehtmlDirectory);
@@ -357,22 +388,29 @@ string RootWImage::saveFiles(int smallWidth, int smallHeight) {
   string smallCanvasCompleteFileName = targetDirectory_+"/"+smallCanvasFileName;
   string largeCanvasCompleteFileName = targetDirectory_+"/"+largeCanvasFileBaseName + ".png";
 
-  gErrorIgnoreLevel = 1500;
-  myCanvas_->cd();
-  myCanvas_->SetCanvasSize(canW, canH);
-  // std::cerr << "Saving " << largeCanvasCompleteFileName << std::endl; // debug
-  myCanvas_->Print(smallCanvasCompleteFileName.c_str());
-  myCanvas_->SetCanvasSize(zoomedWidth_, zoomedHeight_);
-  myCanvas_->Print(largeCanvasCompleteFileName.c_str());
+  RootWImageExport myExport;
+  myExport.canvas = myCanvas_;
+  myExport.canvasName = canvasName;
+  myExport.smallWidth = canW; myExport.smallHeight = canH;
+  myExport.largeWidth = zoomedWidth_; myExport.largeHeight = zoomedHeight_;
+  myExport.smallFileName = smallCanvasCompleteFileName;
+  myExport.largeFileNames.push_back(largeCanvasCompleteFileName);
 
   string fileTypeList;
   for (vector<string>::iterator it=fileTypeV_.begin(); it!=fileTypeV_.end(); ++it) {
     largeCanvasCompleteFileName = targetDirectory_+"/"+largeCanvasFileBaseName + "." + (*it);
-    myCanvas_->Print(largeCanvasCompleteFileName.c_str());
+    myExport.largeFileNames.push_back(largeCanvasCompleteFileName);
     if (it!=fileTypeV_.begin()) fileTypeList+="|";
     fileTypeList+=(*it);
   }
 
+  if (exportQueue_) {
+    myExport.cost = estimateCost(myCanvas_);
+    exportQueue_->push_back(myExport);
+  } else {
+    myExport.print();
+  }
+
   thisText << "<img class='wleftzoom' width='"<< imgW<<"' height='"<<imgH<<"' src='"<< relativeHtmlDirectory_ << "/" << smallCanvasFileName <<"' alt='"<< comment_ <<"' onclick=\"popupDiv('" << relativeHtmlDirectory_ << "/" << largeCanvasFileBaseName << "', "<< zoomedWidth_<<", "<< zoomedHeight_ << " , '"<< comment_ << "','"<<fileTypeList << "');\" />";
 
   myText_[myImageSize] = thisText.str();
@@ -381,6 +419,19 @@ string RootWImage::saveFiles(int smallWidth, int smallHeight) {
   return thisText.str();
 }
 
+// Rough estimate of the time needed to render a pad: number of histogram cells & graph points
+long RootWImage::estimateCost(TPad* basePad) {
+  long cost = 1;
+  TList* aList = basePad->GetListOfPrimitives();
+  for (int i=0; i<aList->GetEntries(); ++i) {
+    TObject* anObject = aList->At(i);
+    if (anObject->InheritsFrom(TPad::Class())) cost += estimateCost((TPad*) anObject);
+    else if (anObject->InheritsFrom(TH1::Class())) cost += ((TH1*) anObject)->GetNcells();
+    else if (anObject->InheritsFrom(TGraph::Class())) cost += ((TGraph*) anObject)->GetN();
+  }
+  return cost;
+}
+
 ostream& RootWImage::dump(ostream& output) {
   output << myText_[lastSize_];
   return output;
@@ -662,6 +713,7 @@ ostream& RootWContent::dump(ostream& output) {
     if (myItem->isImage()) {
       if ( (myImage=dynamic_cast<RootWImage*>(myItem)) ) {
         myImage->setTargetDirectory(targetDirectory_);
+        myImage->setExportQueue(getExportQueue());
 	if (summaryFile) myImage->saveSummary(baseName, summaryFile);
         myImage->saveFiles(THUMBSMALLSIZE, THUMBSMALLSIZE);
       } else {
@@ -696,6 +748,14 @@ TFile* RootWContent::getSummaryFile() {
   }
 }
 
+RootWImageExportQueue* RootWContent::getExportQueue() {
+  if (page_==nullptr) {
+    return nullptr;
+  } else {
+    return page_->getExportQueue();
+  }
+}
+
 //*******************************************//
 // RootWPage                                 //
 //*******************************************//
@@ -816,6 +876,14 @@ TFile* RootWPage::getSummaryFile() {
   }
 }
 
+RootWImageExportQueue* RootWPage::getExportQueue() {
+  if (site_) {
+    return site_->getExportQueue();
+  } else {
+    return nullptr;
+  }
+}
+
 
 //*******************************************//
 // RootWSite                                 //
@@ -832,6 +900,9 @@ RootWSite::RootWSite() {
   summaryFile_ = nullptr;
   createSummaryFile_ = true;
   summaryFileName_ = "summary.root";
+  exportWorkers_ = 1;
+  checkExport_ = false;
+  exportQueue_ = nullptr;
 }
 
 RootWSite::RootWSite(string title) {
@@ -845,6 +916,9 @@ RootWSite::RootWSite(string title) {
   summaryFile_ = nullptr;
   createSummaryFile_ = true;
   summaryFileName_ = "summary.root";
+  exportWorkers_ = 1;
+  checkExport_ = false;
+  exportQueue_ = nullptr;
 }
 
 RootWSite::RootWSite(string title, string comment) {
@@ -858,6 +932,9 @@ RootWSite::RootWSite(string title, string comment) {
   summaryFile_ = nullptr;
   createSummaryFile_ = true;
   summaryFileName_ = "summary.root";
+  exportWorkers_ = 1;
+  checkExport_ = false;
+  exportQueue_ = nullptr;
 }
 
 RootWSite::~RootWSite() {
@@ -1056,6 +1133,11 @@ bool RootWSite::makeSite(bool verbose) {
 				  targetDirectory_.c_str(),
 				  summaryFileName_.c_str()), "RECREATE");
   } else summaryFile_ = nullptr;
+
+  // With several export workers, the pages only queue their image files, which are printed at the end
+  RootWImageExportQueue exportQueue;
+  if (exportWorkers_>1) exportQueue_ = &exportQueue;
+
   for (it=pageList_.begin(); it!=pageList_.end(); it++) {
     myPage = (*it);
     if (verbose) std::cout << " " << myPage->getTitle() << std::flush;
@@ -1074,7 +1156,112 @@ bool RootWSite::makeSite(bool verbose) {
   if (verbose) std::cout << " ";
   if (summaryFile_) summaryFile_->Close();
 
-  return true;
+  bool result = true;
+  if (exportQueue_) {
+    exportQueue_ = nullptr;
+    result = exportImages(exportQueue);
+    if (checkExport_) result &= checkExportedImages(exportQueue);
+  }
+
+  return result;
+}
+
+// Print the queued image files with a pool of exportWorkers_ processes (ROOT graphics is not thread safe): the site
+// process and its forked children pick the images from a shared counter, the most expensive ones first. Each image is
+// printed by a single process from the very same canvas as in the serial case, so the files are not affected
+bool RootWSite::exportImages(RootWImageExportQueue& exportQueue) {
+  profileScope("Exporting images");
+  vector<int> order(exportQueue.size());
+  for (unsigned int i=0; i<order.size(); ++i) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&exportQueue](int a, int b) { return exportQueue[a].cost > exportQueue[b].cost; });
+
+  std::atomic<int>* nextExport = (std::atomic<int>*) mmap(NULL, sizeof(std::atomic<int>), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (nextExport==MAP_FAILED) {
+    cerr << "Couldn't share the image export queue between processes: printing the images serially" << endl;
+    for (auto& myExport : exportQueue) myExport.print();
+    return true;
+  }
+  new (nextExport) std::atomic<int>(0);
+
+  // Flush the streams, so that the children don't write out the buffered output once more
+  cout << flush; cerr << flush;
+  vector<pid_t> workers;
+  for (int i=1; i<exportWorkers_; ++i) {
+    pid_t pid = fork();
+    if (pid==0) {
+      for (int next = (*nextExport)++; next < (int)order.size(); next = (*nextExport)++) exportQueue[order[next]].print();
+      _exit(EXIT_SUCCESS); // Skip the exit handlers of the parent (ROOT, open files)
+    } else if (pid>0) {
+      workers.push_back(pid);
+    } else {
+      cerr << "Couldn't fork image export worker: continuing with " << workers.size()+1 << " processes" << endl;
+      break;
+    }
+  }
+  for (int next = (*nextExport)++; next < (int)order.size(); next = (*nextExport)++) exportQueue[order[next]].print();
+
+  bool result = true;
+  for (auto pid : workers) {
+    int status;
+    if (waitpid(pid, &status, 0)!=pid || !WIFEXITED(status) || WEXITSTATUS(status)!=EXIT_SUCCESS) {
+      cerr << "Image export worker " << pid << " failed: some image files may be missing" << endl;
+      result = false;
+    }
+  }
+  munmap(nextExport, sizeof(std::atomic<int>));
+  return result;
+}
+
+// Print every queued image once more, serially, in a scratch directory and compare the files with those printed by the
+// export workers. Only the raster formats are compared: pdf, eps and root files embed their creation date
+bool RootWSite::checkExportedImages(const RootWImageExportQueue& exportQueue) {
+  profileScope("Checking the exported images");
+  namespace fs = boost::filesystem;
+  fs::path scratchDirectory = fs::temp_directory_path() / fs::unique_path("tklayout-export-%%%%-%%%%");
+  if (!fs::create_directory(scratchDirectory)) {
+    cerr << "Couldn't create directory " << scratchDirectory.string() << ": exported images not checked" << endl;
+    return false;
+  }
+
+  auto isRaster = [](const string& fileName) {
+    string extension = fs::path(fileName).extension().string();
+    return extension==".png" || extension==".gif" || extension==".jpg";
+  };
+  auto sameContents = [](const string& fileName1, const string& fileName2) {
+    std::ifstream file1(fileName1.c_str(), ios::binary), file2(fileName2.c_str(), ios::binary);
+    if (!file1 || !file2) return false;
+    return std::equal(std::istreambuf_iterator<char>(file1), std::istreambuf_iterator<char>(),
+                      std::istreambuf_iterator<char>(file2)) && file2.peek()==EOF;
+  };
+
+  int numCompared = 0;
+  int numDifferent = 0;
+  for (unsigned int i=0; i<exportQueue.size(); ++i) {
+    const RootWImageExport& myExport = exportQueue[i];
+    RootWImageExport serialExport(myExport);
+    vector<pair<string, string> > comparisons; // printed by the workers, printed serially
+    auto redirect = [&](string& fileName) {
+      string serialFileName = (scratchDirectory / (any2str(i) + "_" + fs::path(fileName).filename().string())).string();
+      if (isRaster(fileName)) comparisons.push_back(make_pair(fileName, serialFileName));
+      fileName = serialFileName;
+    };
+    redirect(serialExport.smallFileName);
+    for (auto& largeFileName : serialExport.largeFileNames) redirect(largeFileName);
+    serialExport.print();
+
+    for (const auto& comparison : comparisons) {
+      numCompared++;
+      if (!sameContents(comparison.first, comparison.second)) {
+        numDifferent++;
+        cerr << "Image " << comparison.first << " differs from its serial print" << endl;
+      }
+    }
+  }
+  fs::remove_all(scratchDirectory);
+
+  if (numDifferent) cerr << numDifferent << " of " << numCompared << " exported images differ from their serial print" << endl;
+  else cout << "All " << numCompared << " exported images are identical to their serial print" << endl;
+  return numDifferent==0;
 }
 
 TFile* RootWSite::getSummaryFile() {
@@ -1,5 +1,6 @@
 #include "Sensor.hh"
 #include "DetectorModule.hh"
+#include "RayIntersection.hh"
 
 void Sensor::check() {
   PropertyObject::check();
@@ -57,7 +58,13 @@ void Sensor::clearPolys() {
 std::pair<XYZVector, int> Sensor::checkHitSegment(const XYZVector& trackOrig, const XYZVector& trackDir) const {
   const Polygon3d<4>& poly = hitPoly();
   XYZVector p;
-  if (poly.isLineIntersecting(trackOrig, trackDir, p)) {
+  bool crossed;
+  if (RayIntersection::isClosedForm()) {
+    double t;
+    crossed = RayIntersection::crossSensor(poly, trackOrig, trackDir, t);
+    if (crossed) p = trackOrig + t * trackDir;
+  } else crossed = poly.isLineIntersecting(trackOrig, trackDir, p);
+  if (crossed) {
     XYZVector v = p - poly.getVertex(0);
     double projL = v.Dot((poly.getVertex(1) - poly.getVertex(0)).Unit());
     return std::make_pair(p, projL / stripLength()); 
@@ -11,6 +11,33 @@
 #include "ReportIrradiation.hh"
 
 namespace insur {
+  namespace {
+    /**
+     * Set a property in the parsed configuration. The path elements are separated by '/', each of them being either
+     * a key or key:value, so that "Tracker:Outer/Barrel:TBPS/Layer:1/radius" selects the radius of layer 1 of
+     * barrel TBPS. A key without value selects all the children with that key; the property is added where missing.
+     */
+    void setConfigurationProperty(boost::property_tree::ptree& pt, const std::vector<std::string>& path, unsigned int level, const std::string& value) {
+      std::string key = path[level];
+      std::string data;
+      bool selectData = key.find(':') != std::string::npos;
+      if (selectData) {
+        data = key.substr(key.find(':') + 1);
+        key = key.substr(0, key.find(':'));
+      }
+
+      bool found = false;
+      for (auto& child : pt) {
+        if (child.first != key || (selectData && child.second.data() != data)) continue;
+        found = true;
+        if (level + 1 == path.size()) child.second.put_value(value);
+        else setConfigurationProperty(child.second, path, level + 1, value);
+      }
+      if (!found && level + 1 == path.size()) pt.add_child(boost::property_tree::ptree::path_type(key, '\0'), boost::property_tree::ptree(value));
+      else if (!found) logWARNING("Configuration override: no " + path[level] + " found for " + join<std::string>(path.begin(), path.end(), "/"));
+    }
+  }
+
   // public
   /**
    * The constructor sets the internal pointers to <i>NULL</i>.
@@ -65,23 +92,44 @@ namespace insur {
     tr = NULL;
     px = NULL;
 
-    std::ifstream ifs(getGeometryFile());
+    using namespace boost::property_tree;
+    ptree pt;
+    std::string expandedConfiguration;
+    std::string geometryFile = getGeometryFile();
+    ConfigIncludeTree includeTree;
+    std::ifstream ifs(geometryFile);
     if (ifs.fail()) {
-      std::cerr << "ERROR: cannot open geometry file " << getGeometryFile() << std::endl;
+      std::cerr << "ERROR: cannot open geometry file " << geometryFile << std::endl;
       return false;
     }
     startTaskClock("Building tracker and pixel");
-    std::stringstream ss;
-    ConfigInputOutput mainConfig(ifs, ss);
-    mainConfig.absoluteFileName=getGeometryFile();
-    mainConfig.relativeFileName=getGeometryFile();
-    mainConfig.standardInclude=false;
-    mainConfig.webOutput = webOutput;
-    mainConfiguration.preprocessConfiguration(mainConfig);
-    t2c.addConfigFile(tk2CMSSW::ConfigFile{getGeometryFile(), ss.str()});
-    using namespace boost::property_tree;
-    ptree pt;
-    info_parser::read_info(ss, pt);
+    profileScope("Parsing the configuration");
+    bool cachedConfiguration = configCache_.load(geometryFile, expandedConfiguration, pt, includeTree);
+    if (cachedConfiguration) {
+      mainConfiguration.replayConfigurationGraph(includeTree, webOutput);
+    } else {
+      std::stringstream ss;
+      ConfigInputOutput mainConfig(ifs, ss);
+      mainConfig.absoluteFileName=geometryFile;
+      mainConfig.relativeFileName=geometryFile;
+      mainConfig.standardInclude=false;
+      mainConfig.webOutput = webOutput;
+      mainConfig.includeTree = &includeTree;
+      mainConfiguration.preprocessConfiguration(mainConfig);
+      expandedConfiguration = ss.str();
+      info_parser::read_info(ss, pt);
+      configCache_.save(geometryFile, expandedConfiguration, pt, includeTree);
+    }
+    for (const auto& configurationOverride : configurationOverrides_) {
+      setConfigurationProperty(pt, split<std::string>(configurationOverride.first, "/"), 0, configurationOverride.second);
+    }
+    // The configuration exported with the geometry must be the overridden one
+    if (!configurationOverrides_.empty()) {
+      std::ostringstream overriddenConfiguration;
+      info_parser::write_info(overriddenConfiguration, pt);
+      expandedConfiguration = overriddenConfiguration.str();
+    }
+    t2c.addConfigFile(tk2CMSSW::ConfigFile{geometryFile, expandedConfiguration});
 
     /*
     class CoordExportVisitor : public ConstGeometryVisitor {
@@ -121,11 +169,14 @@ namespace insur {
     try {
       auto childRange = getChildRange(pt, "Tracker");
       std::for_each(childRange.first, childRange.second, [&](const ptree::value_type& kv) {
+        profileScope("Building the tracker geometry");
         Tracker* t = new Tracker();
         t->setup();
         t->myid(kv.second.data());
         t->store(kv.second);
         t->build();
+        if (ModuleClasses::isEnabled()) ModuleClasses::classify(*t);
+        if (PhiSymmetry::isEnabled()) PhiSymmetry::record(*t);
         if (t->myid() == "Pixels") px = t;
         else { tr = t; }
       });
@@ -171,6 +222,14 @@ namespace insur {
       return false;
     }
 
+    // The modules built from a cached configuration are checked against those recorded with the cache entry,
+    // the modules built from a freshly parsed one are recorded (overridden configurations are not cached as such)
+    if (configCache_.enabled() && configurationOverrides_.empty()) {
+      std::vector<const Tracker*> trackers;
+      for (Tracker* t : {tr, px}) if (t) trackers.push_back(t);
+      if (!cachedConfiguration || !configCache_.checkModules(geometryFile, trackers)) configCache_.saveModules(geometryFile, trackers);
+    }
+
     stopTaskClock();
     return true;
   }
@@ -310,6 +369,8 @@ namespace insur {
   bool Squid::createMaterialBudget(bool verbose) {
     if (tr) {
       if (!is) is = new InactiveSurfaces();
+      a.clearTrackSamples();
+      pixelAnalyzer.clearTrackSamples();
       if (mb) delete mb;
       mb  = new MaterialBudget(*tr, *is);
       if (tkMaterialCalc.initDone()) tkMaterialCalc.reset();
@@ -498,6 +559,7 @@ namespace insur {
 
     bool result = site.makeSite(false);
     stopTaskClock();
+    if (StopWatch::isProfiling()) result &= StopWatch::instance()->writeProfile(site.getTargetDirectory());
     return result;
   }
 
@@ -567,10 +629,11 @@ namespace insur {
       stopTaskClock();
     }
     startTaskClock("Creating trigger efficiency plots");
+    // With a material budget, the tracks come from the sample shared with the tagged tracking
     a.analyzeTriggerEfficiency(*tr,
                                mainConfiguration.getTriggerMomenta(),
                                mainConfiguration.getThresholdProbabilities(),
-                               tracks);
+                               tracks, mb, pm);
     stopTaskClock();
     return true;
   }
@@ -583,7 +646,14 @@ namespace insur {
   bool Squid::pureAnalyzeMaterialBudget(int tracks, bool triggerResolution, bool triggerPatternReco, bool debugResolution) {
     if (mb) {
 //      startTaskClock(!trackingResolution ? "Analyzing material budget" : "Analyzing material budget and estimating resolution");
-      // TODO: insert the creation of sample tracks here, to compute intersections only once
+      if (triggerResolution) {
+        // Sample tracks shared by the resolution and trigger efficiency analyses: intersections are computed only once
+        // (the pattern recognition draws its own sample, at the centres of its eta bins; the material budget shoots
+        // from a fixed origin up to another eta, and the geometry analysis draws its own eta, so both keep their tracks)
+        startTaskClock("Creating sample tracks");
+        a.createTrackSample(*mb, pm, tracks);
+        stopTaskClock();
+      }
       startTaskClock("Analyzing material budget" );
       a.analyzeMaterialBudget(*mb, mainConfiguration.getMomenta(), tracks, pm);
       stopTaskClock();
@@ -804,6 +874,69 @@ namespace insur {
     }
   }
 
+  /**
+   * Summarize the layout with a few key figures, for the comparison of layout variants: module counts,
+   * power dissipation, radiation length and pT resolution at the given values of eta.
+   * The material figures need the material budget analysis, the resolution ones the tracking resolution analysis
+   * @return True if there were no errors during processing, false otherwise
+   */
+  bool Squid::computeKeyFigures(const std::vector<double>& etaValues, double pt, const std::string& trackingTag, std::vector<std::pair<std::string, double> >& figures) {
+    if (!tr) {
+      logERROR(err_no_tracker);
+      return false;
+    }
+    startTaskClock("Computing the key figures of the layout");
+
+    class PowerSummer : public ConstGeometryVisitor {
+    public:
+      double totalPower = 0;
+      void visit(const DetectorModule& m) override { totalPower += m.sensorsIrradiationPowerMean() + m.totalPower() * Units::mW; } // W
+    };
+
+    figures.clear();
+    for (Tracker* t : {tr, px}) {
+      if (!t) continue;
+      figures.push_back(std::make_pair(t->myid() + " modules", t->modules().size()));
+
+      IrradiationPowerVisitor irradiation;
+      irradiation.preVisit();
+      SimParms::getInstance().accept(irradiation);
+      t->accept(irradiation);
+      irradiation.postVisit();
+      PowerSummer powerSummer;
+      t->accept(powerSummer);
+      figures.push_back(std::make_pair(t->myid() + " power [kW]", powerSummer.totalPower / 1000.));
+    }
+
+    if (mb) {
+      TH1D& radiation = a.getHistoGlobalR();
+      for (double eta : etaValues) {
+        figures.push_back(std::make_pair("x/X0 at eta=" + any2str(eta), radiation.GetBinContent(radiation.FindBin(eta))));
+      }
+
+      // Resolution of the closest track in eta, as the graph points follow the tracks
+      int parameter = pt * Units::GeV / Units::MeV;
+      std::map<int, TGraph>& ptGraphs = a.getGraphBag().getTaggedGraphs(GraphBag::RealGraph | GraphBag::RhoGraph_Pt, trackingTag);
+      if (ptGraphs.count(parameter)) {
+        const TGraph& ptGraph = ptGraphs[parameter];
+        for (double eta : etaValues) {
+          int closest = -1;
+          for (int i = 0; i < ptGraph.GetN(); i++) {
+            if (closest < 0 || fabs(ptGraph.GetX()[i] - eta) < fabs(ptGraph.GetX()[closest] - eta)) closest = i;
+          }
+          if (closest >= 0) {
+            figures.push_back(std::make_pair("dpT/pT [%] at eta=" + any2str(eta) + ", pT=" + any2str(pt) + " GeV", ptGraph.GetY()[closest]));
+          }
+        }
+      } else {
+        logWARNING("No " + trackingTag + " pT resolution computed for pT = " + any2str(pt) + " GeV");
+      }
+    }
+
+    stopTaskClock();
+    return true;
+  }
+
   void Squid::setBasename(std::string newBasename) {
     baseName_ = newBasename;
   }
@@ -818,6 +951,36 @@ namespace insur {
     htmlDir_ = htmlDir;
   }
 
+  void Squid::setCheckSpatialIndex(bool check) {
+    a.setCheckSpatialIndex(check);
+    pixelAnalyzer.setCheckSpatialIndex(check);
+  }
+
+  void Squid::setNumThreads(int numThreads) {
+    a.setNumThreads(numThreads);
+    pixelAnalyzer.setNumThreads(numThreads);
+  }
+
+  void Squid::setExportProcesses(int numProcesses, bool check) {
+    site.setExportWorkers(numProcesses);
+    site.setCheckExport(check);
+  }
+
+  void Squid::setPatternRecoErrors(PatternRecoErrors errors) {
+    a.setPatternRecoErrors(errors);
+    pixelAnalyzer.setPatternRecoErrors(errors);
+  }
+
+  void Squid::setConfigCache(const std::string& directory, ConfigCache::Check check) {
+    configCache_.setDirectory(directory);
+    configCache_.setCheck(check);
+  }
+
+
+  void Squid::setConfigurationOverrides(const std::vector<std::pair<std::string, std::string> >& overrides) {
+    configurationOverrides_ = overrides;
+  }
+
 
   std::string Squid::getGeometryFile() {
     if (myGeometryFile_ == "") {
@@ -1,9 +1,67 @@
 #include <StopWatch.hh>
 
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+#include <sys/resource.h>
+
+namespace {
+
+  // Scope open in the current thread, with the counters when it was opened
+  struct OpenScope {
+    int node;
+    std::chrono::steady_clock::time_point wallStart;
+    double cpuStart;
+    double childCpuStart;
+    long rssStartKb;
+  };
+  thread_local std::vector<OpenScope> openScopes;
+
+  double threadCpuSeconds() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec*1e-9;
+  }
+
+  double childCpuSeconds() {
+    rusage usage;
+    getrusage(RUSAGE_CHILDREN, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec)*1e-6;
+  }
+
+  long processPeakRssKb() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+  }
+
+  // Current resident memory of the process, 0 where /proc is not available
+  long currentRssKb() {
+    std::ifstream statm("/proc/self/statm");
+    long totalPages, residentPages;
+    if (!(statm >> totalPages >> residentPages)) return 0;
+    return residentPages * (sysconf(_SC_PAGESIZE) / 1024);
+  }
+
+  std::string jsonString(const std::string& text) {
+    std::ostringstream result;
+    result << '"';
+    for (char c : text) {
+      if (c == '"' || c == '\\') result << '\\' << c;
+      else if ((unsigned char)c < 0x20) result << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec;
+      else result << c;
+    }
+    result << '"';
+    return result.str();
+  }
+}
 
 // Global static pointer used to ensure a single instance of the class
 StopWatch* StopWatch::myInstance_ = NULL;
+bool StopWatch::profiling_ = false;
 
 // Returns the instance (if already present) or creates one if needed
 StopWatch* StopWatch::instance() {
@@ -28,6 +86,7 @@ StopWatch::StopWatch() {
   lastVerbosity_ = 0;
   verbosity_ = 1000;
   reportTime_ = true;
+  mainThreadNode_ = 0;
 } 
 
 /* Object destructor */
@@ -36,6 +95,7 @@ StopWatch::~StopWatch() {
 } 
 
 void StopWatch::startCounter(std::string message) {
+  if (profiling_) openScope(message);
   startTimes_.push_back(clock());
   if (startTimes_.size()<=verbosity_) {
     std::cout << std::endl;
@@ -51,6 +111,7 @@ double StopWatch::stopCounter() {
     clock_t startTime = startTimes_.back();
     startTimes_.pop_back();
     timeSeconds = diffClock(stopTime, startTime);
+    if (profiling_) closeScope();
     if (startTimes_.size()<verbosity_) {
       if (startTimes_.size()<lastVerbosity_) std::cout << std::endl;
       std::cout << "done" ;
@@ -78,3 +139,152 @@ double StopWatch::diffClock(const clock_t& stopTime, const clock_t& startTime) {
   return diffs;
 }
 
+
+/**
+ * Start recording the call tree, from the calling thread, which is taken as the main one
+ */
+void StopWatch::setProfiling(bool profiling) {
+  std::lock_guard<std::mutex> lock(profileMutex_);
+  if (profiling && nodes_.empty()) {
+    profileStart_ = std::chrono::steady_clock::now();
+    nodes_.push_back(ProfileNode{"tkLayout", -1, {}, {}, 1, 0, 0, 0, 0, 0});
+    threads_.push_back(std::this_thread::get_id());
+  }
+  profiling_ = profiling;
+}
+
+// Index of the current thread, registering it at its first scope (profileMutex_ locked)
+int StopWatch::threadIndex() {
+  std::thread::id id = std::this_thread::get_id();
+  for (unsigned int i=0; i<threads_.size(); ++i) if (threads_[i]==id) return i;
+  threads_.push_back(id);
+  return threads_.size()-1;
+}
+
+void StopWatch::openScope(const std::string& name) {
+  OpenScope scope;
+  {
+    std::lock_guard<std::mutex> lock(profileMutex_);
+    if (nodes_.empty()) return;
+    bool mainThread = threadIndex()==0;
+    int parent = !openScopes.empty() ? openScopes.back().node : (mainThread ? 0 : mainThreadNode_);
+    auto child = nodes_[parent].childByName.find(name);
+    if (child != nodes_[parent].childByName.end()) scope.node = child->second;
+    else {
+      scope.node = nodes_.size();
+      nodes_.push_back(ProfileNode{name, parent, {}, {}, 0, 0, 0, 0, 0, 0});
+      nodes_[parent].children.push_back(scope.node);
+      nodes_[parent].childByName[name] = scope.node;
+    }
+    if (mainThread) mainThreadNode_ = scope.node;
+  }
+  scope.rssStartKb = currentRssKb();
+  scope.childCpuStart = childCpuSeconds();
+  scope.cpuStart = threadCpuSeconds();
+  scope.wallStart = std::chrono::steady_clock::now();
+  openScopes.push_back(scope);
+}
+
+void StopWatch::closeScope() {
+  if (openScopes.empty()) return;
+  std::chrono::steady_clock::time_point wallStop = std::chrono::steady_clock::now();
+  double cpuStop = threadCpuSeconds();
+  double childCpuStop = childCpuSeconds();
+  long rssIncrease = currentRssKb();
+  long processPeakRss = processPeakRssKb();
+  OpenScope scope = openScopes.back();
+  openScopes.pop_back();
+  rssIncrease -= scope.rssStartKb;
+
+  std::lock_guard<std::mutex> lock(profileMutex_);
+  ProfileNode& node = nodes_[scope.node];
+  double wallSeconds = std::chrono::duration<double>(wallStop - scope.wallStart).count();
+  node.calls++;
+  node.wallSeconds += wallSeconds;
+  node.cpuSeconds += cpuStop - scope.cpuStart;
+  node.childCpuSeconds += childCpuStop - scope.childCpuStart;
+  node.rssIncreaseKb = std::max(node.rssIncreaseKb, rssIncrease);
+  node.processPeakRssKb = processPeakRss;
+
+  int thread = threadIndex();
+  if (thread==0) mainThreadNode_ = node.parent;
+  events_.push_back(TraceEvent{scope.node, thread, std::chrono::duration<double, std::micro>(scope.wallStart - profileStart_).count(),
+                               wallSeconds*1e6, cpuStop - scope.cpuStart, rssIncrease, processPeakRss});
+}
+
+StopWatch::ScopeTotals StopWatch::scopeTotals(const std::string& name) {
+  std::lock_guard<std::mutex> lock(profileMutex_);
+  ScopeTotals totals{0, 0, 0, 0, 0};
+  for (const auto& node : nodes_) {
+    if (node.name != name) continue;
+    totals.calls += node.calls;
+    totals.wallSeconds += node.wallSeconds;
+    totals.cpuSeconds += node.cpuSeconds;
+    totals.rssIncreaseKb = std::max(totals.rssIncreaseKb, node.rssIncreaseKb);
+    totals.processPeakRssKb = std::max(totals.processPeakRssKb, node.processPeakRssKb);
+  }
+  return totals;
+}
+
+void StopWatch::writeNode(std::ostream& output, int node, int depth) const {
+  const ProfileNode& n = nodes_[node];
+  std::string indent(2*depth, ' ');
+  output << indent << "{\"name\": " << jsonString(n.name) << ", \"calls\": " << n.calls
+         << ", \"wall_s\": " << n.wallSeconds << ", \"cpu_s\": " << n.cpuSeconds << ", \"child_processes_cpu_s\": " << n.childCpuSeconds
+         << ", \"rss_increase_kb\": " << n.rssIncreaseKb << ", \"process_peak_rss_kb\": " << n.processPeakRssKb << ", \"children\": [";
+  for (unsigned int i=0; i<n.children.size(); ++i) {
+    output << (i ? ",\n" : "\n");
+    writeNode(output, n.children[i], depth+1);
+  }
+  if (!n.children.empty()) output << "\n" << indent;
+  output << "]}";
+}
+
+/**
+ * Write the call tree recorded so far in profile.json, and the scopes as Chrome trace events in profile_trace.json
+ * @param directory Where to write the files, usually the web site directory
+ * @return True if both files were written
+ */
+bool StopWatch::writeProfile(const std::string& directory) {
+  std::lock_guard<std::mutex> lock(profileMutex_);
+  if (nodes_.empty()) return true;
+
+  // The whole run, up to now
+  ProfileNode& run = nodes_[0];
+  run.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - profileStart_).count();
+  run.cpuSeconds = double(clock())/CLOCKS_PER_SEC;
+  run.childCpuSeconds = childCpuSeconds();
+  run.rssIncreaseKb = currentRssKb();
+  run.processPeakRssKb = processPeakRssKb();
+
+  std::string treeFileName = directory + "/profile.json";
+  std::ofstream tree(treeFileName);
+  tree << std::setprecision(6);
+  tree << "{\"threads\": " << threads_.size() << ", \"profile\":\n";
+  writeNode(tree, 0, 1);
+  tree << "\n}" << std::endl;
+  tree.close();
+
+  std::string traceFileName = directory + "/profile_trace.json";
+  std::ofstream trace(traceFileName);
+  trace << std::fixed << std::setprecision(3);
+  trace << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  for (unsigned int i=0; i<threads_.size(); ++i) {
+    trace << (i ? ",\n" : "\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << getpid() << ", \"tid\": " << i
+          << ", \"args\": {\"name\": \"" << (i ? "worker " + std::to_string(i) : std::string("main")) << "\"}}";
+  }
+  for (const auto& event : events_) {
+    trace << ",\n{\"name\": " << jsonString(nodes_[event.node].name) << ", \"cat\": \"tklayout\", \"ph\": \"X\", \"pid\": " << getpid()
+          << ", \"tid\": " << event.thread << ", \"ts\": " << event.startMicroseconds << ", \"dur\": " << event.durationMicroseconds
+          << ", \"args\": {\"cpu_ms\": " << event.cpuSeconds*1e3 << ", \"rss_increase_kb\": " << event.rssIncreaseKb
+          << ", \"process_peak_rss_kb\": " << event.processPeakRssKb << "}}";
+  }
+  trace << "\n]}" << std::endl;
+  trace.close();
+
+  if (!tree || !trace) {
+    logERROR("Cannot write the profile files " + treeFileName + " and " + traceFileName);
+    return false;
+  }
+  return true;
+}
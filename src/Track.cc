@@ -6,6 +6,7 @@
 #include "Track.hh"
 
 #include <algorithm>
+#include <array>
 #include <cstdlib>
 
 #include <global_constants.hh>
@@ -19,6 +20,125 @@
 using namespace ROOT::Math;
 using namespace std;
 
+CovarianceBackend Track::s_covarianceBackend = CovarianceBackend::TMATRIX;
+
+namespace {
+
+  template<unsigned int NPar> using SymMatrix = SMatrix<double, NPar, NPar, MatRepSym<double, NPar> >;
+
+  //
+  // Hit of the range used in the fit, as seen by the closed-form covariance computation
+  //
+  template<unsigned int NPar> struct FitPoint {
+    double rPos;                    // Hit radius
+    double msThetaOverSinSq;        // Multiple scattering on this hit, affecting all the following hits
+    bool   active;                  // Measurement (true) or pure scatterer (false)
+    double resolution;              // Measurement error (active hits only)
+    std::array<double, NPar> diffs; // Derivatives of the measurement wrt the track parameters (active hits only)
+  };
+
+  //
+  // Compute the covariance matrix C = (D^T * V^-1 * D)^-1 of the track parameters without filling nor inverting the NxN variance matrix
+  // element by element. The MS part of V(r,c), hit r being before hit c, is Sum_i<r ms_i*(R_r-R_i)*(R_c-R_i) = B2(r) + (R_c-R_r)*B1(r),
+  // where B1(r) = Sum_i<r ms_i*(R_r-R_i) and B2(r) = Sum_i<r ms_i*(R_r-R_i)^2 are accumulated hit after hit. V = L*L^T is then Cholesky
+  // decomposed, so that D^T * V^-1 * D = (L^-1 * D)^T * (L^-1 * D) only needs a forward substitution.
+  // Return false if V is not positive definite or D^T * V^-1 * D is singular
+  //
+  template<unsigned int NPar> bool computeCovarianceByCholesky(const std::vector<FitPoint<NPar> >& points, SymMatrix<NPar>& cov) {
+
+    // MS sums at each active hit
+    std::vector<const FitPoint<NPar>*> actives;
+    std::vector<double> msB1, msB2;
+    double a0 = 0., b1 = 0., b2 = 0.;
+    for (unsigned int j=0; j<points.size(); j++) {
+
+      if (j>0) {
+        double d = points[j].rPos - points[j-1].rPos;
+        a0 += points[j-1].msThetaOverSinSq;
+        b2 += 2*d*b1 + d*d*a0;
+        b1 += d*a0;
+      }
+      if (points[j].active) {
+        actives.push_back(&points[j]);
+        msB1.push_back(b1);
+        msB2.push_back(b2);
+      }
+    }
+
+    // Lower triangle of V, decomposed in place into L
+    int n = actives.size();
+    std::vector<double> L(n*n, 0.);
+    for (int r=0; r<n; r++) {
+      for (int c=r; c<n; c++) L[c*n + r] = msB2[r] + (actives[c]->rPos - actives[r]->rPos) * msB1[r];
+      L[r*n + r] += actives[r]->resolution * actives[r]->resolution;
+    }
+    for (int j=0; j<n; j++) {
+
+      double diag = L[j*n + j];
+      for (int k=0; k<j; k++) diag -= L[j*n + k] * L[j*n + k];
+      if (!(diag>0)) return false;
+      diag = sqrt(diag);
+      L[j*n + j] = diag;
+
+      for (int i=j+1; i<n; i++) {
+        double sum = L[i*n + j];
+        for (int k=0; k<j; k++) sum -= L[i*n + k] * L[j*n + k];
+        L[i*n + j] = sum / diag;
+      }
+    }
+
+    // Forward substitution L*Y = D, summing up the information matrix Y^T*Y row by row
+    SymMatrix<NPar> info;
+    std::vector<std::array<double, NPar> > Y(n);
+    for (int i=0; i<n; i++) {
+      for (unsigned int p=0; p<NPar; p++) {
+        double sum = actives[i]->diffs[p];
+        for (int k=0; k<i; k++) sum -= L[i*n + k] * Y[k][p];
+        Y[i][p] = sum / L[i*n + i];
+      }
+      for (unsigned int p=0; p<NPar; p++) {
+        for (unsigned int q=p; q<NPar; q++) info(p, q) += Y[i][p] * Y[i][q];
+      }
+    }
+
+    cov = info;
+    return cov.Invert();
+  }
+
+  //
+  // Copy a fixed-size covariance matrix to its TMatrix counterpart
+  //
+  template<unsigned int NPar> void copyCovariance(const SymMatrix<NPar>& cov, TMatrixT<double>& target) {
+    target.ResizeTo(NPar, NPar);
+    for (unsigned int i=0; i<NPar; i++) {
+      for (unsigned int j=0; j<NPar; j++) target(i, j) = cov(i, j);
+    }
+  }
+
+  //
+  // Cross-check the closed-form covariance matrix against the TMatrix one: each element is compared relative to sqrt(C(i,i)*C(j,j))
+  //
+  template<unsigned int NPar> void validateCovariance(const std::string& projection, const TMatrixT<double>& reference, const SymMatrix<NPar>& cov, bool covDone) {
+
+    static const double tolerance = 1e-9;
+
+    if (!covDone) {
+      logERROR("Covariance matrix in "+projection+" -> computed with TMatrix, but not in closed form!");
+      return;
+    }
+    for (unsigned int i=0; i<NPar; i++) {
+      for (unsigned int j=0; j<NPar; j++) {
+
+        double scale = sqrt(fabs(reference(i, i) * reference(j, j)));
+        if (fabs(cov(i, j) - reference(i, j)) > tolerance*scale) {
+          logWARNING("Covariance matrix in "+projection+" -> closed form differs from TMatrix at ("+any2str(i)+","+any2str(j)+"): "
+                   +any2str(cov(i, j))+" vs "+any2str(reference(i, j)));
+        }
+      }
+    }
+  }
+}
+
 //
 // Track constructor -> need to use setter methods to set: 2 of these [theta, phi, eta, cot(theta)] & 2 of these [mag. field, transv. momentum, radius]
 //
@@ -32,11 +152,16 @@ Track::Track() :
   m_covRPhiDone(false),
   m_covRZDone(false),
   m_refPointRPosCache(0),
-  m_propagOutInCache(true)
+  m_propagOutInCache(true),
+  m_incrStarted(false),
+  m_incrPropagOutIn(true),
+  m_incrNextHit(0),
+  m_incrRPos(0),
+  m_incrNMeasurable(0)
 {}
 
 //
-// Track copy-constructor -> creates deep copy of hit vector
+// Track copy-constructor -> creates copy of hit vector, the copied hits share their geometry (copy-on-write) with the original ones
 //
 Track::Track(const Track& track) {
 
@@ -65,6 +190,14 @@ Track::Track(const Track& track) {
   m_covMatrixRZ.ResizeTo(track.m_covMatrixRZ);
   m_covMatrixRZ = track.m_covMatrixRZ;
 
+  m_incrStarted        = track.m_incrStarted;
+  m_incrPropagOutIn    = track.m_incrPropagOutIn;
+  m_incrNextHit        = track.m_incrNextHit;
+  m_incrRPos           = track.m_incrRPos;
+  m_incrNMeasurable    = track.m_incrNMeasurable;
+  m_incrInfoMatrixRPhi = track.m_incrInfoMatrixRPhi;
+  m_incrInfoMatrixRZ   = track.m_incrInfoMatrixRZ;
+
   for (auto& iHit : track.m_hits) {
     HitPtr hit(new Hit(*iHit));
     addHit(std::move(hit));
@@ -73,7 +206,7 @@ Track::Track(const Track& track) {
 }
 
 //
-// Assign operator with deep copy of hit vector
+// Assign operator with copy of hit vector, the copied hits sharing their geometry with the original ones
 //
 Track& Track::operator= (const Track& track) {
 
@@ -107,6 +240,14 @@ Track& Track::operator= (const Track& track) {
   m_covMatrixRZ.ResizeTo(track.m_covMatrixRZ);
   m_covMatrixRZ = track.m_covMatrixRZ;
 
+  m_incrStarted        = track.m_incrStarted;
+  m_incrPropagOutIn    = track.m_incrPropagOutIn;
+  m_incrNextHit        = track.m_incrNextHit;
+  m_incrRPos           = track.m_incrRPos;
+  m_incrNMeasurable    = track.m_incrNMeasurable;
+  m_incrInfoMatrixRPhi = track.m_incrInfoMatrixRPhi;
+  m_incrInfoMatrixRZ   = track.m_incrInfoMatrixRZ;
+
   for (auto& iHit : track.m_hits) {
     HitPtr hit(new Hit(*iHit));
     addHit(std::move(hit));
@@ -433,6 +574,187 @@ double Track::getDeltaCTau() {
   return deltaCTau;
 }
 
+//
+// Start an incremental (Kalman-like) propagation of the track parameter errors. The hits are then fitted one by one in the propagation direction:
+// inside-out if propagOutIn is false, outside-in otherwise, only keeping the running information matrices (inverse covariance matrices) of the track
+// parameters in R-Phi & s-Z. These are expressed at the radius r_c of the last fitted hit: f(r) = d + phi*(r-r_c) + rho*(r-r_c)^2/2 and
+// z(r) = z + cotg(theta)*(r-r_c), which keeps them well conditioned, and transported from hit to hit as I -> F^-T*I*F^-1. A measurement adds 1/sigma^2
+// to the (d,d) or (z,z) element, the MS on a hit is a random kink of phi (cotg(theta)) added to the covariance matrix, i.e. by Woodbury formula
+// I -> I - I*g*g^T*I / (1/msTheta + g^T*I*g) with g the kinked parameter. As the model is linear, the predicted errors are the same as those of
+// the global fit done by getDeltaD/getDeltaZ with the same ref. point & propagator direction (const B field assumed).
+//
+void Track::startIncrementalErrors(bool propagOutIn/*=true*/) {
+
+  // Sort hits based on particle direction: in-out or out-in (if needed)
+  if (m_reSortHits) {
+
+    bool bySmallerRadius = true;
+    if (m_pt>=0) sortHits(bySmallerRadius);
+    else         sortHits(!bySmallerRadius);
+    m_reSortHits = false;
+  }
+
+  m_incrStarted       = true;
+  m_incrPropagOutIn   = propagOutIn;
+  m_incrNextHit       = propagOutIn ? int(m_hits.size())-1 : 0;
+  m_incrRPos          = 0.;
+  m_incrNMeasurable   = 0;
+  m_incrInfoMatrixRPhi= IncrInfoMatrixRPhi();
+  m_incrInfoMatrixRZ  = IncrInfoMatrixRZ();
+}
+
+//
+// Transport the information matrices of the incremental error propagation to a new radius: I -> F^-T*I*F^-1, F being the linear propagator
+//
+void Track::transportIncrementalErrors(double rPos) {
+
+  double deltaR = rPos - m_incrRPos;
+  m_incrRPos    = rPos;
+  if (deltaR==0) return;
+
+  // R-Phi: (rho, phi, d) -> (rho, phi + rho*deltaR, d + phi*deltaR + rho*deltaR^2/2)
+  double invPropagRPhi[3][3] = {{ 1., 0., 0. }, { -deltaR, 1., 0. }, { deltaR*deltaR/2., -deltaR, 1. }};
+  IncrInfoMatrixRPhi infoRPhi;
+  for (int p=0; p<3; p++) {
+    for (int q=p; q<3; q++) {
+      for (int k=0; k<3; k++) {
+        for (int l=0; l<3; l++) infoRPhi(p, q) += invPropagRPhi[k][p]*m_incrInfoMatrixRPhi(k, l)*invPropagRPhi[l][q];
+      }
+    }
+  }
+  m_incrInfoMatrixRPhi = infoRPhi;
+
+  // s-Z: (cotg(theta), z) -> (cotg(theta), z + cotg(theta)*deltaR)
+  double invPropagRZ[2][2] = {{ 1., 0. }, { -deltaR, 1. }};
+  IncrInfoMatrixRZ infoRZ;
+  for (int p=0; p<2; p++) {
+    for (int q=p; q<2; q++) {
+      for (int k=0; k<2; k++) {
+        for (int l=0; l<2; l++) infoRZ(p, q) += invPropagRZ[k][p]*m_incrInfoMatrixRZ(k, l)*invPropagRZ[l][q];
+      }
+    }
+  }
+  m_incrInfoMatrixRZ = infoRZ;
+}
+
+//
+// Fit all hits lying in front of the ref. point (in propagation direction), which haven't been used by the incremental error propagation yet
+//
+void Track::addIncrementalHits(double refPointRPos) {
+
+  for (; m_incrNextHit>=0 && m_incrNextHit<int(m_hits.size()); m_incrNextHit += (m_incrPropagOutIn ? -1 : +1)) {
+
+    Hit& hit    = *m_hits.at(m_incrNextHit);
+    double rPos = hit.getRPos();
+    if (( m_incrPropagOutIn && !(refPointRPos<rPos)) ||
+        (!m_incrPropagOutIn && !(refPointRPos>rPos))) break;
+
+    transportIncrementalErrors(rPos);
+
+    // Measurement of d & z at the hit
+    if (hit.isActive()) {
+
+      double precRPhi = hit.getResolutionRphi(getRadius(hit.getZPos()));
+      double precRZ   = hit.getResolutionZ(getRadius(hit.getZPos()));
+      m_incrInfoMatrixRPhi(2, 2) += 1./precRPhi/precRPhi;
+      m_incrInfoMatrixRZ(1, 1)   += 1./precRZ/precRZ;
+    }
+    // Hits counted as in the global fit (see computeCovarianceMatrixRPhi)
+    if (hit.isMeasurable()) m_incrNMeasurable++;
+
+    // MS on this hit affects all the hits fitted afterwards (kink of phi & cotg(theta) at the hit)
+    double msThetaRPhi = computeMSThetaOverSinSqRPhi(hit);
+    if (msThetaRPhi>0) {
+
+      double infoKink[3] = { m_incrInfoMatrixRPhi(0, 1), m_incrInfoMatrixRPhi(1, 1), m_incrInfoMatrixRPhi(2, 1) };
+      double norm        = 1./msThetaRPhi + m_incrInfoMatrixRPhi(1, 1);
+      for (int p=0; p<3; p++) {
+        for (int q=p; q<3; q++) m_incrInfoMatrixRPhi(p, q) -= infoKink[p]*infoKink[q]/norm;
+      }
+    }
+
+    double msThetaRZ = computeMSThetaOverSinSqRZ(hit);
+    if (msThetaRZ>0) {
+
+      double infoKink[2] = { m_incrInfoMatrixRZ(0, 0), m_incrInfoMatrixRZ(1, 0) };
+      double norm        = 1./msThetaRZ + m_incrInfoMatrixRZ(0, 0);
+      for (int p=0; p<2; p++) {
+        for (int q=p; q<2; q++) m_incrInfoMatrixRZ(p, q) -= infoKink[p]*infoKink[q]/norm;
+      }
+    }
+  }
+}
+
+//
+// Get DeltaD at refPoint [rPos, zPos] using the incremental error propagation: all hits in front of the ref. point are fitted first (see startIncrementalErrors)
+//
+double Track::getIncrementalDeltaD(double refPointRPos) {
+
+  double deltaD = -1.;
+
+  if (!m_incrStarted) {
+    logERROR("Track::getIncrementalDeltaD(): Incremental error propagation not started!");
+    return deltaD;
+  }
+  if (m_pt<0) {
+    logWARNING("Track::getIncrementalDeltaD(): Incremental error propagation of particle traversing outside-in not yet implemented.");
+    return deltaD;
+  }
+
+  addIncrementalHits(fabs(refPointRPos));
+  if (m_incrNMeasurable<3) return deltaD;
+
+  IncrInfoMatrixRPhi covMatrix(m_incrInfoMatrixRPhi);
+  if (!covMatrix.Invert()) return deltaD;
+
+  // Propagate the covariance matrix from the last fitted hit to the ref. point
+  double deltaR        = fabs(refPointRPos) - m_incrRPos;
+  double propagator[3] = { deltaR*deltaR/2., deltaR, 1. };
+  double deltaDSq      = 0.;
+  for (int p=0; p<3; p++) {
+    for (int q=0; q<3; q++) deltaDSq += propagator[p]*covMatrix(p, q)*propagator[q];
+  }
+  if (deltaDSq>=0) deltaD = sqrt(deltaDSq);
+
+  // TODO: Not working correctly for B = B(z) & [r,z]!=[0,0], so print warning ...
+  if (refPointRPos!=0. && !SimParms::getInstance().isMagFieldConst()) {
+
+    logWARNING("Track::getIncrementalDeltaD(): Mathematical method to get deltaD at [r,z]!=[0,0] in non const. B field not implemented, hence returned value at ref. point computed as in a const. B field.");
+  }
+
+  return deltaD;
+}
+
+//
+// Get DeltaZ at refPoint [rPos, zPos] using the incremental error propagation: all hits in front of the ref. point are fitted first (see startIncrementalErrors)
+//
+double Track::getIncrementalDeltaZ(double refPointRPos) {
+
+  double deltaZ = -1.;
+
+  if (!m_incrStarted) {
+    logERROR("Track::getIncrementalDeltaZ(): Incremental error propagation not started!");
+    return deltaZ;
+  }
+  if (m_pt<0) {
+    logWARNING("Track::getIncrementalDeltaZ(): Incremental error propagation of particle traversing outside-in not yet implemented.");
+    return deltaZ;
+  }
+
+  addIncrementalHits(fabs(refPointRPos));
+  if (m_incrNMeasurable<2) return deltaZ;
+
+  IncrInfoMatrixRZ covMatrix(m_incrInfoMatrixRZ);
+  if (!covMatrix.Invert()) return deltaZ;
+
+  // Propagate the covariance matrix from the last fitted hit to the ref. point
+  double deltaR   = fabs(refPointRPos) - m_incrRPos;
+  double deltaZSq = covMatrix(1,1) + 2*deltaR*covMatrix(0,1) + deltaR*deltaR*covMatrix(0,0);
+  if (deltaZSq>=0) deltaZ = sqrt(deltaZSq);
+
+  return deltaZ;
+}
+
 //
 // Adds a new hit to the track (hit radius automatically updated)
 //
@@ -452,6 +774,7 @@ void Track::addHit(HitPtr newHit) {
   m_reSortHits  = true;
   m_covRPhiDone = false;
   m_covRZDone   = false;
+  m_incrStarted = false;
 }
 
 //
@@ -481,6 +804,7 @@ void Track::addIPConstraint(double dr, double dz) {
   m_reSortHits  = true;
   m_covRPhiDone = false;
   m_covRZDone   = false;
+  m_incrStarted = false;
 }
 
 //
@@ -521,6 +845,7 @@ const Polar3DVector& Track::setThetaPhiPt(const double& newTheta, const double&
   m_reSortHits  = true;
   m_covRPhiDone = false;
   m_covRZDone   = false;
+  m_incrStarted = false;
 
   return m_direction;
 }
@@ -532,6 +857,7 @@ void Track::resetPt(double newPt) {
   if (newPt*m_pt<0) m_reSortHits = true;
   m_covRPhiDone = false;
   m_covRZDone   = false;
+  m_incrStarted = false;
 
   m_pt = newPt;
 
@@ -611,6 +937,7 @@ void Track::keepTaggedHitsOnly(const string& tag, bool useIP /*=true*/) {
   // Cov. matrices need to be recalculated
   m_covRPhiDone = false;
   m_covRZDone   = false;
+  m_incrStarted = false;
 }
 
 //
@@ -627,6 +954,7 @@ void Track::removeMaterial() {
   // Cov. matrices need to be recalculated
   m_covRPhiDone = false;
   m_covRZDone   = false;
+  m_incrStarted = false;
 }
 
 //
@@ -1111,6 +1439,69 @@ std::vector<std::pair<const DetectorModule*, HitType>> Track::getHitModules() co
   return result;
 }
 
+//
+// Compute the MS angle^2 / sin^2(theta) caused by the material of a given hit, projected to R-Phi
+//
+double Track::computeMSThetaOverSinSqRPhi(Hit& hit) const {
+
+  // MS theta
+  double msTheta = 0.0;
+
+  // Material in terms of rad. lengths
+  double XtoX0 = hit.getCorrectedMaterial().radiation;
+
+  if (XtoX0>0) {
+
+    // MS error depends on path length = deltaR/sin(theta), so one can precalculate msTheta_real as msTheta/sin^2(theta), which practically means using pT
+    // instead of p & then one has to multiply the msTheta by deltaR to get MS error
+    msTheta = (13.6*Units::MeV * 13.6*Units::MeV) / (m_pt/Units::MeV * m_pt/Units::MeV) * XtoX0 * (1 + 0.038 * log(XtoX0)) * (1 + 0.038 * log(XtoX0));
+
+    // Take into account a propagation of MS error on virtual barrel plane, on which all measurements are evaluated for consistency (global chi2 fit applied) ->
+    // in limit R->inf. propagation along line used, otherwise a very small correction factor coming from the circular shape of particle track is required (similar
+    // approach as for local resolutions)
+    // TODO: Currently, correction mathematicaly derived only for use case of const magnetic field -> more complex mathematical expression expected in non-const B field
+    // (hence correction not applied in such case)
+    double A = 0;
+    if (SimParms::getInstance().isMagFieldConst()) A = hit.getRPos()/2./getRadius(hit.getZPos());     // r_i/2R
+    double corrFactor = 1 + A*A*cos(m_theta)*cos(m_theta)/(1-A*A);
+
+    msTheta *= corrFactor;
+  }
+
+  return msTheta;
+}
+
+//
+// Compute the MS angle^2 / sin^2(theta) caused by the material of a given hit, projected to s-Z
+//
+double Track::computeMSThetaOverSinSqRZ(Hit& hit) const {
+
+  // MS theta
+  double msTheta = 0.0;
+
+  // Material in terms of rad. lengths
+  double XtoX0 = hit.getCorrectedMaterial().radiation;
+
+  if (XtoX0>0) {
+    // MS error depends on path length = deltaR/sin(theta), so one can precalculate msTheta_real as msTheta/sin^2(theta), which practically means using pT
+    // instead of p & then one has to multiply the msTheta by deltaR to get MS error
+    msTheta = (13.6*Units::MeV * 13.6*Units::MeV) / (m_pt/Units::MeV * m_pt/Units::MeV) * XtoX0 * (1 + 0.038 * log(XtoX0)) * (1 + 0.038 * log(XtoX0));
+
+    // Take into account a propagation of MS error on virtual barrel plane, on which all measurements are evaluated for consistency (global chi2 fit applied) ->
+    // in limit R->inf. propagation along line used, otherwise a very small correction factor coming from the circular shape of particle track is required (similar
+    // approach as for local resolutions)
+    // TODO: Currently, correction mathematicaly derived only for use case of const magnetic field -> more complex mathematical expression expected in non-const B field
+    // (hence correction not applied in such case)
+    double A = 0;
+    if (SimParms::getInstance().isMagFieldConst()) A = hit.getRPos()/2./getRadius(hit.getZPos());  // r_i/2R
+    double corrFactor = pow( cos(m_theta)*cos(m_theta)/sin(m_theta)/sqrt(1-A*A) + sin(m_theta) ,2); // Without correction it would be 1/sin(theta)^2
+
+    msTheta *=corrFactor;
+  }
+
+  return msTheta;
+}
+
 //
 // Compute 3x3 covariance matrix of the track parameters in R-Phi projection, using NxN (N hits = K+L: K active hits on detectors + L passive (artificial) hits due to material)
 // Ref. point dictates, whether Multiple scattering effects need to be calculated inside-out or outside-in. MS effect is symmetric as regards track fitting. PropagOutIn variable
@@ -1121,8 +1512,6 @@ bool Track::computeCovarianceMatrixRPhi(double refPointRPos, bool propagOutIn) {
 
   // Matrix size
   int nHits = m_hits.size();
-  m_varMatrixRPhi.ResizeTo(nHits,nHits);
-  m_varMatrixRPhi.Zero();
 
   //
   // Find hit index ranges relevant for MS effects calculation based on requirements on refPoint & propagation direction
@@ -1181,38 +1570,42 @@ bool Track::computeCovarianceMatrixRPhi(double refPointRPos, bool propagOutIn) {
   // Get contributions from Multiple Couloumb scattering
   std::vector<double> msThetaOverSinSq;
 
-  for (int i=iStart; i<iEnd; i++) {
-
-    // MS theta
-    double msTheta = 0.0;
-
-    // Material in terms of rad. lengths
-    double XtoX0 = m_hits.at(i)->getCorrectedMaterial().radiation;
-    //std::cout << std::fixed << std::setprecision(4) << "Material (" << i << ") = " << XtoX0 << "\t at r=" << m_hits.at(i)->getRadius(m_hits.at(i)->getZPos()) << "\t of type=" << m_hits.at(i)->getObjectKind() << std::endl;
-
-    if (XtoX0>0) {
-
-      // MS error depends on path length = deltaR/sin(theta), so one can precalculate msTheta_real as msTheta/sin^2(theta), which practically means using pT
-      // instead of p & then one has to multiply the msTheta by deltaR to get MS error
-      msTheta = (13.6*Units::MeV * 13.6*Units::MeV) / (m_pt/Units::MeV * m_pt/Units::MeV) * XtoX0 * (1 + 0.038 * log(XtoX0)) * (1 + 0.038 * log(XtoX0));
+  for (int i=iStart; i<iEnd; i++) msThetaOverSinSq.push_back(computeMSThetaOverSinSqRPhi(*m_hits.at(i)));
 
-      // Take into account a propagation of MS error on virtual barrel plane, on which all measurements are evaluated for consistency (global chi2 fit applied) ->
-      // in limit R->inf. propagation along line used, otherwise a very small correction factor coming from the circular shape of particle track is required (similar
-      // approach as for local resolutions)
-      // TODO: Currently, correction mathematicaly derived only for use case of const magnetic field -> more complex mathematical expression expected in non-const B field
-      // (hence correction not applied in such case)
-      double A = 0;
-      if (SimParms::getInstance().isMagFieldConst()) A = m_hits.at(i)->getRPos()/2./getRadius(m_hits.at(i)->getZPos());     // r_i/2R
-      double corrFactor = 1 + A*A*cos(m_theta)*cos(m_theta)/(1-A*A);
-
-      msTheta *= corrFactor;
+  //
+  // Closed-form computation of the 3x3 covariance matrix, without the NxN variance matrix
+  SymMatrix<3> fastCov;
+  bool fastCovDone = false;
+  if (s_covarianceBackend != CovarianceBackend::TMATRIX) {
+
+    std::vector<FitPoint<3> > points;
+    for (int i=iStart; i<=iEnd; i++) {
+
+      FitPoint<3> point;
+      point.rPos             = m_hits.at(i)->getRPos();
+      point.msThetaOverSinSq = (i<iEnd ? msThetaOverSinSq.at(i-iStart) : 0.);
+      point.active           = m_hits.at(i)->isActive();
+      point.resolution       = 0.;
+      if (point.active) {
+        point.resolution = m_hits.at(i)->getResolutionRphi(getRadius(m_hits.at(i)->getZPos()));
+        point.diffs      = {{ computeDfOverDRho(point.rPos, m_hits.at(i)->getZPos()), point.rPos, 1. }};
+      }
+      points.push_back(point);
     }
-    else {
-      msTheta = 0;
+    fastCovDone = computeCovarianceByCholesky(points, fastCov);
+
+    if (s_covarianceBackend == CovarianceBackend::SMATRIX) {
+      m_varMatrixRPhi.ResizeTo(0, 0);
+      if (fastCovDone) copyCovariance(fastCov, m_covMatrixRPhi);
+      else logWARNING("Variance matrix V(NxN) in R-Phi -> not positive definite or singular covariance matrix");
+      if (m_pt>=0 && !propagOutIn) sortHits(bySmallerR); // Important -> resort back
+      return fastCovDone;
     }
-    msThetaOverSinSq.push_back(msTheta);
   }
 
+  m_varMatrixRPhi.ResizeTo(nHits,nHits);
+  m_varMatrixRPhi.Zero();
+
   //
   // Calculate the variance matrix with all correlation terms: c is column, r is row (hits are assumed to be sorted)
   for (int c=iStart ; c<=iEnd; c++) {
@@ -1333,6 +1726,7 @@ bool Track::computeCovarianceMatrixRPhi(double refPointRPos, bool propagOutIn) {
   // Get covariance matrix using global chi2 fit: C = cov(i,j) = (D^T * V^-1 * D)^-1
   m_covMatrixRPhi = diffsT * V.Invert() * diffs;
   m_covMatrixRPhi.Invert();
+  if (s_covarianceBackend == CovarianceBackend::VALIDATE) validateCovariance("R-Phi", m_covMatrixRPhi, fastCov, fastCovDone);
 
   // Sort-back hits based on particle direction if they were resorted
   if (m_pt>=0 && !propagOutIn) sortHits(bySmallerR);
@@ -1351,9 +1745,6 @@ bool Track::computeCovarianceMatrixRZ(double refPointRPos, bool propagOutIn) {
   // Matrix size
   int nHits = m_hits.size();
 
-  m_varMatrixRZ.ResizeTo(nHits,nHits);
-  m_varMatrixRZ.Zero();
-
   //
   // Find hit index ranges relevant for MS effects calculation based on requirements on refPoint & propagation direction
   int iStart          = nHits;
@@ -1414,36 +1805,42 @@ bool Track::computeCovarianceMatrixRZ(double refPointRPos, bool propagOutIn) {
   // needed factor to project the scattering angle on an horizontal surface
   std::vector<double> msThetaOverSinSq;
 
-  for (int i=iStart; i<iEnd; i++) {
+  for (int i=iStart; i<iEnd; i++) msThetaOverSinSq.push_back(computeMSThetaOverSinSqRZ(*m_hits.at(i)));
 
-    // MS theta
-    double msTheta = 0.0;
-
-    // Material in terms of rad. lengths
-    double XtoX0 = m_hits.at(i)->getCorrectedMaterial().radiation;
-
-    if (XtoX0>0) {
-      // MS error depends on path length = deltaR/sin(theta), so one can precalculate msTheta_real as msTheta/sin^2(theta), which practically means using pT
-      // instead of p & then one has to multiply the msTheta by deltaR to get MS error
-      msTheta = (13.6*Units::MeV * 13.6*Units::MeV) / (m_pt/Units::MeV * m_pt/Units::MeV) * XtoX0 * (1 + 0.038 * log(XtoX0)) * (1 + 0.038 * log(XtoX0));
-
-      // Take into account a propagation of MS error on virtual barrel plane, on which all measurements are evaluated for consistency (global chi2 fit applied) ->
-      // in limit R->inf. propagation along line used, otherwise a very small correction factor coming from the circular shape of particle track is required (similar
-      // approach as for local resolutions)
-      // TODO: Currently, correction mathematicaly derived only for use case of const magnetic field -> more complex mathematical expression expected in non-const B field
-      // (hence correction not applied in such case)
-      double A = 0;
-      if (SimParms::getInstance().isMagFieldConst()) A = m_hits.at(i)->getRPos()/2./getRadius(m_hits.at(i)->getZPos());  // r_i/2R
-      double corrFactor = pow( cos(m_theta)*cos(m_theta)/sin(m_theta)/sqrt(1-A*A) + sin(m_theta) ,2); // Without correction it would be 1/sin(theta)^2
-
-      msTheta *=corrFactor;
+  //
+  // Closed-form computation of the 2x2 covariance matrix, without the NxN variance matrix
+  SymMatrix<2> fastCov;
+  bool fastCovDone = false;
+  if (s_covarianceBackend != CovarianceBackend::TMATRIX) {
+
+    std::vector<FitPoint<2> > points;
+    for (int i=iStart; i<=iEnd; i++) {
+
+      FitPoint<2> point;
+      point.rPos             = m_hits.at(i)->getRPos();
+      point.msThetaOverSinSq = (i<iEnd ? msThetaOverSinSq.at(i-iStart) : 0.);
+      point.active           = m_hits.at(i)->isActive();
+      point.resolution       = 0.;
+      if (point.active) {
+        point.resolution = m_hits.at(i)->getResolutionZ(getRadius(m_hits.at(i)->getZPos()));
+        point.diffs      = {{ point.rPos, 1. }};
+      }
+      points.push_back(point);
     }
-    else {
-      msTheta = 0;
+    fastCovDone = computeCovarianceByCholesky(points, fastCov);
+
+    if (s_covarianceBackend == CovarianceBackend::SMATRIX) {
+      m_varMatrixRZ.ResizeTo(0, 0);
+      if (fastCovDone) copyCovariance(fastCov, m_covMatrixRZ);
+      else logWARNING("Variance matrix V(NxN) in R-Z (s-Z) -> not positive definite or singular covariance matrix");
+      if (m_pt>=0 && !propagOutIn) sortHits(bySmallerR); // Important -> resort back
+      return fastCovDone;
     }
-    msThetaOverSinSq.push_back(msTheta);
   }
 
+  m_varMatrixRZ.ResizeTo(nHits,nHits);
+  m_varMatrixRZ.Zero();
+
   //
   // Calculate the variance matrix with all correlation terms: c is column, r is row (hits are assumed to be sorted)
   for (int c=iStart ; c<=iEnd; c++) {
@@ -1566,6 +1963,7 @@ bool Track::computeCovarianceMatrixRZ(double refPointRPos, bool propagOutIn) {
   // Get covariance matrix using global chi2 fit: C = cov(i,j) = (D^T * V^-1 * D)^-1
   m_covMatrixRZ = diffsT * V.Invert() * diffs;
   m_covMatrixRZ.Invert();
+  if (s_covarianceBackend == CovarianceBackend::VALIDATE) validateCovariance("R-Z (s-Z)", m_covMatrixRZ, fastCov, fastCovDone);
 
   // Sort-back hits based on particle direction if they were resorted
   if (m_pt>=0 && !propagOutIn) sortHits(bySmallerR);
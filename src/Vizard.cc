@@ -9,6 +9,7 @@
 #include <TPolyLine.h>
 #include <TPaveText.h>
 #include <ReportModuleCount.hh>
+#include <StopWatch.hh>
 
 #include <boost/filesystem.hpp>
 
@@ -381,6 +382,7 @@ namespace insur {
 
   // TODO: if weightGrid is actually unused, then remove it
   void Vizard::weigthSummart(Analyzer& a, WeightDistributionGrid& weightGrid, RootWSite& site, std::string name) {
+    profileScope("Weight summary");
     RootWContent* myContent;
 
     // Initialize the page with the material budget
@@ -435,6 +437,7 @@ namespace insur {
    * @param name a qualifier that goes in parenthesis in the title (outer or strip, for example)
    */
   void Vizard::histogramSummary(Analyzer& a, MaterialBudget& materialBudget, bool debugServices, RootWSite& site, std::string name) {
+    profileScope("Material summary");
     materialBudgets_.push_back(&materialBudget);
     
     // Initialize the page with the material budget
@@ -1265,6 +1268,7 @@ namespace insur {
    * Create all Outer Tracker cabling plots and csv files, and display them on website.
    */
   bool Vizard::outerCablingSummary(Analyzer& analyzer, Tracker& tracker, RootWSite& site) {
+    profileScope("Outer cabling summary");
     bool isPixelTracker = tracker.isPixelTracker();
 
     if (!isPixelTracker) {
@@ -1636,6 +1640,7 @@ namespace insur {
    * Create all Inner Tracker cabling plots and csv files, and display them on website.
    */
   bool Vizard::innerCablingSummary(Analyzer& analyzer, Tracker& tracker, RootWSite& site) {
+    profileScope("Inner cabling summary");
     bool isPixelTracker = tracker.isPixelTracker();
 
     if (isPixelTracker) {
@@ -1976,6 +1981,7 @@ namespace insur {
    * @param site the RootWSite object for the output
    */
   bool Vizard::geometrySummary(Analyzer& analyzer, Tracker& tracker, InactiveSurfaces* inactive, RootWSite& site, bool& debugResolution, std::string name) {
+    profileScope("Geometry summary");
     trackers_.push_back(&tracker);
 
     std::map<std::string, double>& tagMapWeight = analyzer.getTagWeigth();
@@ -3295,6 +3301,7 @@ namespace insur {
   }
 
   void Vizard::totalMaterialSummary(Analyzer& analyzer, Analyzer& pixelAnalyzer, RootWSite& site) {
+    profileScope("Total material summary");
     // Pointer to an image to create on the fly
     RootWImage* myImage;
     RootWPage& myPage = site.addPage("Material (total)");
@@ -3464,6 +3471,7 @@ namespace insur {
 
   bool Vizard::additionalInfoSite(const std::string& settingsfile,
                                   Analyzer& analyzer, Analyzer& pixelAnalyzer, Tracker& tracker, RootWSite& site) {
+    profileScope("Additional info");
     RootWPage* myPage = new RootWPage("Info");
     myPage->setAddress("info.html");
 
@@ -3623,6 +3631,7 @@ namespace insur {
 
 
   bool Vizard::bandwidthSummary(Analyzer& analyzer, Tracker& tracker, RootWSite& site) {
+    profileScope("Bandwidth summary");
     RootWPage* myPage = new RootWPage("Bandwidth");
     myPage->setAddress("bandwidth.html");
     site.addPage(myPage);
@@ -3778,6 +3787,7 @@ namespace insur {
 
 
   bool Vizard::triggerProcessorsSummary(Analyzer& analyzer, Tracker& tracker, RootWSite& site) {
+    profileScope("Trigger processors summary");
     RootWPage* myPage = new RootWPage("Trigger CPUs");
     RootWTextFile* myTextFile;
     myPage->setAddress("trigger_cpus.html");
@@ -3910,6 +3920,7 @@ namespace insur {
   }
 
   bool Vizard::errorSummary(Analyzer& a, RootWSite& site, std::string additionalTag, bool isTrigger) {
+    profileScope("Resolution summary");
 
     //********************************//
     //*                              *//
@@ -4304,6 +4315,7 @@ namespace insur {
   }
 
   bool Vizard::taggedErrorSummary(Analyzer& analyzer, RootWSite& site) {
+    profileScope("Tagged resolution summary");
 
     //********************************//
     //*                              *//
@@ -5344,6 +5356,7 @@ namespace insur {
   }
 
   bool Vizard::patternRecoSummary(Analyzer& a, mainConfigHandler& mainConfig, RootWSite& site) {
+    profileScope("Pattern recognition summary");
 
     bool isVisOK = true;
 
@@ -6037,6 +6050,7 @@ namespace insur {
   }
 
   bool Vizard::triggerSummary(Analyzer& a, Tracker& tracker, RootWSite& site, bool extended) {
+    profileScope("Trigger summary");
     //********************************//
     //*                              *//
     //*   Page with the trigger      *//
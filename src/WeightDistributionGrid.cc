@@ -1,17 +1,65 @@
 #include "WeightDistributionGrid.hh"
 #include "MaterialObject.hh"
+#include "MessageLogger.hh"
 #include <algorithm>
+#include <cmath>
+#include <sstream>
 
 namespace material {
 
+  bool WeightDistributionGrid::checkStorage_ = false;
+
+  namespace {
+    // Floor division and modulo, for the negative z bins
+    int tileOf(int binIndex) { return binIndex >= 0 ? binIndex / WeightDistributionGrid::tileBins : -1 - (-1 - binIndex) / WeightDistributionGrid::tileBins; }
+    int offsetIn(int binIndex) { return binIndex - tileOf(binIndex) * WeightDistributionGrid::tileBins; }
+  }
+
   WeightDistributionGrid::WeightDistributionGrid(double binDimension) :
-    binDimension_(binDimension) {}
+    binDimension_(binDimension),
+    lastTile_(nullptr) {}
+
+  double& WeightDistributionGrid::bin(int binIndexZ, int binIndexR) {
+    TileIndex tileIndex(tileOf(binIndexZ), tileOf(binIndexR));
+    if (lastTile_ == nullptr || tileIndex != lastTileIndex_) {
+      std::vector<double>& tile = tiles_[tileIndex];
+      if (tile.empty()) tile.assign(tileBins * tileBins, 0.);
+      lastTileIndex_ = tileIndex;
+      lastTile_ = &tile;
+    }
+    return (*lastTile_)[offsetIn(binIndexR) * tileBins + offsetIn(binIndexZ)];
+  }
+
+  double WeightDistributionGrid::operator()(int binIndexZ, int binIndexR) const {
+    auto tile = tiles_.find(TileIndex(tileOf(binIndexZ), tileOf(binIndexR)));
+    return tile != tiles_.end() ? tile->second[offsetIn(binIndexR) * tileBins + offsetIn(binIndexZ)] : 0.;
+  }
+
+  /**
+   * All the bins holding some material, keyed by (z, r) bin index
+   */
+  WeightDistributionGridMapType WeightDistributionGrid::bins() const {
+    WeightDistributionGridMapType result;
+    for (const auto& tile : tiles_) {
+      for (int i = 0; i < tileBins * tileBins; i++) {
+        if (tile.second[i] != 0.) result[std::make_pair(tile.first.first * tileBins + i % tileBins, tile.first.second * tileBins + i / tileBins)] = tile.second[i];
+      }
+    }
+    return result;
+  }
+
+  void WeightDistributionGrid::clear() {
+    tiles_.clear();
+    lastTile_ = nullptr;
+    referenceGrams_.clear();
+  }
 
   void WeightDistributionGrid::addTotalGrams(double minZ, double minR, double maxZ, double maxR, double length, double surface, const MaterialObject& materialObject) {
     int binIndexZStart = floor(minZ / binDimension_);
     int binIndexZ = binIndexZStart;
     int binIndexR = floor(minR / binDimension_);
     double binMinZ, binMinR, binMaxZ, binMaxR, zMul, rMul;
+    double totalGrams = materialObject.totalGrams(length, surface);
 
     do {
       binMinR = floor(binIndexR * binDimension_);
@@ -24,8 +72,12 @@ namespace material {
         zMul = std::max(binMinZ, minZ) - std::min(binMaxZ, maxZ);
         rMul = std::max(binMinR, minR) - std::min(binMaxR, maxR);
 
-        operator[](std::make_pair(binIndexZ, binIndexR)) += 
-          (materialObject.totalGrams(length, surface) * zMul * rMul) / ((maxZ - minZ) * (maxR - minR));
+        bin(binIndexZ, binIndexR) += 
+          (totalGrams * zMul * rMul) / ((maxZ - minZ) * (maxR - minR));
+        if (checkStorage_) {
+          referenceGrams_[std::make_pair(binIndexZ, binIndexR)] += 
+            (materialObject.totalGrams(length, surface) * zMul * rMul) / ((maxZ - minZ) * (maxR - minR));
+        }
 
         binIndexZ ++;
       } while (binMaxZ < maxZ);
@@ -35,8 +87,32 @@ namespace material {
     } while (binMinR < maxR);
   }
 
+  /**
+   * Compare the tiled bins with the map filled as before the tiles, when checking the storage
+   * @return True if every bin holds the same grams, up to rounding
+   */
+  bool WeightDistributionGrid::checkStorage() const {
+    WeightDistributionGridMapType stored = bins();
+    int mismatches = 0;
+    double maxRelativeDifference = 0.;
+    for (const auto& reference : referenceGrams_) {
+      auto found = stored.find(reference.first);
+      double grams = found != stored.end() ? found->second : 0.;
+      double difference = fabs(grams - reference.second) / std::max(fabs(reference.second), 1e-300);
+      maxRelativeDifference = std::max(maxRelativeDifference, difference);
+      if (difference > 1e-12) mismatches++;
+      if (found != stored.end()) stored.erase(found);
+    }
+    mismatches += stored.size(); // bins holding material in the tiles only
+    std::ostringstream message;
+    message << "Weight distribution grid: " << referenceGrams_.size() << " bins compared with the map storage, "
+            << mismatches << " differing, largest relative difference " << maxRelativeDifference;
+    if (mismatches > 0) logWARNING(message.str());
+    else logINFO(message.str());
+    return mismatches == 0;
+  }
+
   double WeightDistributionGrid::binDimension() const {
     return binDimension_;
   }
 }
-
@@ -0,0 +1,102 @@
+#include <boost/program_options.hpp>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <BatchScan.hh>
+#include <StopWatch.hh>
+#include <IrradiationMap.hh>
+#include "SvnRevision.hh"
+
+namespace po = boost::program_options;
+
+int main(int argc, char* argv[]) {
+  std::string usage("Usage: ");
+  usage += argv[0];
+  usage += " <layout files and batch descriptions> [options]";
+  int geomtracks, mattracks;
+  int jobs;
+  double pt;
+  std::string etaList, trackingTag, outputDir;
+  std::string configCacheDir, configCacheCheck, irradiationCacheDir;
+  std::vector<std::string> inputs;
+
+  po::options_description shown("Batch options");
+  shown.add_options()
+    ("help,h", "Display this help message.")
+    ("geometry-tracks,n", po::value<int>(&geomtracks)->default_value(100), "N. of tracks for geometry calculations.")
+    ("material-tracks,N", po::value<int>(&mattracks)->default_value(100), "N. of tracks for material calculations.")
+    ("jobs,j", po::value<int>(&jobs)->default_value(1), "N. of layouts analyzed in parallel.")
+    ("eta", po::value<std::string>(&etaList)->default_value("0,1,2,3"), "Values of eta at which material and resolution are compared.")
+    ("pt", po::value<double>(&pt)->default_value(10), "Transverse momentum (GeV) at which the resolution is compared\n(one of the momenta of the analysis).")
+    ("tag", po::value<std::string>(&trackingTag)->default_value("tracker"), "Tracking tag of the compared resolution.")
+    ("output-dir,o", po::value<std::string>(&outputDir)->default_value("batch"), "Directory of the comparison table, figures and logs.")
+    ("sites", "Also make the geometry, power, material and resolution\nweb site of each layout.")
+    ("config-cache", po::value<std::string>(&configCacheDir), "Directory caching the preprocessed and parsed geometry\nconfiguration, reused while its files are unchanged.")
+    ("config-cache-check", po::value<std::string>(&configCacheCheck)->default_value("mtime"), "How the configuration cache is checked: mtime (file sizes\nand modification times), verify (file contents)\nor invalidate (always rebuilt).")
+    ("irradiation-cache", po::value<std::string>(&irradiationCacheDir), "Directory caching the irradiation maps in binary form and the\nmodule fluences, shared by the layouts analyzed in parallel.")
+    ("version,v", "Prints software version (SVN revision) and quits.")
+    ;
+
+  po::options_description hidden;
+  hidden.add_options()
+    ("inputs", po::value<std::vector<std::string> >(&inputs), "Layout files (.cfg) and batch descriptions")
+    ;
+
+  po::positional_options_description posopt;
+  posopt.add("inputs", -1);
+
+  po::options_description allopt;
+  allopt.add(shown).add(hidden);
+
+  po::variables_map vm;
+  try {
+    po::store(po::command_line_parser(argc, argv).options(allopt).positional(posopt).run(), vm);
+    po::notify(vm);
+
+    if (geomtracks < 1) throw po::invalid_option_value("geometry-tracks");
+    if (mattracks < 1) throw po::invalid_option_value("material-tracks");
+    if (jobs < 1) throw po::invalid_option_value("jobs");
+    if (configCacheCheck != "mtime" && configCacheCheck != "verify" && configCacheCheck != "invalidate") throw po::invalid_option_value("config-cache-check");
+    if (inputs.empty() && !vm.count("help") && !vm.count("version")) throw po::error("Missing layout files");
+
+  } catch(po::error e) {
+    std::cerr << "\nERROR: " << e.what() << std::endl << std::endl;
+    std::cout << usage << std::endl << shown << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (vm.count("help")) {
+    std::cout << usage << std::endl << shown << std::endl;
+    return 0;
+  }
+
+  if (vm.count("version")) {
+    std::cout << "tklayout revision " << SvnRevision::revisionNumber << std::endl;
+    return 0;
+  }
+
+  StopWatch::instance()->setVerbosity(1, false);
+
+  // Layout files are analyzed as they are, other files describe layouts and parameter sweeps
+  BatchScan batch;
+  for (const auto& input : inputs) {
+    bool ok = input.size() > 4 && input.substr(input.size() - 4) == ".cfg" ? batch.addLayout(input) : batch.readDescription(input);
+    if (!ok) return EXIT_FAILURE;
+  }
+
+  std::vector<double> etaValues;
+  for (const auto& eta : split<std::string>(etaList, ",")) etaValues.push_back(str2any<double>(eta));
+
+  batch.setJobs(jobs);
+  batch.setTracks(geomtracks, mattracks);
+  batch.setEtaValues(etaValues);
+  batch.setPt(pt);
+  batch.setTrackingTag(trackingTag);
+  batch.setOutputDirectory(outputDir);
+  batch.setWebSites(vm.count("sites"));
+  batch.setConfigCache(configCacheDir, configCacheCheck == "verify" ? ConfigCache::VERIFY : configCacheCheck == "invalidate" ? ConfigCache::INVALIDATE : ConfigCache::MTIME);
+  IrradiationMap::setCacheDirectory(irradiationCacheDir);
+
+  return batch.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,90 @@
+#include <boost/program_options.hpp>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <Benchmark.hh>
+#include <StopWatch.hh>
+#include "SvnRevision.hh"
+
+namespace po = boost::program_options;
+
+int main(int argc, char* argv[]) {
+  std::string usage("Usage: ");
+  usage += argv[0];
+  usage += " [geometry files] [options]";
+  int geomtracks, mattracks;
+  int repetitions;
+  double tolerance, minSeconds;
+  std::string outputDir, baselineFile;
+  std::vector<std::string> geometryFiles;
+
+  po::options_description shown("Benchmark options");
+  shown.add_options()
+    ("help,h", "Display this help message.")
+    ("geometry-tracks,n", po::value<int>(&geomtracks)->default_value(100), "N. of tracks for geometry calculations.")
+    ("material-tracks,N", po::value<int>(&mattracks)->default_value(100), "N. of tracks for material calculations.")
+    ("repeat,r", po::value<int>(&repetitions)->default_value(1), "N. of runs on each geometry, the minimum time\nof each stage being kept.")
+    ("output-dir,o", po::value<std::string>(&outputDir)->default_value("benchmark"), "Directory of the results (benchmark.json) and logs.")
+    ("compare,c", po::value<std::string>(&baselineFile), "Compare the results with a baseline benchmark.json,\nfailing if any stage regressed.")
+    ("tolerance", po::value<double>(&tolerance)->default_value(0.2), "Relative increase of time or memory above which\na stage regressed.")
+    ("min-seconds", po::value<double>(&minSeconds)->default_value(0.5), "Stages shorter than this in both runs are not\ncompared in time (too noisy).")
+    ("version,v", "Prints software version (SVN revision) and quits.")
+    ;
+
+  po::options_description hidden;
+  hidden.add_options()
+    ("geometries", po::value<std::vector<std::string> >(&geometryFiles), "Geometry files (.cfg)")
+    ;
+
+  po::positional_options_description posopt;
+  posopt.add("geometries", -1);
+
+  po::options_description allopt;
+  allopt.add(shown).add(hidden);
+
+  po::variables_map vm;
+  try {
+    po::store(po::command_line_parser(argc, argv).options(allopt).positional(posopt).run(), vm);
+    po::notify(vm);
+
+    if (geomtracks < 1) throw po::invalid_option_value("geometry-tracks");
+    if (mattracks < 1) throw po::invalid_option_value("material-tracks");
+    if (repetitions < 1) throw po::invalid_option_value("repeat");
+    if (tolerance < 0) throw po::invalid_option_value("tolerance");
+  } catch(po::error e) {
+    std::cerr << "\nERROR: " << e.what() << std::endl << std::endl;
+    std::cout << usage << std::endl << shown << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (vm.count("help")) {
+    std::cout << usage << std::endl << shown << std::endl;
+    std::cout << "Without geometry files, the reference geometry geometries/CMS_Phase2/OT614_200_IT404.cfg is benchmarked." << std::endl;
+    return 0;
+  }
+
+  if (vm.count("version")) {
+    std::cout << "tklayout revision " << SvnRevision::revisionNumber << std::endl;
+    return 0;
+  }
+
+  // The reference layout, on which both cabling maps are designed
+  if (geometryFiles.empty()) geometryFiles.push_back("geometries/CMS_Phase2/OT614_200_IT404.cfg");
+
+  StopWatch::instance()->setVerbosity(1, false);
+
+  Benchmark benchmark;
+  for (const auto& geometryFile : geometryFiles) {
+    if (!benchmark.addGeometry(geometryFile)) return EXIT_FAILURE;
+  }
+  benchmark.setRepetitions(repetitions);
+  benchmark.setTracks(geomtracks, mattracks);
+  benchmark.setOutputDirectory(outputDir);
+  benchmark.setTolerance(tolerance);
+  benchmark.setMinSeconds(minSeconds);
+
+  bool ok = benchmark.run();
+  if (!baselineFile.empty()) ok &= benchmark.compare(baselineFile);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
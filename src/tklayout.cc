@@ -3,6 +3,9 @@
 #include <iostream>
 #include <string>
 #include <Squid.hh>
+#include <ParallelBuild.hh>
+#include <RayIntersection.hh>
+#include <IrradiationMap.hh>
 #include "SvnRevision.hh"
 
 namespace po = boost::program_options;
@@ -12,11 +15,18 @@ int main(int argc, char* argv[]) {
   usage += argv[0];
   usage += " <geometry file> [options]";
   int geomtracks, mattracks;
+  int threads;
+  int exportProcesses;
   //std::vector<int> tracksim;
   int verbosity;
   int randseed; 
 
   std::string basename, optfile, xmldir, htmldir;
+  std::string covBackend;
+  std::string triggerRates;
+  std::string patternRecoErrors;
+  std::string intersectionBackend, serviceRouting;
+  std::string configCacheDir, configCacheCheck, irradiationCacheDir;
   
   po::options_description shown("Analysis options");
   shown.add_options()
@@ -31,6 +41,7 @@ int main(int argc, char* argv[]) {
     ("resolution,r", "Report resolution analysis.")
     ("debug-resolution,R", "Report extended resolution analysis : debug plots for modules parametrized spatial resolution.")
     ("pattern-reco,P", "Report pattern recognition analysis.")
+    ("pattern-reco-errors", po::value<std::string>(&patternRecoErrors)->default_value("refit"), "Pattern recognition errors (used with 'P'): refit (track\nrefitted for every hit), incremental (Kalman-like error\npropagation) or validate (both, cross-checked).")
     ("outerCablingMap", "Outer Tracker : Build an optical cabling map, which connects each module to a bundle, cable, DTC + Build a power cabling map. Also provide info on routing of services through channels.")
     ("innerCablingMap", "Inner Tracker: Build an optical cabling map.")
     ("trigger,t", "Report base trigger analysis.")
@@ -43,6 +54,7 @@ int main(int argc, char* argv[]) {
     ("verbosity", po::value<int>(&verbosity)->default_value(1), "Levels of details in the program's output (overridden by the option 'quiet').")
     ("quiet", "No output is produced, except the required messages (equivalent to verbosity 0, overrides the option 'verbosity')")
     ("performance", "Outputs the CPU time needed for each computing step (overrides the option 'quiet').")
+    ("profile", "Records the wall-clock and CPU time and the resident memory growth\nof the nested computing steps (with the process peak memory), written to profile.json and profile_trace.json\n(Chrome trace format) in the web site directory.")
     ("randseed", po::value<int>(&randseed)->default_value(0xcafebabe), "Set the random seed\nIf explicitly set to 0, seed is random")
     ;
     
@@ -66,6 +78,25 @@ int main(int argc, char* argv[]) {
   otheropt.add_options()
     ("version,v", "Prints software version (SVN revision) and quits.")
     ("webOutput,w", "Prepares the output for web publishing (local running is assumed otherwise).")
+    ("check-spatial-index", "Cross-checks every hit search done through the module spatial index against the brute-force scan of all modules (slow).")
+    ("threads", po::value<int>(&threads)->default_value(1), "N. of threads sharing the material budget eta scan.")
+    ("export-processes", po::value<int>(&exportProcesses)->default_value(1), "N. of processes printing the web site images.")
+    ("check-image-export", "Prints the web site images once more serially after the\nexport processes, and checks that the png files are identical.")
+    ("covariance-backend", po::value<std::string>(&covBackend)->default_value("tmatrix"), "Track covariance computation: tmatrix, smatrix (closed form)\nor validate (both, cross-checked).")
+    ("trigger-rates", po::value<std::string>(&triggerRates)->default_value("direct"), "Integration of the particle and true stub rates over pt:\ndirect, tabulated (cumulative tables shared by the modules\nwith the same stub parameters, radius and |z|; may differ\nslightly from direct for cuts off the table grid) or validate\n(both, cross-checked).")
+    ("intersection-backend", po::value<std::string>(&intersectionBackend)->default_value("area"), "Test of tracks against the sensors: area (plane crossing, then\nsum of triangle areas) or moller-trumbore (closed-form\nbarycentric coordinates, tested in one batch on the spatial\nindex candidates of each track, also replacing the matrix\nsolve of the module crossings).")
+    ("check-weight-grid", "Fills the weight distribution grid from the services and modules,\nboth in its tiled storage and in a map as before, and compares\nthe bins.")
+    ("check-petal-area", "Compares the closed-form trigger petal area with the Monte Carlo\none (100000 random points) at each crossover radius found.")
+    ("fast-trigger-tuning", "Computes the trigger efficiencies of the spacing and window tuning\nonce per set of modules with the same stub parameters, and finds\nthe optimal spacings by root finding instead of profile scans.")
+    ("config-cache", po::value<std::string>(&configCacheDir), "Directory caching the preprocessed and parsed geometry\nconfiguration, reused while its files are unchanged.")
+    ("config-cache-check", po::value<std::string>(&configCacheCheck)->default_value("mtime"), "How the configuration cache is checked: mtime (file sizes\nand modification times), verify (file contents)\nor invalidate (always rebuilt).")
+    ("irradiation-cache", po::value<std::string>(&irradiationCacheDir), "Directory caching the irradiation maps in binary form and the\nmodule fluences, reused while the map files are unchanged.")
+    ("dense-material-storage", "Accumulates masses and material lengths in arrays indexed by\nmaterial and component IDs, instead of maps keyed by name.")
+    ("service-routing", po::value<std::string>(&serviceRouting)->default_value("chained"), "Routing of the services along the sections: chained (walk from\neach source), topological (sources filtered once, then one pass\nover the sections) or validate (both, cross-checked).")
+    ("phi-symmetry", "Detects the smallest phi sector repeated around the layout: the geometry\ntracks are then shot in that sector only, a fraction 1/N of them\nstanding for all the sectors, and the\nirradiation is computed once per set of equivalent modules.\nWithout a symmetry (removed or special modules), the whole\nlayout is analyzed.")
+    ("parallel-build", "Builds the layers of each barrel and the disks of each endcap\nconcurrently, on the number of threads set by --threads.")
+    ("module-classes", "Groups the modules differing only by their phi placement into\nequivalence classes after building the tracker, so that some\nper-module results are computed once per class, and reports\nthe classes and cache hit rates.")
+    ("hit-arena", "Allocates the hits and tracks of the tracking analyses in per-thread\npools, released in bulk at the end of each analysis pass.")
     ;
 
   
@@ -94,6 +125,14 @@ int main(int argc, char* argv[]) {
 
     if (geomtracks < 1) throw po::invalid_option_value("geometry-tracks");
     if (mattracks < 1) throw po::invalid_option_value("material-tracks");
+    if (threads < 1) throw po::invalid_option_value("threads");
+    if (exportProcesses < 1) throw po::invalid_option_value("export-processes");
+    if (covBackend != "tmatrix" && covBackend != "smatrix" && covBackend != "validate") throw po::invalid_option_value("covariance-backend");
+    if (patternRecoErrors != "refit" && patternRecoErrors != "incremental" && patternRecoErrors != "validate") throw po::invalid_option_value("pattern-reco-errors");
+    if (triggerRates != "direct" && triggerRates != "tabulated" && triggerRates != "validate") throw po::invalid_option_value("trigger-rates");
+    if (intersectionBackend != "area" && intersectionBackend != "moller-trumbore") throw po::invalid_option_value("intersection-backend");
+    if (serviceRouting != "chained" && serviceRouting != "topological" && serviceRouting != "validate") throw po::invalid_option_value("service-routing");
+    if (configCacheCheck != "mtime" && configCacheCheck != "verify" && configCacheCheck != "invalidate") throw po::invalid_option_value("config-cache-check");
     if (!vm.count("base-name") && !vm.count("help") && !vm.count("version")) throw po::error("Missing geometry file"); 
 
   } catch(po::error e) {
@@ -122,10 +161,33 @@ int main(int argc, char* argv[]) {
     if (verboseWatch==0) verboseWatch = 1;
   }
   StopWatch::instance()->setVerbosity(verboseWatch, performanceWatch);
+  if (vm.count("profile")) StopWatch::instance()->setProfiling(true);
 
   squid.setGeometryFile(basename);
   squid.webOutput = (vm.count("webOutput")!=0);
   if (htmldir != "") squid.setHtmlDir(htmldir);
+  squid.setCheckSpatialIndex(vm.count("check-spatial-index"));
+  squid.setNumThreads(threads);
+  squid.setExportProcesses(exportProcesses, vm.count("check-image-export"));
+  if (patternRecoErrors == "incremental") squid.setPatternRecoErrors(insur::PatternRecoErrors::INCREMENTAL);
+  else if (patternRecoErrors == "validate") squid.setPatternRecoErrors(insur::PatternRecoErrors::VALIDATE);
+  if (covBackend == "smatrix") Track::setCovarianceBackend(CovarianceBackend::SMATRIX);
+  else if (covBackend == "validate") Track::setCovarianceBackend(CovarianceBackend::VALIDATE);
+  if (triggerRates == "tabulated") PtErrorAdapter::setRateIntegration(RateIntegration::TABULATED);
+  else if (triggerRates == "validate") PtErrorAdapter::setRateIntegration(RateIntegration::VALIDATE);
+  if (intersectionBackend == "moller-trumbore") RayIntersection::setBackend(IntersectionBackend::MOLLER_TRUMBORE);
+  if (vm.count("dense-material-storage")) MaterialProperties::setMassStorage(MaterialProperties::dense_storage);
+  if (serviceRouting == "topological") Materialway::setServiceRouting(Materialway::topological_routing);
+  else if (serviceRouting == "validate") Materialway::setServiceRouting(Materialway::validated_routing);
+  if (vm.count("hit-arena")) AnalysisArena::setAllocation(ArenaAllocation::ARENA);
+  if (vm.count("phi-symmetry")) PhiSymmetry::setEnabled(true);
+  if (vm.count("module-classes")) ModuleClasses::setEnabled(true);
+  if (vm.count("parallel-build")) ParallelBuild::setNumThreads(threads);
+  if (vm.count("fast-trigger-tuning")) TriggerDistanceTuningPlotsVisitor::setFastScan(true);
+  if (vm.count("check-petal-area")) TriggerProcessorBandwidthVisitor::setCheckPetalArea(true);
+  if (vm.count("check-weight-grid")) WeightDistributionGrid::setCheckStorage(true);
+  squid.setConfigCache(configCacheDir, configCacheCheck == "verify" ? ConfigCache::VERIFY : configCacheCheck == "invalidate" ? ConfigCache::INVALIDATE : ConfigCache::MTIME);
+  IrradiationMap::setCacheDirectory(irradiationCacheDir);
 
 
 
@@ -178,6 +240,7 @@ int main(int argc, char* argv[]) {
 
     if (!squid.reportGeometrySite(vm.count("debug-resolution"))) return EXIT_FAILURE;
     if (!squid.additionalInfoSite()) return EXIT_FAILURE;
+    if (vm.count("module-classes")) ModuleClasses::logReport();
     if (!squid.makeSite()) return EXIT_FAILURE;
 
   } else {